@@ -4,33 +4,22 @@
 #
 #-------------------------------------------------
 
-QT       += core gui multimedia
+QT       += core gui multimedia concurrent
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
 TARGET = VideoPlayer_2
 TEMPLATE = app
 
+include(videoplayer_core.pri)
 
 SOURCES += main.cpp \
-    videoplayer.cpp \
-    mainwindow.cpp
+    mainwindow.cpp \
+    videosurface.cpp
 
 HEADERS  += \
-    videoplayer.h \
-    mainwindow.h
+    mainwindow.h \
+    videosurface.h
 
 FORMS    += \
     mainwindow.ui
-
-INCLUDEPATH += $$PWD/ffmpeg/include \
-                $$PWD/src
-
-LIBS += $$PWD/ffmpeg/lib/avcodec.lib \
-        $$PWD/ffmpeg/lib/avdevice.lib \
-        $$PWD/ffmpeg/lib/avfilter.lib \
-        $$PWD/ffmpeg/lib/avformat.lib \
-        $$PWD/ffmpeg/lib/avutil.lib \
-        $$PWD/ffmpeg/lib/postproc.lib \
-        $$PWD/ffmpeg/lib/swresample.lib \
-        $$PWD/ffmpeg/lib/swscale.lib
@@ -0,0 +1,189 @@
+#include "adaptiveencoder.h"
+
+#include <QFile>
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#endif
+
+// 瞬时速度的平滑系数
+static const double kSpeedSmoothing = 0.3;
+// 持续空闲判定需要的速度：实时采集时速度在 1.0 附近
+static const double kHeadroomSpeed = 0.99;
+static const int kMaxUpFactor = 8;
+// 丢帧是零星出现的，最近这段时间内有过丢帧都算过载
+static const int kDropMemoryMs = 2000;
+
+QString EncoderLevel::toText() const
+{
+    return QString("%1 %2 %3fps %4k")
+            .arg(preset)
+            .arg(height > 0 ? QString("%1p").arg(height) : QString("source"))
+            .arg(fps)
+            .arg(bitrateBps / 1000);
+}
+
+AdaptiveEncoder::AdaptiveEncoder()
+    : mLadder(defaultLadder()), mLevel(0), mMaxLevel(mLadder.size() - 1), mSwitches(0),
+      mHoldUntilMs(0), mPressureSinceMs(-1), mHeadroomSinceMs(-1), mLastUpMs(-1), mUpFactor(1),
+      mLastNowMs(-1), mLastOutMs(0), mLastDrops(0), mLastDropMs(-1), mSpeed(-1)
+{
+}
+
+// 0 档与原来固定的编码参数相同，之后先降 preset，再降分辨率和帧率
+QVector<EncoderLevel> AdaptiveEncoder::defaultLadder()
+{
+    QVector<EncoderLevel> ladder;
+    ladder.append({ "medium",    0,   30, 2000000 });
+    ladder.append({ "veryfast",  0,   30, 2000000 });
+    ladder.append({ "superfast", 720, 30, 1500000 });
+    ladder.append({ "ultrafast", 720, 25, 1200000 });
+    ladder.append({ "ultrafast", 540, 20, 800000 });
+    ladder.append({ "ultrafast", 360, 15, 500000 });
+    return ladder;
+}
+
+void AdaptiveEncoder::setLadder(const QVector<EncoderLevel> &ladder)
+{
+    if (ladder.isEmpty())
+        return;
+    mLadder = ladder;
+    setLevelRange(mLevel, -1);
+}
+
+void AdaptiveEncoder::setSettings(const Settings &settings)
+{
+    mSettings = settings;
+}
+
+void AdaptiveEncoder::setLevelRange(int startLevel, int maxLevel)
+{
+    int last = mLadder.size() - 1;
+    mMaxLevel = maxLevel < 0 ? last : qMin(maxLevel, last);
+    mLevel = qBound(0, startLevel, mMaxLevel);
+}
+
+int AdaptiveEncoder::level() const
+{
+    return mLevel;
+}
+
+const EncoderLevel &AdaptiveEncoder::current() const
+{
+    return mLadder.at(mLevel);
+}
+
+int AdaptiveEncoder::switches() const
+{
+    return mSwitches;
+}
+
+double AdaptiveEncoder::speed() const
+{
+    return mSpeed;
+}
+
+void AdaptiveEncoder::restart(qint64 nowMs)
+{
+    mHoldUntilMs = nowMs + mSettings.cooldownMs;
+    mPressureSinceMs = -1;
+    mHeadroomSinceMs = -1;
+    mLastNowMs = -1;       // 新进程的输出时间从 0 开始
+    mLastOutMs = 0;
+    mLastDrops = 0;
+    mLastDropMs = -1;
+    mSpeed = -1;
+}
+
+int AdaptiveEncoder::update(qint64 nowMs, qint64 outTimeMs, qint64 dropFrames, double cpuLoad)
+{
+    if (mLastNowMs >= 0 && dropFrames > mLastDrops)
+        mLastDropMs = nowMs;
+    bool dropping = mLastDropMs >= 0 && nowMs - mLastDropMs <= kDropMemoryMs;
+    if (mLastNowMs >= 0 && nowMs > mLastNowMs) {
+        double instant = double(outTimeMs - mLastOutMs) / double(nowMs - mLastNowMs);
+        mSpeed = mSpeed < 0 ? instant : mSpeed * (1 - kSpeedSmoothing) + instant * kSpeedSmoothing;
+    }
+    mLastNowMs = nowMs;
+    mLastOutMs = outTimeMs;
+    mLastDrops = dropFrames;
+
+    if (nowMs < mHoldUntilMs || mSpeed < 0) {
+        mPressureSinceMs = -1;
+        mHeadroomSinceMs = -1;
+        return -1;
+    }
+
+    bool pressure = mSpeed < mSettings.minSpeed || dropping || (cpuLoad >= 0 && cpuLoad > mSettings.cpuHigh);
+    bool headroom = !pressure && mSpeed >= kHeadroomSpeed && (cpuLoad < 0 || cpuLoad < mSettings.cpuLow);
+    if (!pressure)
+        mPressureSinceMs = -1;
+    else if (mPressureSinceMs < 0)
+        mPressureSinceMs = nowMs;
+    if (!headroom)
+        mHeadroomSinceMs = -1;
+    else if (mHeadroomSinceMs < 0)
+        mHeadroomSinceMs = nowMs;
+
+    if (pressure && nowMs - mPressureSinceMs >= mSettings.downAfterMs && mLevel < mMaxLevel) {
+        // 刚升上来就撑不住，下次升档要等更久，避免来回切换
+        if (mLastUpMs >= 0 && nowMs - mLastUpMs < qint64(mSettings.upAfterMs) * mUpFactor)
+            mUpFactor = qMin(kMaxUpFactor, mUpFactor * 2);
+        return switchTo(mLevel + 1, nowMs);
+    }
+    if (headroom && nowMs - mHeadroomSinceMs >= qint64(mSettings.upAfterMs) * mUpFactor && mLevel > 0) {
+        mLastUpMs = nowMs;
+        return switchTo(mLevel - 1, nowMs);
+    }
+    return -1;
+}
+
+int AdaptiveEncoder::switchTo(int level, qint64 nowMs)
+{
+    mLevel = level;
+    mSwitches++;
+    restart(nowMs);
+    return level;
+}
+
+SystemCpuLoad::SystemCpuLoad()
+    : mLastBusy(0), mLastTotal(0)
+{
+}
+
+double SystemCpuLoad::sample()
+{
+    quint64 busy = 0;
+    quint64 total = 0;
+#if defined(Q_OS_WIN)
+    FILETIME idleTime, kernelTime, userTime;
+    if (!GetSystemTimes(&idleTime, &kernelTime, &userTime))
+        return -1;
+    auto toU64 = [](const FILETIME &ft) { return (quint64(ft.dwHighDateTime) << 32) | ft.dwLowDateTime; };
+    quint64 idle = toU64(idleTime);
+    total = toU64(kernelTime) + toU64(userTime);   // 内核时间包含空闲时间
+    busy = total - idle;
+#elif defined(Q_OS_LINUX)
+    // 第一行: cpu user nice system idle iowait irq softirq steal ...
+    QFile file("/proc/stat");
+    if (!file.open(QIODevice::ReadOnly))
+        return -1;
+    const QList<QByteArray> fields = file.readLine().simplified().split(' ');
+    if (fields.size() < 5 || fields.first() != "cpu")
+        return -1;
+    for (int i = 1; i < fields.size() && i <= 8; i++)
+        total += fields.at(i).toULongLong();
+    quint64 idle = fields.at(4).toULongLong() + (fields.size() > 5 ? fields.at(5).toULongLong() : 0);
+    busy = total - idle;
+#else
+    return -1;
+#endif
+    bool first = mLastTotal == 0;
+    quint64 deltaTotal = total - mLastTotal;
+    quint64 deltaBusy = busy - mLastBusy;
+    mLastTotal = total;
+    mLastBusy = busy;
+    if (first || deltaTotal == 0)
+        return -1;
+    return qBound(0.0, double(deltaBusy) / double(deltaTotal), 1.0);
+}
@@ -0,0 +1,84 @@
+#ifndef ADAPTIVEENCODER_H
+#define ADAPTIVEENCODER_H
+
+#include <QString>
+#include <QVector>
+
+// 一档编码参数
+struct EncoderLevel {
+    QString preset;         // libx264 preset
+    int height;             // 输出高度，0 为原始分辨率（只缩小不放大）
+    int fps;
+    qint64 bitrateBps;
+
+    QString toText() const;
+};
+
+// 编码档位控制：根据推流的实际速度、丢帧和整机 CPU 占用，在档位表里逐级升降。
+// 0 档质量最高，档位越大越省 CPU。只做判断，切换由调用方执行（ffmpeg 命令行推流为重启进程）。
+// 不是线程安全的，只在一个线程里调用。
+class AdaptiveEncoder
+{
+public:
+    struct Settings {
+        double minSpeed = 0.95;     // 实际速度低于它视为跟不上实时
+        double cpuHigh = 0.90;      // 整机 CPU 高于它视为过载
+        double cpuLow = 0.60;       // 低于它才考虑升档
+        int downAfterMs = 5000;     // 持续过载这么久后降一档
+        int upAfterMs = 60000;      // 持续空闲这么久后升一档；升档后很快又降档时加倍，最多 8 倍
+        int cooldownMs = 10000;     // 启动或切换后不做判断，等编码器稳定
+    };
+
+    AdaptiveEncoder();
+
+    static QVector<EncoderLevel> defaultLadder();
+
+    void setLadder(const QVector<EncoderLevel> &ladder);
+    void setSettings(const Settings &settings);
+    void setLevelRange(int startLevel, int maxLevel);   // maxLevel < 0 表示档位表末尾
+
+    int level() const;
+    const EncoderLevel &current() const;
+    int switches() const;
+
+    // 进程（重新）启动时调用，开始冷却
+    void restart(qint64 nowMs);
+    // 每块推流进度调用一次。outTimeMs 为已输出的媒体时长，cpuLoad 为 0~1，未知时 <0。
+    // 需要切换时返回新档位（已生效），否则返回 -1
+    int update(qint64 nowMs, qint64 outTimeMs, qint64 dropFrames, double cpuLoad);
+
+    double speed() const;   // 平滑后的实际速度
+
+private:
+    int switchTo(int level, qint64 nowMs);
+
+    QVector<EncoderLevel> mLadder;
+    Settings mSettings;
+    int mLevel;
+    int mMaxLevel;
+    int mSwitches;
+    qint64 mHoldUntilMs;
+    qint64 mPressureSinceMs;   // -1 表示当前没有过载
+    qint64 mHeadroomSinceMs;   // -1 表示当前没有空闲
+    qint64 mLastUpMs;
+    int mUpFactor;
+    qint64 mLastNowMs;         // 上一块进度，算瞬时速度
+    qint64 mLastOutMs;
+    qint64 mLastDrops;
+    qint64 mLastDropMs;        // 最近一次出现丢帧的时刻
+    double mSpeed;             // 瞬时速度的指数平均，<0 表示还没有
+};
+
+// 整机 CPU 占用，两次 sample() 之间的平均值（0~1）；不支持的平台或第一次调用返回 -1
+class SystemCpuLoad
+{
+public:
+    SystemCpuLoad();
+    double sample();
+
+private:
+    quint64 mLastBusy;
+    quint64 mLastTotal;
+};
+
+#endif // ADAPTIVEENCODER_H
@@ -0,0 +1,140 @@
+#include "controlserver.h"
+#include "streamdaemon.h"
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QSemaphore>
+#include <QSharedPointer>
+
+// 守护进程线程忙（例如正在等某路解码线程退出）时最多等这么久
+static const int kCallTimeoutMs = 30000;
+
+ControlServer::ControlServer(StreamDaemon *daemon, QObject *parent)
+    : QObject(parent), mDaemon(daemon)
+{
+    StreamDaemon *d = mDaemon;
+
+    route("GET", "/jobs", [this, d](const HttpRequest &) {
+        return callDaemon([d]() {
+            QJsonObject root;
+            root["jobs"] = d->jobsJson();
+            return HttpResponse::json(root);
+        });
+    });
+
+    route("GET", "/job", [this, d](const HttpRequest &request) {
+        const QString id = request.query.queryItemValue("id");
+        return callDaemon([d, id]() {
+            QJsonObject job = d->jobJson(id);
+            if (job.isEmpty())
+                return HttpResponse::error(404, QString("No job \"%1\"").arg(id));
+            return HttpResponse::json(job);
+        });
+    });
+
+    route("POST", "/job", [this, d](const HttpRequest &request) {
+        QJsonParseError parseError;
+        QJsonDocument doc = QJsonDocument::fromJson(request.body, &parseError);
+        if (!doc.isObject())
+            return HttpResponse::error(400, "Body must be a JSON object");
+        const QJsonObject object = doc.object();
+        return callDaemon([d, object]() {
+            bool created = false;
+            QString error;
+            if (!d->putJob(object, &created, &error))
+                return HttpResponse::error(400, error);
+            return HttpResponse::json(d->jobJson(object.value("id").toString()), created ? 201 : 200);
+        });
+    });
+
+    route("DELETE", "/job", [this, d](const HttpRequest &request) {
+        const QString id = request.query.queryItemValue("id");
+        return callDaemon([d, id]() {
+            QString error;
+            if (!d->removeJob(id, &error))
+                return HttpResponse::error(404, error);
+            QJsonObject root;
+            root["id"] = id;
+            root["removed"] = true;
+            return HttpResponse::json(root);
+        });
+    });
+
+    route("POST", "/job/start", [this, d](const HttpRequest &request) {
+        const QString id = request.query.queryItemValue("id");
+        return callDaemon([d, id]() {
+            QString error;
+            if (!d->startJob(id, &error))
+                return HttpResponse::error(404, error);
+            return HttpResponse::json(d->jobJson(id));
+        });
+    });
+
+    route("POST", "/job/stop", [this, d](const HttpRequest &request) {
+        const QString id = request.query.queryItemValue("id");
+        return callDaemon([d, id]() {
+            QString error;
+            if (!d->stopJob(id, &error))
+                return HttpResponse::error(404, error);
+            return HttpResponse::json(d->jobJson(id));
+        });
+    });
+
+    route("POST", "/reload", [this, d](const HttpRequest &) {
+        return callDaemon([d]() {
+            QString error;
+            if (!d->reload(&error))
+                return HttpResponse::error(400, error);
+            QJsonObject root;
+            root["jobs"] = d->jobsJson();
+            return HttpResponse::json(root);
+        });
+    });
+}
+
+void ControlServer::setToken(const QString &token)
+{
+    mToken = token;
+}
+
+bool ControlServer::start(const QHostAddress &address, quint16 port, QString *error)
+{
+    return mHttp.start(address, port, error);
+}
+
+void ControlServer::stop()
+{
+    mHttp.stop();
+}
+
+quint16 ControlServer::port() const
+{
+    return mHttp.port();
+}
+
+// 所有路由先检查 token
+void ControlServer::route(const QString &method, const QString &path, const HttpServer::Handler &handler)
+{
+    mHttp.addRoute(method, path, [this, handler](const HttpRequest &request) {
+        if (!mToken.isEmpty() && request.headers.value("authorization") != "Bearer " + mToken)
+            return HttpResponse::error(401, "Unauthorized");
+        return handler(request);
+    });
+}
+
+HttpResponse ControlServer::callDaemon(const Call &call) const
+{
+    // 结果放在共享对象里：超时返回后守护进程线程才执行完也不会写到已释放的栈上
+    struct Result {
+        QSemaphore done;
+        HttpResponse response;
+    };
+    QSharedPointer<Result> result(new Result);
+    QMetaObject::invokeMethod(mDaemon, [result, call]() {
+        result->response = call();
+        result->done.release();
+    }, Qt::QueuedConnection);
+    if (!result->done.tryAcquire(1, kCallTimeoutMs))
+        return HttpResponse::error(503, "Daemon busy");
+    return result->response;
+}
@@ -0,0 +1,42 @@
+#ifndef CONTROLSERVER_H
+#define CONTROLSERVER_H
+
+#include <QObject>
+
+#include "httpserver.h"
+
+class StreamDaemon;
+
+// 守护进程的本机控制接口（HTTP/JSON）：
+//   GET    /jobs                列出所有任务及实时统计
+//   GET    /job?id=x            单个任务
+//   POST   /job                 新增任务或修改配置（请求体为任务 JSON，与配置文件中 jobs 的一项相同）
+//   DELETE /job?id=x            删除任务
+//   POST   /job/start?id=x      启动被停止的任务
+//   POST   /job/stop?id=x       停止任务（保留配置）
+//   POST   /reload              重新读取配置文件
+// 请求在 HttpServer 自己的线程里收发，处理时转到守护进程所在线程执行，媒体线程不受影响。
+// 设置了 token 时请求需带 "Authorization: Bearer <token>"。
+class ControlServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ControlServer(StreamDaemon *daemon, QObject *parent = nullptr);
+
+    void setToken(const QString &token);   // 在 start() 之前设置
+    bool start(const QHostAddress &address, quint16 port, QString *error);
+    void stop();
+    quint16 port() const;
+
+private:
+    typedef std::function<HttpResponse()> Call;
+    void route(const QString &method, const QString &path, const HttpServer::Handler &handler);
+    HttpResponse callDaemon(const Call &call) const;   // 在守护进程线程执行并等待结果
+
+    StreamDaemon *mDaemon;
+    HttpServer mHttp;
+    QString mToken;
+};
+
+#endif // CONTROLSERVER_H
@@ -0,0 +1,142 @@
+#include "jobconfig.h"
+
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QSet>
+
+QString JobConfig::typeName(Type type)
+{
+    switch (type) {
+    case Pull:   return "pull";
+    case Record: return "record";
+    case Push:   return "push";
+    case Mosaic: return "mosaic";
+    }
+    return QString();
+}
+
+// defaults 与任务配置合并：对象逐层合并，其他值以任务为准
+static QJsonObject mergeObjects(const QJsonObject &base, const QJsonObject &over)
+{
+    QJsonObject out = base;
+    for (auto it = over.begin(); it != over.end(); ++it) {
+        if (it.value().isObject() && out.value(it.key()).isObject())
+            out[it.key()] = mergeObjects(out.value(it.key()).toObject(), it.value().toObject());
+        else
+            out[it.key()] = it.value();
+    }
+    return out;
+}
+
+bool parseJobConfig(const QJsonObject &object, const QJsonObject &defaults, JobConfig *job, QString *error)
+{
+    JobConfig parsed;
+    parsed.settings = mergeObjects(defaults, object);
+    parsed.id = parsed.settings.value("id").toString();
+    if (parsed.id.isEmpty()) {
+        *error = "Job has no id";
+        return false;
+    }
+
+    QString type = parsed.settings.value("type").toString("pull");
+    if (type == "pull") {
+        parsed.type = JobConfig::Pull;
+    } else if (type == "record") {
+        parsed.type = JobConfig::Record;
+    } else if (type == "push") {
+        parsed.type = JobConfig::Push;
+    } else if (type == "mosaic") {
+        parsed.type = JobConfig::Mosaic;
+    } else {
+        *error = QString("Job \"%1\": unknown type \"%2\"").arg(parsed.id, type);
+        return false;
+    }
+
+    if (parsed.type == JobConfig::Push) {
+        if (parsed.settings.value("input").toString().isEmpty()
+                || (parsed.settings.value("output").toString().isEmpty()
+                    && parsed.settings.value("renditions").toArray().isEmpty())) {
+            *error = QString("Job \"%1\": push jobs need \"input\" and \"output\" (or \"renditions\")").arg(parsed.id);
+            return false;
+        }
+        const QJsonArray renditions = parsed.settings.value("renditions").toArray();
+        for (int i = 0; i < renditions.size(); i++) {
+            if (renditions.at(i).toObject().value("output").toString().isEmpty()) {
+                *error = QString("Job \"%1\": renditions[%2] has no \"output\"").arg(parsed.id).arg(i);
+                return false;
+            }
+        }
+    } else if (parsed.type == JobConfig::Mosaic) {
+        // inputs 里的任务可以还不存在（之后由控制接口加入），格子先留黑
+        const QJsonArray inputs = parsed.settings.value("inputs").toArray();
+        if (inputs.isEmpty() || parsed.settings.value("output").toString().isEmpty()) {
+            *error = QString("Job \"%1\": mosaic jobs need \"inputs\" (job ids) and \"output\"").arg(parsed.id);
+            return false;
+        }
+        for (int i = 0; i < inputs.size(); i++) {
+            if (!inputs.at(i).isString()) {
+                *error = QString("Job \"%1\": inputs[%2] is not a job id").arg(parsed.id).arg(i);
+                return false;
+            }
+        }
+    } else if (parsed.settings.value("url").toString().isEmpty()) {
+        *error = QString("Job \"%1\": missing \"url\"").arg(parsed.id);
+        return false;
+    }
+    *job = parsed;
+    return true;
+}
+
+bool parseDaemonConfig(const QByteArray &data, DaemonConfig *config, QString *error)
+{
+    QJsonParseError parseError;
+    QJsonDocument doc = QJsonDocument::fromJson(data, &parseError);
+    if (doc.isNull()) {
+        *error = QString("JSON error at offset %1: %2").arg(parseError.offset).arg(parseError.errorString());
+        return false;
+    }
+    if (!doc.isObject()) {
+        *error = "Top level must be an object";
+        return false;
+    }
+    QJsonObject root = doc.object();
+
+    DaemonConfig parsed;
+    parsed.metrics = root.value("metrics").toObject();
+    parsed.control = root.value("control").toObject();
+    parsed.push = root.value("push").toObject();
+    parsed.defaults = root.value("defaults").toObject();
+    QSet<QString> ids;
+    const QJsonArray jobs = root.value("jobs").toArray();
+    for (int i = 0; i < jobs.size(); i++) {
+        if (!jobs.at(i).isObject()) {
+            *error = QString("jobs[%1] is not an object").arg(i);
+            return false;
+        }
+        JobConfig job;
+        if (!parseJobConfig(jobs.at(i).toObject(), parsed.defaults, &job, error)) {
+            error->prepend(QString("jobs[%1]: ").arg(i));
+            return false;
+        }
+        if (ids.contains(job.id)) {
+            *error = QString("Duplicate job id \"%1\"").arg(job.id);
+            return false;
+        }
+        ids.insert(job.id);
+        parsed.jobs.append(job);
+    }
+
+    *config = parsed;
+    return true;
+}
+
+bool loadDaemonConfig(const QString &path, DaemonConfig *config, QString *error)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        *error = QString("Cannot open %1: %2").arg(path, file.errorString());
+        return false;
+    }
+    return parseDaemonConfig(file.readAll(), config, error);
+}
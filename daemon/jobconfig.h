@@ -0,0 +1,44 @@
+#ifndef JOBCONFIG_H
+#define JOBCONFIG_H
+
+#include <QJsonObject>
+#include <QList>
+#include <QString>
+
+// 守护进程的一个任务
+struct JobConfig {
+    enum Type {
+        Pull,     // 拉流：指标、健康检查，可选移动侦测/事件录像/截图/共享内存导出
+        Record,   // 拉流并一直录像（按 max_file_ms 分文件）
+        Push,     // 推流：input 转推到 output
+        Mosaic    // 拼接：inputs 里几个拉流任务的画面拼成一路，编码推流或写文件
+    };
+
+    QString id;
+    Type type = Pull;
+    QJsonObject settings;   // 合并了 defaults 的完整配置，重新加载时按它判断任务是否有变化
+
+    bool operator==(const JobConfig &other) const
+    {
+        return id == other.id && type == other.type && settings == other.settings;
+    }
+    bool operator!=(const JobConfig &other) const { return !(*this == other); }
+
+    static QString typeName(Type type);
+};
+
+struct DaemonConfig {
+    QJsonObject metrics;    // {"port": 9100, "bind": "127.0.0.1", "json": "...", "json_interval_s": 5}
+    QJsonObject control;    // {"port": 9200, "bind": "127.0.0.1", "token": "..."}
+    QJsonObject push;       // 推流预算 {"cpu": 4, "bandwidth_bps": 50000000}
+    QJsonObject defaults;   // 合并进每个任务
+    QList<JobConfig> jobs;
+};
+
+// 解析配置文件（JSON），格式见 daemon/streams.example.json。出错时返回 false 并给出原因
+bool parseDaemonConfig(const QByteArray &data, DaemonConfig *config, QString *error);
+bool loadDaemonConfig(const QString &path, DaemonConfig *config, QString *error);
+// 解析单个任务（配置文件里的一项，或控制接口提交的 JSON）
+bool parseJobConfig(const QJsonObject &object, const QJsonObject &defaults, JobConfig *job, QString *error);
+
+#endif // JOBCONFIG_H
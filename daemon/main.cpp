@@ -0,0 +1,156 @@
+/**
+ * vpdaemon：无界面运行多路拉流/录像/推流任务
+ *
+ * 用法：
+ *   vpdaemon streams.json
+ *   vpdaemon --check streams.json      只检查配置文件
+ *
+ * 配置格式见 streams.example.json。Linux/macOS 下 SIGHUP 重新加载配置（没变的任务不中断），
+ * SIGINT/SIGTERM 停止所有任务后退出。配置了 control 段时开启本机控制接口，见 controlserver.h。
+ */
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QHostAddress>
+#include <QTextCodec>
+#include <QDebug>
+
+#include "streamdaemon.h"
+#include "controlserver.h"
+#include "metrics.h"
+#include "pushmanager.h"
+
+#ifdef Q_OS_UNIX
+#include <QSocketNotifier>
+
+#include <csignal>
+#include <cstring>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// 信号处理函数里只能做异步信号安全的事：把信号号写进 socketpair，由事件循环读出来处理
+static int sSignalFd[2] = { -1, -1 };
+
+static void onSignal(int signo)
+{
+    char c = char(signo);
+    ssize_t written = ::write(sSignalFd[0], &c, 1);
+    Q_UNUSED(written);
+}
+
+static bool installSignalHandlers()
+{
+    if (::socketpair(AF_UNIX, SOCK_STREAM, 0, sSignalFd) != 0)
+        return false;
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = onSignal;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    return sigaction(SIGHUP, &action, nullptr) == 0
+            && sigaction(SIGINT, &action, nullptr) == 0
+            && sigaction(SIGTERM, &action, nullptr) == 0;
+}
+#endif
+
+// 配置文件里的 metrics 段优先于 VP_METRICS_* 环境变量
+static void configureMetrics(MetricsExporter *exporter, const QJsonObject &metrics)
+{
+    exporter->configureFromEnvironment();
+    int port = metrics.value("port").toInt(0);
+    if (port > 0) {
+        QHostAddress address(metrics.value("bind").toString("127.0.0.1"));
+        QString error;
+        if (exporter->startHttp(address, quint16(port), &error))
+            qDebug() << "Metrics endpoint on" << address.toString() << port;
+        else
+            qWarning() << "Metrics endpoint failed:" << error;
+    }
+    if (metrics.contains("json"))
+        exporter->setJsonDump(metrics.value("json").toString(), metrics.value("json_interval_s").toInt(5));
+}
+
+// 控制接口默认只监听本机
+static void configureControl(ControlServer *control, const QJsonObject &settings)
+{
+    int port = settings.value("port").toInt(0);
+    if (port <= 0)
+        return;
+    QHostAddress address(settings.value("bind").toString("127.0.0.1"));
+    control->setToken(settings.value("token").toString());
+    QString error;
+    if (control->start(address, quint16(port), &error))
+        qDebug() << "Control endpoint on" << address.toString() << port;
+    else
+        qWarning() << "Control endpoint failed:" << error;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("vpdaemon");
+    QTextCodec::setCodecForLocale(QTextCodec::codecForName("UTF-8"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Run pull/record/push/mosaic jobs from a configuration file without a GUI");
+    parser.addHelpOption();
+    parser.addPositionalArgument("config", "Job configuration (JSON)");
+    QCommandLineOption checkOpt("check", "Validate the configuration and exit");
+    parser.addOption(checkOpt);
+    parser.process(app);
+    if (parser.positionalArguments().size() != 1)
+        parser.showHelp(2);
+    const QString path = parser.positionalArguments().first();
+
+    DaemonConfig config;
+    QString error;
+    if (!loadDaemonConfig(path, &config, &error)) {
+        qCritical().noquote() << error;
+        return 1;
+    }
+    if (parser.isSet(checkOpt)) {
+        for (const JobConfig &job : config.jobs)
+            qInfo().noquote() << JobConfig::typeName(job.type) << job.id;
+        qInfo() << config.jobs.size() << "jobs OK";
+        return 0;
+    }
+
+    MetricsExporter metrics;
+    configureMetrics(&metrics, config.metrics);
+    PushJobManager::instance()->configureFromEnvironment();   // 配置文件的 push 段在 load 时覆盖
+
+    StreamDaemon daemon;
+    if (!daemon.load(path, &error)) {
+        qCritical().noquote() << error;
+        return 1;
+    }
+    ControlServer control(&daemon);
+    configureControl(&control, config.control);
+
+#ifdef Q_OS_UNIX
+    if (!installSignalHandlers())
+        qWarning() << "Cannot install signal handlers, SIGHUP reload disabled";
+    QSocketNotifier notifier(sSignalFd[1], QSocketNotifier::Read);
+    QObject::connect(&notifier, &QSocketNotifier::activated, &daemon, [&daemon, &app]() {
+        char signo = 0;
+        if (::read(sSignalFd[1], &signo, 1) != 1)
+            return;
+        if (signo == SIGHUP) {
+            QString reloadError;
+            qDebug() << "SIGHUP: reloading" << daemon.configPath();
+            if (!daemon.reload(&reloadError))
+                qWarning().noquote() << "Reload failed, keeping current jobs:" << reloadError;
+        } else {
+            qDebug() << "Signal" << int(signo) << "received, stopping";
+            app.quit();
+        }
+    });
+#endif
+
+    int ret = app.exec();
+    control.stop();   // 先停控制接口，不再有请求转进来
+    daemon.stopAll();
+    PushJobManager::instance()->removeAll();
+    PushJobManager::instance()->waitForStopped();
+    return ret;
+}
@@ -0,0 +1,483 @@
+#include "streamdaemon.h"
+#include "videoplayer.h"
+#include "streamhealth.h"
+#include "pushmanager.h"
+#include "mosaiccompositor.h"
+
+#include <QDebug>
+
+StreamDaemon::StreamDaemon(QObject *parent)
+    : QObject(parent)
+{
+}
+
+StreamDaemon::~StreamDaemon()
+{
+    stopAll();
+}
+
+QString StreamDaemon::configPath() const
+{
+    return mConfigPath;
+}
+
+const DaemonConfig &StreamDaemon::config() const
+{
+    return mConfig;
+}
+
+QStringList StreamDaemon::jobIds() const
+{
+    return mJobs.keys();
+}
+
+bool StreamDaemon::load(const QString &path, QString *error)
+{
+    DaemonConfig config;
+    if (!loadDaemonConfig(path, &config, error))
+        return false;
+    mConfigPath = path;
+    apply(config);
+    return true;
+}
+
+bool StreamDaemon::reload(QString *error)
+{
+    DaemonConfig config;
+    if (!loadDaemonConfig(mConfigPath, &config, error))
+        return false;
+    if (config.metrics != mConfig.metrics)
+        qWarning() << "Daemon: metrics settings changed, restart to apply";
+    apply(config);
+    return true;
+}
+
+void StreamDaemon::apply(const DaemonConfig &config)
+{
+    QMap<QString, JobConfig> wanted;
+    for (const JobConfig &job : config.jobs)
+        wanted.insert(job.id, job);
+
+    // 先停掉删除和变化了的任务，再启动新的，避免同一个输出地址同时有两个推流
+    int unchanged = 0;
+    for (auto it = mJobs.begin(); it != mJobs.end();) {
+        Job *job = it.value();
+        auto next = wanted.find(it.key());
+        if (next != wanted.end() && next.value() == job->config) {
+            // 配置没变：运行的继续运行，控制接口停掉的保持停止
+            wanted.erase(next);
+            unchanged++;
+            ++it;
+            continue;
+        }
+        halt(job);
+        if (next == wanted.end()) {
+            qDebug() << "Daemon: job" << job->config.id << "removed";
+            delete job;
+            it = mJobs.erase(it);
+        } else {
+            qDebug() << "Daemon: job" << job->config.id << "changed, restarting";
+            job->config = next.value();
+            job->held = false;
+            wanted.erase(next);
+            launch(job);
+            ++it;
+        }
+    }
+    for (const JobConfig &added : wanted) {
+        Job *job = new Job;
+        job->config = added;
+        mJobs.insert(added.id, job);
+        launch(job);
+    }
+    configurePushBudget(config.push);
+    mConfig = config;
+    qDebug() << "Daemon:" << mJobs.size() << "jobs," << unchanged << "unchanged";
+}
+
+void StreamDaemon::stopAll()
+{
+    // 全部停完再删除：停拉流任务时要在 mJobs 里找引用它的拼接任务
+    for (Job *job : mJobs)
+        halt(job);
+    qDeleteAll(mJobs);
+    mJobs.clear();
+}
+
+bool StreamDaemon::startJob(const QString &id, QString *error)
+{
+    Job *job = mJobs.value(id);
+    if (!job) {
+        *error = QString("No job \"%1\"").arg(id);
+        return false;
+    }
+    job->held = false;
+    if (!job->isRunning())
+        launch(job);
+    return true;
+}
+
+bool StreamDaemon::stopJob(const QString &id, QString *error)
+{
+    Job *job = mJobs.value(id);
+    if (!job) {
+        *error = QString("No job \"%1\"").arg(id);
+        return false;
+    }
+    job->held = true;
+    halt(job);
+    return true;
+}
+
+bool StreamDaemon::putJob(const QJsonObject &object, bool *created, QString *error)
+{
+    JobConfig config;
+    if (!parseJobConfig(object, mConfig.defaults, &config, error))
+        return false;
+
+    Job *job = mJobs.value(config.id);
+    *created = job == nullptr;
+    if (!job) {
+        job = new Job;
+        job->config = config;
+        mJobs.insert(config.id, job);
+        launch(job);
+    } else if (job->config != config || !job->isRunning()) {
+        halt(job);
+        job->config = config;
+        job->held = false;
+        launch(job);
+    }
+    return true;
+}
+
+bool StreamDaemon::removeJob(const QString &id, QString *error)
+{
+    Job *job = mJobs.take(id);
+    if (!job) {
+        *error = QString("No job \"%1\"").arg(id);
+        return false;
+    }
+    halt(job);
+    delete job;
+    qDebug() << "Daemon: job" << id << "removed";
+    return true;
+}
+
+QJsonArray StreamDaemon::jobsJson()
+{
+    QJsonArray jobs;
+    for (Job *job : mJobs)
+        jobs.append(toJson(job));
+    return jobs;
+}
+
+QJsonObject StreamDaemon::jobJson(const QString &id)
+{
+    Job *job = mJobs.value(id);
+    return job ? toJson(job) : QJsonObject();
+}
+
+QJsonObject StreamDaemon::toJson(Job *job)
+{
+    QJsonObject o;
+    o["id"] = job->config.id;
+    o["type"] = JobConfig::typeName(job->config.type);
+    o["state"] = job->isRunning() ? "running" : "stopped";
+    o["settings"] = job->config.settings;
+    if (job->push) {
+        o["push"] = job->push->toJson();
+        return o;
+    }
+    if (job->mosaic) {
+        const MosaicStats stats = job->mosaic->stats();
+        QJsonObject mosaic;
+        mosaic["frames"] = double(stats.frames);
+        mosaic["late_ticks"] = double(stats.lateTicks);
+        mosaic["tiles_scaled"] = double(stats.tilesScaled);
+        mosaic["inputs"] = stats.inputs;
+        mosaic["live_inputs"] = stats.liveInputs;
+        o["mosaic"] = mosaic;
+        return o;
+    }
+    VideoPlayer *player = job->player;
+    if (!player)
+        return o;
+
+    PerfSnapshot snap = player->perfStats()->snapshot();
+    QJsonObject stats;
+    if (job->hasSnapshot)
+        stats["fps"] = snap.fpsSince(job->lastSnapshot);
+    stats["frames_decoded"] = double(snap.framesDecoded);
+    stats["frames_dropped"] = double(snap.framesDropped);
+    stats["queue"] = snap.queueDepth;
+    const PerfStageSnapshot &frame = snap.stages[PerfFrame];
+    stats["frame_p50_ms"] = frame.p50Ms;
+    stats["frame_p99_ms"] = frame.p99Ms;
+    o["stats"] = stats;
+    job->lastSnapshot = snap;
+    job->hasSnapshot = true;
+
+    o["health"] = healthConditionsText(player->streamHealth()->conditions());
+    o["recording"] = player->recorder()->isRecording();
+    return o;
+}
+
+void StreamDaemon::launch(Job *job)
+{
+    const QString id = job->config.id;
+    const QJsonObject &s = job->config.settings;
+
+    if (job->config.type == JobConfig::Push) {
+        // 推流交给 PushJobManager：每路独立重试，超出全局预算时排队。守护进程默认一直重试
+        const QJsonObject retryCfg = s.value("retry").toObject();
+        PushJobSpec spec;
+        spec.id = id;
+        spec.input = s.value("input").toString();
+        spec.output = s.value("output").toString();
+        spec.retry.maxRetries = retryCfg.value("max").toInt(-1);
+        spec.retry.delayMs = retryCfg.value("delay_ms").toInt(spec.retry.delayMs);
+        spec.retry.maxDelayMs = retryCfg.value("max_delay_ms").toInt(spec.retry.maxDelayMs);
+        spec.retry.backoff = retryCfg.value("backoff").toDouble(spec.retry.backoff);
+        spec.retry.stableMs = retryCfg.value("stable_ms").toInt(spec.retry.stableMs);
+        spec.cpuCost = s.value("cpu").toDouble(-1);
+        spec.bitrateBps = qint64(s.value("bitrate_bps").toDouble(-1));
+        spec.progressIntervalMs = s.value("progress_interval_ms").toInt(spec.progressIntervalMs);
+        spec.ffreport = s.value("ffreport").toString();
+        spec.lowLatency = s.value("low_latency").toBool(false);
+        const QJsonArray renditions = s.value("renditions").toArray();
+        for (const QJsonValue &value : renditions) {
+            const QJsonObject r = value.toObject();
+            PushRendition rendition;
+            rendition.output = r.value("output").toString();
+            rendition.height = r.value("height").toInt(0);
+            rendition.fps = qMax(1, r.value("fps").toInt(rendition.fps));
+            rendition.bitrateBps = qint64(r.value("bitrate_bps").toDouble(double(rendition.bitrateBps)));
+            rendition.preset = r.value("preset").toString(rendition.preset);
+            rendition.threads = r.value("threads").toInt(0);
+            spec.renditions.append(rendition);
+        }
+        // "adaptive": false，或 {"enabled": true, "start_level": 0, "max_level": 3}
+        const QJsonValue adaptive = s.value("adaptive");
+        if (adaptive.isBool()) {
+            spec.adaptive = adaptive.toBool();
+        } else if (adaptive.isObject()) {
+            const QJsonObject adaptiveCfg = adaptive.toObject();
+            spec.adaptive = adaptiveCfg.value("enabled").toBool(true);
+            spec.startLevel = adaptiveCfg.value("start_level").toInt(0);
+            spec.maxLevel = adaptiveCfg.value("max_level").toInt(-1);
+        }
+        PushJob *push = PushJobManager::instance()->submit(spec);
+        job->push = push;
+        connect(push, &PushJob::sig_Output, this, [id](const QString &message) {
+            qDebug().noquote() << QString("[%1]").arg(id) << message;
+        });
+        connect(push, &PushJob::sig_Failed, this, [id](const QString &reason) {
+            qWarning().noquote() << QString("[%1]").arg(id) << reason;
+        });
+        connect(push, &PushJob::sig_StateChanged, this, [id](PushState state) {
+            qDebug() << QString("[%1]").arg(id) << "push" << pushStateName(state);
+        });
+    } else if (job->config.type == JobConfig::Mosaic) {
+        // 拼接：按固定帧率取 inputs 里各拉流任务的最新帧，缩放进各自的格子后编码成一路
+        MosaicCompositor *mosaic = new MosaicCompositor(this);
+        mosaic->setObjectName(id);
+        job->mosaic = mosaic;
+        mosaic->setCanvasSize(QSize(s.value("width").toInt(1920), s.value("height").toInt(1080)));
+        mosaic->setFps(s.value("fps").toDouble(25));
+        mosaic->setGrid(s.value("columns").toInt(0), s.value("rows").toInt(0));
+        mosaic->setStaleMs(s.value("stale_ms").toInt(3000));
+        ProcessedOutput *output = mosaic->output();
+        output->setOutput(s.value("output").toString());
+        output->setBitrate(qint64(s.value("bitrate_bps").toDouble(4000000)));
+        connect(output, &ProcessedOutput::sig_OutputError, this, [id](const QString &message) {
+            qWarning().noquote() << QString("[%1]").arg(id) << message;
+        });
+        bindMosaics();
+        mosaic->start();
+    } else {
+        VideoPlayer *player = new VideoPlayer(this);
+        player->setObjectName(id);
+        job->player = player;
+        job->hasSnapshot = false;
+        connect(player, &VideoPlayer::sig_StreamError, this, [id](const QString &message) {
+            qWarning().noquote() << QString("[%1]").arg(id) << message;
+        });
+        configurePull(job);
+        player->startPlay();
+        bindMosaics();
+    }
+    qDebug() << "Daemon: started" << JobConfig::typeName(job->config.type) << "job" << id;
+    emit sig_JobStarted(id);
+}
+
+void StreamDaemon::halt(Job *job)
+{
+    if (job->push) {
+        PushJobManager::instance()->remove(job->config.id);
+        job->push = nullptr;
+    } else if (job->player) {
+        VideoPlayer *player = job->player;
+        player->stopPlay();   // 等解码线程退出，录像在这里收尾
+        job->player = nullptr;
+        bindMosaics();        // 拼接任务不再取这一路的帧之后才能删除
+        delete player;
+    } else if (job->mosaic) {
+        job->mosaic->stop();  // 等合成线程退出，输出在这里收尾
+        delete job->mosaic;
+        job->mosaic = nullptr;
+    } else {
+        return;
+    }
+    emit sig_JobStopped(job->config.id);
+}
+
+void StreamDaemon::configurePull(Job *job)
+{
+    const QString id = job->config.id;
+    const QJsonObject &s = job->config.settings;
+    VideoPlayer *player = job->player;
+
+    player->setStreamUrl(s.value("url").toString());
+    player->setTransportProtocol(s.value("transport").toString("tcp"));
+    player->setAutoReconnect(s.value("reconnect").toBool(true));
+    player->setAudioEnabled(false);
+    player->setVideoOutputEnabled(false);   // 没有界面，不转 RGB
+    connect(player, &VideoPlayer::sig_Reconnecting, this, [id](int attempt) {
+        qWarning() << QString("[%1]").arg(id) << "reconnecting, attempt" << attempt;
+    });
+
+    // 移动侦测：录像要求移动触发或输出移动叠加画面时自动开启
+    const QJsonObject motionCfg = s.value("motion").toObject();
+    const QJsonObject recordCfg = s.value("record").toObject();
+    const bool recordOnMotion = recordCfg.value("on_motion").toBool(false);
+    const bool motionOverlay = s.value("processed").toObject().value("stage").toString() == "motion";
+    MotionDetector *motion = player->motionDetector();
+    motion->setEnabled(motionCfg.value("enabled").toBool(recordOnMotion || motionOverlay));
+    if (motionCfg.contains("fps"))
+        motion->setAnalysisFps(motionCfg.value("fps").toDouble());
+    if (motionCfg.contains("sensitivity"))
+        motion->setSensitivity(motionCfg.value("sensitivity").toInt());
+    if (motionCfg.contains("hold_ms"))
+        motion->setHoldMs(motionCfg.value("hold_ms").toInt());
+    if (motionCfg.contains("zones")) {
+        QVector<MotionZone> zones;
+        if (MotionDetector::parseZones(motionCfg.value("zones").toString(), &zones))
+            motion->setZones(zones);
+        else
+            qWarning() << QString("[%1]").arg(id) << "invalid motion zones, using the whole picture";
+    }
+    connect(motion, &MotionDetector::sig_MotionStarted, this, [id](const QString &zone, double level) {
+        qDebug() << QString("[%1]").arg(id) << "motion started in" << zone << level;
+    });
+    connect(motion, &MotionDetector::sig_MotionStopped, this, [id](const QString &zone) {
+        qDebug() << QString("[%1]").arg(id) << "motion stopped in" << zone;
+    });
+
+    // 事件录像：record 类型一直录，pull 类型按需由移动触发
+    const bool continuous = job->config.type == JobConfig::Record;
+    EventRecorder *recorder = player->recorder();
+    recorder->setEnabled(continuous || recordOnMotion);
+    recorder->setMotionTriggerEnabled(recordOnMotion);
+    if (recordCfg.contains("dir"))
+        recorder->setOutputDir(recordCfg.value("dir").toString());
+    if (recordCfg.contains("container"))
+        recorder->setContainer(recordCfg.value("container").toString());
+    if (recordCfg.contains("preroll_ms"))
+        recorder->setPreRollMs(recordCfg.value("preroll_ms").toInt());
+    if (recordCfg.contains("postroll_ms"))
+        recorder->setPostRollMs(recordCfg.value("postroll_ms").toInt());
+    if (recordCfg.contains("max_file_ms"))
+        recorder->setMaxFileMs(recordCfg.value("max_file_ms").toInt());
+    if (continuous)
+        recorder->beginHold("continuous");
+    connect(recorder, &EventRecorder::sig_RecordingFinished, this,
+            [id](const QString &path, qint64 durationMs, qint64 bytes) {
+        qDebug() << QString("[%1]").arg(id) << "recording saved:" << path << durationMs << "ms" << bytes << "bytes";
+    });
+    connect(recorder, &EventRecorder::sig_RecordingError, this, [id](const QString &message) {
+        qWarning().noquote() << QString("[%1]").arg(id) << message;
+    });
+
+    // 画面健康检查默认开启
+    const QJsonObject healthCfg = s.value("health").toObject();
+    StreamHealth *health = player->streamHealth();
+    health->setEnabled(healthCfg.value("enabled").toBool(true));
+    if (healthCfg.contains("freeze_ms"))
+        health->setFreezeWindowMs(healthCfg.value("freeze_ms").toInt());
+    if (healthCfg.contains("black_ms"))
+        health->setBlackWindowMs(healthCfg.value("black_ms").toInt());
+    if (healthCfg.contains("exposure_ms"))
+        health->setExposureWindowMs(healthCfg.value("exposure_ms").toInt());
+    connect(health, &StreamHealth::sig_ConditionRaised, this, [id](const QString &name) {
+        qWarning() << QString("[%1]").arg(id) << "picture" << name;
+    });
+
+    // 定时缩略图
+    const QJsonObject snapshotCfg = s.value("snapshot").toObject();
+    Snapshotter *snapshotter = player->snapshotter();
+    if (snapshotCfg.contains("dir"))
+        snapshotter->setOutputDir(snapshotCfg.value("dir").toString());
+    if (snapshotCfg.contains("format"))
+        snapshotter->setFormat(snapshotCfg.value("format").toString());
+    if (snapshotCfg.contains("quality"))
+        snapshotter->setQuality(snapshotCfg.value("quality").toInt());
+    if (snapshotCfg.contains("width"))
+        snapshotter->setMaxWidth(snapshotCfg.value("width").toInt());
+    snapshotter->setPeriodic(snapshotCfg.value("interval_ms").toInt(0), snapshotCfg.value("to_file").toBool(true));
+
+    // 共享内存导出
+    const QJsonObject exportCfg = s.value("export").toObject();
+    SharedFrameWriter *frameExport = player->frameExport();
+    frameExport->setName(exportCfg.value("name").toString());
+    frameExport->setFormat(exportCfg.value("format").toString() == "rgb32" ? SharedFrameRgb32 : SharedFrameYuv420p);
+    frameExport->setMaxFps(exportCfg.value("fps").toDouble(0));
+    if (exportCfg.contains("slots"))
+        frameExport->setSlotCount(exportCfg.value("slots").toInt());
+
+    // 分析画面重新编码输出（推流或写文件）
+    const QJsonObject processedCfg = s.value("processed").toObject();
+    ProcessedOutput *processed = player->processedOutput();
+    processed->setOutput(processedCfg.value("output").toString());
+    ProcessedStage stage = ProcessedSource;
+    if (processedCfg.contains("stage") && !parseProcessedStage(processedCfg.value("stage").toString(), &stage))
+        qWarning() << QString("[%1]").arg(id) << "unknown processed stage" << processedCfg.value("stage").toString();
+    processed->setStage(stage);
+    processed->setMaxFps(processedCfg.value("fps").toDouble(25));
+    processed->setBitrate(qint64(processedCfg.value("bitrate_bps").toDouble(2000000)));
+    processed->setBinaryThreshold(processedCfg.value("threshold").toInt(200));
+    connect(processed, &ProcessedOutput::sig_OutputError, this, [id](const QString &message) {
+        qWarning().noquote() << QString("[%1]").arg(id) << message;
+    });
+}
+
+// 拼接任务按 inputs 里的 id 取对应任务的播放器，没有或没在运行的占一个黑格子。
+// 拉流任务启动或停止时都重新绑定一次
+void StreamDaemon::bindMosaics()
+{
+    for (Job *job : mJobs) {
+        if (!job->mosaic)
+            continue;
+        QList<VideoPlayer *> inputs;
+        const QJsonArray ids = job->config.settings.value("inputs").toArray();
+        for (const QJsonValue &value : ids) {
+            Job *input = mJobs.value(value.toString());
+            inputs.append(input ? input->player : nullptr);
+        }
+        if (inputs != job->mosaic->inputs())
+            job->mosaic->setInputs(inputs);
+    }
+}
+
+// 配置文件 push 段里给出的项覆盖环境变量/默认值，重新加载时立即生效
+void StreamDaemon::configurePushBudget(const QJsonObject &settings)
+{
+    if (settings.isEmpty())
+        return;
+    PushBudget budget = PushJobManager::instance()->budget();
+    if (settings.contains("cpu"))
+        budget.cpuCores = settings.value("cpu").toDouble();
+    if (settings.contains("bandwidth_bps"))
+        budget.bandwidthBps = qint64(settings.value("bandwidth_bps").toDouble());
+    PushJobManager::instance()->setBudget(budget);
+}
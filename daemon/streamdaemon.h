@@ -0,0 +1,75 @@
+#ifndef STREAMDAEMON_H
+#define STREAMDAEMON_H
+
+#include <QObject>
+#include <QMap>
+#include <QJsonArray>
+
+#include "jobconfig.h"
+#include "perfstats.h"
+
+class VideoPlayer;
+class PushJob;
+class MosaicCompositor;
+
+// 按配置文件运行多路拉流/录像/推流任务，无界面。
+// 重新加载时逐个比较任务配置：没变的任务不受影响，变了的重启，删掉的停止，新增的启动。
+// 所有接口只在主线程调用，媒体处理都在各 VideoPlayer 自己的线程里。
+// 控制接口对任务的修改只在内存中生效，不写回配置文件：重新加载后任务列表和配置以文件为准，
+// 只有被控制接口停止、配置又没变的任务保持停止。
+class StreamDaemon : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit StreamDaemon(QObject *parent = nullptr);
+    ~StreamDaemon();
+
+    bool load(const QString &path, QString *error);
+    bool reload(QString *error);          // 重新读取 load() 时的文件；解析失败时保持现有任务不变
+    void apply(const DaemonConfig &config);
+    void stopAll();
+
+    QString configPath() const;
+    const DaemonConfig &config() const;
+    QStringList jobIds() const;
+
+    // 单个任务的控制，出错时返回 false 并给出原因
+    bool startJob(const QString &id, QString *error);
+    bool stopJob(const QString &id, QString *error);     // 停止但保留任务，可再 startJob
+    bool putJob(const QJsonObject &object, bool *created, QString *error);   // 新增或按新配置重启
+    bool removeJob(const QString &id, QString *error);
+
+    // 任务状态和实时统计
+    QJsonArray jobsJson();
+    QJsonObject jobJson(const QString &id);
+
+signals:
+    void sig_JobStarted(const QString &id);
+    void sig_JobStopped(const QString &id);
+
+private:
+    struct Job {
+        JobConfig config;
+        VideoPlayer *player = nullptr;   // pull/record
+        PushJob *push = nullptr;         // push，归 PushJobManager 所有
+        MosaicCompositor *mosaic = nullptr;   // mosaic
+        bool held = false;          // 被控制接口停止，重新加载时配置没变就保持停止
+        PerfSnapshot lastSnapshot;  // 上次查询时的快照，用来算帧率
+        bool hasSnapshot = false;
+
+        bool isRunning() const { return player || push || mosaic; }
+    };
+    void launch(Job *job);
+    void halt(Job *job);
+    void configurePull(Job *job);
+    void bindMosaics();
+    void configurePushBudget(const QJsonObject &settings);
+    QJsonObject toJson(Job *job);
+
+    QString mConfigPath;
+    DaemonConfig mConfig;
+    QMap<QString, Job *> mJobs;
+};
+
+#endif // STREAMDAEMON_H
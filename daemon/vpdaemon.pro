@@ -0,0 +1,26 @@
+#-------------------------------------------------
+#
+# 无界面守护进程：按配置文件运行多路拉流/录像/推流，与界面程序共用播放核心
+#
+#-------------------------------------------------
+
+QT       += core gui multimedia concurrent network
+QT       -= widgets
+
+CONFIG   += console c++11
+CONFIG   -= app_bundle
+
+TARGET = vpdaemon
+TEMPLATE = app
+
+include(../videoplayer_core.pri)
+
+SOURCES += main.cpp \
+    jobconfig.cpp \
+    streamdaemon.cpp \
+    controlserver.cpp
+
+HEADERS += \
+    jobconfig.h \
+    streamdaemon.h \
+    controlserver.h
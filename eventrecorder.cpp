@@ -0,0 +1,437 @@
+#include "eventrecorder.h"
+#include "perfstats.h"
+
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QStandardPaths>
+#include <QDebug>
+
+// 写线程积压超过这个量就开始丢包（磁盘太慢或卡住），避免解码线程内存无限增长
+static const qint64 kMaxQueueBytes = qint64(32) * 1024 * 1024;
+
+static QString avError(int err)
+{
+    char buf[AV_ERROR_MAX_STRING_SIZE] = { 0 };
+    av_strerror(err, buf, sizeof(buf));
+    return QString::fromUtf8(buf);
+}
+
+EventRecorder::EventRecorder(QObject *parent)
+    : QObject(parent), mEnabled(false), mContainer("mkv"),
+      mPreRollNs(qint64(5000) * 1000000), mPostRollNs(qint64(10000) * 1000000),
+      mMaxFileNs(qint64(30) * 60 * 1000000000), mMotionTrigger(true), mLastActivityNs(0),
+      mVideoStream(-1), mRecording(false), mWaitKeyframe(false), mFileStartNs(0),
+      mQueueBytes(0), mQuit(false), mWriter(nullptr),
+      mOut(nullptr), mStartUs(AV_NOPTS_VALUE), mDurationUs(0), mWriteErrors(0)
+{
+    mOutputDir = QStandardPaths::writableLocation(QStandardPaths::MoviesLocation) + "/recordings";
+}
+
+EventRecorder::~EventRecorder()
+{
+    if (mWriter) {
+        if (mRecording)
+            enqueue(Command{ Command::Close, QString(), QVector<StreamInfo>(), nullptr });
+        {
+            QMutexLocker locker(&mQueueMutex);
+            mQuit = true;
+            mQueueCond.wakeAll();
+        }
+        mWriter->wait();
+        delete mWriter;
+    }
+    freeStreams();
+}
+
+void EventRecorder::setEnabled(bool enabled)
+{
+    QMutexLocker locker(&mMutex);
+    mEnabled = enabled;
+}
+
+bool EventRecorder::isEnabled() const
+{
+    QMutexLocker locker(&mMutex);
+    return mEnabled;
+}
+
+void EventRecorder::setOutputDir(const QString &dir)
+{
+    QMutexLocker locker(&mMutex);
+    mOutputDir = dir;
+}
+
+void EventRecorder::setStreamName(const QString &name)
+{
+    // 只保留文件名里安全的字符
+    QString safe;
+    for (QChar c : name)
+        safe += (c.isLetterOrNumber() || c == '-' || c == '_') ? c : QChar('_');
+    QMutexLocker locker(&mMutex);
+    mStreamName = safe;
+}
+
+void EventRecorder::setContainer(const QString &ext)
+{
+    QMutexLocker locker(&mMutex);
+    mContainer = ext;
+}
+
+void EventRecorder::setPreRollMs(int ms)
+{
+    QMutexLocker locker(&mMutex);
+    mPreRollNs = qint64(qMax(0, ms)) * 1000000;
+}
+
+int EventRecorder::preRollMs() const
+{
+    QMutexLocker locker(&mMutex);
+    return int(mPreRollNs / 1000000);
+}
+
+void EventRecorder::setPostRollMs(int ms)
+{
+    QMutexLocker locker(&mMutex);
+    mPostRollNs = qint64(qMax(0, ms)) * 1000000;
+}
+
+void EventRecorder::setMaxFileMs(int ms)
+{
+    QMutexLocker locker(&mMutex);
+    mMaxFileNs = qint64(qMax(0, ms)) * 1000000;
+}
+
+void EventRecorder::setMotionTriggerEnabled(bool enabled)
+{
+    QMutexLocker locker(&mMutex);
+    mMotionTrigger = enabled;
+}
+
+void EventRecorder::trigger(const QString &source)
+{
+    Q_UNUSED(source);
+    QMutexLocker locker(&mMutex);
+    mLastActivityNs = perfNowNs();
+}
+
+void EventRecorder::beginHold(const QString &source)
+{
+    QMutexLocker locker(&mMutex);
+    mHolds.insert(source);
+    mLastActivityNs = perfNowNs();
+}
+
+void EventRecorder::endHold(const QString &source)
+{
+    QMutexLocker locker(&mMutex);
+    if (mHolds.remove(source))
+        mLastActivityNs = perfNowNs();
+}
+
+void EventRecorder::onMotionStarted(const QString &zone)
+{
+    {
+        QMutexLocker locker(&mMutex);
+        if (!mMotionTrigger)
+            return;
+    }
+    beginHold("motion:" + zone);
+}
+
+void EventRecorder::onMotionStopped(const QString &zone)
+{
+    endHold("motion:" + zone);
+}
+
+bool EventRecorder::isRecording() const
+{
+    return mRecording;
+}
+
+bool EventRecorder::isActive(qint64 nowNs) const
+{
+    QMutexLocker locker(&mMutex);
+    if (!mEnabled)
+        return false;
+    if (!mHolds.isEmpty())
+        return true;
+    return mLastActivityNs != 0 && nowNs - mLastActivityNs < mPostRollNs;
+}
+
+QString EventRecorder::nextPath() const
+{
+    QMutexLocker locker(&mMutex);
+    QString name = mStreamName.isEmpty() ? QString("stream") : mStreamName;
+    return QString("%1/%2_%3.%4").arg(mOutputDir, name,
+                                      QDateTime::currentDateTime().toString("yyyyMMdd-HHmmss-zzz"),
+                                      mContainer);
+}
+
+void EventRecorder::freeStreams()
+{
+    for (StreamInfo &info : mStreams)
+        avcodec_parameters_free(&info.params);
+    mStreams.clear();
+}
+
+void EventRecorder::openStreams(const AVFormatContext *fmtCtx, int videoStream, int audioStream)
+{
+    closeStreams();
+    mVideoStream = videoStream;
+    for (int index : { videoStream, audioStream }) {
+        if (index < 0 || index >= int(fmtCtx->nb_streams))
+            continue;
+        StreamInfo info;
+        info.inputIndex = index;
+        info.params = avcodec_parameters_alloc();
+        info.timeBase = fmtCtx->streams[index]->time_base;
+        if (!info.params || avcodec_parameters_copy(info.params, fmtCtx->streams[index]->codecpar) < 0) {
+            avcodec_parameters_free(&info.params);
+            continue;
+        }
+        mStreams.append(info);
+    }
+}
+
+void EventRecorder::closeStreams()
+{
+    if (mRecording) {
+        enqueue(Command{ Command::Close, QString(), QVector<StreamInfo>(), nullptr });
+        mRecording = false;
+    }
+    freeStreams();
+    mVideoStream = -1;
+}
+
+void EventRecorder::startFile(qint64 nowNs, PacketRing *ring)
+{
+    Command open{ Command::Open, nextPath(), QVector<StreamInfo>(), nullptr };
+    for (const StreamInfo &info : mStreams) {
+        StreamInfo copy = info;
+        copy.params = avcodec_parameters_alloc();
+        avcodec_parameters_copy(copy.params, info.params);
+        open.streams.append(copy);
+    }
+    if (!mWriter) {
+        mWriter = QThread::create([this]() { writerLoop(); });
+        mWriter->setObjectName("EventRecorder");
+        mWriter->start();
+    }
+    enqueue(open);
+    mRecording = true;
+    mFileStartNs = nowNs;
+    mWaitKeyframe = true;
+
+    // 预录部分：缓冲从关键帧开始，直接全部写入
+    if (ring) {
+        const QVector<AVPacket *> packets = ring->snapshot();
+        for (AVPacket *packet : packets) {
+            if (mWaitKeyframe && !(packet->stream_index == mVideoStream && (packet->flags & AV_PKT_FLAG_KEY))) {
+                av_packet_free(&packet);
+                continue;
+            }
+            mWaitKeyframe = false;
+            if (!enqueue(Command{ Command::Write, QString(), QVector<StreamInfo>(), packet })) {
+                av_packet_free(&packet);
+                mWaitKeyframe = true;
+            }
+        }
+    }
+}
+
+void EventRecorder::process(const AVPacket *packet, PacketRing *ring)
+{
+    if (mStreams.isEmpty())
+        return;
+    qint64 now = perfNowNs();
+    bool active = isActive(now);
+    bool keyframe = packet->stream_index == mVideoStream && (packet->flags & AV_PKT_FLAG_KEY);
+
+    if (!mRecording) {
+        // 当前包已经在缓冲里，会随预录部分一起写入
+        if (active)
+            startFile(now, ring);
+        return;
+    }
+
+    if (!active) {
+        enqueue(Command{ Command::Close, QString(), QVector<StreamInfo>(), nullptr });
+        mRecording = false;
+        return;
+    }
+
+    qint64 maxFileNs;
+    {
+        QMutexLocker locker(&mMutex);
+        maxFileNs = mMaxFileNs;
+    }
+    if (keyframe && maxFileNs > 0 && now - mFileStartNs >= maxFileNs) {
+        // 长时间持续触发：在关键帧处换一个文件
+        enqueue(Command{ Command::Close, QString(), QVector<StreamInfo>(), nullptr });
+        startFile(now, nullptr);
+    }
+
+    if (mWaitKeyframe) {
+        if (!keyframe)
+            return;
+        mWaitKeyframe = false;
+    }
+    AVPacket *copy = av_packet_clone(packet);
+    if (!copy)
+        return;
+    if (!enqueue(Command{ Command::Write, QString(), QVector<StreamInfo>(), copy })) {
+        av_packet_free(&copy);
+        mWaitKeyframe = true;   // 丢了包，后面的非关键帧解不出来，等下一个关键帧
+    }
+}
+
+bool EventRecorder::enqueue(const Command &command)
+{
+    QMutexLocker locker(&mQueueMutex);
+    if (command.type == Command::Write) {
+        if (mQueueBytes > kMaxQueueBytes)
+            return false;
+        mQueueBytes += command.packet->size;
+    }
+    mQueue.append(command);
+    mQueueCond.wakeOne();
+    return true;
+}
+
+void EventRecorder::writerLoop()
+{
+    forever {
+        Command command;
+        {
+            QMutexLocker locker(&mQueueMutex);
+            while (mQueue.isEmpty() && !mQuit)
+                mQueueCond.wait(&mQueueMutex);
+            if (mQueue.isEmpty())
+                break;
+            command = mQueue.takeFirst();
+            if (command.type == Command::Write)
+                mQueueBytes -= command.packet->size;
+        }
+        switch (command.type) {
+        case Command::Open:
+            writerClose();
+            writerOpen(command);
+            break;
+        case Command::Write:
+            writerPacket(command.packet);
+            break;
+        case Command::Close:
+            writerClose();
+            break;
+        }
+    }
+    writerClose();
+}
+
+void EventRecorder::writerOpen(Command &command)
+{
+    QString error;
+    QByteArray path = command.path.toUtf8();
+    QDir().mkpath(QFileInfo(command.path).absolutePath());
+    int ret = avformat_alloc_output_context2(&mOut, nullptr, nullptr, path.constData());
+    if (ret < 0 || !mOut) {
+        error = QString("Cannot create %1: %2").arg(command.path, avError(ret));
+    } else {
+        int maxIndex = 0;
+        for (const StreamInfo &info : command.streams)
+            maxIndex = qMax(maxIndex, info.inputIndex + 1);
+        mOutIndex = QVector<int>(maxIndex, -1);
+        mInTimeBase = QVector<AVRational>(maxIndex, av_make_q(0, 1));
+        for (const StreamInfo &info : command.streams) {
+            AVStream *stream = avformat_new_stream(mOut, nullptr);
+            if (!stream || avcodec_parameters_copy(stream->codecpar, info.params) < 0)
+                continue;
+            stream->codecpar->codec_tag = 0;
+            stream->time_base = info.timeBase;
+            mOutIndex[info.inputIndex] = stream->index;
+            mInTimeBase[info.inputIndex] = info.timeBase;
+        }
+        if (!(mOut->oformat->flags & AVFMT_NOFILE)) {
+            ret = avio_open(&mOut->pb, path.constData(), AVIO_FLAG_WRITE);
+            if (ret < 0)
+                error = QString("Cannot open %1: %2").arg(command.path, avError(ret));
+        }
+        if (error.isEmpty()) {
+            ret = avformat_write_header(mOut, nullptr);
+            if (ret < 0)
+                error = QString("Cannot write header for %1: %2").arg(command.path, avError(ret));
+        }
+    }
+    for (StreamInfo &info : command.streams)
+        avcodec_parameters_free(&info.params);
+
+    if (!error.isEmpty()) {
+        qWarning() << "EventRecorder:" << error;
+        if (mOut) {
+            if (mOut->pb)
+                avio_closep(&mOut->pb);
+            avformat_free_context(mOut);
+            mOut = nullptr;
+        }
+        emit sig_RecordingError(error);
+        return;
+    }
+    mOutPath = command.path;
+    mStartUs = AV_NOPTS_VALUE;
+    mDurationUs = 0;
+    mWriteErrors = 0;
+    qDebug() << "EventRecorder: recording to" << mOutPath;
+    emit sig_RecordingStarted(mOutPath);
+}
+
+void EventRecorder::writerPacket(AVPacket *packet)
+{
+    int index = packet->stream_index;
+    if (!mOut || index < 0 || index >= mOutIndex.size() || mOutIndex[index] < 0) {
+        av_packet_free(&packet);
+        return;
+    }
+    const AVRational inTb = mInTimeBase[index];
+    AVStream *stream = mOut->streams[mOutIndex[index]];
+
+    // 以第一个包为零点，文件从 0 开始
+    qint64 ts = packet->dts != AV_NOPTS_VALUE ? packet->dts : packet->pts;
+    if (mStartUs == AV_NOPTS_VALUE && ts != AV_NOPTS_VALUE)
+        mStartUs = av_rescale_q(ts, inTb, AV_TIME_BASE_Q);
+    if (mStartUs != AV_NOPTS_VALUE) {
+        qint64 offset = av_rescale_q(mStartUs, AV_TIME_BASE_Q, inTb);
+        if (packet->pts != AV_NOPTS_VALUE)
+            packet->pts -= offset;
+        if (packet->dts != AV_NOPTS_VALUE)
+            packet->dts -= offset;
+    }
+    if (packet->dts != AV_NOPTS_VALUE && packet->dts < 0) {
+        av_packet_free(&packet);   // 交织顺序上早于第一个视频关键帧的音频包
+        return;
+    }
+    if (packet->pts != AV_NOPTS_VALUE)
+        mDurationUs = qMax(mDurationUs, av_rescale_q(packet->pts, inTb, AV_TIME_BASE_Q));
+
+    av_packet_rescale_ts(packet, inTb, stream->time_base);
+    packet->stream_index = stream->index;
+    packet->pos = -1;
+    int ret = av_interleaved_write_frame(mOut, packet);
+    if (ret < 0 && mWriteErrors++ == 0)
+        qWarning() << "EventRecorder: write failed" << avError(ret);
+    av_packet_free(&packet);
+}
+
+void EventRecorder::writerClose()
+{
+    if (!mOut)
+        return;
+    av_write_trailer(mOut);
+    qint64 bytes = mOut->pb ? avio_size(mOut->pb) : 0;
+    if (!(mOut->oformat->flags & AVFMT_NOFILE))
+        avio_closep(&mOut->pb);
+    avformat_free_context(mOut);
+    mOut = nullptr;
+    qDebug() << "EventRecorder: finished" << mOutPath << mDurationUs / 1000 << "ms" << bytes << "bytes";
+    emit sig_RecordingFinished(mOutPath, mDurationUs / 1000, bytes);
+}
@@ -0,0 +1,129 @@
+#ifndef EVENTRECORDER_H
+#define EVENTRECORDER_H
+
+#include <QObject>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QList>
+#include <QSet>
+#include <QVector>
+#include <QThread>
+
+#include <atomic>
+
+#include "packetring.h"
+
+extern "C" {
+    #include <libavformat/avformat.h>
+}
+
+// 事件录像：有移动（或外部触发）时开始，把预录缓冲里的包和之后收到的包原样写进文件（不转码），
+// 所有触发都结束并过了 post-roll 后停止。静止画面不写盘，磁盘和 CPU 开销只随事件多少变化。
+// 文件写入在单独的线程里做，解码线程只把包的引用放进队列；写盘跟不上时丢包并从下一个关键帧继续。
+//
+// 线程：触发接口（trigger/beginHold/endHold/onMotion*）和设置可在任意线程调用；
+// openStreams/process/closeStreams 只在解码线程调用。
+class EventRecorder : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit EventRecorder(QObject *parent = nullptr);
+    ~EventRecorder();
+
+    void setEnabled(bool enabled);            // 开启后才缓存预录包、响应触发，默认关闭
+    bool isEnabled() const;
+    void setOutputDir(const QString &dir);    // 默认 <视频目录>/recordings
+    void setStreamName(const QString &name);  // 文件名前缀
+    void setContainer(const QString &ext);    // mkv（默认）、mp4 或 ts
+    void setPreRollMs(int ms);                // 默认 5000
+    int preRollMs() const;
+    void setPostRollMs(int ms);               // 默认 10000
+    void setMaxFileMs(int ms);                // 单个文件最长时长，到点后在下一个关键帧换文件，默认 30 分钟
+    void setMotionTriggerEnabled(bool enabled);   // 移动侦测是否触发录像，默认开启
+
+    // 单次触发：录下预录部分和之后 post-roll 时长，录像进行中则延长
+    void trigger(const QString &source);
+    // 持续触发：beginHold 到 endHold 之间一直录，结束后再录 post-roll
+    void beginHold(const QString &source);
+    void endHold(const QString &source);
+    bool isRecording() const;
+
+    // 解码线程：流打开后登记要录的流（audioStream 可为 -1），每个读到的包都交给 process
+    void openStreams(const AVFormatContext *fmtCtx, int videoStream, int audioStream);
+    void process(const AVPacket *packet, PacketRing *ring);
+    void closeStreams();
+
+public slots:
+    void onMotionStarted(const QString &zone);
+    void onMotionStopped(const QString &zone);
+
+signals:
+    void sig_RecordingStarted(const QString &path);
+    void sig_RecordingFinished(const QString &path, qint64 durationMs, qint64 bytes);
+    void sig_RecordingError(const QString &message);
+
+private:
+    Q_DISABLE_COPY(EventRecorder)
+
+    struct StreamInfo {
+        int inputIndex;
+        AVCodecParameters *params;
+        AVRational timeBase;
+    };
+    struct Command {
+        enum Type { Open, Write, Close } type;
+        QString path;
+        QVector<StreamInfo> streams;     // Open：各自一份参数拷贝，由写线程释放
+        AVPacket *packet;                // Write
+    };
+
+    bool isActive(qint64 nowNs) const;
+    QString nextPath() const;
+    void startFile(qint64 nowNs, PacketRing *ring);
+    bool enqueue(const Command &command);
+    void freeStreams();
+
+    // 写线程
+    void writerLoop();
+    void writerOpen(Command &command);
+    void writerPacket(AVPacket *packet);
+    void writerClose();
+
+    // 设置和触发状态
+    mutable QMutex mMutex;
+    bool mEnabled;
+    QString mOutputDir;
+    QString mStreamName;
+    QString mContainer;
+    qint64 mPreRollNs, mPostRollNs, mMaxFileNs;
+    bool mMotionTrigger;
+    QSet<QString> mHolds;
+    qint64 mLastActivityNs;          // 最近一次触发或持续触发结束的时刻，0 表示没有
+
+    // 解码线程
+    QVector<StreamInfo> mStreams;
+    int mVideoStream;
+    std::atomic<bool> mRecording;
+    bool mWaitKeyframe;              // 从下一个视频关键帧开始写（缓冲为空或丢过包）
+    qint64 mFileStartNs;
+
+    // 写队列
+    QMutex mQueueMutex;
+    QWaitCondition mQueueCond;
+    QList<Command> mQueue;
+    qint64 mQueueBytes;
+    bool mQuit;
+    QThread *mWriter;
+
+    // 以下只在写线程访问
+    AVFormatContext *mOut;
+    QString mOutPath;
+    QVector<int> mOutIndex;          // 输入流序号 -> 输出流序号，-1 表示不录
+    QVector<AVRational> mInTimeBase;
+    qint64 mStartUs;                 // 第一个包的 dts，所有时间戳以它为零点
+    qint64 mDurationUs;
+    int mWriteErrors;
+};
+
+#endif // EVENTRECORDER_H
@@ -0,0 +1,18 @@
+# FFmpeg 头文件与库
+
+win32 {
+    INCLUDEPATH += $$PWD/ffmpeg/include
+
+    LIBS += $$PWD/ffmpeg/lib/avcodec.lib \
+            $$PWD/ffmpeg/lib/avdevice.lib \
+            $$PWD/ffmpeg/lib/avfilter.lib \
+            $$PWD/ffmpeg/lib/avformat.lib \
+            $$PWD/ffmpeg/lib/avutil.lib \
+            $$PWD/ffmpeg/lib/postproc.lib \
+            $$PWD/ffmpeg/lib/swresample.lib \
+            $$PWD/ffmpeg/lib/swscale.lib
+} else {
+    # Linux 服务器上使用系统安装的 FFmpeg 开发包
+    CONFIG += link_pkgconfig
+    PKGCONFIG += libavcodec libavdevice libavfilter libavformat libavutil libswresample libswscale
+}
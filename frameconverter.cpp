@@ -0,0 +1,287 @@
+#include "frameconverter.h"
+
+#include <QThread>
+#include <QFuture>
+#include <QtConcurrent/QtConcurrentRun>
+#include <QDebug>
+
+extern "C" {
+    #include <libavutil/pixdesc.h>
+}
+
+// 每个条带至少这么多源像素，再小时线程切换的开销超过收益
+static const int kMinSlicePixels = 960 * 540;
+static const int kMaxSlices = 8;
+// 保留的上下文组数：常见的是主/子码流两种分辨率，再加上窗口缩放前后的目标尺寸
+static const int kMaxCached = 4;
+
+static AVPixelFormat avFormatFor(QImage::Format format)
+{
+    switch (format) {
+    case QImage::Format_RGB32:
+    case QImage::Format_ARGB32:
+        return AV_PIX_FMT_RGB32;
+    case QImage::Format_RGB888:
+        return AV_PIX_FMT_RGB24;
+    case QImage::Format_Grayscale8:
+        return AV_PIX_FMT_GRAY8;
+    default:
+        return AV_PIX_FMT_NONE;
+    }
+}
+
+FrameConverter::FrameConverter()
+    : mCurrent(nullptr), mUseCounter(0), mCreated(0),
+      mThreadCount(0), mFastPath(true), mSimd("auto")
+{
+}
+
+FrameConverter::~FrameConverter()
+{
+    mPool.waitForDone();
+    clearCache();
+}
+
+bool FrameConverter::Key::operator==(const Key &other) const
+{
+    return srcWidth == other.srcWidth && srcHeight == other.srcHeight
+            && srcFormat == other.srcFormat && srcRange == other.srcRange
+            && dstWidth == other.dstWidth && dstHeight == other.dstHeight
+            && dstFormat == other.dstFormat;
+}
+
+void FrameConverter::setThreadCount(int count)
+{
+    if (count == mThreadCount)
+        return;
+    mThreadCount = count;
+    clearCache();   // 下一帧按新的条带数重建
+}
+
+void FrameConverter::setFastPathEnabled(bool enabled)
+{
+    if (enabled == mFastPath)
+        return;
+    mFastPath = enabled;
+    clearCache();
+}
+
+bool FrameConverter::setSimd(const QString &name)
+{
+    YuvConverter probe;
+    if (!probe.setSimd(name))
+        return false;
+    mSimd = name;
+    for (Entry *entry : mEntries)
+        entry->yuv.setSimd(name);
+    return true;
+}
+
+QString FrameConverter::backendName() const
+{
+    if (!mCurrent || mCurrent->slices.isEmpty())
+        return QString();
+    return mCurrent->slices.first().ctx ? QString("sws") : mCurrent->yuv.simdName();
+}
+
+int FrameConverter::sliceCount() const
+{
+    return mCurrent ? mCurrent->slices.size() : 0;
+}
+
+int FrameConverter::cachedCount() const
+{
+    return mEntries.size();
+}
+
+int FrameConverter::createdCount() const
+{
+    return mCreated;
+}
+
+int FrameConverter::autoSliceCount(int srcWidth, int srcHeight, int dstWidth, int dstHeight)
+{
+    // 转换开销大致随源、目标中较大的一方增长
+    qint64 pixels = qMax(qint64(srcWidth) * srcHeight, qint64(dstWidth) * dstHeight);
+    int count = int(pixels / kMinSlicePixels);
+    return qBound(1, qMin(count, QThread::idealThreadCount()), kMaxSlices);
+}
+
+void FrameConverter::freeEntry(Entry *entry)
+{
+    for (const Slice &slice : entry->slices) {
+        if (slice.ctx)
+            sws_freeContext(slice.ctx);
+    }
+    delete entry;
+}
+
+void FrameConverter::clearCache()
+{
+    for (Entry *entry : mEntries)
+        freeEntry(entry);
+    mEntries.clear();
+    mCurrent = nullptr;
+}
+
+FrameConverter::Entry *FrameConverter::lookup(const Key &key)
+{
+    if (mCurrent && mCurrent->key == key)
+        return mCurrent;
+    for (Entry *entry : mEntries) {
+        if (entry->key == key)
+            return entry;
+    }
+    return nullptr;
+}
+
+FrameConverter::Entry *FrameConverter::create(const Key &key, const AVFrame *src)
+{
+    Entry *entry = new Entry;
+    entry->key = key;
+    entry->chromaShift = 0;
+    entry->lastUsed = 0;
+    entry->yuv.setSimd(mSimd);
+
+    const int dstWidth = key.dstWidth, dstHeight = key.dstHeight;
+    int count = mThreadCount > 0 ? mThreadCount
+                                 : autoSliceCount(src->width, src->height, dstWidth, dstHeight);
+    if (mFastPath && key.dstFormat == AV_PIX_FMT_RGB32 && entry->yuv.prepare(src, dstWidth, dstHeight)) {
+        // 专用实现每个目标行独立计算，直接按目标行均分
+        count = qBound(1, count, qMax(1, dstHeight / 16));
+        for (int i = 0; i < count; i++) {
+            Slice slice;
+            slice.ctx = nullptr;
+            slice.srcY = slice.srcH = 0;
+            slice.dstY = int(qint64(dstHeight) * i / count);
+            slice.dstH = int(qint64(dstHeight) * (i + 1) / count) - slice.dstY;
+            entry->slices.append(slice);
+        }
+        return entry;
+    }
+
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(AVPixelFormat(src->format));
+    if (!desc) {
+        delete entry;
+        return nullptr;
+    }
+
+    // 调色板、位流和硬件帧不能按行切分
+    if (desc->flags & (AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_BITSTREAM | AV_PIX_FMT_FLAG_HWACCEL))
+        count = 1;
+    entry->chromaShift = desc->log2_chroma_h;
+    const int align = 1 << entry->chromaShift;
+    count = qBound(1, count, src->height / qMax(align, 16));
+
+    // 源行按色度对齐切分，目标行按比例对应
+    int prevSrcY = 0, prevDstY = 0;
+    for (int i = 1; i <= count; i++) {
+        int srcY = src->height, dstY = dstHeight;
+        if (i < count) {
+            srcY = int(qint64(src->height) * i / count) & ~(align - 1);
+            dstY = int((qint64(srcY) * dstHeight + src->height / 2) / src->height);
+        }
+        Slice slice;
+        slice.srcY = prevSrcY;
+        slice.srcH = srcY - prevSrcY;
+        slice.dstY = prevDstY;
+        slice.dstH = dstY - prevDstY;
+        if (slice.srcH <= 0 || slice.dstH <= 0)
+            continue;
+        slice.ctx = sws_getContext(src->width, slice.srcH, AVPixelFormat(src->format),
+                                   dstWidth, slice.dstH, AVPixelFormat(key.dstFormat),
+                                   SWS_BICUBIC, nullptr, nullptr, nullptr);
+        if (!slice.ctx) {
+            qWarning() << "FrameConverter: sws_getContext failed for"
+                       << av_get_pix_fmt_name(AVPixelFormat(src->format));
+            freeEntry(entry);
+            return nullptr;
+        }
+        entry->slices.append(slice);
+        prevSrcY = srcY;
+        prevDstY = dstY;
+    }
+    if (entry->slices.isEmpty()) {
+        delete entry;
+        return nullptr;
+    }
+    return entry;
+}
+
+void FrameConverter::convertSlice(const Entry *entry, const Slice &slice, const AVFrame *src,
+                                  uint8_t *dst, int dstStride) const
+{
+    if (!slice.ctx) {
+        entry->yuv.convertRows(src, dst, dstStride, slice.dstY, slice.dstY + slice.dstH);
+        return;
+    }
+    const uint8_t *srcData[4] = { nullptr, nullptr, nullptr, nullptr };
+    for (int p = 0; p < 4 && src->data[p]; p++) {
+        // 色度平面（1、2）按下采样后的行号偏移，亮度和 alpha 平面按原行号
+        int y = (p == 1 || p == 2) ? (slice.srcY >> entry->chromaShift) : slice.srcY;
+        srcData[p] = src->data[p] + qint64(y) * src->linesize[p];
+    }
+    uint8_t *dstData[4] = { dst + qint64(slice.dstY) * dstStride, nullptr, nullptr, nullptr };
+    int dstLinesize[4] = { dstStride, 0, 0, 0 };
+    sws_scale(slice.ctx, srcData, src->linesize, 0, slice.srcH, dstData, dstLinesize);
+}
+
+bool FrameConverter::convert(const AVFrame *src, QImage *dst)
+{
+    const AVPixelFormat dstFormat = avFormatFor(dst->format());
+    if (dst->isNull() || dstFormat == AV_PIX_FMT_NONE || src->width <= 0 || src->height <= 0)
+        return false;
+
+    Key key;
+    key.srcWidth = src->width;
+    key.srcHeight = src->height;
+    key.srcFormat = src->format;
+    key.srcRange = src->color_range;
+    key.dstWidth = dst->width();
+    key.dstHeight = dst->height();
+    key.dstFormat = dstFormat;
+
+    Entry *entry = lookup(key);
+    if (!entry) {
+        entry = create(key, src);
+        if (!entry)
+            return false;
+        if (mCreated > 0) {
+            qDebug() << "FrameConverter: new geometry" << src->width << "x" << src->height
+                     << av_get_pix_fmt_name(AVPixelFormat(src->format))
+                     << "->" << key.dstWidth << "x" << key.dstHeight;
+        }
+        mCreated++;
+        if (mEntries.size() >= kMaxCached) {
+            int oldest = 0;
+            for (int i = 1; i < mEntries.size(); i++) {
+                if (mEntries.at(i)->lastUsed < mEntries.at(oldest)->lastUsed)
+                    oldest = i;
+            }
+            freeEntry(mEntries.takeAt(oldest));
+        }
+        mEntries.append(entry);
+    }
+    entry->lastUsed = ++mUseCounter;
+    mCurrent = entry;
+    const QVector<Slice> &slices = entry->slices;
+    if (mPool.maxThreadCount() < slices.size() - 1)
+        mPool.setMaxThreadCount(slices.size() - 1);
+
+    // 在调用线程里取像素指针（会触发 QImage 分离），工作线程只写各自的行
+    uint8_t *dstBits = dst->bits();
+    const int dstStride = dst->bytesPerLine();
+
+    QVector<QFuture<void> > futures;
+    futures.reserve(slices.size() - 1);
+    for (int i = 1; i < slices.size(); i++) {
+        const Slice &slice = slices.at(i);
+        futures.append(QtConcurrent::run(&mPool, [this, entry, &slice, src, dstBits, dstStride]() {
+            convertSlice(entry, slice, src, dstBits, dstStride);
+        }));
+    }
+    convertSlice(entry, slices.first(), src, dstBits, dstStride);
+    for (QFuture<void> &future : futures)
+        future.waitForFinished();
+    return true;
+}
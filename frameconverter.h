@@ -0,0 +1,93 @@
+#ifndef FRAMECONVERTER_H
+#define FRAMECONVERTER_H
+
+#include <QImage>
+#include <QVector>
+#include <QThreadPool>
+
+#include "yuvconverter.h"
+
+extern "C" {
+    #include <libavutil/frame.h>
+    #include <libswscale/swscale.h>
+}
+
+// 解码帧转 RGB32（可同时缩放）。高分辨率时把画面按行切成若干水平条带，
+// 每条带一个 SwsContext，在线程池里并行转换；调用线程自己也处理一条。
+// 条带边界按色度行对齐；边界处的滤波只用到本条带的源行，
+// 与整帧一次 sws_scale 相比只在边界附近的几行有细微差异。
+// YUV420P/NV12 等常见格式优先走 YuvConverter 的专用 SIMD 实现（按目标行切分，无边界差异），
+// 其他格式用 sws_scale。
+// 转换参数取自每一帧自身的宽高/格式（摄像头切换码流、SPS 变化时无需重开流），
+// 最近用过的几组参数的上下文都保留着，在几种分辨率之间来回切换时不用重建。
+// 同一个实例只能在一个线程里使用。
+class FrameConverter
+{
+public:
+    FrameConverter();
+    ~FrameConverter();
+
+    // 条带数，0（默认）表示按分辨率和 CPU 核数自动选择
+    void setThreadCount(int count);
+    int sliceCount() const;
+
+    // 关闭后总是用 sws_scale（对比测试用），默认开启
+    void setFastPathEnabled(bool enabled);
+    bool setSimd(const QString &name);     // 见 YuvConverter::setSimd
+    // 当前帧实际使用的实现："sws" 或 YuvConverter 的 SIMD 名称，如 "avx2"
+    QString backendName() const;
+
+    // dst 需预先按目标尺寸分配好，格式为 Format_RGB32/ARGB32（RGB888、Grayscale8 只走 sws_scale）
+    bool convert(const AVFrame *src, QImage *dst);
+
+    // 缓存的转换上下文组数，以及累计新建的次数（统计/测试用）
+    int cachedCount() const;
+    int createdCount() const;
+
+    // 自动模式下给定源/目标尺寸使用的条带数
+    static int autoSliceCount(int srcWidth, int srcHeight, int dstWidth, int dstHeight);
+
+private:
+    Q_DISABLE_COPY(FrameConverter)
+
+    struct Slice {
+        SwsContext *ctx;       // 为空时该条带由 YuvConverter 转换
+        int srcY, srcH;
+        int dstY, dstH;
+    };
+
+    // 源/目标参数，任何一项变化都对应另一组上下文
+    struct Key {
+        int srcWidth, srcHeight, srcFormat, srcRange;
+        int dstWidth, dstHeight, dstFormat;
+        bool operator==(const Key &other) const;
+    };
+
+    struct Entry {
+        Key key;
+        QVector<Slice> slices;
+        YuvConverter yuv;
+        int chromaShift;       // 源格式色度平面的垂直下采样位数
+        quint64 lastUsed;
+    };
+
+    Entry *lookup(const Key &key);
+    Entry *create(const Key &key, const AVFrame *src);
+    void convertSlice(const Entry *entry, const Slice &slice, const AVFrame *src,
+                      uint8_t *dst, int dstStride) const;
+    static void freeEntry(Entry *entry);
+    void clearCache();
+
+    QVector<Entry *> mEntries;  // 最多 kMaxCached 组，满了淘汰最久没用的
+    Entry *mCurrent;
+    quint64 mUseCounter;
+    int mCreated;
+
+    int mThreadCount;
+    bool mFastPath;
+    QString mSimd;
+
+    QThreadPool mPool;
+};
+
+#endif // FRAMECONVERTER_H
@@ -0,0 +1,66 @@
+#ifndef FRAMEMAILBOX_H
+#define FRAMEMAILBOX_H
+
+#include <QtGlobal>
+
+#include <atomic>
+#include <utility>
+
+// 单槽“最新帧优先”邮箱：生产者（解码线程）不断覆盖，消费者（界面线程）只取最新的一帧。
+// 不加锁，积压最多一帧；被覆盖掉的帧计入 dropped()。
+// post() 返回 true 时生产者需要通知消费者一次（例如发一个不带数据的信号），
+// 消费者取走之前不会再要求通知，事件队列里最多只有一个待处理的通知。
+template <typename T>
+class FrameMailbox
+{
+public:
+    FrameMailbox() : mSlot(nullptr), mNotifyPending(false), mPosted(0), mDropped(0) {}
+    ~FrameMailbox() { delete mSlot.exchange(nullptr); }
+
+    bool post(const T &value, bool *replaced = nullptr)
+    {
+        T *old = mSlot.exchange(new T(value));
+        mPosted.fetch_add(1, std::memory_order_relaxed);
+        if (old) {
+            delete old;
+            mDropped.fetch_add(1, std::memory_order_relaxed);
+        }
+        if (replaced)
+            *replaced = old != nullptr;
+        return !mNotifyPending.exchange(true);
+    }
+
+    // 先清通知标志再取：取走之后到达的帧一定会再触发一次通知
+    bool take(T *out)
+    {
+        mNotifyPending.store(false);
+        T *value = mSlot.exchange(nullptr);
+        if (!value)
+            return false;
+        *out = std::move(*value);
+        delete value;
+        return true;
+    }
+
+    // 返回是否丢弃了一帧未取走的帧
+    bool clear()
+    {
+        T *value = mSlot.exchange(nullptr);
+        mNotifyPending.store(false);
+        delete value;
+        return value != nullptr;
+    }
+
+    quint64 posted() const { return mPosted.load(std::memory_order_relaxed); }
+    quint64 dropped() const { return mDropped.load(std::memory_order_relaxed); }
+
+private:
+    Q_DISABLE_COPY(FrameMailbox)
+
+    std::atomic<T *> mSlot;
+    std::atomic<bool> mNotifyPending;
+    std::atomic<quint64> mPosted;
+    std::atomic<quint64> mDropped;
+};
+
+#endif // FRAMEMAILBOX_H
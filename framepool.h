@@ -0,0 +1,75 @@
+#ifndef FRAMEPOOL_H
+#define FRAMEPOOL_H
+
+#include <QVector>
+
+extern "C" {
+    #include <libavutil/frame.h>
+}
+
+// 解码线程的 AVFrame 缓冲池，与 ImagePool 同样的思路：交给别人的是 av_frame_clone 出来的引用，
+// 对方释放后池里这份的缓冲引用计数回到 1（可写），下一帧直接复用，不用每帧重新分配。
+// 尺寸或格式变了时旧缓冲逐步被淘汰。只能在一个线程里使用。
+//
+// 用法：
+//     AVFrame *frame = pool.acquire(width, height, AV_PIX_FMT_YUV420P);
+//     ...写入 frame->data...
+//     AVFrame *ref = av_frame_clone(frame);   // 交给其他线程，用完 av_frame_free
+class FramePool
+{
+public:
+    explicit FramePool(int capacity = 4) : mCapacity(capacity), mAllocations(0) {}
+    ~FramePool() { clear(); }
+
+    // 返回池里的帧（仍归池所有，不要释放），缓冲可写，内容未初始化；分配失败返回 nullptr
+    AVFrame *acquire(int width, int height, AVPixelFormat format)
+    {
+        for (AVFrame *frame : mFrames) {
+            if (frame->width == width && frame->height == height && frame->format == format
+                    && av_frame_is_writable(frame))
+                return frame;
+        }
+        // 没有可用的：顺带丢掉已空闲但尺寸不对的旧缓冲
+        for (int i = mFrames.size() - 1; i >= 0; i--) {
+            if (av_frame_is_writable(mFrames.at(i))) {
+                AVFrame *stale = mFrames.takeAt(i);
+                av_frame_free(&stale);
+            }
+        }
+        AVFrame *frame = av_frame_alloc();
+        if (!frame)
+            return nullptr;
+        frame->width = width;
+        frame->height = height;
+        frame->format = format;
+        if (av_frame_get_buffer(frame, 32) < 0) {
+            av_frame_free(&frame);
+            return nullptr;
+        }
+        mAllocations++;
+        mFrames.append(frame);
+        // 超过容量时丢掉最早的（仍在使用的话缓冲由最后一个引用释放）
+        while (mFrames.size() > mCapacity) {
+            AVFrame *oldest = mFrames.takeFirst();
+            av_frame_free(&oldest);
+        }
+        return frame;
+    }
+
+    void clear()
+    {
+        for (AVFrame *frame : mFrames)
+            av_frame_free(&frame);
+        mFrames.clear();
+    }
+
+    // 累计新分配的次数，稳定运行时应该不再增长
+    int allocations() const { return mAllocations; }
+
+private:
+    QVector<AVFrame *> mFrames;
+    int mCapacity;
+    int mAllocations;
+};
+
+#endif // FRAMEPOOL_H
@@ -0,0 +1,186 @@
+#include "httpserver.h"
+
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QJsonDocument>
+#include <QSharedPointer>
+#include <QUrl>
+
+static const int kMaxHeaderSize = 64 * 1024;
+static const int kMaxBodySize = 1024 * 1024;
+
+static QByteArray reasonPhrase(int status)
+{
+    switch (status) {
+    case 200: return "OK";
+    case 201: return "Created";
+    case 202: return "Accepted";
+    case 400: return "Bad Request";
+    case 401: return "Unauthorized";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    case 409: return "Conflict";
+    case 413: return "Payload Too Large";
+    case 500: return "Internal Server Error";
+    case 503: return "Service Unavailable";
+    default:  return "Unknown";
+    }
+}
+
+HttpResponse HttpResponse::json(const QJsonObject &object, int status)
+{
+    HttpResponse response;
+    response.status = status;
+    response.contentType = "application/json";
+    response.body = QJsonDocument(object).toJson(QJsonDocument::Compact);
+    return response;
+}
+
+HttpResponse HttpResponse::error(int status, const QString &message)
+{
+    QJsonObject object;
+    object["error"] = message;
+    return json(object, status);
+}
+
+HttpServer::HttpServer(QObject *parent)
+    : QObject(parent), mContext(nullptr), mServer(nullptr), mPort(0)
+{
+}
+
+HttpServer::~HttpServer()
+{
+    stop();
+}
+
+void HttpServer::addRoute(const QString &method, const QString &path, const Handler &handler)
+{
+    mRoutes[path][method.toUpper()] = handler;
+}
+
+bool HttpServer::start(const QHostAddress &address, quint16 port, QString *error)
+{
+    if (mServer)
+        return true;
+
+    mContext = new QObject;
+    mContext->moveToThread(&mThread);
+    mThread.start();
+
+    // QTcpServer 必须在服务器线程里创建
+    bool ok = false;
+    QString errorText;
+    QMetaObject::invokeMethod(mContext, [&]() {
+        mServer = new QTcpServer(mContext);
+        ok = mServer->listen(address, port);
+        if (!ok) {
+            errorText = mServer->errorString();
+            return;
+        }
+        mPort = mServer->serverPort();
+        connect(mServer, &QTcpServer::newConnection, mContext, [this]() { onNewConnection(); });
+    }, Qt::BlockingQueuedConnection);
+
+    if (!ok) {
+        if (error) *error = errorText;
+        stop();
+    }
+    return ok;
+}
+
+void HttpServer::stop()
+{
+    if (!mContext)
+        return;
+    // 服务器和所有连接都是 mContext 的子对象，线程退出前在服务器线程里一起删除
+    mContext->deleteLater();
+    mThread.quit();
+    mThread.wait();
+    mContext = nullptr;
+    mServer = nullptr;
+    mPort = 0;
+}
+
+bool HttpServer::isListening() const
+{
+    return mServer != nullptr;
+}
+
+quint16 HttpServer::port() const
+{
+    return mPort;
+}
+
+static void writeResponse(QTcpSocket *socket, const HttpResponse &response)
+{
+    QByteArray out = "HTTP/1.0 " + QByteArray::number(response.status) + " " + reasonPhrase(response.status) + "\r\n";
+    out += "Content-Type: " + response.contentType + "\r\n";
+    out += "Content-Length: " + QByteArray::number(response.body.size()) + "\r\n";
+    out += "Connection: close\r\n\r\n";
+    out += response.body;
+    socket->write(out);
+    socket->disconnectFromHost();
+}
+
+void HttpServer::onNewConnection()
+{
+    while (mServer->hasPendingConnections()) {
+        QTcpSocket *socket = mServer->nextPendingConnection();
+        socket->setParent(mContext);
+        QSharedPointer<QByteArray> buffer(new QByteArray);
+
+        connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+        connect(socket, &QTcpSocket::readyRead, socket, [this, socket, buffer]() {
+            buffer->append(socket->readAll());
+
+            int headerEnd = buffer->indexOf("\r\n\r\n");
+            if (headerEnd < 0) {
+                if (buffer->size() > kMaxHeaderSize)
+                    writeResponse(socket, HttpResponse::error(413, "header too large"));
+                return;
+            }
+
+            HttpRequest request;
+            QList<QByteArray> lines = buffer->left(headerEnd).split('\n');
+            QList<QByteArray> requestLine = lines.first().trimmed().split(' ');
+            if (requestLine.size() < 2) {
+                writeResponse(socket, HttpResponse::error(400, "bad request line"));
+                return;
+            }
+            for (int i = 1; i < lines.size(); i++) {
+                int colon = lines.at(i).indexOf(':');
+                if (colon > 0)
+                    request.headers[QString::fromLatin1(lines.at(i).left(colon)).trimmed().toLower()] =
+                            QString::fromLatin1(lines.at(i).mid(colon + 1)).trimmed();
+            }
+
+            int contentLength = request.headers.value("content-length").toInt();
+            if (contentLength > kMaxBodySize) {
+                writeResponse(socket, HttpResponse::error(413, "body too large"));
+                return;
+            }
+            if (buffer->size() < headerEnd + 4 + contentLength)
+                return;   // 请求体还没收完
+
+            QUrl url(QString::fromLatin1(requestLine.at(1)));
+            request.method = QString::fromLatin1(requestLine.at(0)).toUpper();
+            request.path = url.path();
+            request.query = QUrlQuery(url);
+            request.body = buffer->mid(headerEnd + 4, contentLength);
+            buffer->clear();
+
+            writeResponse(socket, dispatch(request));
+        });
+    }
+}
+
+HttpResponse HttpServer::dispatch(const HttpRequest &request) const
+{
+    auto route = mRoutes.constFind(request.path);
+    if (route == mRoutes.constEnd())
+        return HttpResponse::error(404, "no such endpoint");
+    auto handler = route->constFind(request.method);
+    if (handler == route->constEnd())
+        return HttpResponse::error(405, "method not allowed");
+    return (*handler)(request);
+}
@@ -0,0 +1,62 @@
+#ifndef HTTPSERVER_H
+#define HTTPSERVER_H
+
+#include <QObject>
+#include <QHostAddress>
+#include <QThread>
+#include <QMap>
+#include <QUrlQuery>
+#include <QJsonObject>
+
+#include <functional>
+
+class QTcpServer;
+
+struct HttpRequest {
+    QString method;
+    QString path;
+    QUrlQuery query;
+    QMap<QString, QString> headers;   // 键为小写
+    QByteArray body;
+};
+
+struct HttpResponse {
+    int status = 200;
+    QByteArray contentType = "text/plain; charset=utf-8";
+    QByteArray body;
+
+    static HttpResponse json(const QJsonObject &object, int status = 200);
+    static HttpResponse error(int status, const QString &message);
+};
+
+// 最小的内嵌 HTTP/1.0 服务器，在自己的线程里收发，界面卡顿不影响抓取。
+// 路由必须在 start() 之前注册，处理函数在服务器线程中调用，需自行保证线程安全。
+class HttpServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    typedef std::function<HttpResponse(const HttpRequest &)> Handler;
+
+    explicit HttpServer(QObject *parent = nullptr);
+    ~HttpServer();
+
+    void addRoute(const QString &method, const QString &path, const Handler &handler);
+
+    bool start(const QHostAddress &address, quint16 port, QString *error);
+    void stop();
+    bool isListening() const;
+    quint16 port() const;
+
+private:
+    void onNewConnection();
+    HttpResponse dispatch(const HttpRequest &request) const;
+
+    QMap<QString, QMap<QString, Handler> > mRoutes;   // 路径 -> 方法 -> 处理函数
+    QThread mThread;
+    QObject *mContext;                                // 住在 mThread 中，连接都挂在它下面
+    QTcpServer *mServer;
+    quint16 mPort;
+};
+
+#endif // HTTPSERVER_H
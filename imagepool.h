@@ -0,0 +1,61 @@
+#ifndef IMAGEPOOL_H
+#define IMAGEPOOL_H
+
+#include <QImage>
+#include <QVector>
+
+// 解码线程的 QImage 缓冲池。发出去的帧和池里的副本共享像素数据，
+// 界面、邮箱都释放之后引用计数回到 1，下一帧直接复用这块内存，免得每帧重新分配几十 MB。
+// 尺寸或格式变了（码流切换分辨率、窗口缩放）时旧缓冲逐步被淘汰。
+// 只能在一个线程里使用。
+//
+// 用法：
+//     QImage image = pool.acquire(size, QImage::Format_RGB32);
+//     ...写入 image...
+//     pool.recycle(image);   // 写完再放回，之后才能共享给别人
+class ImagePool
+{
+public:
+    explicit ImagePool(int capacity = 4) : mCapacity(capacity), mAllocations(0) {}
+
+    // 返回独占的图像，写像素不会触发复制；内容未初始化
+    QImage acquire(const QSize &size, QImage::Format format)
+    {
+        for (int i = 0; i < mImages.size(); i++) {
+            const QImage &image = mImages.at(i);
+            if (!image.isDetached())
+                continue;   // 还有人在用
+            if (image.size() == size && image.format() == format)
+                return mImages.takeAt(i);
+        }
+        // 没有可用的：顺带丢掉已空闲但尺寸不对的旧缓冲
+        for (int i = mImages.size() - 1; i >= 0; i--) {
+            if (mImages.at(i).isDetached())
+                mImages.remove(i);
+        }
+        mAllocations++;
+        return QImage(size, format);
+    }
+
+    // 写完后放回池里；超过容量时丢掉最早的（仍在使用的话由最后一个使用者释放）
+    void recycle(const QImage &image)
+    {
+        if (image.isNull())
+            return;
+        mImages.append(image);
+        while (mImages.size() > mCapacity)
+            mImages.removeFirst();
+    }
+
+    void clear() { mImages.clear(); }
+
+    // 累计新分配的次数，稳定播放时应该不再增长
+    int allocations() const { return mAllocations; }
+
+private:
+    QVector<QImage> mImages;
+    int mCapacity;
+    int mAllocations;
+};
+
+#endif // IMAGEPOOL_H
@@ -0,0 +1,225 @@
+#include "keyframeindex.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+#include <algorithm>
+
+extern "C" {
+    #include <libavformat/avformat.h>
+}
+
+static const quint32 kIndexMagic = 0x4B464958; // "KFIX"
+static const quint32 kIndexVersion = 1;
+static const qint64 kEntryBytes = 16; // 每个条目：pts + pos
+
+// 索引文件候选路径：优先放在媒体文件旁边，目录不可写时放到缓存目录
+static QStringList indexCandidates(const QString &mediaFile)
+{
+    QStringList paths;
+    paths << KeyframeIndex::indexPathFor(mediaFile);
+
+    QString cacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    if (!cacheDir.isEmpty()) {
+        QByteArray key = QCryptographicHash::hash(
+            QFileInfo(mediaFile).absoluteFilePath().toUtf8(), QCryptographicHash::Md5).toHex();
+        paths << QDir(cacheDir).filePath("kfidx/" + QString::fromLatin1(key) + ".kfidx");
+    }
+    return paths;
+}
+
+KeyframeIndex::KeyframeIndex()
+    : mStreamIndex(-1), mTimeBase(av_make_q(1, AV_TIME_BASE)), mReady(false)
+{
+}
+
+QString KeyframeIndex::indexPathFor(const QString &mediaFile)
+{
+    return mediaFile + ".kfidx";
+}
+
+bool KeyframeIndex::loadOrBuild(const QString &mediaFile)
+{
+    const QStringList paths = indexCandidates(mediaFile);
+    for (const QString &path : paths) {
+        if (load(path, mediaFile))
+            return true;
+    }
+
+    if (!build(mediaFile))
+        return false;
+
+    for (const QString &path : paths) {
+        if (save(path, mediaFile))
+            break;
+    }
+    return true;
+}
+
+bool KeyframeIndex::isReady() const
+{
+    QMutexLocker locker(&mMutex);
+    return mReady;
+}
+
+int KeyframeIndex::streamIndex() const
+{
+    QMutexLocker locker(&mMutex);
+    return mStreamIndex;
+}
+
+AVRational KeyframeIndex::timeBase() const
+{
+    QMutexLocker locker(&mMutex);
+    return mTimeBase;
+}
+
+bool KeyframeIndex::findKeyframe(qint64 targetPts, Entry *entry) const
+{
+    QMutexLocker locker(&mMutex);
+    if (!mReady || mEntries.isEmpty())
+        return false;
+
+    // 二分查找最后一个 pts <= targetPts 的关键帧
+    auto it = std::upper_bound(mEntries.constBegin(), mEntries.constEnd(), targetPts,
+                               [](qint64 pts, const Entry &e) { return pts < e.pts; });
+    if (it == mEntries.constBegin()) {
+        *entry = mEntries.first();
+    } else {
+        *entry = *(it - 1);
+    }
+    return true;
+}
+
+bool KeyframeIndex::load(const QString &indexFile, const QString &mediaFile)
+{
+    QFile file(indexFile);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QFileInfo info(mediaFile);
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_6);
+
+    quint32 magic = 0, version = 0, count = 0;
+    qint64 fileSize = 0, mtimeMs = 0;
+    qint32 streamIndex = -1, tbNum = 0, tbDen = 0;
+    in >> magic >> version >> fileSize >> mtimeMs >> streamIndex >> tbNum >> tbDen >> count;
+
+    if (in.status() != QDataStream::Ok || magic != kIndexMagic || version != kIndexVersion)
+        return false;
+    // 源文件被修改过，索引作废
+    if (fileSize != info.size() || mtimeMs != info.lastModified().toMSecsSinceEpoch())
+        return false;
+    if (tbNum <= 0 || tbDen <= 0)
+        return false;
+    // 条目数以文件里实际剩下的字节为准，损坏或手改的索引不能让这里分配大量内存
+    if (count > quint64(file.size() - file.pos()) / kEntryBytes)
+        return false;
+
+    QVector<Entry> entries;
+    entries.reserve(int(count));
+    for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; i++) {
+        Entry e;
+        in >> e.pts >> e.pos;
+        entries.append(e);
+    }
+    if (in.status() != QDataStream::Ok)
+        return false;
+
+    QMutexLocker locker(&mMutex);
+    mEntries.swap(entries);
+    mStreamIndex = streamIndex;
+    mTimeBase = av_make_q(tbNum, tbDen);
+    mReady = true;
+    return true;
+}
+
+bool KeyframeIndex::save(const QString &indexFile, const QString &mediaFile) const
+{
+    QDir().mkpath(QFileInfo(indexFile).absolutePath());
+
+    QSaveFile file(indexFile);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+
+    QFileInfo info(mediaFile);
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_6);
+
+    QMutexLocker locker(&mMutex);
+    out << kIndexMagic << kIndexVersion
+        << qint64(info.size()) << qint64(info.lastModified().toMSecsSinceEpoch())
+        << qint32(mStreamIndex) << qint32(mTimeBase.num) << qint32(mTimeBase.den)
+        << quint32(mEntries.size());
+    for (const Entry &e : mEntries) {
+        out << e.pts << e.pos;
+    }
+    locker.unlock();
+
+    return file.commit();
+}
+
+// 只读包不解码，扫描整个文件的视频关键帧
+bool KeyframeIndex::build(const QString &mediaFile)
+{
+    AVFormatContext *fmtCtx = nullptr;
+    QByteArray path = mediaFile.toUtf8();
+    if (avformat_open_input(&fmtCtx, path.constData(), nullptr, nullptr) < 0) {
+        qWarning() << "KeyframeIndex: cannot open" << mediaFile;
+        return false;
+    }
+    if (avformat_find_stream_info(fmtCtx, nullptr) < 0) {
+        avformat_close_input(&fmtCtx);
+        return false;
+    }
+
+    int videoStream = av_find_best_stream(fmtCtx, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+    if (videoStream < 0) {
+        avformat_close_input(&fmtCtx);
+        return false;
+    }
+
+    // 只保留视频流，其它流的包直接丢弃
+    for (unsigned int i = 0; i < fmtCtx->nb_streams; i++) {
+        if (int(i) != videoStream)
+            fmtCtx->streams[i]->discard = AVDISCARD_ALL;
+    }
+
+    QVector<Entry> entries;
+    AVPacket packet;
+    av_init_packet(&packet);
+    while (av_read_frame(fmtCtx, &packet) >= 0) {
+        if (packet.stream_index == videoStream && (packet.flags & AV_PKT_FLAG_KEY)) {
+            qint64 pts = packet.pts != AV_NOPTS_VALUE ? packet.pts : packet.dts;
+            if (pts != AV_NOPTS_VALUE) {
+                Entry e;
+                e.pts = pts;
+                e.pos = packet.pos;
+                entries.append(e);
+            }
+        }
+        av_packet_unref(&packet);
+    }
+
+    AVRational tb = fmtCtx->streams[videoStream]->time_base;
+    avformat_close_input(&fmtCtx);
+
+    std::sort(entries.begin(), entries.end(),
+              [](const Entry &a, const Entry &b) { return a.pts < b.pts; });
+
+    QMutexLocker locker(&mMutex);
+    mEntries.swap(entries);
+    mStreamIndex = videoStream;
+    mTimeBase = tb;
+    mReady = true;
+    qDebug() << "KeyframeIndex: built" << mEntries.size() << "keyframes for" << mediaFile;
+    return true;
+}
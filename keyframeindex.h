@@ -0,0 +1,47 @@
+#ifndef KEYFRAMEINDEX_H
+#define KEYFRAMEINDEX_H
+
+#include <QString>
+#include <QVector>
+#include <QMutex>
+
+extern "C" {
+    #include <libavutil/rational.h>
+}
+
+// 本地文件的关键帧索引，持久化到 <文件名>.kfidx，用于快速定位
+class KeyframeIndex
+{
+public:
+    struct Entry {
+        qint64 pts;   // 视频流 time_base 下的时间戳
+        qint64 pos;   // 数据包在文件中的字节偏移
+    };
+
+    KeyframeIndex();
+
+    // 先尝试读取缓存的索引，失败或过期时重新扫描文件并保存
+    bool loadOrBuild(const QString &mediaFile);
+
+    bool isReady() const;
+    int streamIndex() const;
+    AVRational timeBase() const;
+
+    // 查找 pts <= targetPts 的最后一个关键帧
+    bool findKeyframe(qint64 targetPts, Entry *entry) const;
+
+    static QString indexPathFor(const QString &mediaFile);
+
+private:
+    bool load(const QString &indexFile, const QString &mediaFile);
+    bool save(const QString &indexFile, const QString &mediaFile) const;
+    bool build(const QString &mediaFile);
+
+    mutable QMutex mMutex;
+    QVector<Entry> mEntries;
+    int mStreamIndex;
+    AVRational mTimeBase;
+    bool mReady;
+};
+
+#endif // KEYFRAMEINDEX_H
@@ -10,17 +10,38 @@
 #include <QTextCodec>
 
 #include "mainwindow.h"
+#include "metrics.h"
+#include "pushmanager.h"
 
 int main(int argc, char *argv[])
 {
+    // VP_RENDERER=software：强制软件 OpenGL（Windows 为 opengl32sw，Linux 为 Mesa llvmpipe），
+    // 没有 GPU 的机器和无头测试用；必须在创建 QApplication 之前设置
+    if (qgetenv("VP_RENDERER") == "software") {
+        QCoreApplication::setAttribute(Qt::AA_UseSoftwareOpenGL);
+        qputenv("LIBGL_ALWAYS_SOFTWARE", "1");
+    }
+
     QApplication a(argc, argv);
 
     QTextCodec *codec = QTextCodec::codecForName("UTF-8"); //设置编码格式为UTF-8
     QTextCodec::setCodecForLocale(codec);
 
-    MainWindow w;
-    w.show();
+    // 指标导出：VP_METRICS_PORT 开启 HTTP /metrics，VP_METRICS_JSON 定期写 JSON 文件
+    MetricsExporter metrics;
+    metrics.configureFromEnvironment();
+
+    // 推流预算：VP_PUSH_CPU（核，默认按 CPU 核数）、VP_PUSH_BANDWIDTH（bit/s，默认不限），超出的推流排队
+    PushJobManager::instance()->configureFromEnvironment();
 
-    return a.exec();
+    int ret;
+    {
+        MainWindow w;
+        w.show();
+        ret = a.exec();
+    }
+    // 窗口关闭时停掉的推流在后台收尾，退出前等它们写完
+    PushJobManager::instance()->waitForStopped();
+    return ret;
 }
 
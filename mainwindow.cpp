@@ -31,15 +31,156 @@ MainWindow::MainWindow(QWidget *parent) :
     this->setWindowTitle(title);
     mPlayer = new VideoPlayer;
     this->setWindowFlags(Qt::Widget | Qt::MSWindowsFixedSizeDialogHint);
-    connect(mPlayer, &VideoPlayer::sig_GetOneFrame, this, &MainWindow::slotGetOneFrame);
+    // 优先用 OpenGL 画面：YUV 平面直接上传，着色器里转换和缩放，解码线程不再做 RGB 转换。
+    // 没有可用的 OpenGL 或 VP_RENDERER=label 时退回 QLabel 显示
+    if (qgetenv("VP_RENDERER") != "label" && VideoSurface::isAvailable()) {
+        mSurface = new VideoSurface(ui->videoLabel);
+        mSurface->setGeometry(ui->videoLabel->rect());
+        mSurface->setPerfStats(mPlayer->perfStats());
+        connect(mPlayer, &VideoPlayer::sig_YuvFrameReady, this, &MainWindow::onYuvFrameReady);
+    } else {
+        // 解码线程只覆盖邮箱里的最新帧，界面忙时不会在事件队列里堆积整帧
+        connect(mPlayer, &VideoPlayer::sig_FrameReady, this, &MainWindow::onFrameReady);
+        connect(mPlayer, &VideoPlayer::sig_RFrameReady, this, &MainWindow::onRFrameReady);
+    }
     connect(ui->pullstreamButton, &QPushButton::toggled, this, &MainWindow::onPullStreamClicked);
-    connect(mPlayer, &VideoPlayer::sig_GetRFrame, this, &MainWindow::slotGetRFrame);
     //2017.8.12---lizhen
     connect(ui->Open_red,&QAction::triggered,this,&MainWindow::slotOpenRed);
     connect(ui->Close_Red,&QAction::triggered,this,&MainWindow::slotCloseRed);
     connect(mPlayer, &VideoPlayer::sig_StreamError, this, &MainWindow::onStreamError);
     // mainwindow.cpp
     connect(mPlayer, &VideoPlayer::sig_RequireButtonReset, this, &MainWindow::onPushButtonReset);
+    connect(mPlayer, &VideoPlayer::sig_PushProgress, this, [this](const QString &, const PushProgress &progress) {
+        mPushProgressText = progress.end ? QString() : progress.toText();
+    });
+    // 本地文件回放：进度条、暂停、单步、倍速
+    connect(mPlayer, &VideoPlayer::sig_DurationChanged, this, &MainWindow::onDurationChanged);
+    connect(mPlayer, &VideoPlayer::sig_PositionChanged, this, &MainWindow::onPositionChanged);
+    connect(mPlayer, &VideoPlayer::sig_PlaybackFinished, this, [this]() {
+        ui->pauseButton->setChecked(true);
+    });
+    connect(ui->seekSlider, &QSlider::sliderReleased, this, &MainWindow::onSeekSliderReleased);
+    connect(ui->pauseButton, &QPushButton::toggled, this, &MainWindow::onPauseToggled);
+    connect(ui->stepButton, &QPushButton::clicked, this, &MainWindow::onStepClicked);
+    connect(ui->speedComboBox, QOverload<int>::of(&QComboBox::currentIndexChanged),
+            this, &MainWindow::onSpeedChanged);
+    ui->seekSlider->setEnabled(false);
+
+    // 性能统计叠加层，盖在视频区域左上角
+    mStatsLabel = new QLabel(ui->videoLabel);
+    mStatsLabel->setStyleSheet("QLabel { color: #00ff00; background-color: rgba(0, 0, 0, 160);"
+                               " font-family: monospace; font-size: 9pt; padding: 4px; }");
+    mStatsLabel->setAttribute(Qt::WA_TransparentForMouseEvents);
+    mStatsLabel->hide();
+    mLastSnapshot = mPlayer->perfStats()->snapshot();
+    connect(ui->Show_Stats, &QAction::toggled, this, &MainWindow::onShowStatsToggled);
+    connect(&mStatsTimer, &QTimer::timeout, this, &MainWindow::updateStatsOverlay);
+
+    // 移动侦测：区域、分析帧率、灵敏度可用环境变量配置，见 README
+    MotionDetector *motion = mPlayer->motionDetector();
+    QVector<MotionZone> zones;
+    if (!qEnvironmentVariableIsEmpty("VP_MOTION_ZONES")
+            && !MotionDetector::parseZones(QString::fromLocal8Bit(qgetenv("VP_MOTION_ZONES")), &zones))
+        qWarning() << "Invalid VP_MOTION_ZONES, using the whole frame";
+    motion->setZones(zones);
+    if (!qEnvironmentVariableIsEmpty("VP_MOTION_FPS"))
+        motion->setAnalysisFps(qgetenv("VP_MOTION_FPS").toDouble());
+    if (!qEnvironmentVariableIsEmpty("VP_MOTION_SENSITIVITY"))
+        motion->setSensitivity(qgetenv("VP_MOTION_SENSITIVITY").toInt());
+    mMotionLabel = new QLabel(ui->videoLabel);
+    mMotionLabel->setScaledContents(true);
+    mMotionLabel->setAttribute(Qt::WA_TransparentForMouseEvents);
+    mMotionLabel->setAttribute(Qt::WA_TranslucentBackground);
+    mMotionLabel->hide();
+    mMotionBadge = new QLabel(ui->videoLabel);
+    mMotionBadge->setStyleSheet("QLabel { color: white; background-color: rgba(200, 0, 0, 180);"
+                                " font-size: 9pt; padding: 4px; }");
+    mMotionBadge->setAttribute(Qt::WA_TransparentForMouseEvents);
+    mMotionBadge->hide();
+    connect(ui->Enable_Motion, &QAction::toggled, this, &MainWindow::onEnableMotionToggled);
+    connect(ui->Show_Motion, &QAction::toggled, this, &MainWindow::onShowMotionToggled);
+    connect(motion, &MotionDetector::sig_MotionStarted, this, &MainWindow::onMotionStarted);
+    connect(motion, &MotionDetector::sig_MotionStopped, this, &MainWindow::onMotionStopped);
+    connect(motion, &MotionDetector::sig_OverlayReady, this, &MainWindow::onMotionOverlayReady);
+
+    // 事件录像：一直保留预录缓冲（只是包的引用），由菜单决定移动侦测是否触发；
+    // 预录/后录时长和目录可用环境变量配置
+    EventRecorder *recorder = mPlayer->recorder();
+    recorder->setEnabled(true);
+    recorder->setMotionTriggerEnabled(false);
+    if (!qEnvironmentVariableIsEmpty("VP_RECORD_DIR"))
+        recorder->setOutputDir(QString::fromLocal8Bit(qgetenv("VP_RECORD_DIR")));
+    if (!qEnvironmentVariableIsEmpty("VP_RECORD_PREROLL_MS"))
+        recorder->setPreRollMs(qgetenv("VP_RECORD_PREROLL_MS").toInt());
+    if (!qEnvironmentVariableIsEmpty("VP_RECORD_POSTROLL_MS"))
+        recorder->setPostRollMs(qgetenv("VP_RECORD_POSTROLL_MS").toInt());
+    connect(ui->Record_On_Motion, &QAction::toggled, this, &MainWindow::onRecordOnMotionToggled);
+    connect(ui->Record_Now, &QAction::triggered, this, &MainWindow::onRecordNowTriggered);
+    connect(recorder, &EventRecorder::sig_RecordingFinished, this,
+            [](const QString &path, qint64 durationMs, qint64 bytes) {
+        qDebug() << "Recording saved:" << path << durationMs << "ms" << bytes << "bytes";
+    });
+    connect(recorder, &EventRecorder::sig_RecordingError, this, &MainWindow::onStreamError);
+
+    // 截图：菜单保存当前画面；设置 VP_SNAPSHOT_INTERVAL_MS 后定时覆盖写 <目录>/<流名>.jpg 作为缩略图
+    Snapshotter *snapshotter = mPlayer->snapshotter();
+    if (!qEnvironmentVariableIsEmpty("VP_SNAPSHOT_DIR"))
+        snapshotter->setOutputDir(QString::fromLocal8Bit(qgetenv("VP_SNAPSHOT_DIR")));
+    if (!qEnvironmentVariableIsEmpty("VP_SNAPSHOT_WIDTH"))
+        snapshotter->setMaxWidth(qgetenv("VP_SNAPSHOT_WIDTH").toInt());
+    if (!qEnvironmentVariableIsEmpty("VP_SNAPSHOT_INTERVAL_MS"))
+        snapshotter->setPeriodic(qgetenv("VP_SNAPSHOT_INTERVAL_MS").toInt(), true);
+    connect(ui->Take_Snapshot, &QAction::triggered, this, &MainWindow::onTakeSnapshotTriggered);
+    connect(snapshotter, &Snapshotter::sig_SnapshotReady, this,
+            [](int id, const QByteArray &image, const QString &path) {
+        if (id)
+            qDebug() << "Snapshot saved:" << path << image.size() << "bytes";
+    });
+    connect(snapshotter, &Snapshotter::sig_SnapshotFailed, this,
+            [this](int id, const QString &message) {
+        if (id)
+            onStreamError(message);
+    });
+
+    // 共享内存帧导出：设置 VP_SHM_NAME 后开启，本机分析进程用 SharedFrameReader 或 tools/shmcat 读取
+    SharedFrameWriter *frameExport = mPlayer->frameExport();
+    frameExport->setName(QString::fromLocal8Bit(qgetenv("VP_SHM_NAME")));
+    if (qgetenv("VP_SHM_FORMAT") == "rgb32")
+        frameExport->setFormat(SharedFrameRgb32);
+    if (!qEnvironmentVariableIsEmpty("VP_SHM_FPS"))
+        frameExport->setMaxFps(qgetenv("VP_SHM_FPS").toDouble());
+    if (!qEnvironmentVariableIsEmpty("VP_SHM_SLOTS"))
+        frameExport->setSlotCount(qgetenv("VP_SHM_SLOTS").toInt());
+
+    // 分析画面输出：设置 VP_PROCESSED_OUTPUT（rtsp:// 地址或文件路径）后开启，VP_PROCESSED_STAGE 选 source/red/binary/motion
+    ProcessedOutput *processed = mPlayer->processedOutput();
+    processed->setOutput(QString::fromLocal8Bit(qgetenv("VP_PROCESSED_OUTPUT")));
+    ProcessedStage stage;
+    if (parseProcessedStage(QString::fromLocal8Bit(qgetenv("VP_PROCESSED_STAGE")), &stage))
+        processed->setStage(stage);
+    if (!qEnvironmentVariableIsEmpty("VP_PROCESSED_FPS"))
+        processed->setMaxFps(qgetenv("VP_PROCESSED_FPS").toDouble());
+    if (!qEnvironmentVariableIsEmpty("VP_PROCESSED_BITRATE"))
+        processed->setBitrate(qgetenv("VP_PROCESSED_BITRATE").toLongLong());
+    if (!qEnvironmentVariableIsEmpty("VP_PROCESSED_THRESHOLD"))
+        processed->setBinaryThreshold(qgetenv("VP_PROCESSED_THRESHOLD").toInt());
+    // 输出断开后每隔几秒重试，错误只写日志，不弹框
+    connect(processed, &ProcessedOutput::sig_OutputError, this, [](const QString &message) {
+        qWarning() << "Processed output:" << message;
+    });
+
+    // 画面健康检查默认开启，各异常的判定时长可用环境变量调整，当前状态显示在统计信息里
+    StreamHealth *health = mPlayer->streamHealth();
+    if (!qEnvironmentVariableIsEmpty("VP_HEALTH_FREEZE_MS"))
+        health->setFreezeWindowMs(qgetenv("VP_HEALTH_FREEZE_MS").toInt());
+    if (!qEnvironmentVariableIsEmpty("VP_HEALTH_BLACK_MS"))
+        health->setBlackWindowMs(qgetenv("VP_HEALTH_BLACK_MS").toInt());
+    if (!qEnvironmentVariableIsEmpty("VP_HEALTH_EXPOSURE_MS"))
+        health->setExposureWindowMs(qgetenv("VP_HEALTH_EXPOSURE_MS").toInt());
+
+    // 画面缩放在解码线程里完成，显示区域变化时通知播放线程
+    ui->videoLabel->installEventFilter(this);
+    updateDisplaySize();
 
     //mPlayer->startPlay();
 
@@ -102,14 +243,6 @@ bool MainWindow::slotCloseRed()
     return open_red;
 }
 
-// videoplayer.cpp
-void VideoPlayer::playAudioData(const QByteArray &audioData)
-{
-    if (mAudioIO) {
-        mAudioIO->write(audioData);
-    }
-}
-
 //void MainWindow::paintEvent(QPaintEvent*) {
 //    QPainter painter(this);
 //    painter.fillRect(rect(), Qt::black);
@@ -123,18 +256,69 @@ void VideoPlayer::playAudioData(const QByteArray &audioData)
 //                         mCachedImage);
 //    }
 //}
+void MainWindow::onFrameReady()
+{
+    QImage img;
+    if (mPlayer->takeFrame(&img))
+        slotGetOneFrame(img);
+}
+
+void MainWindow::onYuvFrameReady()
+{
+    QSharedPointer<AVFrame> frame;
+    if (mPlayer->takeYuvFrame(&frame))
+        mSurface->setFrame(frame);
+}
+
+void MainWindow::onRFrameReady()
+{
+    QImage img;
+    if (mPlayer->takeRFrame(&img))
+        slotGetRFrame(img);
+}
+
 // 修改slot函数
 void MainWindow::slotGetOneFrame(QImage img)
 {
+    PerfScope scope(mPlayer->perfStats(), PerfPaint);
     mCachedImage = QPixmap::fromImage(img);
+    mCachedImage.setDevicePixelRatio(ui->videoLabel->devicePixelRatioF());
     updateVideoLabel();
 }
 
+// 帧已经是显示尺寸，直接贴图；只有显示区域刚变化、解码线程还没跟上的帧才在这里缩放
 void MainWindow::updateVideoLabel()
 {
+    if (mCachedImage.isNull())
+        return;
     QSize labelSize = ui->videoLabel->size();
-    ui->videoLabel->setPixmap(mCachedImage.scaled(
-        labelSize, Qt::KeepAspectRatio, Qt::SmoothTransformation));
+    QSize imageSize = mCachedImage.size() / mCachedImage.devicePixelRatio();
+    QSize fitted = imageSize.scaled(labelSize, Qt::KeepAspectRatio);
+    if (qAbs(fitted.width() - imageSize.width()) <= 1 && qAbs(fitted.height() - imageSize.height()) <= 1) {
+        ui->videoLabel->setPixmap(mCachedImage);
+    } else {
+        QPixmap scaled = mCachedImage.scaled(labelSize * mCachedImage.devicePixelRatio(),
+                                             Qt::KeepAspectRatio, Qt::FastTransformation);
+        scaled.setDevicePixelRatio(mCachedImage.devicePixelRatio());
+        ui->videoLabel->setPixmap(scaled);
+    }
+}
+
+void MainWindow::updateDisplaySize()
+{
+    mPlayer->setDisplaySize(ui->videoLabel->size() * ui->videoLabel->devicePixelRatioF());
+}
+
+bool MainWindow::eventFilter(QObject *watched, QEvent *event)
+{
+    if (watched == ui->videoLabel && event->type() == QEvent::Resize) {
+        updateDisplaySize();
+        if (mSurface)
+            mSurface->setGeometry(ui->videoLabel->rect());
+        updateVideoLabel();
+        layoutMotionOverlay();
+    }
+    return QMainWindow::eventFilter(watched, event);
 }
 
 // 新增槽函数
@@ -157,6 +341,9 @@ void MainWindow::onPullStreamClicked(bool checked)
         mPlayer->stopPlay();
         mPlayer->setStreamUrl(rtspUrl);
         mPlayer->setTransportProtocol(transport); // 设置传输协议
+        ui->seekSlider->setEnabled(mPlayer->isLocalFile());
+        ui->seekSlider->setValue(0);
+        ui->pauseButton->setChecked(false);
         mPlayer->startPlay();
     } else {
         // 停止拉流
@@ -188,6 +375,7 @@ void MainWindow::on_pushstreamButton_clicked(bool checked) {
         // 按钮弹起（停止推流）
         mPlayer->stopPushing();
         ui->pushstreamButton->setText("开始推流");  // 恢复按钮文字
+        mPushProgressText.clear();
     }
 }
 
@@ -199,3 +387,149 @@ void MainWindow::onPushButtonReset() {
     }
 }
 
+void MainWindow::onDurationChanged(qint64 ms)
+{
+    ui->seekSlider->setRange(0, int(ms));
+}
+
+void MainWindow::onPositionChanged(qint64 ms)
+{
+    // 拖动进度条时不覆盖用户的位置
+    if (!ui->seekSlider->isSliderDown())
+        ui->seekSlider->setValue(int(ms));
+}
+
+void MainWindow::onSeekSliderReleased()
+{
+    mPlayer->seekTo(ui->seekSlider->value());
+}
+
+void MainWindow::onPauseToggled(bool checked)
+{
+    mPlayer->setPaused(checked);
+    ui->pauseButton->setText(checked ? "播放" : "暂停");
+}
+
+void MainWindow::onStepClicked()
+{
+    mPlayer->stepFrame();
+    ui->pauseButton->setChecked(true);
+}
+
+void MainWindow::onSpeedChanged(int index)
+{
+    QString text = ui->speedComboBox->itemText(index);
+    text.chop(1); // 去掉 "x"
+    mPlayer->setPlaybackSpeed(text.toDouble());
+}
+
+void MainWindow::onShowStatsToggled(bool checked)
+{
+    mStatsLabel->setVisible(checked);
+    if (checked) {
+        mLastSnapshot = mPlayer->perfStats()->snapshot();
+        mStatsTimer.start(500);
+        updateStatsOverlay();
+    } else {
+        mStatsTimer.stop();
+    }
+}
+
+void MainWindow::updateStatsOverlay()
+{
+    PerfSnapshot snap = mPlayer->perfStats()->snapshot();
+    QString text = snap.toText(mLastSnapshot)
+            + "\nhealth: " + healthConditionsText(mPlayer->streamHealth()->conditions());
+    if (!mPushProgressText.isEmpty())
+        text += "\npush: " + mPushProgressText;
+    mStatsLabel->setText(text);
+    mStatsLabel->adjustSize();
+    mStatsLabel->raise();
+    mLastSnapshot = snap;
+}
+
+void MainWindow::onEnableMotionToggled(bool checked)
+{
+    mPlayer->motionDetector()->setEnabled(checked);
+    if (!checked) {
+        mActiveZones.clear();
+        mMotionBadge->hide();
+        mMotionLabel->clear();
+    }
+}
+
+void MainWindow::onShowMotionToggled(bool checked)
+{
+    mPlayer->motionDetector()->setOverlayEnabled(checked);
+    mMotionLabel->setVisible(checked);
+    if (checked && !ui->Enable_Motion->isChecked())
+        ui->Enable_Motion->setChecked(true);
+}
+
+void MainWindow::onMotionStarted(const QString &zone, double level)
+{
+    qDebug() << "Motion started in" << zone << "level" << level;
+    if (!mActiveZones.contains(zone))
+        mActiveZones.append(zone);
+    mMotionBadge->setText("移动: " + mActiveZones.join(", "));
+    mMotionBadge->adjustSize();
+    layoutMotionOverlay();
+    mMotionBadge->show();
+    mMotionBadge->raise();
+}
+
+void MainWindow::onMotionStopped(const QString &zone)
+{
+    qDebug() << "Motion stopped in" << zone;
+    mActiveZones.removeAll(zone);
+    if (mActiveZones.isEmpty()) {
+        mMotionBadge->hide();
+        return;
+    }
+    mMotionBadge->setText("移动: " + mActiveZones.join(", "));
+    mMotionBadge->adjustSize();
+    layoutMotionOverlay();
+}
+
+void MainWindow::onMotionOverlayReady()
+{
+    QImage overlay;
+    if (!mPlayer->motionDetector()->takeOverlay(&overlay) || !ui->Show_Motion->isChecked())
+        return;
+    mMotionLabel->setPixmap(QPixmap::fromImage(overlay));
+    layoutMotionOverlay();
+    mMotionLabel->raise();
+}
+
+// 掩码按画面等比铺在视频区域中间（与画面的留边一致），区域名贴在右上角
+void MainWindow::layoutMotionOverlay()
+{
+    QRect area = ui->videoLabel->rect();
+    const QPixmap *pixmap = mMotionLabel->pixmap();
+    if (pixmap && !pixmap->isNull()) {
+        QSize fitted = pixmap->size().scaled(area.size(), Qt::KeepAspectRatio);
+        QRect rect(QPoint(0, 0), fitted);
+        rect.moveCenter(area.center());
+        mMotionLabel->setGeometry(rect);
+    }
+    mMotionBadge->move(area.right() - mMotionBadge->width() - 4, 4);
+}
+
+void MainWindow::onRecordOnMotionToggled(bool checked)
+{
+    mPlayer->recorder()->setMotionTriggerEnabled(checked);
+    if (checked && !ui->Enable_Motion->isChecked())
+        ui->Enable_Motion->setChecked(true);
+}
+
+// 手动触发一次：录下预录缓冲里已有的部分和之后的 post-roll
+void MainWindow::onRecordNowTriggered()
+{
+    mPlayer->recorder()->trigger("manual");
+}
+
+void MainWindow::onTakeSnapshotTriggered()
+{
+    Snapshotter *snapshotter = mPlayer->snapshotter();
+    snapshotter->request(snapshotter->nextPath());
+}
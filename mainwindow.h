@@ -13,9 +13,12 @@
 #include <QPaintEvent>
 #include <QWidget>
 #include <QtDebug>
+#include <QLabel>
+#include <QTimer>
 
 #include <QtConcurrent/qtconcurrentrun.h>
 #include "videoplayer.h"
+#include "videosurface.h"
 
 namespace Ui {
 class MainWindow;
@@ -33,6 +36,7 @@ public:
 
 protected:
     //void paintEvent(QPaintEvent *event);
+    bool eventFilter(QObject *watched, QEvent *event) override;
 
 private:
     Ui::MainWindow *ui;
@@ -40,26 +44,61 @@ private:
     VideoPlayer *mPlayer;                  //播放线程
 
     QImage mImage;                         //记录当前的图像
-    QPixmap  mCachedImage;   // 缓存缩放后的图像
+    QPixmap  mCachedImage;   // 当前帧，解码线程已按显示尺寸缩放好
     QImage R_mImage;                       //2017.8.11---lizhen
 
     QString url; 
 
     bool open_red=false;
 
+    VideoSurface *mSurface = nullptr;      // OpenGL 画面，为空时用 videoLabel 显示
+    QLabel *mStatsLabel;                   // 性能统计叠加层
+    QTimer mStatsTimer;
+    PerfSnapshot mLastSnapshot;
+    QString mPushProgressText;   // 最近一次推流进度，显示在统计信息里
+
+    QLabel *mMotionLabel;                  // 移动块掩码，盖在画面上
+    QLabel *mMotionBadge;                  // 正在移动的区域名
+    QStringList mActiveZones;
+    void layoutMotionOverlay();
+
 private slots:
     void slotGetRFrame(QImage img);        //2017.8.11---lizhen
     bool slotOpenRed();                    //2017.8.12---lizhen
     bool slotCloseRed();                   //2017.8.12
     // 声明槽函数（用于接收视频帧）
     void slotGetOneFrame(QImage img);
+    void onFrameReady();                   // 从播放线程的邮箱取最新帧
+    void onRFrameReady();
+    void onYuvFrameReady();
 
     // 声明更新视频标签的函数
     void updateVideoLabel();
+    void updateDisplaySize();              // 把显示区域尺寸告诉播放线程
     void onPullStreamClicked(bool checked);
     void onStreamError(const QString &errorMsg); // 新增错误处理槽
     void on_pushstreamButton_clicked(bool checked);
     void onPushButtonReset();  // 按钮状态复位
+
+    // 本地文件回放控制
+    void onDurationChanged(qint64 ms);
+    void onPositionChanged(qint64 ms);
+    void onSeekSliderReleased();
+    void onPauseToggled(bool checked);
+    void onStepClicked();
+    void onSpeedChanged(int index);
+
+    void onShowStatsToggled(bool checked);
+    void updateStatsOverlay();
+
+    void onEnableMotionToggled(bool checked);
+    void onShowMotionToggled(bool checked);
+    void onMotionStarted(const QString &zone, double level);
+    void onMotionStopped(const QString &zone);
+    void onMotionOverlayReady();
+    void onRecordOnMotionToggled(bool checked);
+    void onRecordNowTriggered();
+    void onTakeSnapshotTriggered();
 };
 
 #endif // MAINWINDOW_H
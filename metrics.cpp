@@ -0,0 +1,296 @@
+#include "metrics.h"
+#include "streamhealth.h"
+
+#include <QDateTime>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QSaveFile>
+#include <QUrl>
+#include <QDebug>
+
+StreamMetrics::StreamMetrics(const QString &kind, const QString &name, const PerfStats *perf)
+    : kind(kind), name(name),
+      mOpens(0), mReconnects(0), mPackets(0), mBytes(0), mFrames(0), mDropped(0), mErrors(0),
+      mConnected(false), mLastFrameNs(0), mHealth(-1), mLumaMean(0.0), mHealthEvents(0), mId(0), mPerf(perf),
+      mSampleBytes(0), mSampleFrames(0), mSampleNs(perfNowNs()), mBitrateBps(0.0), mFps(0.0)
+{
+}
+
+void StreamMetrics::setHealth(int conditions, double lumaMean)
+{
+    mLumaMean.store(lumaMean, std::memory_order_relaxed);
+    int previous = mHealth.exchange(conditions, std::memory_order_relaxed);
+    int raised = conditions & ~qMax(0, previous);
+    for (; raised; raised &= raised - 1)
+        mHealthEvents.fetch_add(1, std::memory_order_relaxed);
+}
+
+MetricsRegistry *MetricsRegistry::instance()
+{
+    static MetricsRegistry registry;
+    return &registry;
+}
+
+QString MetricsRegistry::displayName(const QString &url)
+{
+    if (!url.contains("://"))
+        return url;   // 本地文件路径
+    return QUrl(url).adjusted(QUrl::RemoveUserInfo).toString();
+}
+
+QSharedPointer<StreamMetrics> MetricsRegistry::registerStream(const QString &kind, const QString &url,
+                                                              const PerfStats *perf)
+{
+    QSharedPointer<StreamMetrics> metrics(new StreamMetrics(kind, displayName(url), perf));
+    QMutexLocker locker(&mMutex);
+    metrics->mId = mNextId++;
+    mStreams.append(metrics);
+    return metrics;
+}
+
+void MetricsRegistry::unregisterStream(const QSharedPointer<StreamMetrics> &metrics)
+{
+    QMutexLocker locker(&mMutex);
+    mStreams.removeAll(metrics);
+}
+
+void MetricsRegistry::sampleRates()
+{
+    QMutexLocker locker(&mMutex);
+    qint64 now = perfNowNs();
+    for (const QSharedPointer<StreamMetrics> &m : mStreams) {
+        quint64 bytes = m->mBytes.load(std::memory_order_relaxed);
+        quint64 frames = m->mFrames.load(std::memory_order_relaxed);
+        double sec = (now - m->mSampleNs) / 1e9;
+        if (sec > 0) {
+            m->mBitrateBps = (bytes - m->mSampleBytes) * 8 / sec;
+            m->mFps = (frames - m->mSampleFrames) / sec;
+        }
+        m->mSampleBytes = bytes;
+        m->mSampleFrames = frames;
+        m->mSampleNs = now;
+    }
+}
+
+static QByteArray escapeLabel(const QString &value)
+{
+    QByteArray out = value.toUtf8();
+    out.replace('\\', "\\\\").replace('"', "\\\"").replace('\n', "\\n");
+    return out;
+}
+
+QByteArray MetricsRegistry::toPrometheus() const
+{
+    struct Family {
+        const char *name;
+        const char *type;
+        const char *help;
+    };
+    static const Family families[] = {
+        { "vp_stream_up", "gauge", "1 while the stream is connected" },
+        { "vp_stream_opens_total", "counter", "Successful stream opens / push process starts" },
+        { "vp_stream_reconnects_total", "counter", "Reconnect attempts" },
+        { "vp_stream_packets_total", "counter", "Demuxed packets" },
+        { "vp_stream_received_bytes_total", "counter", "Demuxed payload bytes" },
+        { "vp_stream_frames_decoded_total", "counter", "Decoded video frames" },
+        { "vp_stream_frames_dropped_total", "counter", "Decoded frames that were not displayed" },
+        { "vp_stream_errors_total", "counter", "Decode errors / abnormal push process exits" },
+        { "vp_stream_bitrate_bps", "gauge", "Received bitrate over the last sample interval" },
+        { "vp_stream_fps", "gauge", "Decoded frame rate over the last sample interval" },
+        { "vp_stream_last_frame_age_seconds", "gauge", "Time since the last decoded frame" },
+        { "vp_stream_frozen", "gauge", "1 while the picture has not changed for the freeze window" },
+        { "vp_stream_black", "gauge", "1 while the picture has been black for the black window" },
+        { "vp_stream_overexposed", "gauge", "1 while the picture has been overexposed for the exposure window" },
+        { "vp_stream_blank", "gauge", "1 while the picture has been a flat colour for the black window" },
+        { "vp_stream_health_events_total", "counter", "Picture health conditions raised" },
+        { "vp_stream_luma_mean", "gauge", "Mean luma (0-255) of the last health sample" },
+    };
+    enum { FamilyCount = sizeof(families) / sizeof(families[0]) };
+
+    QMutexLocker locker(&mMutex);
+    qint64 now = perfNowNs();
+    QByteArray out;
+    out.reserve(1024 + mStreams.size() * 2048);
+
+    for (int f = 0; f < FamilyCount; f++) {
+        out += QByteArray("# HELP ") + families[f].name + " " + families[f].help + "\n";
+        out += QByteArray("# TYPE ") + families[f].name + " " + families[f].type + "\n";
+        for (int i = 0; i < mStreams.size(); i++) {
+            const StreamMetrics *m = mStreams.at(i).data();
+            double value = 0;
+            switch (f) {
+            case 0:  value = m->mConnected.load(std::memory_order_relaxed) ? 1 : 0; break;
+            case 1:  value = m->mOpens.load(std::memory_order_relaxed); break;
+            case 2:  value = m->mReconnects.load(std::memory_order_relaxed); break;
+            case 3:  value = m->mPackets.load(std::memory_order_relaxed); break;
+            case 4:  value = m->mBytes.load(std::memory_order_relaxed); break;
+            case 5:  value = m->mFrames.load(std::memory_order_relaxed); break;
+            case 6:  value = m->mDropped.load(std::memory_order_relaxed); break;
+            case 7:  value = m->mErrors.load(std::memory_order_relaxed); break;
+            case 8:  value = m->mBitrateBps; break;
+            case 9:  value = m->mFps; break;
+            case 10: {
+                qint64 last = m->mLastFrameNs.load(std::memory_order_relaxed);
+                if (last == 0)
+                    continue;   // 还没有出过画面
+                value = (now - last) / 1e9;
+                break;
+            }
+            default: {
+                // 画面健康类指标：没做过检查的流（推流、音频）不输出
+                int health = m->mHealth.load(std::memory_order_relaxed);
+                if (health < 0)
+                    continue;
+                if (f == 15)
+                    value = m->mHealthEvents.load(std::memory_order_relaxed);
+                else if (f == 16)
+                    value = m->mLumaMean.load(std::memory_order_relaxed);
+                else
+                    value = (health & (1 << (f - 11))) ? 1 : 0;
+                break;
+            }
+            }
+            out += families[f].name;
+            out += "{id=\"" + QByteArray::number(m->mId) + "\",kind=\"" + escapeLabel(m->kind)
+                    + "\",stream=\"" + escapeLabel(m->name) + "\"} " + QByteArray::number(value, 'g', 12) + "\n";
+        }
+    }
+
+    // 单帧处理延迟（解码到出图），summary 形式
+    out += "# HELP vp_stream_frame_latency_seconds Per-frame decode-to-delivery latency\n";
+    out += "# TYPE vp_stream_frame_latency_seconds summary\n";
+    for (int i = 0; i < mStreams.size(); i++) {
+        const StreamMetrics *m = mStreams.at(i).data();
+        if (!m->mPerf)
+            continue;
+        PerfStageSnapshot s = m->mPerf->snapshot().stages[PerfFrame];
+        QByteArray labels = "id=\"" + QByteArray::number(m->mId) + "\",kind=\"" + escapeLabel(m->kind)
+                + "\",stream=\"" + escapeLabel(m->name) + "\"";
+        const double quantiles[] = { 0.5, 0.9, 0.99 };
+        const double values[] = { s.p50Ms, s.p90Ms, s.p99Ms };
+        for (int q = 0; q < 3; q++) {
+            out += "vp_stream_frame_latency_seconds{" + labels + ",quantile=\"" + QByteArray::number(quantiles[q])
+                    + "\"} " + QByteArray::number(values[q] / 1000.0, 'g', 6) + "\n";
+        }
+        out += "vp_stream_frame_latency_seconds_sum{" + labels + "} "
+                + QByteArray::number(s.meanMs * s.count / 1000.0, 'g', 12) + "\n";
+        out += "vp_stream_frame_latency_seconds_count{" + labels + "} " + QByteArray::number(s.count) + "\n";
+    }
+    return out;
+}
+
+QJsonObject MetricsRegistry::toJson() const
+{
+    QMutexLocker locker(&mMutex);
+    qint64 now = perfNowNs();
+    QJsonArray streams;
+    for (int i = 0; i < mStreams.size(); i++) {
+        const StreamMetrics *m = mStreams.at(i).data();
+        QJsonObject o;
+        o["id"] = m->mId;
+        o["kind"] = m->kind;
+        o["stream"] = m->name;
+        o["up"] = m->mConnected.load(std::memory_order_relaxed);
+        o["opens"] = double(m->mOpens.load(std::memory_order_relaxed));
+        o["reconnects"] = double(m->mReconnects.load(std::memory_order_relaxed));
+        o["packets"] = double(m->mPackets.load(std::memory_order_relaxed));
+        o["bytes"] = double(m->mBytes.load(std::memory_order_relaxed));
+        o["frames_decoded"] = double(m->mFrames.load(std::memory_order_relaxed));
+        o["frames_dropped"] = double(m->mDropped.load(std::memory_order_relaxed));
+        o["errors"] = double(m->mErrors.load(std::memory_order_relaxed));
+        o["bitrate_bps"] = m->mBitrateBps;
+        o["fps"] = m->mFps;
+        qint64 last = m->mLastFrameNs.load(std::memory_order_relaxed);
+        if (last)
+            o["last_frame_age_s"] = (now - last) / 1e9;
+        int health = m->mHealth.load(std::memory_order_relaxed);
+        if (health >= 0) {
+            o["health"] = healthConditionsText(health);
+            o["health_events"] = double(m->mHealthEvents.load(std::memory_order_relaxed));
+            o["luma_mean"] = m->mLumaMean.load(std::memory_order_relaxed);
+        }
+        if (m->mPerf) {
+            PerfStageSnapshot s = m->mPerf->snapshot().stages[PerfFrame];
+            QJsonObject lat;
+            lat["p50"] = s.p50Ms;
+            lat["p90"] = s.p90Ms;
+            lat["p99"] = s.p99Ms;
+            lat["max"] = s.maxMs;
+            o["frame_latency_ms"] = lat;
+        }
+        streams.append(o);
+    }
+
+    QJsonObject root;
+    root["timestamp_ms"] = double(QDateTime::currentMSecsSinceEpoch());
+    root["streams"] = streams;
+    return root;
+}
+
+MetricsExporter::MetricsExporter(QObject *parent)
+    : QObject(parent), mJsonIntervalSec(0), mTicks(0)
+{
+    mHttp.addRoute("GET", "/metrics", [](const HttpRequest &) {
+        HttpResponse response;
+        response.contentType = "text/plain; version=0.0.4; charset=utf-8";
+        response.body = MetricsRegistry::instance()->toPrometheus();
+        return response;
+    });
+    mHttp.addRoute("GET", "/metrics.json", [](const HttpRequest &) {
+        return HttpResponse::json(MetricsRegistry::instance()->toJson());
+    });
+
+    connect(&mTimer, &QTimer::timeout, this, &MetricsExporter::onTick);
+    mTimer.start(1000);
+}
+
+bool MetricsExporter::startHttp(const QHostAddress &address, quint16 port, QString *error)
+{
+    return mHttp.start(address, port, error);
+}
+
+quint16 MetricsExporter::httpPort() const
+{
+    return mHttp.port();
+}
+
+void MetricsExporter::setJsonDump(const QString &path, int intervalSec)
+{
+    mJsonPath = path;
+    mJsonIntervalSec = qMax(1, intervalSec);
+}
+
+void MetricsExporter::configureFromEnvironment()
+{
+    bool ok = false;
+    int port = qEnvironmentVariableIntValue("VP_METRICS_PORT", &ok);
+    if (ok && port > 0) {
+        // 默认只对本机开放，需要集中抓取时设置 VP_METRICS_BIND=0.0.0.0
+        QHostAddress address(QString::fromLocal8Bit(qgetenv("VP_METRICS_BIND")));
+        if (address.isNull())
+            address = QHostAddress::LocalHost;
+        QString error;
+        if (startHttp(address, quint16(port), &error))
+            qDebug() << "Metrics endpoint on" << address.toString() << port;
+        else
+            qWarning() << "Metrics endpoint failed:" << error;
+    }
+
+    QString jsonPath = QString::fromLocal8Bit(qgetenv("VP_METRICS_JSON"));
+    if (!jsonPath.isEmpty())
+        setJsonDump(jsonPath, 5);
+}
+
+void MetricsExporter::onTick()
+{
+    MetricsRegistry::instance()->sampleRates();
+
+    if (mJsonPath.isEmpty() || ++mTicks % mJsonIntervalSec != 0)
+        return;
+    // 先写临时文件再替换，采集脚本不会读到半个文件
+    QSaveFile file(mJsonPath);
+    if (file.open(QIODevice::WriteOnly)) {
+        file.write(QJsonDocument(MetricsRegistry::instance()->toJson()).toJson());
+        file.commit();
+    }
+}
@@ -0,0 +1,120 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <QObject>
+#include <QMutex>
+#include <QList>
+#include <QSharedPointer>
+#include <QJsonObject>
+#include <QHostAddress>
+#include <QTimer>
+
+#include <atomic>
+
+#include "perfstats.h"
+#include "httpserver.h"
+
+// 单条流（拉流或推流）的计数器。热路径上只有 relaxed 原子加，不加锁；
+// 码率/帧率由 MetricsRegistry::sampleRates() 每秒根据计数差值算出。
+class StreamMetrics
+{
+public:
+    StreamMetrics(const QString &kind, const QString &name, const PerfStats *perf);
+
+    const QString kind;   // "pull" 或 "push"
+    const QString name;   // 去掉用户名和密码的地址
+
+    void onOpened()              { mOpens.fetch_add(1, std::memory_order_relaxed); setConnected(true); }
+    void onReconnect()           { mReconnects.fetch_add(1, std::memory_order_relaxed); }
+    void onPacket(int bytes)     { mPackets.fetch_add(1, std::memory_order_relaxed);
+                                   mBytes.fetch_add(quint64(bytes), std::memory_order_relaxed); }
+    void onFrameDecoded()        { mFrames.fetch_add(1, std::memory_order_relaxed);
+                                   mLastFrameNs.store(perfNowNs(), std::memory_order_relaxed); }
+    void onFrameDropped()        { mDropped.fetch_add(1, std::memory_order_relaxed); }
+    void onError()               { mErrors.fetch_add(1, std::memory_order_relaxed); }   // 解码错误 / 推流进程异常退出
+    void onProgress(quint64 bytes, quint64 frames, quint64 dropped)   // 推流进度的增量
+                                 { mBytes.fetch_add(bytes, std::memory_order_relaxed);
+                                   mFrames.fetch_add(frames, std::memory_order_relaxed);
+                                   mDropped.fetch_add(dropped, std::memory_order_relaxed);
+                                   if (frames) mLastFrameNs.store(perfNowNs(), std::memory_order_relaxed); }
+    void setConnected(bool on)   { mConnected.store(on, std::memory_order_relaxed); }
+    void setHealth(int conditions, double lumaMean);   // 画面健康检查的结果（HealthCondition 位），每次取样后更新
+
+private:
+    friend class MetricsRegistry;
+
+    std::atomic<quint64> mOpens;
+    std::atomic<quint64> mReconnects;
+    std::atomic<quint64> mPackets;
+    std::atomic<quint64> mBytes;
+    std::atomic<quint64> mFrames;
+    std::atomic<quint64> mDropped;
+    std::atomic<quint64> mErrors;
+    std::atomic<bool> mConnected;
+    std::atomic<qint64> mLastFrameNs;
+    std::atomic<int> mHealth;            // -1 表示还没有检查过
+    std::atomic<double> mLumaMean;
+    std::atomic<quint64> mHealthEvents;  // 出现异常的次数
+
+    int mId;                  // 注册序号，流重名时区分
+    const PerfStats *mPerf;   // 可为空；注销前一直有效
+
+    // 以下只在 sampleRates() 中、持有注册表锁时访问
+    quint64 mSampleBytes;
+    quint64 mSampleFrames;
+    qint64 mSampleNs;
+    double mBitrateBps;
+    double mFps;
+};
+
+// 进程内所有流的指标，导出为 Prometheus 文本格式或 JSON
+class MetricsRegistry
+{
+public:
+    static MetricsRegistry *instance();
+
+    QSharedPointer<StreamMetrics> registerStream(const QString &kind, const QString &url,
+                                                 const PerfStats *perf = nullptr);
+    void unregisterStream(const QSharedPointer<StreamMetrics> &metrics);
+
+    void sampleRates();
+    QByteArray toPrometheus() const;
+    QJsonObject toJson() const;
+
+    static QString displayName(const QString &url);   // 隐去地址中的账号密码
+
+private:
+    MetricsRegistry() : mNextId(0) {}
+
+    mutable QMutex mMutex;
+    QList<QSharedPointer<StreamMetrics> > mStreams;
+    int mNextId;
+};
+
+// 对外导出：HTTP /metrics（Prometheus）、/metrics.json，以及定期写本地 JSON 文件
+class MetricsExporter : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit MetricsExporter(QObject *parent = nullptr);
+
+    bool startHttp(const QHostAddress &address, quint16 port, QString *error);
+    quint16 httpPort() const;
+    void setJsonDump(const QString &path, int intervalSec);
+
+    // 读取 VP_METRICS_PORT / VP_METRICS_JSON 环境变量，未设置时什么也不做
+    void configureFromEnvironment();
+
+private slots:
+    void onTick();
+
+private:
+    HttpServer mHttp;
+    QTimer mTimer;
+    QString mJsonPath;
+    int mJsonIntervalSec;
+    int mTicks;
+};
+
+#endif // METRICS_H
@@ -0,0 +1,424 @@
+#include "mosaiccompositor.h"
+#include "videoplayer.h"
+#include "perfstats.h"
+
+#include <QFuture>
+#include <QtConcurrent/QtConcurrentRun>
+#include <QDebug>
+
+#include <cmath>
+#include <cstring>
+
+extern "C" {
+    #include <libavutil/imgutils.h>
+}
+
+// 交给编码的整帧：编码队列里的、编码器持有的和正在拷贝的
+static const int kOutputFrames = 4;
+
+// 画布为 YUV420P 限制范围
+static const quint8 kBlackY = 16;
+static const quint8 kBlackC = 128;
+
+static void fillRect(AVFrame *frame, const QRect &rect, quint8 y, quint8 c)
+{
+    for (int row = rect.top(); row <= rect.bottom(); row++)
+        memset(frame->data[0] + qint64(row) * frame->linesize[0] + rect.x(), y, size_t(rect.width()));
+    const int cx = rect.x() / 2;
+    const int cw = (rect.width() + 1) / 2;
+    for (int row = rect.y() / 2; row < (rect.y() + rect.height() + 1) / 2; row++) {
+        memset(frame->data[1] + qint64(row) * frame->linesize[1] + cx, c, size_t(cw));
+        memset(frame->data[2] + qint64(row) * frame->linesize[2] + cx, c, size_t(cw));
+    }
+}
+
+// 过时的画面压暗一半、饱和度减半，一眼能看出这一路不是实时的
+static void dimRect(AVFrame *frame, const QRect &rect)
+{
+    for (int row = rect.top(); row <= rect.bottom(); row++) {
+        quint8 *p = frame->data[0] + qint64(row) * frame->linesize[0] + rect.x();
+        for (int i = 0; i < rect.width(); i++)
+            p[i] = quint8((p[i] + kBlackY) >> 1);
+    }
+    const int cx = rect.x() / 2;
+    const int cw = (rect.width() + 1) / 2;
+    for (int row = rect.y() / 2; row < (rect.y() + rect.height() + 1) / 2; row++) {
+        for (int plane = 1; plane <= 2; plane++) {
+            quint8 *p = frame->data[plane] + qint64(row) * frame->linesize[plane] + cx;
+            for (int i = 0; i < cw; i++)
+                p[i] = quint8((p[i] + kBlackC) >> 1);
+        }
+    }
+}
+
+// YUVJ 格式换成对应的普通格式，色彩范围单独告诉 swscale（YUVJ 直接交给 sws_getCachedContext 会每帧重建）
+static AVPixelFormat plainFormat(const AVFrame *frame, int *fullRange)
+{
+    *fullRange = frame->color_range == AVCOL_RANGE_JPEG ? 1 : 0;
+    switch (frame->format) {
+    case AV_PIX_FMT_YUVJ420P: *fullRange = 1; return AV_PIX_FMT_YUV420P;
+    case AV_PIX_FMT_YUVJ422P: *fullRange = 1; return AV_PIX_FMT_YUV422P;
+    case AV_PIX_FMT_YUVJ444P: *fullRange = 1; return AV_PIX_FMT_YUV444P;
+    case AV_PIX_FMT_YUVJ440P: *fullRange = 1; return AV_PIX_FMT_YUV440P;
+    default: return AVPixelFormat(frame->format);
+    }
+}
+
+QVector<QRect> MosaicCompositor::tileRects(const QSize &canvas, int count, int columns, int rows)
+{
+    QVector<QRect> rects;
+    if (count <= 0 || canvas.width() < 32 || canvas.height() < 2)
+        return rects;
+    if (columns <= 0 && rows <= 0) {
+        columns = int(std::ceil(std::sqrt(double(count))));
+        rows = (count + columns - 1) / columns;
+    } else if (columns <= 0) {
+        columns = (count + rows - 1) / rows;
+    } else if (rows <= 0) {
+        rows = (count + columns - 1) / columns;
+    }
+    const int w = canvas.width();
+    const int h = canvas.height();
+    const int n = qMin(count, columns * rows);
+    for (int i = 0; i < n; i++) {
+        const int c = i % columns;
+        const int r = i / columns;
+        const int x0 = (w * c / columns) & ~31;
+        const int x1 = c == columns - 1 ? w : (w * (c + 1) / columns) & ~31;
+        const int y0 = (h * r / rows) & ~1;
+        const int y1 = r == rows - 1 ? h : (h * (r + 1) / rows) & ~1;
+        rects.append(QRect(x0, y0, x1 - x0, y1 - y0));
+    }
+    return rects;
+}
+
+QRect MosaicCompositor::fitRect(const QRect &tile, int srcWidth, int srcHeight, AVRational sampleAspect)
+{
+    if (srcWidth <= 0 || srcHeight <= 0 || tile.width() < 32 || tile.height() < 2)
+        return QRect();
+    double aspect = double(srcWidth) / srcHeight;
+    if (sampleAspect.num > 0 && sampleAspect.den > 0)
+        aspect *= av_q2d(sampleAspect);
+    int w = tile.width();
+    int h = qRound(w / aspect);
+    if (h > tile.height()) {
+        h = tile.height();
+        w = qRound(h * aspect);
+    }
+    // 宽度取 32 的倍数：swscale 的 SIMD 按块写行尾，不会越过本格子写到相邻格子里
+    w = qBound(32, w & ~31, tile.width() & ~31);
+    h = qBound(2, h & ~1, tile.height() & ~1);
+    const int x = tile.x() + (((tile.width() - w) / 2) & ~31);
+    const int y = tile.y() + (((tile.height() - h) / 2) & ~1);
+    return QRect(x, y, w, h);
+}
+
+MosaicCompositor::MosaicCompositor(QObject *parent)
+    : QObject(parent), mQuit(false), mThread(nullptr),
+      mFrames(kOutputFrames), mCanvas(nullptr), mLayoutInputs(0)
+{
+    mConfig.canvas = QSize(1920, 1080);
+    mConfig.intervalNs = qint64(1e9 / 25);
+    mConfig.columns = 0;
+    mConfig.rows = 0;
+    mConfig.staleNs = qint64(3000) * 1000000;
+    mLayout = mConfig;
+    mOutput.setStage(ProcessedSource);
+}
+
+MosaicCompositor::~MosaicCompositor()
+{
+    stop();
+    setInputs(QList<VideoPlayer *>());
+}
+
+void MosaicCompositor::setInputs(const QList<VideoPlayer *> &inputs)
+{
+    QList<VideoPlayer *> old;
+    // 先登记新的再注销旧的，两边都有的输入不会丢掉最新帧
+    for (VideoPlayer *player : inputs) {
+        if (player)
+            player->addFrameTap();
+    }
+    {
+        QMutexLocker locker(&mMutex);
+        old = mInputs;
+        mInputs = inputs;
+    }
+    for (VideoPlayer *player : old) {
+        if (player)
+            player->removeFrameTap();
+    }
+}
+
+QList<VideoPlayer *> MosaicCompositor::inputs() const
+{
+    QMutexLocker locker(&mMutex);
+    return mInputs;
+}
+
+void MosaicCompositor::setCanvasSize(const QSize &size)
+{
+    QMutexLocker locker(&mMutex);
+    mConfig.canvas = QSize(qMax(64, size.width() & ~1), qMax(64, size.height() & ~1));
+}
+
+QSize MosaicCompositor::canvasSize() const
+{
+    QMutexLocker locker(&mMutex);
+    return mConfig.canvas;
+}
+
+void MosaicCompositor::setFps(double fps)
+{
+    QMutexLocker locker(&mMutex);
+    mConfig.intervalNs = qint64(1e9 / qBound(1.0, fps, 120.0));
+}
+
+void MosaicCompositor::setGrid(int columns, int rows)
+{
+    QMutexLocker locker(&mMutex);
+    mConfig.columns = qMax(0, columns);
+    mConfig.rows = qMax(0, rows);
+}
+
+void MosaicCompositor::setStaleMs(int ms)
+{
+    QMutexLocker locker(&mMutex);
+    mConfig.staleNs = qint64(qMax(0, ms)) * 1000000;
+}
+
+ProcessedOutput *MosaicCompositor::output()
+{
+    return &mOutput;
+}
+
+void MosaicCompositor::start()
+{
+    if (mThread)
+        return;
+    {
+        QMutexLocker locker(&mMutex);
+        mQuit = false;
+        mStats = MosaicStats();
+    }
+    mThread = QThread::create([this]() { composeLoop(); });
+    mThread->setObjectName("MosaicCompositor");
+    mThread->start();
+}
+
+void MosaicCompositor::stop()
+{
+    if (!mThread)
+        return;
+    {
+        QMutexLocker locker(&mMutex);
+        mQuit = true;
+        mWake.wakeAll();
+    }
+    mThread->wait();
+    delete mThread;
+    mThread = nullptr;
+}
+
+bool MosaicCompositor::isRunning() const
+{
+    return mThread != nullptr;
+}
+
+MosaicStats MosaicCompositor::stats() const
+{
+    QMutexLocker locker(&mMutex);
+    return mStats;
+}
+
+void MosaicCompositor::composeLoop()
+{
+    // 按绝对时刻走：每帧的合成耗时不累积成漂移；落后超过一帧时跳过错过的时刻，不补帧
+    qint64 next = perfNowNs();
+    QMutexLocker locker(&mMutex);
+    while (!mQuit) {
+        const Config cfg = mConfig;
+        locker.unlock();
+        mOutput.setMaxFps(1e9 / cfg.intervalNs);
+        compose(cfg);
+        locker.relock();
+
+        next += cfg.intervalNs;
+        qint64 now = perfNowNs();
+        if (now - next >= cfg.intervalNs) {
+            const qint64 missed = (now - next) / cfg.intervalNs;
+            mStats.lateTicks += quint64(missed);
+            next += missed * cfg.intervalNs;
+        }
+        while (!mQuit && (now = perfNowNs()) < next)
+            mWake.wait(&mMutex, ulong((next - now + 999999) / 1000000));
+    }
+    locker.unlock();
+
+    mPool.waitForDone();
+    mOutput.close();
+    freeTiles();
+    av_frame_free(&mCanvas);
+    mFrames.clear();
+    mLayoutInputs = 0;
+}
+
+bool MosaicCompositor::compose(const Config &cfg)
+{
+    // 取各路最新帧的引用；持锁期间 setInputs 不会换掉输入
+    QVector<QSharedPointer<AVFrame> > frames;
+    QVector<qint64> times;
+    {
+        QMutexLocker locker(&mMutex);
+        frames.resize(mInputs.size());
+        times.resize(mInputs.size());
+        for (int i = 0; i < mInputs.size(); i++) {
+            if (mInputs.at(i))
+                frames[i] = mInputs.at(i)->latestFrame(&times[i]);
+        }
+    }
+
+    if (!mCanvas || frames.size() != mLayoutInputs || cfg.canvas != mLayout.canvas
+            || cfg.columns != mLayout.columns || cfg.rows != mLayout.rows)
+        resetCanvas(cfg, frames.size());
+    if (!mCanvas)
+        return false;
+
+    // 只有换了帧的格子需要缩放；没有新帧的保持画布上的最后一帧，过时了压暗一次
+    const qint64 now = perfNowNs();
+    QVector<Tile *> work;
+    int live = 0;
+    for (int i = 0; i < mTiles.size(); i++) {
+        Tile &tile = mTiles[i];
+        const QSharedPointer<AVFrame> &frame = frames.at(i);
+        if (frame && times.at(i) != tile.frameNs && frame->width > 0 && frame->height > 0) {
+            tile.pending = frame;
+            tile.frameNs = times.at(i);
+            tile.dimmed = false;
+            work.append(&tile);
+        } else if (tile.frameNs && !tile.dimmed && now - tile.frameNs > cfg.staleNs && !tile.content.isEmpty()) {
+            dimRect(mCanvas, tile.content);
+            tile.dimmed = true;
+        }
+        if (tile.frameNs && now - tile.frameNs <= cfg.staleNs)
+            live++;
+    }
+
+    // 各格子写画布上互不重叠的区域，每个格子自己的 SwsContext，可以并行；调用线程做第一个
+    if (!work.isEmpty()) {
+        if (mPool.maxThreadCount() < work.size() - 1)
+            mPool.setMaxThreadCount(work.size() - 1);
+        QVector<QFuture<void> > futures;
+        futures.reserve(work.size() - 1);
+        for (int i = 1; i < work.size(); i++) {
+            Tile *tile = work.at(i);
+            futures.append(QtConcurrent::run(&mPool, [this, tile]() { scaleTile(tile); }));
+        }
+        scaleTile(work.first());
+        for (QFuture<void> &future : futures)
+            future.waitForFinished();
+        for (Tile *tile : work)
+            tile->pending.clear();   // 不占着解码器的缓冲
+    }
+
+    // 画布整帧拷进帧池交给编码，下一帧接着在画布上改
+    bool ok = false;
+    AVFrame *out = mFrames.acquire(mCanvas->width, mCanvas->height, AV_PIX_FMT_YUV420P);
+    if (out) {
+        av_image_copy(out->data, out->linesize, const_cast<const uint8_t **>(mCanvas->data), mCanvas->linesize,
+                      AV_PIX_FMT_YUV420P, mCanvas->width, mCanvas->height);
+        out->color_range = AVCOL_RANGE_MPEG;
+        out->sample_aspect_ratio = av_make_q(1, 1);
+        mOutput.offer(out);
+        ok = true;
+    }
+
+    QMutexLocker locker(&mMutex);
+    if (ok)
+        mStats.frames++;
+    mStats.tilesScaled += quint64(work.size());
+    mStats.inputs = frames.size();
+    mStats.liveInputs = live;
+    return ok;
+}
+
+void MosaicCompositor::resetCanvas(const Config &cfg, int inputs)
+{
+    freeTiles();
+    av_frame_free(&mCanvas);
+    mFrames.clear();
+    mLayout = cfg;
+    mLayoutInputs = inputs;
+
+    AVFrame *canvas = av_frame_alloc();
+    if (!canvas)
+        return;
+    canvas->width = cfg.canvas.width();
+    canvas->height = cfg.canvas.height();
+    canvas->format = AV_PIX_FMT_YUV420P;
+    canvas->color_range = AVCOL_RANGE_MPEG;
+    if (av_frame_get_buffer(canvas, 32) < 0) {
+        qWarning() << "MosaicCompositor: cannot allocate a" << cfg.canvas << "canvas";
+        av_frame_free(&canvas);
+        return;
+    }
+    mCanvas = canvas;
+    fillRect(mCanvas, QRect(QPoint(0, 0), cfg.canvas), kBlackY, kBlackC);
+
+    const QVector<QRect> rects = tileRects(cfg.canvas, inputs, cfg.columns, cfg.rows);
+    if (rects.size() < inputs)
+        qWarning() << "MosaicCompositor:" << inputs << "inputs but only" << rects.size() << "tiles";
+    mTiles.resize(rects.size());
+    for (int i = 0; i < rects.size(); i++)
+        mTiles[i].rect = rects.at(i);
+}
+
+// 线程池里调用，只写本格子的区域
+void MosaicCompositor::scaleTile(Tile *tile)
+{
+    const AVFrame *src = tile->pending.data();
+    const QRect fit = fitRect(tile->rect, src->width, src->height, src->sample_aspect_ratio);
+    if (fit.isEmpty())
+        return;
+    if (fit != tile->content) {
+        // 画面比例变了：格子先清成黑色，免得留下上一个画面的边
+        fillRect(mCanvas, tile->rect, kBlackY, kBlackC);
+        tile->content = fit;
+        tile->srcRange = -1;
+    }
+
+    int fullRange = 0;
+    const AVPixelFormat format = plainFormat(src, &fullRange);
+    if (src->width != tile->srcWidth || src->height != tile->srcHeight || format != tile->srcFormat) {
+        tile->srcWidth = src->width;
+        tile->srcHeight = src->height;
+        tile->srcFormat = format;
+        tile->srcRange = -1;
+    }
+    tile->sws = sws_getCachedContext(tile->sws, src->width, src->height, format,
+                                     fit.width(), fit.height(), AV_PIX_FMT_YUV420P,
+                                     SWS_BILINEAR, nullptr, nullptr, nullptr);
+    if (!tile->sws)
+        return;
+    if (tile->srcRange != fullRange) {
+        const int *coefficients = sws_getCoefficients(SWS_CS_DEFAULT);
+        sws_setColorspaceDetails(tile->sws, coefficients, fullRange, coefficients, 0, 0, 1 << 16, 1 << 16);
+        tile->srcRange = fullRange;
+    }
+
+    uint8_t *dst[4] = {
+        mCanvas->data[0] + qint64(fit.y()) * mCanvas->linesize[0] + fit.x(),
+        mCanvas->data[1] + qint64(fit.y() / 2) * mCanvas->linesize[1] + fit.x() / 2,
+        mCanvas->data[2] + qint64(fit.y() / 2) * mCanvas->linesize[2] + fit.x() / 2,
+        nullptr
+    };
+    sws_scale(tile->sws, src->data, src->linesize, 0, src->height, dst, mCanvas->linesize);
+}
+
+void MosaicCompositor::freeTiles()
+{
+    for (Tile &tile : mTiles)
+        sws_freeContext(tile.sws);
+    mTiles.clear();
+}
@@ -0,0 +1,118 @@
+#ifndef MOSAICCOMPOSITOR_H
+#define MOSAICCOMPOSITOR_H
+
+#include <QObject>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QList>
+#include <QVector>
+#include <QRect>
+#include <QSharedPointer>
+#include <QThread>
+#include <QThreadPool>
+
+#include "framepool.h"
+#include "processedoutput.h"
+
+extern "C" {
+    #include <libavutil/frame.h>
+    #include <libswscale/swscale.h>
+}
+
+class VideoPlayer;
+
+struct MosaicStats {
+    quint64 frames = 0;         // 已交给编码的画面
+    quint64 lateTicks = 0;      // 合成没赶上输出时刻而跳过的帧
+    quint64 tilesScaled = 0;    // 缩放过的格子次数，没有新帧的格子不重复缩放
+    int inputs = 0;
+    int liveInputs = 0;         // stale_ms 内有新帧的输入
+};
+
+// 多路拼接输出：把几个 VideoPlayer 的解码帧缩放进同一画布的各个格子，按固定帧率编码成一路流。
+// 合成线程按输出帧率走：每个时刻取各路最新的解码帧（只是引用），只有换了帧的格子才重新缩放；
+// 各格子的缩放在自己的线程池里并行，用 libswscale（按 CPU 选 SIMD 实现），格子左边按 32 像素对齐，
+// 写入走对齐的路径。画布整帧交给 ProcessedOutput 编码推流或写文件。
+// 某路断开或跟不上时格子保持最后一帧，超过 stale_ms 没有新帧时变暗；一直没有画面的格子为黑色。
+//
+// 线程：接口都在主线程调用，设置下一帧生效；setInputs 返回后合成线程不再访问换下来的输入，
+// 输入在换下或本对象析构之前不能删除。
+class MosaicCompositor : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit MosaicCompositor(QObject *parent = nullptr);
+    ~MosaicCompositor();
+
+    // 按顺序从左到右、从上到下排格子，nullptr 占一个空格（如还没启动的任务），运行中可以更换
+    void setInputs(const QList<VideoPlayer *> &inputs);
+    QList<VideoPlayer *> inputs() const;
+    void setCanvasSize(const QSize &size);   // 默认 1920x1080，取偶数
+    QSize canvasSize() const;
+    void setFps(double fps);                 // 输出帧率，默认 25
+    void setGrid(int columns, int rows);     // 0 表示按格子数自动（接近正方形）
+    void setStaleMs(int ms);                 // 默认 3000
+
+    // 输出地址和码率在这里设置；编码帧率跟随 setFps
+    ProcessedOutput *output();
+
+    void start();
+    void stop();                             // 等合成线程退出，输出在这里收尾
+    bool isRunning() const;
+    MosaicStats stats() const;
+
+    // columns x rows 等分画布，格子左边按 32 像素、上边按 2 像素对齐；columns/rows 为 0 时自动
+    static QVector<QRect> tileRects(const QSize &canvas, int count, int columns, int rows);
+    // 源画面按显示宽高比缩放后在格子里居中的区域，左边按 32 像素对齐，宽高取偶数
+    static QRect fitRect(const QRect &tile, int srcWidth, int srcHeight, AVRational sampleAspect);
+
+private:
+    Q_DISABLE_COPY(MosaicCompositor)
+
+    struct Config {
+        QSize canvas;
+        qint64 intervalNs;
+        int columns;
+        int rows;
+        qint64 staleNs;
+    };
+    // 以下只在合成线程访问
+    struct Tile {
+        QRect rect;                      // 格子在画布上的位置
+        QRect content;                   // 当前画面占的区域
+        SwsContext *sws = nullptr;
+        int srcWidth = 0;                // sws 当前对应的源画面，变了时重新设置色彩范围
+        int srcHeight = 0;
+        int srcFormat = AV_PIX_FMT_NONE;
+        int srcRange = -1;
+        qint64 frameNs = 0;              // 画布上这一帧的收到时刻，0 表示还没有画面
+        bool dimmed = false;
+        QSharedPointer<AVFrame> pending; // 本次要缩放的帧
+    };
+
+    void composeLoop();
+    bool compose(const Config &cfg);
+    void resetCanvas(const Config &cfg, int inputs);
+    void scaleTile(Tile *tile);
+    void freeTiles();
+
+    mutable QMutex mMutex;
+    QWaitCondition mWake;
+    Config mConfig;
+    QList<VideoPlayer *> mInputs;
+    bool mQuit;
+    QThread *mThread;
+    MosaicStats mStats;
+    ProcessedOutput mOutput;
+
+    // 以下只在合成线程访问
+    QThreadPool mPool;
+    FramePool mFrames;                   // 交给编码的整帧
+    AVFrame *mCanvas;
+    QVector<Tile> mTiles;
+    Config mLayout;                      // mCanvas/mTiles 对应的设置
+    int mLayoutInputs;
+};
+
+#endif // MOSAICCOMPOSITOR_H
@@ -0,0 +1,511 @@
+#include "motiondetector.h"
+
+#include <QThread>
+#include <QStringList>
+#include <QtConcurrent/QtConcurrentRun>
+#include <QDebug>
+
+#include <cstring>
+#include <cstdlib>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define VP_MOTION_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define VP_MOTION_NEON
+#endif
+
+extern "C" {
+    #include <libavutil/pixdesc.h>
+}
+
+// 分析分辨率的上限宽度：1080p 按 4x4 块平均得到 480x270
+static const int kMaxAnalysisWidth = 480;
+// 背景更新速度（Q4 定点右移位数）：静止块每次分析靠近 1/16，有移动的块 1/128
+static const int kFastShift = 4;
+static const int kSlowShift = 7;
+// 整幅画面超过这个比例的块同时变化，按光照突变处理，重置背景
+static const double kGlobalChangeRatio = 0.5;
+// 连续几次分析超过阈值才算开始移动，过滤单帧噪声（压缩花屏、雨滴）
+static const int kStartHits = 2;
+
+// ---- 差分内核：一行块与背景比较，输出掩码并更新背景 ----
+
+#if defined(VP_MOTION_SSE2)
+// n 为 16 的倍数；与下面的 C 版本逐位一致
+static void compareRow(const quint8 *cur, quint16 *bg, quint8 *mask, int n, int threshold)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i thr = _mm_set1_epi8(char(threshold));
+    const __m128i ones = _mm_set1_epi8(char(0xff));
+    for (int i = 0; i < n; i += 16) {
+        __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i *>(cur + i));
+        __m128i b0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(bg + i));
+        __m128i b1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(bg + i + 8));
+        __m128i b8 = _mm_packus_epi16(_mm_srli_epi16(b0, 4), _mm_srli_epi16(b1, 4));
+        __m128i diff = _mm_or_si128(_mm_subs_epu8(c, b8), _mm_subs_epu8(b8, c));
+        __m128i still = _mm_cmpeq_epi8(_mm_subs_epu8(diff, thr), zero);
+        __m128i moving = _mm_xor_si128(still, ones);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(mask + i), moving);
+
+        __m128i d0 = _mm_sub_epi16(_mm_slli_epi16(_mm_unpacklo_epi8(c, zero), 4), b0);
+        __m128i d1 = _mm_sub_epi16(_mm_slli_epi16(_mm_unpackhi_epi8(c, zero), 4), b1);
+        __m128i m0 = _mm_unpacklo_epi8(moving, moving);
+        __m128i m1 = _mm_unpackhi_epi8(moving, moving);
+        __m128i s0 = _mm_or_si128(_mm_and_si128(m0, _mm_srai_epi16(d0, kSlowShift)),
+                                  _mm_andnot_si128(m0, _mm_srai_epi16(d0, kFastShift)));
+        __m128i s1 = _mm_or_si128(_mm_and_si128(m1, _mm_srai_epi16(d1, kSlowShift)),
+                                  _mm_andnot_si128(m1, _mm_srai_epi16(d1, kFastShift)));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(bg + i), _mm_add_epi16(b0, s0));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(bg + i + 8), _mm_add_epi16(b1, s1));
+    }
+}
+
+static int countMask(const quint8 *mask, int n)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi8(1);
+    __m128i sum = zero;
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i m = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(mask + i)), one);
+        sum = _mm_add_epi64(sum, _mm_sad_epu8(m, zero));
+    }
+    int count = _mm_cvtsi128_si32(sum) + _mm_cvtsi128_si32(_mm_srli_si128(sum, 8));
+    for (; i < n; i++)
+        count += mask[i] & 1;
+    return count;
+}
+#elif defined(VP_MOTION_NEON)
+static void compareRow(const quint8 *cur, quint16 *bg, quint8 *mask, int n, int threshold)
+{
+    const uint8x16_t thr = vdupq_n_u8(quint8(threshold));
+    for (int i = 0; i < n; i += 16) {
+        uint8x16_t c = vld1q_u8(cur + i);
+        uint16x8_t b0 = vld1q_u16(bg + i);
+        uint16x8_t b1 = vld1q_u16(bg + i + 8);
+        uint8x16_t b8 = vcombine_u8(vshrn_n_u16(b0, 4), vshrn_n_u16(b1, 4));
+        uint8x16_t moving = vcgtq_u8(vabdq_u8(c, b8), thr);
+        vst1q_u8(mask + i, moving);
+
+        int16x8_t d0 = vsubq_s16(vreinterpretq_s16_u16(vshll_n_u8(vget_low_u8(c), 4)), vreinterpretq_s16_u16(b0));
+        int16x8_t d1 = vsubq_s16(vreinterpretq_s16_u16(vshll_n_u8(vget_high_u8(c), 4)), vreinterpretq_s16_u16(b1));
+        uint16x8_t m0 = vreinterpretq_u16_s16(vmovl_s8(vreinterpret_s8_u8(vget_low_u8(moving))));
+        uint16x8_t m1 = vreinterpretq_u16_s16(vmovl_s8(vreinterpret_s8_u8(vget_high_u8(moving))));
+        int16x8_t s0 = vbslq_s16(m0, vshrq_n_s16(d0, kSlowShift), vshrq_n_s16(d0, kFastShift));
+        int16x8_t s1 = vbslq_s16(m1, vshrq_n_s16(d1, kSlowShift), vshrq_n_s16(d1, kFastShift));
+        vst1q_u16(bg + i, vaddq_u16(b0, vreinterpretq_u16_s16(s0)));
+        vst1q_u16(bg + i + 8, vaddq_u16(b1, vreinterpretq_u16_s16(s1)));
+    }
+}
+
+static int countMask(const quint8 *mask, int n)
+{
+    uint32x4_t sum = vdupq_n_u32(0);
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        uint8x16_t m = vandq_u8(vld1q_u8(mask + i), vdupq_n_u8(1));
+        sum = vpadalq_u16(sum, vpaddlq_u8(m));
+    }
+    int count = int(vgetq_lane_u32(sum, 0) + vgetq_lane_u32(sum, 1)
+                    + vgetq_lane_u32(sum, 2) + vgetq_lane_u32(sum, 3));
+    for (; i < n; i++)
+        count += mask[i] & 1;
+    return count;
+}
+#else
+static void compareRow(const quint8 *cur, quint16 *bg, quint8 *mask, int n, int threshold)
+{
+    for (int i = 0; i < n; i++) {
+        int b = bg[i] >> 4;
+        bool moving = std::abs(int(cur[i]) - b) > threshold;
+        mask[i] = moving ? 0xff : 0;
+        int delta = (int(cur[i]) << 4) - int(bg[i]);
+        bg[i] = quint16(bg[i] + (delta >> (moving ? kSlowShift : kFastShift)));
+    }
+}
+
+static int countMask(const quint8 *mask, int n)
+{
+    int count = 0;
+    for (int i = 0; i < n; i++)
+        count += mask[i] & 1;
+    return count;
+}
+#endif
+
+// 把一行源像素累加到 16 位行和里（每个块最多 16x16 个像素，不会溢出）
+static void accumulateRow(const quint8 *src, quint16 *acc, int n)
+{
+    int x = 0;
+#if defined(VP_MOTION_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    for (; x + 16 <= n; x += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x));
+        __m128i a0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(acc + x));
+        __m128i a1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(acc + x + 8));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(acc + x), _mm_add_epi16(a0, _mm_unpacklo_epi8(v, zero)));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(acc + x + 8), _mm_add_epi16(a1, _mm_unpackhi_epi8(v, zero)));
+    }
+#elif defined(VP_MOTION_NEON)
+    for (; x + 16 <= n; x += 16) {
+        uint8x16_t v = vld1q_u8(src + x);
+        vst1q_u16(acc + x, vaddw_u8(vld1q_u16(acc + x), vget_low_u8(v)));
+        vst1q_u16(acc + x + 8, vaddw_u8(vld1q_u16(acc + x + 8), vget_high_u8(v)));
+    }
+#endif
+    for (; x < n; x++)
+        acc[x] = quint16(acc[x] + src[x]);
+}
+
+// ---- MotionDetector ----
+
+MotionDetector::MotionDetector(QObject *parent)
+    : QObject(parent), mPerf(nullptr), mLastSubmitNs(0), mBusy(false), mResetPending(false),
+      mFactor(1), mWidth(0), mHeight(0), mStride(0), mHasBackground(false)
+{
+    mConfig.enabled = false;
+    mConfig.intervalNs = 200000000;
+    mConfig.sensitivity = 50;
+    mConfig.overlay = false;
+    mConfig.holdNs = qint64(2000) * 1000000;
+}
+
+MotionDetector::~MotionDetector()
+{
+    mJob.waitForFinished();
+}
+
+QThreadPool *MotionDetector::analysisPool()
+{
+    // 所有摄像头共用，最多占一半核，避免和解码抢 CPU
+    static QThreadPool *pool = []() {
+        QThreadPool *p = new QThreadPool;
+        p->setMaxThreadCount(qMax(1, QThread::idealThreadCount() / 2));
+        return p;
+    }();
+    return pool;
+}
+
+void MotionDetector::setEnabled(bool enabled)
+{
+    QMutexLocker locker(&mConfigMutex);
+    if (mConfig.enabled && !enabled)
+        mResetPending = true;   // 重新开启时从头建立背景
+    mConfig.enabled = enabled;
+}
+
+bool MotionDetector::isEnabled() const
+{
+    QMutexLocker locker(&mConfigMutex);
+    return mConfig.enabled;
+}
+
+void MotionDetector::setAnalysisFps(double fps)
+{
+    QMutexLocker locker(&mConfigMutex);
+    mConfig.intervalNs = fps > 0 ? qint64(1e9 / fps) : 0;
+}
+
+void MotionDetector::setSensitivity(int sensitivity)
+{
+    QMutexLocker locker(&mConfigMutex);
+    mConfig.sensitivity = qBound(1, sensitivity, 100);
+}
+
+void MotionDetector::setZones(const QVector<MotionZone> &zones)
+{
+    QMutexLocker locker(&mConfigMutex);
+    mConfig.zones = zones;
+}
+
+QVector<MotionZone> MotionDetector::zones() const
+{
+    QMutexLocker locker(&mConfigMutex);
+    return mConfig.zones;
+}
+
+void MotionDetector::setOverlayEnabled(bool enabled)
+{
+    QMutexLocker locker(&mConfigMutex);
+    mConfig.overlay = enabled;
+}
+
+void MotionDetector::setHoldMs(int ms)
+{
+    QMutexLocker locker(&mConfigMutex);
+    mConfig.holdNs = qint64(qMax(0, ms)) * 1000000;
+}
+
+void MotionDetector::setPerfStats(PerfStats *stats)
+{
+    mPerf = stats;
+}
+
+MotionDetector::Config MotionDetector::config() const
+{
+    QMutexLocker locker(&mConfigMutex);
+    return mConfig;
+}
+
+void MotionDetector::reset()
+{
+    mResetPending = true;
+    mLastSubmitNs = 0;
+    QMutexLocker locker(&mMaskMutex);
+    mLatestMask = MotionMask();
+}
+
+bool MotionDetector::takeOverlay(QImage *image)
+{
+    return mOverlay.take(image);
+}
+
+MotionMask MotionDetector::latestMask() const
+{
+    QMutexLocker locker(&mMaskMutex);
+    return mLatestMask;
+}
+
+bool MotionDetector::parseZones(const QString &text, QVector<MotionZone> *zones)
+{
+    zones->clear();
+    for (const QString &item : text.split(';', QString::SkipEmptyParts)) {
+        QStringList parts = item.trimmed().split(':');
+        if (parts.size() < 2 || parts.size() > 3)
+            return false;
+        QStringList coords = parts[1].split(',');
+        if (coords.size() != 4)
+            return false;
+        double v[4];
+        for (int i = 0; i < 4; i++) {
+            bool ok = false;
+            v[i] = coords[i].trimmed().toDouble(&ok);
+            if (!ok || v[i] < 0 || v[i] > 1)
+                return false;
+        }
+        MotionZone zone;
+        zone.name = parts[0].trimmed();
+        zone.rect = QRectF(v[0], v[1], v[2], v[3]) & QRectF(0, 0, 1, 1);
+        if (parts.size() == 3) {
+            bool ok = false;
+            zone.sensitivity = parts[2].toInt(&ok);
+            if (!ok || zone.sensitivity < 1 || zone.sensitivity > 100)
+                return false;
+        }
+        if (zone.name.isEmpty() || zone.rect.isEmpty())
+            return false;
+        zones->append(zone);
+    }
+    return true;
+}
+
+void MotionDetector::submit(const AVFrame *frame)
+{
+    qint64 intervalNs;
+    {
+        QMutexLocker locker(&mConfigMutex);
+        if (!mConfig.enabled)
+            return;
+        intervalNs = mConfig.intervalNs;
+    }
+    qint64 now = perfNowNs();
+    if (mLastSubmitNs && now - mLastSubmitNs < intervalNs)
+        return;
+
+    // 只处理第一个平面是亮度的格式（YUV 平面/半平面），RGB、调色板和硬件帧跳过
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(AVPixelFormat(frame->format));
+    if (!desc || (desc->flags & (AV_PIX_FMT_FLAG_RGB | AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_HWACCEL))
+            || desc->comp[0].depth != 8 || desc->comp[0].step != 1
+            || frame->width < 16 || frame->height < 16)
+        return;
+
+    if (mBusy.exchange(true))
+        return;     // 上一帧还没分析完，跳过这一帧
+    AVFrame *ref = av_frame_clone(frame);
+    if (!ref) {
+        mBusy = false;
+        return;
+    }
+    mLastSubmitNs = now;
+    mJob = QtConcurrent::run(analysisPool(), [this, ref, now]() {
+        analyze(ref, now);
+    });
+}
+
+void MotionDetector::downsample(const AVFrame *frame)
+{
+    int factor = 1;
+    while (frame->width / factor > kMaxAnalysisWidth && factor < 16)
+        factor *= 2;
+    const int width = frame->width / factor;
+    const int height = frame->height / factor;
+    if (factor != mFactor || width != mWidth || height != mHeight) {
+        // 分辨率变化（首帧或码流切换）：重新分配，背景从下一帧重建
+        mFactor = factor;
+        mWidth = width;
+        mHeight = height;
+        mStride = (width + 15) & ~15;
+        mCurrent = QVector<quint8>(mStride * height, 0);
+        mBackground = QVector<quint16>(mStride * height, 0);
+        mMask = QVector<quint8>(mStride * height, 0);
+        mHasBackground = false;
+    }
+
+    int shift = 0;
+    while ((1 << shift) < factor)
+        shift++;
+    const int usedWidth = width * factor;
+    QVector<quint16> acc(usedWidth);
+    for (int by = 0; by < height; by++) {
+        acc.fill(0);
+        for (int r = 0; r < factor; r++) {
+            const quint8 *src = frame->data[0] + qint64(by * factor + r) * frame->linesize[0];
+            accumulateRow(src, acc.data(), usedWidth);
+        }
+        quint8 *out = mCurrent.data() + by * mStride;
+        const quint16 *a = acc.constData();
+        for (int bx = 0; bx < width; bx++) {
+            int sum = 0;
+            for (int k = 0; k < factor; k++)
+                sum += a[k];
+            out[bx] = quint8(sum >> (2 * shift));
+            a += factor;
+        }
+    }
+}
+
+void MotionDetector::analyze(AVFrame *frame, qint64 timeNs)
+{
+    qint64 startNs = perfNowNs();
+    const Config cfg = config();
+
+    if (mResetPending.exchange(false)) {
+        mHasBackground = false;
+        for (ZoneState &state : mZoneStates) {
+            if (state.active)
+                emit sig_MotionStopped(state.name);
+        }
+        mZoneStates.clear();
+    }
+
+    downsample(frame);
+    av_frame_free(&frame);
+
+    bool compared = false;
+    if (!mHasBackground) {
+        for (int i = 0; i < mCurrent.size(); i++)
+            mBackground[i] = quint16(mCurrent[i] << 4);
+        mMask.fill(0);
+        mHasBackground = true;
+    } else {
+        const int threshold = 60 - cfg.sensitivity / 2;
+        for (int y = 0; y < mHeight; y++) {
+            int offset = y * mStride;
+            compareRow(mCurrent.constData() + offset, mBackground.data() + offset,
+                       mMask.data() + offset, mStride, threshold);
+        }
+        compared = true;
+
+        int changed = 0;
+        for (int y = 0; y < mHeight; y++)
+            changed += countMask(mMask.constData() + y * mStride, mWidth);
+        if (changed > kGlobalChangeRatio * mWidth * mHeight) {
+            // 光照突变：不报移动，直接以当前画面为背景
+            for (int i = 0; i < mCurrent.size(); i++)
+                mBackground[i] = quint16(mCurrent[i] << 4);
+            mMask.fill(0);
+            compared = false;
+        }
+    }
+
+    if (compared)
+        updateZones(cfg, timeNs);
+    {
+        QMutexLocker locker(&mMaskMutex);
+        mLatestMask.cells = mMask;
+        mLatestMask.width = mWidth;
+        mLatestMask.height = mHeight;
+        mLatestMask.stride = mStride;
+        mLatestMask.factor = mFactor;
+    }
+    if (cfg.overlay)
+        emitOverlay();
+    if (mPerf)
+        mPerf->record(PerfMotion, startNs);
+    mBusy = false;
+}
+
+void MotionDetector::updateZones(const Config &cfg, qint64 timeNs)
+{
+    QVector<MotionZone> zones = cfg.zones;
+    if (zones.isEmpty()) {
+        MotionZone all;
+        all.name = "all";
+        all.rect = QRectF(0, 0, 1, 1);
+        zones.append(all);
+    }
+
+    // 区域配置变化时重建状态，仍在移动中的区域先补发停止事件
+    bool same = zones.size() == mZoneStates.size();
+    for (int i = 0; same && i < zones.size(); i++)
+        same = zones.at(i).name == mZoneStates.at(i).name;
+    if (!same) {
+        for (const ZoneState &state : mZoneStates) {
+            if (state.active)
+                emit sig_MotionStopped(state.name);
+        }
+        mZoneStates = QVector<ZoneState>(zones.size());
+        for (int i = 0; i < zones.size(); i++)
+            mZoneStates[i].name = zones.at(i).name;
+    }
+
+    for (int i = 0; i < zones.size(); i++) {
+        const MotionZone &zone = zones.at(i);
+        ZoneState &state = mZoneStates[i];
+        int x0 = qBound(0, int(zone.rect.left() * mWidth), mWidth);
+        int x1 = qBound(0, int(zone.rect.right() * mWidth + 0.5), mWidth);
+        int y0 = qBound(0, int(zone.rect.top() * mHeight), mHeight);
+        int y1 = qBound(0, int(zone.rect.bottom() * mHeight + 0.5), mHeight);
+        int cells = (x1 - x0) * (y1 - y0);
+        if (cells <= 0)
+            continue;
+
+        int changed = 0;
+        for (int y = y0; y < y1; y++)
+            changed += countMask(mMask.constData() + y * mStride + x0, x1 - x0);
+        // 灵敏度 50 时需要约 2% 的块变化，100 时任意 4 个块
+        int sensitivity = zone.sensitivity > 0 ? zone.sensitivity : cfg.sensitivity;
+        double level = double(changed) / cells;
+        bool moving = changed >= 4 && level >= (101 - sensitivity) / 2500.0;
+
+        if (moving) {
+            state.hits++;
+            state.lastMotionNs = timeNs;
+            if (!state.active && state.hits >= kStartHits) {
+                state.active = true;
+                emit sig_MotionStarted(state.name, level);
+            }
+        } else {
+            state.hits = 0;
+            if (state.active && timeNs - state.lastMotionNs >= cfg.holdNs) {
+                state.active = false;
+                emit sig_MotionStopped(state.name);
+            }
+        }
+    }
+}
+
+void MotionDetector::emitOverlay()
+{
+    QImage overlay(mWidth, mHeight, QImage::Format_ARGB32_Premultiplied);
+    for (int y = 0; y < mHeight; y++) {
+        const quint8 *mask = mMask.constData() + y * mStride;
+        QRgb *line = reinterpret_cast<QRgb *>(overlay.scanLine(y));
+        for (int x = 0; x < mWidth; x++)
+            line[x] = mask[x] ? 0x80800000 : 0;   // 半透明红色（预乘）
+    }
+    if (mOverlay.post(overlay))
+        emit sig_OverlayReady();
+}
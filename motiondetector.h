@@ -0,0 +1,130 @@
+#ifndef MOTIONDETECTOR_H
+#define MOTIONDETECTOR_H
+
+#include <QObject>
+#include <QImage>
+#include <QMutex>
+#include <QRectF>
+#include <QFuture>
+#include <QThreadPool>
+#include <QVector>
+
+#include <atomic>
+
+#include "framemailbox.h"
+#include "perfstats.h"
+
+extern "C" {
+    #include <libavutil/frame.h>
+}
+
+// 侦测区域，坐标按画面归一化（0..1），与分辨率无关
+struct MotionZone {
+    QString name;
+    QRectF rect;
+    int sensitivity = -1;      // 1..100，-1 表示使用全局灵敏度
+};
+
+// 最近一次分析的移动块：分析分辨率下每个点对应原画面 factor×factor 个像素，有移动为 0xff
+struct MotionMask {
+    QVector<quint8> cells;
+    int width = 0;
+    int height = 0;
+    int stride = 0;
+    int factor = 1;
+};
+
+// 亮度平面上的移动侦测。
+// 解码线程按分析帧率抽帧（只增加引用，不拷贝），Y 平面按块平均下采样到约 480 像素宽，
+// 在共享线程池里与背景模型做绝对差（SSE2/NEON），超过阈值的块占区域的比例达到要求即视为移动。
+// 背景按指数滑动平均更新，有移动的块更新得慢；整幅画面大面积变化（开关灯、切换日夜模式）时重置背景。
+// 上一帧还没分析完时新帧直接跳过，不会在解码线程里等待。
+class MotionDetector : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit MotionDetector(QObject *parent = nullptr);
+    ~MotionDetector();
+
+    // 以下设置可在任意线程调用，下一次分析时生效
+    void setEnabled(bool enabled);
+    bool isEnabled() const;
+    void setAnalysisFps(double fps);            // 默认 5
+    void setSensitivity(int sensitivity);       // 1..100，默认 50
+    void setZones(const QVector<MotionZone> &zones);   // 为空时整幅画面作为一个区域 "all"
+    QVector<MotionZone> zones() const;
+    void setOverlayEnabled(bool enabled);       // 开启后每次分析都输出一幅移动块掩码
+    void setHoldMs(int ms);                     // 停止移动多久后发出 sig_MotionStopped，默认 2000
+    void setPerfStats(PerfStats *stats);        // 分析耗时记到 PerfMotion 阶段
+
+    // 解码线程调用；frame 需是 YUV 格式（Y 在 data[0]），其他格式忽略
+    void submit(const AVFrame *frame);
+    // 重新开始（换流、重连）：丢弃背景模型和区域状态
+    void reset();
+
+    // 最近一次分析的掩码：有移动的块为半透明红色，其余透明，尺寸为分析分辨率。收到 sig_OverlayReady 后调用
+    bool takeOverlay(QImage *image);
+    // 最近一次分析的移动块（隐式共享，不拷贝），任意线程可调用；还没有分析过时为空
+    MotionMask latestMask() const;
+
+    // "名称:x,y,w,h[:灵敏度];..."，坐标为 0..1 的小数，例如 "door:0,0,0.3,1;yard:0.3,0.5,0.7,0.5:70"
+    static bool parseZones(const QString &text, QVector<MotionZone> *zones);
+
+signals:
+    void sig_MotionStarted(const QString &zone, double level);   // level 为变化块所占比例
+    void sig_MotionStopped(const QString &zone);
+    void sig_OverlayReady();
+
+private:
+    Q_DISABLE_COPY(MotionDetector)
+
+    struct Config {
+        bool enabled;
+        qint64 intervalNs;
+        int sensitivity;
+        QVector<MotionZone> zones;
+        bool overlay;
+        qint64 holdNs;
+    };
+    struct ZoneState {
+        QString name;
+        bool active = false;
+        int hits = 0;              // 连续超过阈值的分析次数
+        qint64 lastMotionNs = 0;
+    };
+
+    Config config() const;
+    void analyze(AVFrame *frame, qint64 timeNs);
+    void downsample(const AVFrame *frame);
+    void updateZones(const Config &cfg, qint64 timeNs);
+    void emitOverlay();
+
+    mutable QMutex mConfigMutex;
+    Config mConfig;
+    PerfStats *mPerf;
+
+    // 解码线程
+    qint64 mLastSubmitNs;
+    std::atomic<bool> mBusy;
+    std::atomic<bool> mResetPending;
+    QFuture<void> mJob;
+
+    // 以下只在分析任务里访问（同一时间只有一个任务）
+    int mFactor;                   // 下采样倍数
+    int mWidth, mHeight;           // 分析分辨率
+    int mStride;                   // 按 16 字节对齐的行宽
+    QVector<quint8> mCurrent;
+    QVector<quint16> mBackground;  // Q4 定点
+    QVector<quint8> mMask;         // 有移动的块为 0xff
+    QVector<ZoneState> mZoneStates;
+    bool mHasBackground;
+
+    FrameMailbox<QImage> mOverlay;
+    mutable QMutex mMaskMutex;
+    MotionMask mLatestMask;
+
+    static QThreadPool *analysisPool();
+};
+
+#endif // MOTIONDETECTOR_H
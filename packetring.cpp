@@ -0,0 +1,100 @@
+#include "packetring.h"
+
+PacketRing::PacketRing()
+    : mVideoStream(-1), mKeyframes(0), mBytes(0),
+      mDurationNs(qint64(5000) * 1000000), mMaxBytes(qint64(64) * 1024 * 1024)
+{
+}
+
+PacketRing::~PacketRing()
+{
+    clear();
+}
+
+void PacketRing::setVideoStream(int index)
+{
+    if (index != mVideoStream)
+        clear();
+    mVideoStream = index;
+}
+
+void PacketRing::setDurationMs(int ms)
+{
+    mDurationNs = qint64(qMax(0, ms)) * 1000000;
+}
+
+void PacketRing::setMaxBytes(qint64 bytes)
+{
+    mMaxBytes = bytes;
+}
+
+void PacketRing::clear()
+{
+    dropFront(mEntries.size());
+}
+
+void PacketRing::dropFront(int count)
+{
+    for (int i = 0; i < count && !mEntries.isEmpty(); i++) {
+        Entry entry = mEntries.takeFirst();
+        mBytes -= entry.packet->size;
+        if (entry.keyframe)
+            mKeyframes--;
+        av_packet_free(&entry.packet);
+    }
+}
+
+void PacketRing::push(const AVPacket *packet, qint64 timeNs)
+{
+    if (mVideoStream < 0)
+        return;
+    bool keyframe = packet->stream_index == mVideoStream && (packet->flags & AV_PKT_FLAG_KEY);
+    // 缓冲总是从关键帧开始，第一个关键帧之前的包没有用
+    if (mEntries.isEmpty() && !keyframe)
+        return;
+
+    Entry entry;
+    entry.packet = av_packet_clone(packet);
+    if (!entry.packet)
+        return;
+    entry.timeNs = timeNs;
+    entry.keyframe = keyframe;
+    mEntries.append(entry);
+    mBytes += packet->size;
+    if (keyframe)
+        mKeyframes++;
+    trim(timeNs);
+}
+
+// 第二个 GOP 的起点已经早于保留窗口（或超出字节上限）时，整个第一个 GOP 都可以丢掉
+void PacketRing::trim(qint64 nowNs)
+{
+    while (mKeyframes >= 2) {
+        int next = 1;
+        while (next < mEntries.size() && !mEntries.at(next).keyframe)
+            next++;
+        bool expired = nowNs - mEntries.at(next).timeNs >= mDurationNs;
+        if (!expired && mBytes <= mMaxBytes)
+            break;
+        dropFront(next);
+    }
+}
+
+QVector<AVPacket *> PacketRing::snapshot() const
+{
+    QVector<AVPacket *> packets;
+    packets.reserve(mEntries.size());
+    for (const Entry &entry : mEntries) {
+        AVPacket *packet = av_packet_clone(entry.packet);
+        if (packet)
+            packets.append(packet);
+    }
+    return packets;
+}
+
+qint64 PacketRing::spanMs() const
+{
+    if (mEntries.isEmpty())
+        return 0;
+    return (mEntries.last().timeNs - mEntries.first().timeNs) / 1000000;
+}
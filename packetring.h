@@ -0,0 +1,56 @@
+#ifndef PACKETRING_H
+#define PACKETRING_H
+
+#include <QList>
+#include <QVector>
+#include <QtGlobal>
+
+extern "C" {
+    #include <libavcodec/avcodec.h>
+}
+
+// 压缩包预录缓冲：保留最近一段时间的视频/音频包（只增加引用，不拷贝数据），
+// 总是从视频关键帧开始，按整个 GOP 淘汰，取出来的内容可以直接写成一段能解码的录像。
+// 实际保留的时长在 [duration, duration + 一个 GOP) 之间。
+// 只在解码线程里使用，不加锁。
+class PacketRing
+{
+public:
+    PacketRing();
+    ~PacketRing();
+
+    void setVideoStream(int index);
+    void setDurationMs(int ms);         // 默认 5000
+    void setMaxBytes(qint64 bytes);     // 默认 64 MB，超过时即使时长不够也淘汰最早的 GOP
+
+    void push(const AVPacket *packet, qint64 timeNs);
+    void clear();
+
+    // 缓冲中的全部包（各自新增一份引用，调用方负责 av_packet_free）
+    QVector<AVPacket *> snapshot() const;
+
+    int count() const { return mEntries.size(); }
+    qint64 bytes() const { return mBytes; }
+    qint64 spanMs() const;
+
+private:
+    Q_DISABLE_COPY(PacketRing)
+
+    struct Entry {
+        AVPacket *packet;
+        qint64 timeNs;         // 收到的时刻
+        bool keyframe;         // 视频关键帧，GOP 的起点
+    };
+
+    void trim(qint64 nowNs);
+    void dropFront(int count);
+
+    QList<Entry> mEntries;
+    int mVideoStream;
+    int mKeyframes;
+    qint64 mBytes;
+    qint64 mDurationNs;
+    qint64 mMaxBytes;
+};
+
+#endif // PACKETRING_H
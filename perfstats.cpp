@@ -0,0 +1,201 @@
+#include "perfstats.h"
+
+#include <QtAlgorithms>
+
+#include <chrono>
+#include <cmath>
+
+const char *perfStageName(PerfStage stage)
+{
+    switch (stage) {
+    case PerfNetwork:    return "network";
+    case PerfDecode:     return "decode";
+    case PerfConvert:    return "convert";
+    case PerfRedChannel: return "red";
+    case PerfDeliver:    return "deliver";
+    case PerfPaint:      return "paint";
+    case PerfMotion:     return "motion";
+    case PerfFrame:      return "frame";
+    default:             return "unknown";
+    }
+}
+
+qint64 perfNowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// 单写者累加：普通读改写即可，避免 lock 前缀
+template <typename T, typename V>
+static inline void bump(std::atomic<T> &value, V delta)
+{
+    value.store(value.load(std::memory_order_relaxed) + T(delta), std::memory_order_relaxed);
+}
+
+LatencyHistogram::LatencyHistogram()
+{
+    reset();
+}
+
+int LatencyHistogram::bucketIndex(qint64 us)
+{
+    if (us < SubBuckets)
+        return us < 0 ? 0 : int(us);
+
+    int exponent = 63 - int(qCountLeadingZeroBits(quint64(us)));
+    if (exponent >= MaxExponent)
+        return BucketCount - 1;
+
+    int sub = int(us >> (exponent - SubBucketBits)) & (SubBuckets - 1);
+    return SubBuckets + (exponent - SubBucketBits) * SubBuckets + sub;
+}
+
+// 桶的代表值取区间中点
+qint64 LatencyHistogram::bucketValue(int index)
+{
+    if (index < SubBuckets)
+        return index;
+
+    int exponent = (index - SubBuckets) / SubBuckets + SubBucketBits;
+    int sub = (index - SubBuckets) % SubBuckets;
+    qint64 width = qint64(1) << (exponent - SubBucketBits);
+    return (SubBuckets + sub) * width + width / 2;
+}
+
+void LatencyHistogram::record(qint64 us)
+{
+    bump(mBuckets[bucketIndex(us)], 1);
+    bump(mCount, 1);
+    bump(mSum, us < 0 ? 0 : us);
+    if (us > mMax.load(std::memory_order_relaxed))
+        mMax.store(us, std::memory_order_relaxed);
+}
+
+void LatencyHistogram::reset()
+{
+    for (int i = 0; i < BucketCount; i++)
+        mBuckets[i].store(0, std::memory_order_relaxed);
+    mCount.store(0, std::memory_order_relaxed);
+    mSum.store(0, std::memory_order_relaxed);
+    mMax.store(0, std::memory_order_relaxed);
+}
+
+quint64 LatencyHistogram::count() const
+{
+    return mCount.load(std::memory_order_relaxed);
+}
+
+qint64 LatencyHistogram::maxValue() const
+{
+    return mMax.load(std::memory_order_relaxed);
+}
+
+double LatencyHistogram::mean() const
+{
+    quint64 n = count();
+    return n ? double(mSum.load(std::memory_order_relaxed)) / n : 0.0;
+}
+
+qint64 LatencyHistogram::percentile(double p) const
+{
+    Q_ASSERT(p >= 0.0 && p <= 1.0);
+    quint64 n = count();
+    if (n == 0)
+        return 0;
+
+    quint64 rank = quint64(std::ceil(p * n));
+    if (rank == 0)
+        rank = 1;
+
+    quint64 seen = 0;
+    for (int i = 0; i < BucketCount; i++) {
+        seen += mBuckets[i].load(std::memory_order_relaxed);
+        if (seen >= rank)
+            return qMin(bucketValue(i), maxValue());
+    }
+    return maxValue();
+}
+
+double PerfSnapshot::fpsSince(const PerfSnapshot &previous) const
+{
+    qint64 elapsedNs = timestampNs - previous.timestampNs;
+    if (elapsedNs <= 0 || framesDecoded < previous.framesDecoded)
+        return 0.0;
+    return (framesDecoded - previous.framesDecoded) * 1e9 / elapsedNs;
+}
+
+QString PerfSnapshot::toText(const PerfSnapshot &previous) const
+{
+    QString text = QString("fps %1  queue %2  dropped %3\n")
+            .arg(fpsSince(previous), 0, 'f', 1)
+            .arg(queueDepth)
+            .arg(framesDropped);
+    for (int i = 0; i < PerfStageCount; i++) {
+        const PerfStageSnapshot &s = stages[i];
+        text += QString("%1 %2 ms (p99 %3)\n")
+                .arg(perfStageName(PerfStage(i)), -8)
+                .arg(s.p50Ms, 0, 'f', 2)
+                .arg(s.p99Ms, 0, 'f', 2);
+    }
+    return text.trimmed();
+}
+
+PerfStats::PerfStats()
+    : mFramesDecoded(0), mFramesDropped(0), mQueueDepth(0)
+{
+}
+
+void PerfStats::record(PerfStage stage, qint64 startNs)
+{
+    mStages[stage].record((perfNowNs() - startNs) / 1000);
+}
+
+void PerfStats::frameDecoded()
+{
+    bump(mFramesDecoded, 1);
+}
+
+void PerfStats::frameDropped()
+{
+    bump(mFramesDropped, 1);
+}
+
+// 队列深度由两个线程增减，需要原子 RMW
+void PerfStats::frameQueued()
+{
+    mQueueDepth.fetch_add(1, std::memory_order_relaxed);
+}
+
+void PerfStats::frameConsumed()
+{
+    mQueueDepth.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void PerfStats::reset()
+{
+    for (int i = 0; i < PerfStageCount; i++)
+        mStages[i].reset();
+    mFramesDecoded.store(0, std::memory_order_relaxed);
+    mFramesDropped.store(0, std::memory_order_relaxed);
+}
+
+PerfSnapshot PerfStats::snapshot() const
+{
+    PerfSnapshot snap;
+    snap.timestampNs = perfNowNs();
+    snap.framesDecoded = mFramesDecoded.load(std::memory_order_relaxed);
+    snap.framesDropped = mFramesDropped.load(std::memory_order_relaxed);
+    snap.queueDepth = mQueueDepth.load(std::memory_order_relaxed);
+    for (int i = 0; i < PerfStageCount; i++) {
+        const LatencyHistogram &h = mStages[i];
+        PerfStageSnapshot &s = snap.stages[i];
+        s.count = h.count();
+        s.meanMs = h.mean() / 1000.0;
+        s.p50Ms = h.percentile(0.50) / 1000.0;
+        s.p90Ms = h.percentile(0.90) / 1000.0;
+        s.p99Ms = h.percentile(0.99) / 1000.0;
+        s.maxMs = h.maxValue() / 1000.0;
+    }
+    return snap;
+}
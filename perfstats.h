@@ -0,0 +1,116 @@
+#ifndef PERFSTATS_H
+#define PERFSTATS_H
+
+#include <QString>
+#include <QtGlobal>
+
+#include <atomic>
+
+// 播放热路径的各个阶段
+enum PerfStage {
+    PerfNetwork = 0,   // av_read_frame
+    PerfDecode,        // avcodec_decode_video2
+    PerfConvert,       // sws_scale + 拷贝到 QImage
+    PerfRedChannel,    // 红色通道提取
+    PerfDeliver,       // 发射帧信号
+    PerfPaint,         // 界面线程缩放并显示
+    PerfMotion,        // 移动侦测（分析线程池，按分析帧率抽帧）
+    PerfFrame,         // 单帧从送入解码到信号发出的总耗时
+    PerfStageCount
+};
+
+const char *perfStageName(PerfStage stage);
+
+// 单调时钟，纳秒
+qint64 perfNowNs();
+
+// HDR 风格的对数-线性直方图，单位微秒，相对误差约 6%
+// 每个直方图只允许一个线程写入（无锁、无原子 RMW），任意线程可并发读取
+class LatencyHistogram
+{
+public:
+    enum {
+        SubBucketBits = 4,
+        SubBuckets = 1 << SubBucketBits,
+        MaxExponent = 36,   // 约 19 小时，超出的值记入最后一个桶
+        BucketCount = SubBuckets * (MaxExponent - SubBucketBits + 1)
+    };
+
+    LatencyHistogram();
+
+    void record(qint64 us);
+    void reset();
+
+    quint64 count() const;
+    qint64 maxValue() const;
+    double mean() const;
+    qint64 percentile(double p) const;   // p 为 0~1 的分位，0.99 即 p99
+
+private:
+    static int bucketIndex(qint64 us);
+    static qint64 bucketValue(int index);
+
+    std::atomic<quint32> mBuckets[BucketCount];
+    std::atomic<quint64> mCount;
+    std::atomic<quint64> mSum;
+    std::atomic<qint64> mMax;
+};
+
+struct PerfStageSnapshot {
+    quint64 count;
+    double meanMs;
+    double p50Ms;
+    double p90Ms;
+    double p99Ms;
+    double maxMs;
+};
+
+struct PerfSnapshot {
+    qint64 timestampNs;
+    quint64 framesDecoded;
+    quint64 framesDropped;
+    int queueDepth;
+    PerfStageSnapshot stages[PerfStageCount];
+
+    // 与上一次快照比较得到帧率
+    double fpsSince(const PerfSnapshot &previous) const;
+    QString toText(const PerfSnapshot &previous) const;
+};
+
+// 每个 VideoPlayer 一份的性能统计，常开，开销为每阶段两次时钟读取
+class PerfStats
+{
+public:
+    PerfStats();
+
+    void record(PerfStage stage, qint64 startNs);
+    void frameDecoded();
+    void frameDropped();
+    void frameQueued();        // 帧已投递给界面
+    void frameConsumed();      // 界面已取走/显示
+    void reset();
+
+    PerfSnapshot snapshot() const;
+
+private:
+    LatencyHistogram mStages[PerfStageCount];
+    std::atomic<quint64> mFramesDecoded;
+    std::atomic<quint64> mFramesDropped;
+    std::atomic<int> mQueueDepth;
+};
+
+// 作用域计时：析构时记录到对应阶段
+class PerfScope
+{
+public:
+    PerfScope(PerfStats *stats, PerfStage stage)
+        : mStats(stats), mStage(stage), mStartNs(perfNowNs()) {}
+    ~PerfScope() { mStats->record(mStage, mStartNs); }
+
+private:
+    PerfStats *mStats;
+    PerfStage mStage;
+    qint64 mStartNs;
+};
+
+#endif // PERFSTATS_H
@@ -0,0 +1,569 @@
+#include "processedoutput.h"
+#include "motiondetector.h"
+#include "metrics.h"
+#include "perfstats.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QDebug>
+
+#include <climits>
+
+extern "C" {
+    #include <libavutil/imgutils.h>
+    #include <libavutil/opt.h>
+}
+
+// 编码线程最多积压的帧数，再多就在解码线程丢帧（编码跟不上时延迟不会越积越大）
+static const int kMaxQueuedFrames = 2;
+// 帧池：解码线程正在写的、队列里的和编码器持有的
+static const int kPoolFrames = 6;
+// 打开或写入失败后隔这么久再试（RTSP 服务器重启、磁盘满等）
+static const qint64 kRetryNs = qint64(3000) * 1000000;
+
+static QString avError(int err)
+{
+    char buf[AV_ERROR_MAX_STRING_SIZE] = { 0 };
+    av_strerror(err, buf, sizeof(buf));
+    return QString::fromUtf8(buf);
+}
+
+const char *processedStageName(ProcessedStage stage)
+{
+    switch (stage) {
+    case ProcessedSource: return "source";
+    case ProcessedRed:    return "red";
+    case ProcessedBinary: return "binary";
+    case ProcessedMotion: return "motion";
+    }
+    return "unknown";
+}
+
+bool parseProcessedStage(const QString &name, ProcessedStage *stage)
+{
+    for (ProcessedStage s : { ProcessedSource, ProcessedRed, ProcessedBinary, ProcessedMotion }) {
+        if (name.compare(processedStageName(s), Qt::CaseInsensitive) == 0) {
+            *stage = s;
+            return true;
+        }
+    }
+    return false;
+}
+
+// ---- 各级画面：按 2x2 亮度块 + 一对色度逐块计算，src 与 dst 可以是同一帧 ----
+
+static inline quint8 clip8(int v)
+{
+    return quint8(v < 0 ? 0 : (v > 255 ? 255 : v));
+}
+
+static bool isFullRange(const AVFrame *frame)
+{
+    return frame->format == AV_PIX_FMT_YUVJ420P || frame->color_range == AVCOL_RANGE_JPEG;
+}
+
+// YUV420P 与 YUVJ420P 的内存布局相同，av_frame_copy 要求格式一致，这里直接拷平面
+static void copyPlanes(const AVFrame *src, AVFrame *dst)
+{
+    av_image_copy(dst->data, dst->linesize, const_cast<const uint8_t **>(src->data), src->linesize,
+                  AV_PIX_FMT_YUV420P, src->width, src->height);
+}
+
+// op(quint8 y[4], quint8 *u, quint8 *v, int lumaX, int lumaY)；画面边缘不足 2x2 时重复边上的像素，只写回有效的
+template <typename Op>
+static void forEachBlock(const AVFrame *src, AVFrame *dst, Op op)
+{
+    const int w = src->width;
+    const int h = src->height;
+    const int cw = (w + 1) / 2;
+    const int ch = (h + 1) / 2;
+    for (int cy = 0; cy < ch; cy++) {
+        const int y0 = cy * 2;
+        const int y1 = qMin(y0 + 1, h - 1);
+        const quint8 *sy0 = src->data[0] + qint64(y0) * src->linesize[0];
+        const quint8 *sy1 = src->data[0] + qint64(y1) * src->linesize[0];
+        const quint8 *su = src->data[1] + qint64(cy) * src->linesize[1];
+        const quint8 *sv = src->data[2] + qint64(cy) * src->linesize[2];
+        quint8 *dy0 = dst->data[0] + qint64(y0) * dst->linesize[0];
+        quint8 *dy1 = dst->data[0] + qint64(y1) * dst->linesize[0];
+        quint8 *du = dst->data[1] + qint64(cy) * dst->linesize[1];
+        quint8 *dv = dst->data[2] + qint64(cy) * dst->linesize[2];
+        for (int cx = 0; cx < cw; cx++) {
+            const int x0 = cx * 2;
+            const int x1 = qMin(x0 + 1, w - 1);
+            quint8 y[4] = { sy0[x0], sy0[x1], sy1[x0], sy1[x1] };
+            quint8 u = su[cx];
+            quint8 v = sv[cx];
+            op(y, &u, &v, x0, y0);
+            dy0[x0] = y[0];
+            dy0[x1] = x1 > x0 ? y[1] : y[0];
+            if (y1 > y0) {
+                dy1[x0] = y[2];
+                dy1[x1] = x1 > x0 ? y[3] : y[2];
+            }
+            du[cx] = u;
+            dv[cx] = v;
+        }
+    }
+}
+
+// 只保留红色：(R, 0, 0) 再转回 YUV，BT.601
+static void renderRed(const AVFrame *src, AVFrame *dst, bool fullRange)
+{
+    forEachBlock(src, dst, [fullRange](quint8 y[4], quint8 *u, quint8 *v, int, int) {
+        const int dv = *v - 128;
+        int sum = 0;
+        for (int i = 0; i < 4; i++) {
+            int r = fullRange ? clip8(y[i] + ((359 * dv + 128) >> 8))
+                              : clip8((298 * (y[i] - 16) + 409 * dv + 128) >> 8);
+            y[i] = fullRange ? quint8((77 * r + 128) >> 8) : quint8(((66 * r + 128) >> 8) + 16);
+            sum += r;
+        }
+        const int r = sum / 4;
+        *u = fullRange ? clip8(128 + ((-43 * r + 128) >> 8)) : clip8(128 + ((-38 * r + 128) >> 8));
+        *v = fullRange ? clip8(128 + ((127 * r + 128) >> 8)) : clip8(128 + ((112 * r + 128) >> 8));
+    });
+}
+
+// 灰度超过阈值为白，其余为黑；灰度即 0.3R+0.59G+0.11B，也就是全范围的亮度
+static void renderBinary(const AVFrame *src, AVFrame *dst, bool fullRange, int threshold)
+{
+    const int white = fullRange ? 255 : 235;
+    const int black = fullRange ? 0 : 16;
+    const int limit = fullRange ? threshold : 16 + threshold * 219 / 255;
+    forEachBlock(src, dst, [white, black, limit](quint8 y[4], quint8 *u, quint8 *v, int, int) {
+        for (int i = 0; i < 4; i++)
+            y[i] = quint8(y[i] > limit ? white : black);
+        *u = 128;
+        *v = 128;
+    });
+}
+
+// 有移动的块与红色各占一半，同界面上的移动叠加层
+static void renderMotion(const AVFrame *src, AVFrame *dst, bool fullRange, const MotionMask &mask)
+{
+    if (src != dst)
+        copyPlanes(src, dst);
+    if (mask.cells.isEmpty() || mask.factor <= 0)
+        return;
+    const int redY = fullRange ? 76 : 81;
+    const int redU = fullRange ? 85 : 90;
+    const int redV = fullRange ? 255 : 240;
+    const quint8 *cells = mask.cells.constData();
+    forEachBlock(dst, dst, [&](quint8 y[4], quint8 *u, quint8 *v, int x, int row) {
+        const int mx = x / mask.factor;
+        const int my = row / mask.factor;
+        if (mx >= mask.width || my >= mask.height || !cells[my * mask.stride + mx])
+            return;
+        for (int i = 0; i < 4; i++)
+            y[i] = quint8((y[i] + redY + 1) >> 1);
+        *u = quint8((*u + redU + 1) >> 1);
+        *v = quint8((*v + redV + 1) >> 1);
+    });
+}
+
+void ProcessedOutput::render(const AVFrame *src, AVFrame *dst, ProcessedStage stage, int binaryThreshold,
+                             const MotionDetector *motion)
+{
+    const bool fullRange = isFullRange(src);
+    switch (stage) {
+    case ProcessedSource:
+        if (src != dst)
+            copyPlanes(src, dst);
+        break;
+    case ProcessedRed:
+        renderRed(src, dst, fullRange);
+        break;
+    case ProcessedBinary:
+        renderBinary(src, dst, fullRange, binaryThreshold);
+        break;
+    case ProcessedMotion: {
+        // 移动侦测没开时掩码是空的，输出原画
+        MotionMask mask;
+        if (motion && motion->isEnabled())
+            mask = motion->latestMask();
+        renderMotion(src, dst, fullRange, mask);
+        break;
+    }
+    }
+    dst->color_range = fullRange ? AVCOL_RANGE_JPEG : AVCOL_RANGE_MPEG;
+}
+
+ProcessedOutput::ProcessedOutput(QObject *parent)
+    : QObject(parent), mMotion(nullptr), mPool(kPoolFrames), mSws(nullptr), mNextDueNs(0), mStartNs(0),
+      mQueuedFrames(0), mQuit(false), mEncoder(nullptr),
+      mOut(nullptr), mCodec(nullptr), mStream(nullptr), mRetryNs(0), mPtsBase(0), mLastPts(-1),
+      mOpen(false), mDropped(0)
+{
+    mConfig.stage = ProcessedSource;
+    mConfig.bitrateBps = 2000000;
+    mConfig.intervalNs = qint64(1e9 / 25);
+    mConfig.threshold = 200;
+}
+
+ProcessedOutput::~ProcessedOutput()
+{
+    if (mEncoder) {
+        {
+            QMutexLocker locker(&mQueueMutex);
+            mQuit = true;
+            mQueueCond.wakeAll();
+        }
+        mEncoder->wait();
+        delete mEncoder;
+    }
+    for (Command &command : mQueue)
+        av_frame_free(&command.frame);
+    sws_freeContext(mSws);
+}
+
+void ProcessedOutput::setOutput(const QString &url)
+{
+    QMutexLocker locker(&mMutex);
+    mConfig.url = url.trimmed();
+}
+
+QString ProcessedOutput::output() const
+{
+    QMutexLocker locker(&mMutex);
+    return mConfig.url;
+}
+
+bool ProcessedOutput::isEnabled() const
+{
+    QMutexLocker locker(&mMutex);
+    return !mConfig.url.isEmpty();
+}
+
+void ProcessedOutput::setStage(ProcessedStage stage)
+{
+    QMutexLocker locker(&mMutex);
+    mConfig.stage = stage;
+}
+
+ProcessedStage ProcessedOutput::stage() const
+{
+    QMutexLocker locker(&mMutex);
+    return mConfig.stage;
+}
+
+void ProcessedOutput::setBitrate(qint64 bps)
+{
+    QMutexLocker locker(&mMutex);
+    mConfig.bitrateBps = qMax(Q_INT64_C(10000), bps);
+}
+
+void ProcessedOutput::setMaxFps(double fps)
+{
+    QMutexLocker locker(&mMutex);
+    mConfig.intervalNs = fps > 0 ? qint64(1e9 / fps) : 0;
+}
+
+void ProcessedOutput::setBinaryThreshold(int threshold)
+{
+    QMutexLocker locker(&mMutex);
+    mConfig.threshold = qBound(0, threshold, 255);
+}
+
+void ProcessedOutput::setMotionDetector(const MotionDetector *detector)
+{
+    QMutexLocker locker(&mMutex);
+    mMotion = detector;
+}
+
+ProcessedOutput::Config ProcessedOutput::config() const
+{
+    QMutexLocker locker(&mMutex);
+    return mConfig;
+}
+
+void ProcessedOutput::offer(const AVFrame *frame)
+{
+    const Config cfg = config();
+    if (cfg.url.isEmpty() || frame->width < 2 || frame->height < 2)
+        return;
+    qint64 now = perfNowNs();
+    // 提前不到四分之一间隔的帧也算到时：来帧与输出同帧率时时间上的抖动不会被当成多余的帧丢掉
+    if (mNextDueNs && now < mNextDueNs - cfg.intervalNs / 4)
+        return;
+    {
+        QMutexLocker locker(&mQueueMutex);
+        if (mQueuedFrames >= kMaxQueuedFrames) {
+            mDropped++;
+            return;
+        }
+    }
+    // 按间隔累加；落后超过一个间隔（来帧慢于输出帧率、刚开始）时从现在重新计
+    mNextDueNs = mNextDueNs && now - mNextDueNs < cfg.intervalNs ? mNextDueNs + cfg.intervalNs
+                                                                  : now + cfg.intervalNs;
+    if (!mStartNs)
+        mStartNs = now;
+
+    const MotionDetector *motion;
+    {
+        QMutexLocker locker(&mMutex);
+        motion = mMotion;
+    }
+
+    AVFrame *out = nullptr;
+    const bool yuv420 = frame->format == AV_PIX_FMT_YUV420P || frame->format == AV_PIX_FMT_YUVJ420P;
+    if (yuv420 && cfg.stage == ProcessedSource) {
+        // 原画：直接引用解码帧，不拷贝像素
+        out = av_frame_clone(frame);
+        if (out) {
+            out->color_range = isFullRange(frame) ? AVCOL_RANGE_JPEG : AVCOL_RANGE_MPEG;
+            out->format = AV_PIX_FMT_YUV420P;   // YUVJ420P 内存布局相同，用色彩范围区分
+        }
+    } else {
+        AVFrame *pooled = mPool.acquire(frame->width, frame->height, AV_PIX_FMT_YUV420P);
+        if (!pooled)
+            return;
+        if (yuv420) {
+            render(frame, pooled, cfg.stage, cfg.threshold, motion);
+        } else {
+            // 先转成 YUV420P 再原地生成该级画面
+            mSws = sws_getCachedContext(mSws, frame->width, frame->height, AVPixelFormat(frame->format),
+                                        frame->width, frame->height, AV_PIX_FMT_YUV420P,
+                                        SWS_BILINEAR, nullptr, nullptr, nullptr);
+            if (!mSws)
+                return;
+            sws_scale(mSws, frame->data, frame->linesize, 0, frame->height, pooled->data, pooled->linesize);
+            pooled->color_range = AVCOL_RANGE_MPEG;
+            render(pooled, pooled, cfg.stage, cfg.threshold, motion);
+        }
+        out = av_frame_clone(pooled);
+    }
+    if (!out)
+        return;
+    out->pts = (now - mStartNs) / 1000000;   // 毫秒，按墙钟：重连后流时间戳会跳变
+    out->pict_type = AV_PICTURE_TYPE_NONE;
+    if (!enqueue(Command{ Command::Frame, out, cfg }))
+        av_frame_free(&out);
+}
+
+void ProcessedOutput::close()
+{
+    mNextDueNs = 0;
+    mStartNs = 0;
+    mPool.clear();
+    if (mEncoder)
+        enqueue(Command{ Command::Close, nullptr, Config() });
+}
+
+bool ProcessedOutput::enqueue(const Command &command)
+{
+    QMutexLocker locker(&mQueueMutex);
+    if (mQuit)
+        return false;
+    if (!mEncoder) {
+        mEncoder = QThread::create([this]() { encoderLoop(); });
+        mEncoder->setObjectName("ProcessedOutput");
+        mEncoder->start();
+    }
+    if (command.type == Command::Frame)
+        mQueuedFrames++;
+    mQueue.append(command);
+    mQueueCond.wakeOne();
+    return true;
+}
+
+void ProcessedOutput::encoderLoop()
+{
+    forever {
+        Command command;
+        {
+            QMutexLocker locker(&mQueueMutex);
+            while (mQueue.isEmpty() && !mQuit)
+                mQueueCond.wait(&mQueueMutex);
+            if (mQueue.isEmpty() || mQuit)
+                break;
+            command = mQueue.takeFirst();
+            if (command.type == Command::Frame)
+                mQueuedFrames--;
+        }
+        switch (command.type) {
+        case Command::Frame:
+            encoderFrame(command.frame, command.config);
+            break;
+        case Command::Close:
+            encoderClose();
+            mRetryNs = 0;
+            break;
+        }
+    }
+    encoderClose();
+}
+
+void ProcessedOutput::encoderFrame(AVFrame *frame, const Config &cfg)
+{
+    // 地址、码率、帧率或分辨率变了：结束当前输出，按新设置重新打开
+    if (mOut && (cfg.url != mOpened.url || cfg.bitrateBps != mOpened.bitrateBps
+                 || cfg.intervalNs != mOpened.intervalNs
+                 || frame->width != mCodec->width || frame->height != mCodec->height
+                 || frame->color_range != mCodec->color_range)) {
+        encoderClose();
+        mRetryNs = 0;
+    }
+    if (!mOut) {
+        if (mRetryNs && perfNowNs() < mRetryNs) {
+            av_frame_free(&frame);
+            mDropped++;
+            return;
+        }
+        QString error;
+        if (!encoderOpen(cfg, frame, &error)) {
+            qWarning() << "ProcessedOutput:" << error;
+            encoderClose();
+            mRetryNs = perfNowNs() + kRetryNs;
+            av_frame_free(&frame);
+            emit sig_OutputError(error);
+            return;
+        }
+        mRetryNs = 0;
+        mPtsBase = frame->pts;
+        mLastPts = -1;
+        qDebug() << "ProcessedOutput:" << processedStageName(cfg.stage) << "to"
+                 << MetricsRegistry::displayName(cfg.url);
+        emit sig_OutputStarted(cfg.url);
+    }
+
+    frame->pts = qMax(frame->pts - mPtsBase, mLastPts + 1);
+    mLastPts = frame->pts;
+    bool ok = encoderDrain(frame);
+    av_frame_free(&frame);
+    if (!ok) {
+        QString error = QString("Write to %1 failed").arg(MetricsRegistry::displayName(cfg.url));
+        qWarning() << "ProcessedOutput:" << error;
+        encoderClose();
+        mRetryNs = perfNowNs() + kRetryNs;
+        emit sig_OutputError(error);
+    }
+}
+
+bool ProcessedOutput::encoderOpen(const Config &cfg, const AVFrame *frame, QString *error)
+{
+    const QByteArray url = cfg.url.toUtf8();
+    const bool rtsp = cfg.url.startsWith("rtsp://", Qt::CaseInsensitive);
+    if (!rtsp)
+        QDir().mkpath(QFileInfo(cfg.url).absolutePath());
+    int ret = avformat_alloc_output_context2(&mOut, nullptr, rtsp ? "rtsp" : nullptr, url.constData());
+    if (ret < 0 || !mOut) {
+        *error = QString("Cannot create %1: %2").arg(MetricsRegistry::displayName(cfg.url), avError(ret));
+        return false;
+    }
+
+    AVCodec *codec = avcodec_find_encoder_by_name("libx264");
+    if (!codec)
+        codec = avcodec_find_encoder(AV_CODEC_ID_H264);
+    if (!codec)
+        codec = avcodec_find_encoder(AV_CODEC_ID_MPEG4);
+    if (!codec) {
+        *error = "No H.264 or MPEG-4 encoder available";
+        return false;
+    }
+    mCodec = avcodec_alloc_context3(codec);
+    if (!mCodec) {
+        *error = "Out of memory";
+        return false;
+    }
+    const double fps = cfg.intervalNs > 0 ? 1e9 / cfg.intervalNs : 25.0;
+    mCodec->width = frame->width;
+    mCodec->height = frame->height;
+    mCodec->pix_fmt = AV_PIX_FMT_YUV420P;
+    mCodec->color_range = frame->color_range;
+    mCodec->time_base = av_make_q(1, 1000);   // 时间戳为毫秒
+    mCodec->framerate = av_d2q(fps, 1000);
+    mCodec->gop_size = qMax(1, qRound(fps * 2));   // 两秒一个关键帧，中途连上的客户端很快出画
+    mCodec->max_b_frames = 0;
+    mCodec->bit_rate = cfg.bitrateBps;
+    mCodec->rc_max_rate = cfg.bitrateBps;
+    mCodec->rc_buffer_size = int(qMin(cfg.bitrateBps * 2, qint64(INT_MAX)));
+    if (mOut->oformat->flags & AVFMT_GLOBALHEADER)
+        mCodec->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+    if (QByteArray(codec->name) == "libx264") {
+        av_opt_set(mCodec->priv_data, "preset", "veryfast", 0);
+        av_opt_set(mCodec->priv_data, "tune", "zerolatency", 0);
+    }
+    ret = avcodec_open2(mCodec, codec, nullptr);
+    if (ret < 0) {
+        *error = QString("Cannot open encoder %1: %2").arg(codec->name, avError(ret));
+        return false;
+    }
+
+    mStream = avformat_new_stream(mOut, nullptr);
+    if (!mStream || avcodec_parameters_from_context(mStream->codecpar, mCodec) < 0) {
+        *error = "Cannot create output stream";
+        return false;
+    }
+    mStream->time_base = mCodec->time_base;
+    if (!(mOut->oformat->flags & AVFMT_NOFILE)) {
+        ret = avio_open(&mOut->pb, url.constData(), AVIO_FLAG_WRITE);
+        if (ret < 0) {
+            *error = QString("Cannot open %1: %2").arg(MetricsRegistry::displayName(cfg.url), avError(ret));
+            return false;
+        }
+    }
+    AVDictionary *options = nullptr;
+    if (rtsp)
+        av_dict_set(&options, "rtsp_transport", "tcp", 0);
+    ret = avformat_write_header(mOut, &options);
+    av_dict_free(&options);
+    if (ret < 0) {
+        *error = QString("Cannot write header for %1: %2").arg(MetricsRegistry::displayName(cfg.url), avError(ret));
+        return false;
+    }
+
+    mOpened = cfg;
+    mOpen = true;
+    mMetrics = MetricsRegistry::instance()->registerStream("push", cfg.url);
+    mMetrics->onOpened();
+    return true;
+}
+
+// 送一帧（nullptr 表示冲刷）并写出编码器给出的所有包；写失败返回 false
+bool ProcessedOutput::encoderDrain(AVFrame *frame)
+{
+    int ret = avcodec_send_frame(mCodec, frame);
+    if (ret < 0 && ret != AVERROR_EOF)
+        return false;
+    AVPacket *packet = av_packet_alloc();
+    if (!packet)
+        return false;
+    quint64 bytes = 0;
+    bool ok = true;
+    while ((ret = avcodec_receive_packet(mCodec, packet)) >= 0) {
+        bytes += quint64(packet->size);
+        av_packet_rescale_ts(packet, mCodec->time_base, mStream->time_base);
+        packet->stream_index = mStream->index;
+        if (av_interleaved_write_frame(mOut, packet) < 0) {
+            ok = false;
+            break;
+        }
+    }
+    av_packet_free(&packet);
+    if (mMetrics)
+        mMetrics->onProgress(bytes, frame ? 1 : 0, mDropped.exchange(0));
+    return ok;
+}
+
+void ProcessedOutput::encoderClose()
+{
+    if (mOpen) {
+        encoderDrain(nullptr);
+        av_write_trailer(mOut);
+        mOpen = false;
+    }
+    if (mOut) {
+        if (mOut->pb && !(mOut->oformat->flags & AVFMT_NOFILE))
+            avio_closep(&mOut->pb);
+        avformat_free_context(mOut);
+        mOut = nullptr;
+    }
+    mStream = nullptr;
+    avcodec_free_context(&mCodec);
+    if (mMetrics) {
+        mMetrics->setConnected(false);
+        MetricsRegistry::instance()->unregisterStream(mMetrics);
+        mMetrics.clear();
+    }
+}
@@ -0,0 +1,132 @@
+#ifndef PROCESSEDOUTPUT_H
+#define PROCESSEDOUTPUT_H
+
+#include <QObject>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QList>
+#include <QSharedPointer>
+#include <QThread>
+
+#include <atomic>
+
+#include "framepool.h"
+
+extern "C" {
+    #include <libavcodec/avcodec.h>
+    #include <libavformat/avformat.h>
+    #include <libswscale/swscale.h>
+}
+
+class MotionDetector;
+class StreamMetrics;
+
+// 输出哪一级分析画面
+enum ProcessedStage {
+    ProcessedSource = 0,   // 解码后的原画
+    ProcessedRed,          // 红色通道（同界面的红色通道小窗）
+    ProcessedBinary,       // 灰度阈值二值图（同界面的二值图）
+    ProcessedMotion        // 原画叠加移动块（半透明红色）
+};
+
+const char *processedStageName(ProcessedStage stage);
+bool parseProcessedStage(const QString &name, ProcessedStage *stage);   // source/red/binary/motion
+
+// 把分析画面重新编码，推成 RTSP 流或写文件，下游系统直接拿到处理后的画面。
+// 解码线程从帧池里取一块 YUV420P 帧，直接在 Y/U/V 平面上算出该级画面（不经过 QImage/RGB），
+// 原画且已是 YUV420P 时直接引用解码帧；编码线程拿到的只是帧的引用，
+// 用 libavcodec（优先 libx264）编码、libavformat 封装输出。编码跟不上时丢帧，不阻塞解码线程；
+// 输出断开后隔几秒重新打开。
+//
+// 线程：设置可在任意线程调用，下一帧生效；offer/close 只在解码线程调用；信号在编码线程里发出。
+class ProcessedOutput : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ProcessedOutput(QObject *parent = nullptr);
+    ~ProcessedOutput();
+
+    // rtsp://... 推流，其他按扩展名选封装写文件；为空（默认）时关闭
+    void setOutput(const QString &url);
+    QString output() const;
+    bool isEnabled() const;
+    void setStage(ProcessedStage stage);        // 默认原画
+    ProcessedStage stage() const;
+    void setBitrate(qint64 bps);                // 默认 2 Mbit/s
+    void setMaxFps(double fps);                 // 默认 25，0 表示每帧都编码
+    void setBinaryThreshold(int threshold);     // 二值图的灰度阈值 0..255，默认 200
+    void setMotionDetector(const MotionDetector *detector);   // 移动叠加的掩码来源
+
+    // 解码线程：每个要显示的帧都交给它，关闭或没到编码时刻时立即返回
+    void offer(const AVFrame *frame);
+    // 解码线程：停止播放时结束当前输出（文件写尾）
+    void close();
+
+    // 按阶段生成一帧，dst 须为与 src 同尺寸的 YUV420P 可写帧；src 须为 YUV420P/YUVJ420P。线程安全
+    static void render(const AVFrame *src, AVFrame *dst, ProcessedStage stage, int binaryThreshold,
+                       const MotionDetector *motion);
+
+signals:
+    void sig_OutputStarted(const QString &url);
+    void sig_OutputError(const QString &message);
+
+private:
+    Q_DISABLE_COPY(ProcessedOutput)
+
+    struct Config {
+        QString url;
+        ProcessedStage stage;
+        qint64 bitrateBps;
+        qint64 intervalNs;
+        int threshold;
+    };
+    struct Command {
+        enum Type { Frame, Close } type;
+        AVFrame *frame;                  // Frame：帧池里的一份引用，由编码线程释放
+        Config config;
+    };
+
+    Config config() const;
+    bool enqueue(const Command &command);
+
+    // 编码线程
+    void encoderLoop();
+    bool encoderOpen(const Config &cfg, const AVFrame *frame, QString *error);
+    void encoderFrame(AVFrame *frame, const Config &cfg);
+    bool encoderDrain(AVFrame *frame);
+    void encoderClose();
+
+    mutable QMutex mMutex;
+    Config mConfig;
+    const MotionDetector *mMotion;
+
+    // 解码线程
+    FramePool mPool;
+    SwsContext *mSws;                // 解码输出不是 YUV420P 时先转格式
+    qint64 mNextDueNs;               // 下一帧的编码时刻，按间隔累加，来帧的抖动不会造成丢帧
+    qint64 mStartNs;                 // 第一帧的时刻，时间戳以它为零点
+
+    // 编码队列
+    QMutex mQueueMutex;
+    QWaitCondition mQueueCond;
+    QList<Command> mQueue;
+    int mQueuedFrames;
+    bool mQuit;
+    QThread *mEncoder;
+
+    // 以下只在编码线程访问
+    AVFormatContext *mOut;
+    AVCodecContext *mCodec;
+    AVStream *mStream;
+    Config mOpened;                  // 当前输出对应的设置
+    qint64 mRetryNs;                 // 打开或写入失败后隔一段时间再试
+    qint64 mPtsBase;                 // 这次输出第一帧的时间戳，输出从 0 开始
+    qint64 mLastPts;
+    bool mOpen;                      // 已写文件头
+    QSharedPointer<StreamMetrics> mMetrics;
+
+    std::atomic<quint64> mDropped;   // 还没计入指标的丢帧（两个线程都会丢）
+};
+
+#endif // PROCESSEDOUTPUT_H
@@ -0,0 +1,846 @@
+#include "pushmanager.h"
+#include "metrics.h"
+
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDebug>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QProcessEnvironment>
+#include <QThread>
+#include <QtMath>
+
+#include <algorithm>
+#include <climits>
+
+// 没有指定时的占用估计：摄像头按 libx264 编码一路约一个核、码率上限 2M；转推只是搬包
+static const double kEncodeCpuCost = 1.0;
+static const qint64 kEncodeBitrateBps = 2000000;
+static const double kCopyCpuCost = 0.05;
+static const qint64 kCopyBitrateBps = 4000000;
+
+// 同播估算占用时，原始分辨率按 1080p 算
+static const int kSourceHeightEstimate = 1080;
+
+// 停止时等 ffmpeg 自己退出的时间，超时后强制结束（异步，不阻塞主线程）
+static const int kTerminateTimeoutMs = 3000;
+
+const char *pushStateName(PushState state)
+{
+    switch (state) {
+    case PushQueued:   return "queued";
+    case PushStarting: return "starting";
+    case PushRunning:  return "running";
+    case PushRetrying: return "retrying";
+    case PushFinished: return "finished";
+    case PushFailed:   return "failed";
+    case PushStopped:  return "stopped";
+    }
+    return "unknown";
+}
+
+QVector<PushRendition> parseRenditions(const QString &text, const QString &baseOutput)
+{
+    QVector<PushRendition> renditions;
+    const QStringList items = text.split(',', QString::SkipEmptyParts);
+    for (const QString &item : items) {
+        const QStringList fields = item.trimmed().split(':');
+        if (fields.size() != 3)
+            continue;
+        PushRendition r;
+        r.height = fields.at(0).toInt();
+        r.fps = qMax(1, fields.at(1).toInt());
+        r.bitrateBps = qMax(Q_INT64_C(1), fields.at(2).toLongLong()) * 1000;
+        r.output = renditions.isEmpty() ? baseOutput : QString("%1_%2p").arg(baseOutput).arg(r.height);
+        renditions.append(r);
+    }
+    return renditions;
+}
+
+// 相对 1080p30 一路的编码量
+static double renditionWeight(const PushRendition &r)
+{
+    double height = r.height > 0 ? r.height : kSourceHeightEstimate;
+    return (height / kSourceHeightEstimate) * (height / kSourceHeightEstimate) * r.fps / 30.0;
+}
+
+// 按高度从大到小排，原始分辨率在最前；级联缩放时每路都从上一路缩小
+static QVector<PushRendition> sortedRenditions(const QVector<PushRendition> &renditions)
+{
+    QVector<PushRendition> sorted = renditions;
+    std::stable_sort(sorted.begin(), sorted.end(), [](const PushRendition &a, const PushRendition &b) {
+        return (a.height > 0 ? a.height : INT_MAX) > (b.height > 0 ? b.height : INT_MAX);
+    });
+    return sorted;
+}
+
+// libx264 码控和 GOP 参数。
+// 默认：两秒一个关键帧，VBV 两秒，码率平稳但关键帧处有尖峰；
+// 低延迟：每秒完成一轮帧内刷新，不再有 IDR 尖峰（中途加入的客户端最多等一轮刷新才出完整画面），
+// VBV 只有一帧大小，每帧都不超过平均帧大小，发送排队时间不超过一帧
+static QStringList x264Arguments(const QString &preset, int fps, qint64 bitrateBps, bool lowLatency)
+{
+    QStringList args;
+    args << "-preset:v" << preset
+         << "-tune:v" << "zerolatency"
+         << "-b:v" << QString::number(bitrateBps)
+         << "-maxrate" << QString::number(bitrateBps);
+    if (!lowLatency) {
+        args << "-g" << QString::number(fps * 2)
+             << "-bufsize" << QString::number(bitrateBps * 2);
+        return args;
+    }
+    args << "-g" << QString::number(fps)
+         << "-bf" << "0"
+         << "-bufsize" << QString::number(qMax(Q_INT64_C(1), bitrateBps / qMax(1, fps)))
+         << "-x264-params" << "intra-refresh=1:scenecut=0:sliced-threads=1:rc-lookahead=0:sync-lookahead=0";
+    return args;
+}
+
+int PushRetryPolicy::delayFor(int attempt) const
+{
+    double delay = delayMs * qPow(qMax(1.0, backoff), qMax(0, attempt - 1));
+    return int(qMin(delay, double(qMax(delayMs, maxDelayMs))));
+}
+
+PushJob::PushJob(const PushJobSpec &spec, QObject *parent)
+    : QObject(parent), mSpec(spec), mState(PushQueued), mProcess(nullptr),
+      mCountedBytes(0), mCountedFrames(0), mCountedDrops(0)
+{
+    qRegisterMetaType<PushProgress>();
+    if (mSpec.output.isEmpty() && !mSpec.renditions.isEmpty())
+        mSpec.output = mSpec.renditions.first().output;
+    if (mSpec.id.isEmpty())
+        mSpec.id = mSpec.output;
+    bool encode = inputKind(mSpec.input) == PushInputCamera;
+    mAdaptive = encode && mSpec.adaptive && mSpec.renditions.isEmpty();
+    mEncoder.setLevelRange(mSpec.startLevel, mSpec.maxLevel);
+    mCpuCost = mSpec.cpuCost >= 0 ? mSpec.cpuCost : (encode ? kEncodeCpuCost : kCopyCpuCost);
+    mBitrateBps = mSpec.bitrateBps >= 0 ? mSpec.bitrateBps : (encode ? kEncodeBitrateBps : kCopyBitrateBps);
+    if (!mSpec.renditions.isEmpty()) {
+        // 同播按各路分辨率和帧率估算
+        double cpu = 0;
+        qint64 bitrate = 0;
+        for (const PushRendition &r : mSpec.renditions) {
+            cpu += qMax(0.1, kEncodeCpuCost * renditionWeight(r));
+            bitrate += r.bitrateBps;
+        }
+        mCpuCost = mSpec.cpuCost >= 0 ? mSpec.cpuCost : cpu;
+        mBitrateBps = mSpec.bitrateBps >= 0 ? mSpec.bitrateBps : bitrate;
+    }
+    mMetrics = MetricsRegistry::instance()->registerStream("push", mSpec.output);
+
+    mRetryTimer.setSingleShot(true);
+    connect(&mRetryTimer, &QTimer::timeout, this, &PushJob::launch);
+}
+
+PushJob::~PushJob()
+{
+    mRetryTimer.stop();
+    killProcess();
+    MetricsRegistry::instance()->unregisterStream(mMetrics);
+}
+
+QString PushJob::id() const
+{
+    return mSpec.id;
+}
+
+const PushJobSpec &PushJob::spec() const
+{
+    return mSpec;
+}
+
+PushState PushJob::state() const
+{
+    return mState;
+}
+
+bool PushJob::isActive() const
+{
+    return mState == PushQueued || mState == PushStarting || mState == PushRunning || mState == PushRetrying;
+}
+
+PushJobStats PushJob::stats() const
+{
+    PushJobStats stats = mStats;
+    if (mRunClock.isValid())
+        stats.uptimeMs += mRunClock.elapsed();
+    return stats;
+}
+
+bool PushJob::isAdaptive() const
+{
+    return mAdaptive;
+}
+
+const EncoderLevel &PushJob::encoderLevel() const
+{
+    return mEncoder.current();
+}
+
+PushProgress PushJob::progress() const
+{
+    return mProgress;
+}
+
+double PushJob::cpuCost() const
+{
+    return mCpuCost;
+}
+
+qint64 PushJob::bitrateBps() const
+{
+    return mBitrateBps;
+}
+
+QJsonObject PushJob::toJson() const
+{
+    PushJobStats s = stats();
+    QJsonObject o;
+    o["id"] = mSpec.id;
+    o["input"] = MetricsRegistry::displayName(mSpec.input);
+    o["output"] = MetricsRegistry::displayName(mSpec.output);
+    o["state"] = pushStateName(mState);
+    o["cpu"] = mCpuCost;
+    o["bitrate_bps"] = double(mBitrateBps);
+    o["low_latency"] = mSpec.lowLatency;
+    o["starts"] = s.starts;
+    o["retries"] = s.retries;
+    o["total_retries"] = s.totalRetries;
+    o["failures"] = s.failures;
+    o["uptime_s"] = s.uptimeMs / 1000.0;
+    if (s.runningSinceMs)
+        o["running_since_ms"] = double(s.runningSinceMs);
+    o["last_exit_code"] = s.lastExitCode;
+    if (!s.lastError.isEmpty())
+        o["last_error"] = s.lastError;
+    if (mProgress.timestampMs) {
+        QJsonObject p;
+        p["frame"] = double(mProgress.frame);
+        p["fps"] = mProgress.fps;
+        p["bitrate_bps"] = mProgress.bitrateBps;
+        p["total_bytes"] = double(mProgress.totalBytes);
+        p["speed"] = mProgress.speed;
+        p["dup_frames"] = double(mProgress.dupFrames);
+        p["drop_frames"] = double(mProgress.dropFrames);
+        p["lag_ms"] = double(mProgress.lagMs);
+        if (mProgress.quality >= 0)
+            p["quality"] = mProgress.quality;
+        p["timestamp_ms"] = double(mProgress.timestampMs);
+        o["progress"] = p;
+    }
+    if (!mSpec.renditions.isEmpty()) {
+        QJsonArray renditions;
+        for (const PushRendition &r : sortedRenditions(mSpec.renditions)) {
+            QJsonObject ro;
+            ro["output"] = MetricsRegistry::displayName(r.output);
+            ro["height"] = r.height;
+            ro["fps"] = r.fps;
+            ro["bitrate_bps"] = double(r.bitrateBps);
+            renditions.append(ro);
+        }
+        o["renditions"] = renditions;
+    }
+    if (mAdaptive) {
+        QJsonObject e;
+        e["level"] = mEncoder.level();
+        e["settings"] = mEncoder.current().toText();
+        e["switches"] = mEncoder.switches();
+        if (mEncoder.speed() >= 0)
+            e["speed"] = mEncoder.speed();
+        o["encoder"] = e;
+    }
+    return o;
+}
+
+PushInputKind PushJob::inputKind(const QString &input)
+{
+    if (input.contains("://"))
+        return PushInputNetwork;
+    if (input.contains("Camera", Qt::CaseInsensitive) || input.contains("CAM", Qt::CaseInsensitive)
+            || input.contains("USB", Qt::CaseInsensitive) || !QFileInfo(input).exists())
+        return PushInputCamera;
+    return PushInputFile;
+}
+
+QStringList PushJob::buildArguments(const PushJobSpec &spec, const EncoderLevel &level)
+{
+    // 进度以 key=value 块写到标准输出，日志走标准错误
+    QStringList args;
+    args << "-nostats" << "-progress" << "pipe:1";
+    if (!spec.renditions.isEmpty())
+        return args + simulcastArguments(spec);
+    switch (inputKind(spec.input)) {
+    case PushInputNetwork:
+        // 网络流转推：不转码
+        if (spec.input.startsWith("rtsp://", Qt::CaseInsensitive))
+            args << "-rtsp_transport" << "tcp";
+        args << "-i" << spec.input
+             << "-c" << "copy"
+             << "-rtsp_transport" << "tcp"
+             << "-loglevel" << "warning";
+        break;
+    case PushInputCamera:
+        // 摄像头设备参数
+        args << "-f" << "dshow"
+             << "-thread_queue_size" << "512"  // 增加线程队列大小
+             << "-i" << "video=" + spec.input
+             << "-vcodec" << "libx264"
+             << x264Arguments(level.preset, level.fps, level.bitrateBps, spec.lowLatency)
+             << "-r" << QString::number(level.fps);
+        if (level.height > 0)
+            args << "-vf" << QString("scale=-2:'min(ih,%1)'").arg(level.height);   // 只缩小
+        args << "-rtsp_transport" << "tcp"
+             << "-reconnect" << "1"
+             << "-reconnect_at_eof" << "1"
+             << "-reconnect_streamed" << "1"
+             << "-reconnect_delay_max" << "5"
+             << "-timeout" << "5000000"
+             << "-muxdelay" << (spec.lowLatency ? "0" : "0.5")
+             << "-loglevel" << "warning";  // 减少不必要的日志
+        break;
+    case PushInputFile:
+        // 文件输入参数
+        args << "-re"
+             << "-stream_loop" << "-1"
+             << "-i" << spec.input
+             << "-c" << "copy"
+             << "-rtsp_transport" << "tcp"
+             << "-fflags" << "+genpts"
+             << "-loglevel" << "warning";
+        break;
+    }
+    args << "-f" << "rtsp" << spec.output;
+    return args;
+}
+
+// 同播：输入只打开一次，级联缩放后每路用自己的编码参数和线程数推到各自的地址
+QStringList PushJob::simulcastArguments(const PushJobSpec &spec)
+{
+    QStringList args;
+    args << "-loglevel" << "warning";
+    switch (inputKind(spec.input)) {
+    case PushInputNetwork:
+        if (spec.input.startsWith("rtsp://", Qt::CaseInsensitive))
+            args << "-rtsp_transport" << "tcp";
+        if (spec.lowLatency)
+            args << "-fflags" << "nobuffer";   // 解复用不额外缓冲
+        args << "-i" << spec.input;
+        break;
+    case PushInputCamera:
+        args << "-f" << "dshow" << "-thread_queue_size" << "512" << "-i" << "video=" + spec.input;
+        break;
+    case PushInputFile:
+        args << "-re" << "-stream_loop" << "-1" << "-i" << spec.input;
+        break;
+    }
+    args << "-filter_complex" << simulcastFilter(spec.renditions);
+
+    // 没指定线程数的各路按编码量分本机的核，避免每路 x264 都按全部核数开线程
+    const QVector<PushRendition> sorted = sortedRenditions(spec.renditions);
+    double totalWeight = 0;
+    for (const PushRendition &r : sorted)
+        totalWeight += renditionWeight(r);
+    const int cores = QThread::idealThreadCount();
+    for (int i = 0; i < sorted.size(); i++) {
+        const PushRendition &r = sorted.at(i);
+        int threads = r.threads > 0 ? r.threads : qMax(1, qRound(cores * renditionWeight(r) / totalWeight));
+        args << "-map" << QString("[v%1]").arg(i)
+             << "-c:v" << "libx264"
+             << "-threads:v" << QString::number(threads)
+             << x264Arguments(r.preset, r.fps, r.bitrateBps, spec.lowLatency);
+        if (spec.lowLatency)
+            args << "-muxdelay" << "0";
+        args << "-f" << "rtsp"
+             << "-rtsp_transport" << "tcp"
+             << r.output;
+    }
+    return args;
+}
+
+// [0:v]format=yuv420p,scale=..,split=2[o0][n0];[o0]fps=30[v0];[n0]scale=..[o1];[o1]fps=15[v1]
+QString PushJob::simulcastFilter(const QVector<PushRendition> &renditions)
+{
+    const QVector<PushRendition> sorted = sortedRenditions(renditions);
+    QStringList parts;
+    for (int i = 0; i < sorted.size(); i++) {
+        const PushRendition &r = sorted.at(i);
+        QString part = i == 0 ? QString("[0:v]format=yuv420p,") : QString("[n%1]").arg(i - 1);
+        part += r.height > 0 ? QString("scale=-2:'min(ih,%1)'").arg(r.height) : QString("null");
+        if (i < sorted.size() - 1)
+            part += QString(",split=2[o%1][n%1]").arg(i);
+        else
+            part += QString("[o%1]").arg(i);
+        parts << part << QString("[o%1]fps=%2[v%1]").arg(i).arg(r.fps);
+    }
+    return parts.join(';');
+}
+
+void PushJob::launch()
+{
+    killProcess();
+    mLastLine.clear();
+    mProgressBuffer.clear();
+    mBlock = PushProgress();
+    mCountedBytes = mCountedFrames = mCountedDrops = 0;
+    mProgressClock.invalidate();
+
+    mProcess = new QProcess(this);
+    if (!mSpec.ffreport.isEmpty()) {
+        QProcessEnvironment env = QProcessEnvironment::systemEnvironment();
+        env.insert("FFREPORT", mSpec.ffreport);   // 详细日志写盘，只在需要排查时开启
+        mProcess->setProcessEnvironment(env);
+    }
+    mProcess->setProcessChannelMode(QProcess::SeparateChannels);
+
+    connect(mProcess, &QProcess::readyReadStandardError, this, [this]() {
+        QString output = QString::fromLocal8Bit(mProcess->readAllStandardError()).trimmed();
+        if (output.isEmpty())
+            return;
+        mLastLine = output.section('\n', -1).trimmed();
+        emit sig_Output(output);
+    });
+    connect(mProcess, &QProcess::readyReadStandardOutput, this, &PushJob::readProgress);
+    connect(mProcess, &QProcess::started, this, &PushJob::onStarted);
+    connect(mProcess, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished), this, &PushJob::onFinished);
+    connect(mProcess, &QProcess::errorOccurred, this, &PushJob::onStartError);
+
+    if (mAdaptive)
+        mEncoder.restart(QDateTime::currentMSecsSinceEpoch());
+    QStringList args = buildArguments(mSpec, mEncoder.current());
+    emit sig_Output(QString("启动推流命令: ffmpeg %1").arg(args.join(" ")));
+    mStats.starts++;
+    setState(PushStarting);
+    mProcess->start("ffmpeg", args);
+}
+
+void PushJob::stop()
+{
+    mRetryTimer.stop();
+    if (mRunClock.isValid()) {
+        mStats.uptimeMs += mRunClock.elapsed();
+        mRunClock.invalidate();
+    }
+    mStats.runningSinceMs = 0;
+    killProcess();
+    mMetrics->setConnected(false);
+    setState(PushStopped);
+}
+
+void PushJob::fail(const QString &reason)
+{
+    mRetryTimer.stop();
+    killProcess();
+    mStats.lastError = reason;
+    setState(PushFailed);
+    emit sig_Failed(reason);
+}
+
+void PushJob::setState(PushState state)
+{
+    if (mState == state)
+        return;
+    mState = state;
+    emit sig_StateChanged(state);
+}
+
+// 断开信号后结束进程，不再触发重试。不在主线程里等待：进程退出后自行释放，超时仍未退出时强制结束
+void PushJob::killProcess()
+{
+    if (!mProcess)
+        return;
+    QProcess *process = mProcess;
+    mProcess = nullptr;
+    disconnect(process, nullptr, this, nullptr);
+    if (process->state() == QProcess::NotRunning) {
+        process->deleteLater();
+        return;
+    }
+    // 任务可能随即被删除，进程交给管理器，不随任务析构（析构 QProcess 会阻塞等待）
+    process->setParent(PushJobManager::instance());
+    connect(process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
+            process, &QObject::deleteLater);
+    const QString name = MetricsRegistry::displayName(mSpec.output);
+    QTimer::singleShot(kTerminateTimeoutMs, process, [process, name]() {
+        if (process->state() != QProcess::NotRunning) {
+            qWarning() << "FFmpeg 被强制终止" << name;
+            process->kill();        // 退出后由 finished 释放
+        } else {
+            process->deleteLater(); // 没启动起来，不会有 finished
+        }
+    });
+    // ffmpeg 从标准输入读到 q 时正常收尾（写文件尾、断开 RTSP）。Windows 上 terminate() 只发 WM_CLOSE，
+    // 控制台程序收不到；其他平台上 SIGTERM 同样会让它收尾
+    process->write("q");
+    process->terminate();
+}
+
+void PushJob::onStarted()
+{
+    mRunClock.start();
+    mStats.runningSinceMs = QDateTime::currentMSecsSinceEpoch();
+    mMetrics->onOpened();
+    setState(PushRunning);
+}
+
+void PushJob::onFinished(int code, QProcess::ExitStatus status)
+{
+    mStats.lastExitCode = code;
+    bool normal = code == 0 && status == QProcess::NormalExit;
+    handleExit(normal, mLastLine.isEmpty() ? QString("ffmpeg 退出码 %1").arg(code) : mLastLine);
+}
+
+// 启动失败时不会再有 finished 信号；运行中崩溃的情况由 finished 处理
+void PushJob::onStartError(QProcess::ProcessError error)
+{
+    if (error == QProcess::FailedToStart)
+        handleExit(false, QString("启动FFmpeg失败: %1").arg(mProcess->errorString()));
+}
+
+void PushJob::handleExit(bool normal, const QString &reason)
+{
+    qint64 ranMs = mRunClock.isValid() ? mRunClock.elapsed() : 0;
+    mStats.uptimeMs += ranMs;
+    mRunClock.invalidate();
+    mStats.runningSinceMs = 0;
+    mMetrics->setConnected(false);
+    disconnect(mProcess, nullptr, this, nullptr);
+    mProcess->deleteLater();
+    mProcess = nullptr;
+
+    if (normal) {
+        mStats.retries = 0;
+        setState(PushFinished);
+        return;
+    }
+
+    mStats.failures++;
+    mStats.lastError = reason;
+    mMetrics->onError();
+    if (ranMs >= mSpec.retry.stableMs)
+        mStats.retries = 0;   // 稳定运行过一段时间，重新计数
+    if (mSpec.retry.maxRetries >= 0 && mStats.retries >= mSpec.retry.maxRetries) {
+        fail("超过最大重试次数，停止推流");
+        return;
+    }
+    mStats.retries++;
+    mStats.totalRetries++;
+    mMetrics->onReconnect();
+    emit sig_Output(QString("第 %1 次重试...").arg(mStats.retries));
+    setState(PushRetrying);
+    mRetryTimer.start(mSpec.retry.delayFor(mStats.retries));
+}
+
+void PushJob::readProgress()
+{
+    mProgressBuffer += mProcess->readAllStandardOutput();
+    int start = 0;
+    int newline;
+    while ((newline = mProgressBuffer.indexOf('\n', start)) >= 0) {
+        const QByteArray line = mProgressBuffer.mid(start, newline - start).trimmed();
+        start = newline + 1;
+        int eq = line.indexOf('=');
+        if (eq <= 0)
+            continue;
+        const QByteArray key = line.left(eq);
+        const QByteArray value = line.mid(eq + 1).trimmed();
+        // 数值未知时 ffmpeg 输出 N/A，toDouble 失败得 0
+        if (key == "frame") {
+            mBlock.frame = value.toLongLong();
+        } else if (key == "fps") {
+            mBlock.fps = value.toDouble();
+        } else if (key == "bitrate") {
+            QByteArray number = value;
+            number.replace("kbits/s", "");
+            mBlock.bitrateBps = number.toDouble() * 1000;
+        } else if (key == "total_size") {
+            mBlock.totalBytes = value.toLongLong();
+        } else if (key == "out_time_us" || key == "out_time_ms") {
+            mBlock.outTimeMs = value.toLongLong() / 1000;   // 两个键的单位都是微秒
+        } else if (key == "dup_frames") {
+            mBlock.dupFrames = value.toLongLong();
+        } else if (key == "drop_frames") {
+            mBlock.dropFrames = value.toLongLong();
+        } else if (key == "speed") {
+            QByteArray number = value;
+            number.replace("x", "");
+            mBlock.speed = number.toDouble();
+        } else if (key.startsWith("stream_") && key.endsWith("_q")) {
+            mBlock.quality = value.toDouble();
+        } else if (key == "progress") {
+            mBlock.end = value == "end";
+            finishProgressBlock();
+        }
+    }
+    mProgressBuffer.remove(0, start);
+}
+
+// 一块进度结束：更新指标，按间隔限速发出
+void PushJob::finishProgressBlock()
+{
+    PushProgress p = mBlock;
+    mBlock = PushProgress();
+    p.timestampMs = QDateTime::currentMSecsSinceEpoch();
+    if (mRunClock.isValid())
+        p.lagMs = qMax(Q_INT64_C(0), mRunClock.elapsed() - p.outTimeMs);
+
+    qint64 bytes = qMax(Q_INT64_C(0), p.totalBytes - mCountedBytes);
+    qint64 frames = qMax(Q_INT64_C(0), p.frame - mCountedFrames);
+    qint64 drops = qMax(Q_INT64_C(0), p.dropFrames - mCountedDrops);
+    mMetrics->onProgress(quint64(bytes), quint64(frames), quint64(drops));
+    mCountedBytes = qMax(mCountedBytes, p.totalBytes);
+    mCountedFrames = qMax(mCountedFrames, p.frame);
+    mCountedDrops = qMax(mCountedDrops, p.dropFrames);
+
+    mProgress = p;
+    if (p.end || !mProgressClock.isValid() || mProgressClock.elapsed() >= mSpec.progressIntervalMs) {
+        mProgressClock.start();
+        emit sig_Progress(p);
+    }
+
+    if (mAdaptive && mState == PushRunning && !p.end) {
+        double cpu = PushJobManager::instance()->cpuLoad();
+        int level = mEncoder.update(p.timestampMs, p.outTimeMs, p.dropFrames, cpu);
+        if (level >= 0) {
+            emit sig_Output(QString("编码档位切换到 %1: %2（速度 %3，CPU %4%）")
+                            .arg(level).arg(mEncoder.current().toText())
+                            .arg(mEncoder.speed(), 0, 'f', 2).arg(cpu * 100, 0, 'f', 0));
+            emit sig_EncoderLevelChanged(level);
+            // 不在进程的信号里重启它
+            QMetaObject::invokeMethod(this, [this]() { switchEncoderLevel(); }, Qt::QueuedConnection);
+        }
+    }
+}
+
+// ffmpeg 命令行不能在运行中改编码参数，按新档位重启进程；新进程从关键帧开始，不计入重试
+void PushJob::switchEncoderLevel()
+{
+    if (mState != PushRunning)
+        return;
+    if (mRunClock.isValid()) {
+        mStats.uptimeMs += mRunClock.elapsed();
+        mRunClock.invalidate();
+    }
+    mStats.runningSinceMs = 0;
+    launch();
+}
+
+QString PushProgress::toText() const
+{
+    QString text = QString("%1 fps %2 kbit/s %3x drop %4 dup %5 lag %6 ms")
+            .arg(fps, 0, 'f', 1)
+            .arg(bitrateBps / 1000, 0, 'f', 0)
+            .arg(speed, 0, 'f', 2)
+            .arg(dropFrames)
+            .arg(dupFrames)
+            .arg(lagMs);
+    if (quality >= 0)
+        text += QString(" q %1").arg(quality, 0, 'f', 1);
+    return text;
+}
+
+PushJobManager *PushJobManager::instance()
+{
+    // 挂在 QCoreApplication 下，程序退出时随之析构并结束所有 ffmpeg 进程
+    static PushJobManager *manager = new PushJobManager(QCoreApplication::instance());
+    return manager;
+}
+
+PushJobManager::PushJobManager(QObject *parent)
+    : QObject(parent), mScheduling(false), mReschedule(false), mCpuLoad(-1)
+{
+    mBudget.cpuCores = QThread::idealThreadCount();
+    connect(&mCpuTimer, &QTimer::timeout, this, [this]() { mCpuLoad = mCpu.sample(); });
+}
+
+void PushJobManager::setBudget(const PushBudget &budget)
+{
+    mBudget = budget;
+    schedule();
+}
+
+PushBudget PushJobManager::budget() const
+{
+    return mBudget;
+}
+
+void PushJobManager::configureFromEnvironment()
+{
+    PushBudget budget = mBudget;
+    if (!qEnvironmentVariableIsEmpty("VP_PUSH_CPU"))
+        budget.cpuCores = qMax(0.0, qgetenv("VP_PUSH_CPU").toDouble());
+    if (!qEnvironmentVariableIsEmpty("VP_PUSH_BANDWIDTH"))
+        budget.bandwidthBps = qMax(Q_INT64_C(0), qgetenv("VP_PUSH_BANDWIDTH").toLongLong());
+    setBudget(budget);
+}
+
+PushJob *PushJobManager::submit(const PushJobSpec &spec)
+{
+    PushJob *job = new PushJob(spec, this);
+    remove(job->id());
+    connect(job, &PushJob::sig_StateChanged, this, [this, job](PushState state) {
+        emit sig_JobStateChanged(job->id(), state);
+        if (!job->isActive())
+            schedule();   // 释放了预算
+    });
+    mJobs.append(job);
+    // 推迟到事件循环里启动，调用方先连好信号
+    QMetaObject::invokeMethod(this, [this]() { schedule(); }, Qt::QueuedConnection);
+    return job;
+}
+
+void PushJobManager::remove(const QString &id)
+{
+    PushJob *target = job(id);
+    if (!target)
+        return;
+    mJobs.removeOne(target);
+    target->stop();
+    target->deleteLater();
+}
+
+void PushJobManager::removeAll()
+{
+    const QList<PushJob *> all = mJobs;
+    for (PushJob *job : all)
+        remove(job->id());
+}
+
+void PushJobManager::waitForStopped()
+{
+    // 停止中的进程都挂在管理器下（见 PushJob::killProcess），退出后才会释放
+    QElapsedTimer clock;
+    clock.start();
+    const QList<QProcess *> stopping = findChildren<QProcess *>(QString(), Qt::FindDirectChildrenOnly);
+    for (QProcess *process : stopping) {
+        const int left = qMax(0, kTerminateTimeoutMs - int(clock.elapsed()));
+        if (process->state() != QProcess::NotRunning && !process->waitForFinished(left)) {
+            qWarning() << "FFmpeg 被强制终止";
+            process->kill();
+            process->waitForFinished(1000);
+        }
+    }
+}
+
+PushJob *PushJobManager::job(const QString &id) const
+{
+    for (PushJob *job : mJobs) {
+        if (job->id() == id)
+            return job;
+    }
+    return nullptr;
+}
+
+QList<PushJob *> PushJobManager::jobs() const
+{
+    return mJobs;
+}
+
+// 启动中、运行中和等待重试的任务都占着预算
+static bool holdsBudget(const PushJob *job)
+{
+    return job->state() == PushStarting || job->state() == PushRunning || job->state() == PushRetrying;
+}
+
+double PushJobManager::cpuInUse() const
+{
+    double total = 0;
+    for (const PushJob *job : mJobs) {
+        if (holdsBudget(job))
+            total += job->cpuCost();
+    }
+    return total;
+}
+
+qint64 PushJobManager::bandwidthInUse() const
+{
+    qint64 total = 0;
+    for (const PushJob *job : mJobs) {
+        if (holdsBudget(job))
+            total += job->bitrateBps();
+    }
+    return total;
+}
+
+bool PushJobManager::fits(const PushJob *job) const
+{
+    if (mBudget.cpuCores > 0 && cpuInUse() + job->cpuCost() > mBudget.cpuCores + 1e-9)
+        return false;
+    if (mBudget.bandwidthBps > 0 && bandwidthInUse() + job->bitrateBps() > mBudget.bandwidthBps)
+        return false;
+    return true;
+}
+
+bool PushJobManager::fitsAlone(const PushJob *job) const
+{
+    if (mBudget.cpuCores > 0 && job->cpuCost() > mBudget.cpuCores + 1e-9)
+        return false;
+    if (mBudget.bandwidthBps > 0 && job->bitrateBps() > mBudget.bandwidthBps)
+        return false;
+    return true;
+}
+
+// 按提交顺序启动排队的任务，放不下的跳过，后面占用小的仍可启动
+void PushJobManager::schedule()
+{
+    if (mScheduling) {
+        mReschedule = true;   // 状态变化信号里又触发了调度，当前这轮结束后再来一遍
+        return;
+    }
+    mScheduling = true;
+    do {
+        mReschedule = false;
+        const QList<PushJob *> pending = mJobs;
+        for (PushJob *job : pending) {
+            if (job->state() != PushQueued)
+                continue;
+            if (!fitsAlone(job))
+                job->fail("推流占用超出全局预算");
+            else if (fits(job))
+                job->launch();
+        }
+    } while (mReschedule);
+    mScheduling = false;
+    updateCpuSampling();
+}
+
+// 只在有自适应编码的任务时采样 CPU
+void PushJobManager::updateCpuSampling()
+{
+    bool needed = false;
+    for (const PushJob *job : mJobs)
+        needed = needed || (job->isAdaptive() && job->isActive());
+    if (needed && !mCpuTimer.isActive()) {
+        mCpu.sample();
+        mCpuLoad = -1;
+        mCpuTimer.start(1000);
+    } else if (!needed && mCpuTimer.isActive()) {
+        mCpuTimer.stop();
+        mCpuLoad = -1;
+    }
+}
+
+double PushJobManager::cpuLoad() const
+{
+    return mCpuLoad;
+}
+
+QJsonObject PushJobManager::toJson() const
+{
+    QJsonObject budget;
+    budget["cpu"] = mBudget.cpuCores;
+    budget["bandwidth_bps"] = double(mBudget.bandwidthBps);
+    QJsonArray jobs;
+    for (const PushJob *job : mJobs)
+        jobs.append(job->toJson());
+
+    QJsonObject root;
+    root["budget"] = budget;
+    root["cpu_in_use"] = cpuInUse();
+    root["bandwidth_in_use_bps"] = double(bandwidthInUse());
+    if (mCpuLoad >= 0)
+        root["cpu_load"] = mCpuLoad;
+    root["jobs"] = jobs;
+    return root;
+}
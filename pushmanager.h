@@ -0,0 +1,233 @@
+#ifndef PUSHMANAGER_H
+#define PUSHMANAGER_H
+
+#include <QObject>
+#include <QProcess>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QSharedPointer>
+#include <QJsonObject>
+#include <QList>
+#include <QVector>
+#include <QMetaType>
+
+#include "adaptiveencoder.h"
+
+class StreamMetrics;
+
+// 推流任务的状态
+enum PushState {
+    PushQueued = 0,   // 等待预算（CPU/带宽）
+    PushStarting,     // 进程已创建，还没起来
+    PushRunning,
+    PushRetrying,     // 异常退出，等待重试
+    PushFinished,     // 输入结束，进程正常退出
+    PushFailed,       // 重试用尽或超出预算
+    PushStopped       // 手动停止
+};
+
+const char *pushStateName(PushState state);
+
+// 按输入地址区分的推流方式
+enum PushInputKind {
+    PushInputNetwork = 0,   // 网络流，不转码
+    PushInputCamera,        // 摄像头，libx264 编码
+    PushInputFile           // 本地文件循环推送，不转码
+};
+
+// 重试策略：第 n 次重试前等待 min(delayMs * backoff^(n-1), maxDelayMs)
+struct PushRetryPolicy {
+    int maxRetries = 3;         // <0 表示一直重试
+    int delayMs = 3000;
+    int maxDelayMs = 60000;
+    double backoff = 2.0;
+    int stableMs = 30000;       // 一次运行超过这么久后重试计数清零
+
+    int delayFor(int attempt) const;
+};
+
+// 同播的一路输出
+struct PushRendition {
+    QString output;
+    int height = 0;             // 输出高度，0 为原始分辨率（只缩小不放大）
+    int fps = 30;
+    qint64 bitrateBps = 2000000;
+    QString preset = "veryfast";
+    int threads = 0;            // 编码线程数，0 表示按各路像素率分配本机核数
+};
+
+// "0:30:2000,360:15:500"（高度:帧率:kbit/s）：第一路推到 baseOutput，其余推到 baseOutput_<高度>p
+QVector<PushRendition> parseRenditions(const QString &text, const QString &baseOutput);
+
+struct PushJobSpec {
+    QString id;                 // 为空时用输出地址
+    QString input;
+    QString output;             // 同播时可为空（取第一路的地址）
+    QVector<PushRendition> renditions;   // 非空时为同播：输入只采集/解码一次，缩放成多路分别编码推送
+    PushRetryPolicy retry;
+    double cpuCost = -1;        // 占用的 CPU（核），<0 按输入类型估计
+    qint64 bitrateBps = -1;     // 占用的上行带宽，<0 按输入类型估计
+    int progressIntervalMs = 1000;   // sig_Progress 的最小间隔
+    QString ffreport;           // 非空时作为 FFREPORT 环境变量写 ffmpeg 日志，如 "file=push.log:level=32"
+    bool adaptive = true;       // 摄像头编码推流按速度和 CPU 负载自动升降编码档位（同播时不用）
+    int startLevel = 0;         // 起始档位，见 AdaptiveEncoder::defaultLadder()
+    int maxLevel = -1;          // 最多降到的档位，<0 为档位表末尾
+    // 低延迟编码：周期帧内刷新代替关键帧、切片多线程、VBV 限制为单帧、无 B 帧。
+    // 只对编码的推流生效（摄像头和同播），转推不转码时不变
+    bool lowLatency = false;
+};
+
+// ffmpeg -progress 输出的一块进度（ffmpeg 约每 0.5 秒输出一块）
+struct PushProgress {
+    qint64 timestampMs = 0;     // 收到时的墙钟时间
+    qint64 frame = 0;           // 已输出帧数
+    double fps = 0;
+    double bitrateBps = 0;      // ffmpeg 估计的输出码率，未知时为 0
+    qint64 totalBytes = 0;      // 已输出字节，未知时为 0
+    qint64 outTimeMs = 0;       // 已输出的媒体时长
+    qint64 dupFrames = 0;
+    qint64 dropFrames = 0;
+    double speed = 0;           // 相对实时的速度，1.0 为实时
+    double quality = -1;        // 编码器量化参数，转推不编码时为 -1
+    qint64 lagMs = 0;           // 本次运行的墙钟时长减去已输出时长，持续变大说明编码/发送跟不上
+    bool end = false;           // progress=end，ffmpeg 即将退出
+
+    QString toText() const;
+};
+Q_DECLARE_METATYPE(PushProgress)
+
+struct PushJobStats {
+    int starts = 0;             // 启动进程的次数
+    int retries = 0;            // 当前连续重试次数
+    int totalRetries = 0;
+    int failures = 0;           // 异常退出次数
+    qint64 uptimeMs = 0;        // 累计运行时间（含当前这次）
+    qint64 runningSinceMs = 0;  // 当前这次进入运行的时刻（墙钟），未运行时为 0
+    int lastExitCode = 0;
+    QString lastError;
+};
+
+// 全局推流预算，0 表示不限制
+struct PushBudget {
+    double cpuCores = 0;
+    qint64 bandwidthBps = 0;
+};
+
+// 一路推流：一个 ffmpeg 进程，自己的状态机、重试和统计。由 PushJobManager 创建和启动。
+class PushJob : public QObject
+{
+    Q_OBJECT
+
+public:
+    ~PushJob();
+
+    QString id() const;
+    const PushJobSpec &spec() const;
+    PushState state() const;
+    bool isActive() const;          // 排队、启动、运行或等待重试
+    PushJobStats stats() const;
+    PushProgress progress() const;  // 最近一块进度（不受限速影响）
+    double cpuCost() const;         // 生效的估计值
+    qint64 bitrateBps() const;
+    QJsonObject toJson() const;
+    bool isAdaptive() const;
+    const EncoderLevel &encoderLevel() const;   // 当前编码档位（只对摄像头编码有意义）
+
+    static PushInputKind inputKind(const QString &input);
+    static QStringList buildArguments(const PushJobSpec &spec, const EncoderLevel &level);
+    static QString simulcastFilter(const QVector<PushRendition> &renditions);   // 同播的 filter_complex
+
+signals:
+    void sig_StateChanged(PushState state);
+    void sig_Output(const QString &text);     // ffmpeg 的日志输出（标准错误）
+    void sig_Progress(const PushProgress &progress);   // 结构化进度，间隔不小于 progressIntervalMs
+    void sig_Failed(const QString &reason);   // 重试用尽或无法排入预算
+    void sig_EncoderLevelChanged(int level);  // 自动切换了编码档位，ffmpeg 随即重启
+
+private:
+    friend class PushJobManager;
+    PushJob(const PushJobSpec &spec, QObject *parent);
+
+    static QStringList simulcastArguments(const PushJobSpec &spec);
+
+    void launch();                  // 预算已预留，启动进程
+    void stop();                    // 结束进程，进入 PushStopped
+    void fail(const QString &reason);
+    void setState(PushState state);
+    void killProcess();
+    void onStarted();
+    void onFinished(int code, QProcess::ExitStatus status);
+    void onStartError(QProcess::ProcessError error);
+    void handleExit(bool normal, const QString &reason);
+    void readProgress();
+    void finishProgressBlock();
+    void switchEncoderLevel();
+
+    PushJobSpec mSpec;
+    PushState mState;
+    PushJobStats mStats;
+    double mCpuCost;
+    qint64 mBitrateBps;
+    QProcess *mProcess;
+    QTimer mRetryTimer;
+    QElapsedTimer mRunClock;        // 当前这次运行的时长
+    QString mLastLine;              // 最近一行日志，异常退出时作为原因
+    QByteArray mProgressBuffer;     // 标准输出里未满一行的部分
+    PushProgress mBlock;            // 正在解析的进度块
+    PushProgress mProgress;
+    QElapsedTimer mProgressClock;   // 距上次发出 sig_Progress
+    qint64 mCountedBytes;           // 已计入指标的字节/帧/丢帧，每次启动进程时清零
+    qint64 mCountedFrames;
+    qint64 mCountedDrops;
+    bool mAdaptive;
+    AdaptiveEncoder mEncoder;
+    QSharedPointer<StreamMetrics> mMetrics;
+};
+
+// 管理进程内所有推流任务：多路同时运行、互不影响；按提交顺序在预算允许时启动，
+// 超出预算的任务排队，有任务结束后再启动。只在主线程使用。
+class PushJobManager : public QObject
+{
+    Q_OBJECT
+
+public:
+    static PushJobManager *instance();
+
+    void setBudget(const PushBudget &budget);
+    PushBudget budget() const;
+    void configureFromEnvironment();   // VP_PUSH_CPU（核）、VP_PUSH_BANDWIDTH（bit/s）
+
+    // 提交并按预算启动；同 id 的任务先停止再替换
+    PushJob *submit(const PushJobSpec &spec);
+    void remove(const QString &id);    // 停止并删除
+    void removeAll();
+    // 程序退出前调用：停止是异步的，这里等还在收尾的 ffmpeg 退出，超时的强制结束。会阻塞
+    void waitForStopped();
+
+    PushJob *job(const QString &id) const;
+    QList<PushJob *> jobs() const;
+    double cpuInUse() const;
+    qint64 bandwidthInUse() const;
+    double cpuLoad() const;            // 整机 CPU 占用（0~1），有自适应编码的任务运行时每秒采样，未知时 <0
+    QJsonObject toJson() const;
+
+signals:
+    void sig_JobStateChanged(const QString &id, PushState state);
+
+private:
+    explicit PushJobManager(QObject *parent);
+    void schedule();
+    bool fits(const PushJob *job) const;
+    bool fitsAlone(const PushJob *job) const;
+    void updateCpuSampling();
+
+    PushBudget mBudget;       // 默认 CPU 按核数，带宽不限
+    QList<PushJob *> mJobs;   // 提交顺序
+    bool mScheduling;
+    bool mReschedule;
+    SystemCpuLoad mCpu;
+    QTimer mCpuTimer;
+    double mCpuLoad;
+};
+
+#endif // PUSHMANAGER_H
@@ -0,0 +1,414 @@
+#include "sharedframe.h"
+#include "perfstats.h"
+
+#include <QDateTime>
+#include <QCoreApplication>
+#include <QImage>
+#include <QDebug>
+
+#include <cerrno>
+#include <cstring>
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+extern "C" {
+    #include <libavutil/imgutils.h>
+}
+
+static quint64 alignUp(quint64 value)
+{
+    return (value + 63) & ~quint64(63);
+}
+
+static SharedFrameSlot *slotAt(const SharedFrameHeader *header, quint64 index)
+{
+    const char *base = reinterpret_cast<const char *>(header) + header->headerSize;
+    return reinterpret_cast<SharedFrameSlot *>(const_cast<char *>(base + index * header->slotSize));
+}
+
+// ---- 平台相关的映射 ----
+
+static void *mapSegment(const QString &name, quint64 size, bool create, quint64 *mappedSize,
+                        void **handle, QString *error)
+{
+#ifdef Q_OS_WIN
+    std::wstring wname = name.toStdWString();
+    HANDLE mapping;
+    if (create) {
+        mapping = CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+                                     DWORD(size >> 32), DWORD(size & 0xffffffff), wname.c_str());
+        if (mapping && GetLastError() == ERROR_ALREADY_EXISTS) {
+            // 旧的映射还被读端打开着，大小不能改，等读端关掉后再建
+            CloseHandle(mapping);
+            *error = "Shared memory still in use by readers";
+            return nullptr;
+        }
+    } else {
+        mapping = OpenFileMappingW(FILE_MAP_READ, FALSE, wname.c_str());
+    }
+    if (!mapping) {
+        *error = QString("Shared memory %1 failed (error %2)").arg(name).arg(GetLastError());
+        return nullptr;
+    }
+    void *view = MapViewOfFile(mapping, create ? FILE_MAP_ALL_ACCESS : FILE_MAP_READ, 0, 0, 0);
+    if (!view) {
+        *error = QString("MapViewOfFile failed (error %1)").arg(GetLastError());
+        CloseHandle(mapping);
+        return nullptr;
+    }
+    MEMORY_BASIC_INFORMATION info;
+    VirtualQuery(view, &info, sizeof(info));
+    *mappedSize = create ? size : quint64(info.RegionSize);
+    *handle = mapping;
+    return view;
+#else
+    QByteArray path = name.toLocal8Bit();
+    int fd;
+    if (create) {
+        shm_unlink(path.constData());   // 上次异常退出留下的
+        fd = shm_open(path.constData(), O_CREAT | O_EXCL | O_RDWR, 0660);
+        if (fd >= 0 && ftruncate(fd, off_t(size)) < 0) {
+            ::close(fd);
+            shm_unlink(path.constData());
+            fd = -1;
+        }
+    } else {
+        fd = shm_open(path.constData(), O_RDONLY, 0);
+        struct stat st;
+        if (fd >= 0 && fstat(fd, &st) == 0)
+            size = quint64(st.st_size);
+    }
+    if (fd < 0) {
+        *error = QString("Shared memory %1 failed: %2").arg(name, QString::fromLocal8Bit(strerror(errno)));
+        return nullptr;
+    }
+    void *view = mmap(nullptr, size_t(size), create ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (view == MAP_FAILED) {
+        *error = QString("mmap failed: %1").arg(QString::fromLocal8Bit(strerror(errno)));
+        if (create)
+            shm_unlink(path.constData());
+        return nullptr;
+    }
+    *mappedSize = size;
+    *handle = nullptr;
+    return view;
+#endif
+}
+
+static void unmapSegment(const QString &name, const void *view, quint64 size, void *handle, bool unlink)
+{
+#ifdef Q_OS_WIN
+    Q_UNUSED(name);
+    Q_UNUSED(size);
+    Q_UNUSED(unlink);
+    UnmapViewOfFile(view);
+    CloseHandle(handle);
+#else
+    Q_UNUSED(handle);
+    munmap(const_cast<void *>(view), size_t(size));
+    if (unlink)
+        shm_unlink(name.toLocal8Bit().constData());
+#endif
+}
+
+// ---- SharedFrameWriter ----
+
+SharedFrameWriter::SharedFrameWriter()
+    : mSlotSize(0), mLastPublishNs(0), mRetryNs(0), mHeader(nullptr), mMapSize(0),
+      mHandle(nullptr), mSws(nullptr)
+{
+    mConfig.format = SharedFrameYuv420p;
+    mConfig.intervalNs = 0;
+    mConfig.slotCount = 4;
+    mOpened = mConfig;
+}
+
+SharedFrameWriter::~SharedFrameWriter()
+{
+    close();
+    sws_freeContext(mSws);
+}
+
+QString SharedFrameWriter::systemName(const QString &name)
+{
+    QString safe;
+    for (QChar c : name)
+        safe += (c.isLetterOrNumber() || c == '-' || c == '_') ? c : QChar('_');
+#ifdef Q_OS_WIN
+    return "Local\\vp_" + safe;
+#else
+    return "/vp_" + safe;
+#endif
+}
+
+void SharedFrameWriter::setName(const QString &name)
+{
+    QMutexLocker locker(&mMutex);
+    mConfig.name = name;
+}
+
+QString SharedFrameWriter::name() const
+{
+    QMutexLocker locker(&mMutex);
+    return mConfig.name;
+}
+
+void SharedFrameWriter::setFormat(SharedFrameFormat format)
+{
+    QMutexLocker locker(&mMutex);
+    mConfig.format = format;
+}
+
+void SharedFrameWriter::setMaxFps(double fps)
+{
+    QMutexLocker locker(&mMutex);
+    mConfig.intervalNs = fps > 0 ? qint64(1e9 / fps) : 0;
+}
+
+void SharedFrameWriter::setSlotCount(int count)
+{
+    QMutexLocker locker(&mMutex);
+    mConfig.slotCount = qBound(2, count, 64);
+}
+
+bool SharedFrameWriter::open(const Config &cfg, quint64 slotSize)
+{
+    const quint64 headerSize = alignUp(sizeof(SharedFrameHeader));
+    const quint64 size = headerSize + slotSize * quint64(cfg.slotCount);
+    const QString name = systemName(cfg.name);
+    QString error;
+    void *view = mapSegment(name, size, true, &mMapSize, &mHandle, &error);
+    if (!view) {
+        qWarning() << "Frame export:" << error;
+        return false;
+    }
+
+    // 新建的共享内存全是 0，只需填头部
+    mHeader = static_cast<SharedFrameHeader *>(view);
+    mHeader->magic = kSharedFrameMagic;
+    mHeader->version = kSharedFrameVersion;
+    mHeader->headerSize = quint32(headerSize);
+    mHeader->slotCount = quint32(cfg.slotCount);
+    mHeader->slotSize = slotSize;
+    mHeader->writerPid = quint32(QCoreApplication::applicationPid());
+    mHeader->published.store(0, std::memory_order_release);
+    mOpened = cfg;
+    mSlotSize = slotSize;
+    qDebug() << "Frame export:" << name << cfg.slotCount << "slots of" << slotSize << "bytes";
+    return true;
+}
+
+void SharedFrameWriter::close()
+{
+    if (!mHeader)
+        return;
+    // 先标记作废，已经映射的读端看到后重新打开
+    mHeader->closed.store(1, std::memory_order_release);
+    unmapSegment(systemName(mOpened.name), mHeader, mMapSize, mHandle, true);
+    mHeader = nullptr;
+    mHandle = nullptr;
+    mMapSize = 0;
+    mSlotSize = 0;
+}
+
+bool SharedFrameWriter::fillSlot(SharedFrameSlot *slot, uint8_t *data, const AVFrame *frame,
+                                 SharedFrameFormat format)
+{
+    const int w = frame->width;
+    const int h = frame->height;
+    if (format == SharedFrameRgb32) {
+        // 直接让转换器写进共享内存（QImage 只包一层，不分配）
+        QImage image(data, w, h, w * 4, QImage::Format_RGB32);
+        slot->planeCount = 1;
+        slot->stride[0] = quint32(w * 4);
+        slot->offset[0] = 0;
+        slot->dataSize = quint32(w * 4 * h);
+        return mRgb.convert(frame, &image);
+    }
+
+    const int cw = (w + 1) / 2;
+    const int ch = (h + 1) / 2;
+    uint8_t *planes[4] = { data, data + w * h, data + w * h + cw * ch, nullptr };
+    int strides[4] = { w, cw, cw, 0 };
+    slot->planeCount = 3;
+    for (int i = 0; i < 3; i++) {
+        slot->stride[i] = quint32(strides[i]);
+        slot->offset[i] = quint32(planes[i] - data);
+    }
+    slot->dataSize = quint32(w * h + 2 * cw * ch);
+
+    if (frame->format == AV_PIX_FMT_YUV420P || frame->format == AV_PIX_FMT_YUVJ420P) {
+        av_image_copy_plane(planes[0], strides[0], frame->data[0], frame->linesize[0], w, h);
+        av_image_copy_plane(planes[1], strides[1], frame->data[1], frame->linesize[1], cw, ch);
+        av_image_copy_plane(planes[2], strides[2], frame->data[2], frame->linesize[2], cw, ch);
+        return true;
+    }
+    // 其他格式（NV12、4:2:2 等）只做格式转换，不缩放
+    mSws = sws_getCachedContext(mSws, w, h, AVPixelFormat(frame->format), w, h, AV_PIX_FMT_YUV420P,
+                                SWS_BILINEAR, nullptr, nullptr, nullptr);
+    if (!mSws)
+        return false;
+    return sws_scale(mSws, frame->data, frame->linesize, 0, h, planes, strides) > 0;
+}
+
+bool SharedFrameWriter::publish(const AVFrame *frame, qint64 ptsMs)
+{
+    Config cfg;
+    {
+        QMutexLocker locker(&mMutex);
+        cfg = mConfig;
+    }
+    if (cfg.name.isEmpty()) {
+        close();
+        return false;
+    }
+    qint64 now = perfNowNs();
+    if (mLastPublishNs && now - mLastPublishNs < cfg.intervalNs)
+        return false;
+    if (frame->width <= 0 || frame->height <= 0)
+        return false;
+
+    // 分辨率、格式、槽数变了就重建（读端会看到 closed 后重新打开）
+    quint64 dataSize = cfg.format == SharedFrameRgb32
+            ? quint64(frame->width) * frame->height * 4
+            : quint64(frame->width) * frame->height + 2 * quint64((frame->width + 1) / 2) * ((frame->height + 1) / 2);
+    quint64 slotSize = alignUp(sizeof(SharedFrameSlot) + dataSize);
+    if (!mHeader || slotSize != mSlotSize || cfg.name != mOpened.name
+            || cfg.format != mOpened.format || cfg.slotCount != mOpened.slotCount) {
+        if (mRetryNs && now < mRetryNs)
+            return false;
+        close();
+        if (!open(cfg, slotSize)) {
+            mRetryNs = now + qint64(1000) * 1000000;
+            return false;
+        }
+        mRetryNs = 0;
+    }
+    mLastPublishNs = now;
+
+    // seqlock：先把 sequence 改成奇数，写完槽头和像素后再改成偶数
+    quint64 number = mHeader->published.load(std::memory_order_relaxed) + 1;
+    SharedFrameSlot *slot = slotAt(mHeader, (number - 1) % mHeader->slotCount);
+    quint64 seq = slot->sequence.load(std::memory_order_relaxed);
+    slot->sequence.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot->frameNumber = number;
+    slot->ptsMs = ptsMs;
+    slot->wallTimeUs = QDateTime::currentMSecsSinceEpoch() * 1000;
+    slot->format = quint32(cfg.format);
+    slot->width = quint32(frame->width);
+    slot->height = quint32(frame->height);
+    uint8_t *data = reinterpret_cast<uint8_t *>(slot) + sizeof(SharedFrameSlot);
+    bool ok = fillSlot(slot, data, frame, cfg.format);
+
+    slot->sequence.store(seq + 2, std::memory_order_release);
+    if (ok)
+        mHeader->published.store(number, std::memory_order_release);
+    return ok;
+}
+
+// ---- SharedFrameReader ----
+
+SharedFrameReader::SharedFrameReader()
+    : mHeader(nullptr), mMapSize(0), mHandle(nullptr)
+{
+}
+
+SharedFrameReader::~SharedFrameReader()
+{
+    close();
+}
+
+bool SharedFrameReader::open(const QString &name, QString *error)
+{
+    close();
+    QString systemName = SharedFrameWriter::systemName(name);
+    const void *view = mapSegment(systemName, 0, false, &mMapSize, &mHandle, error);
+    if (!view)
+        return false;
+
+    const SharedFrameHeader *header = static_cast<const SharedFrameHeader *>(view);
+    if (mMapSize < sizeof(SharedFrameHeader) || header->magic != kSharedFrameMagic
+            || header->version != kSharedFrameVersion
+            || header->slotSize < sizeof(SharedFrameSlot)
+            || header->headerSize + header->slotSize * header->slotCount > mMapSize) {
+        *error = "Not a frame export segment or unsupported version";
+        unmapSegment(systemName, view, mMapSize, mHandle, false);
+        mHandle = nullptr;
+        mMapSize = 0;
+        return false;
+    }
+    mHeader = header;
+    return true;
+}
+
+void SharedFrameReader::close()
+{
+    if (!mHeader)
+        return;
+    unmapSegment(QString(), mHeader, mMapSize, mHandle, false);
+    mHeader = nullptr;
+    mHandle = nullptr;
+    mMapSize = 0;
+}
+
+bool SharedFrameReader::isOpen() const
+{
+    return mHeader != nullptr;
+}
+
+bool SharedFrameReader::isClosedByWriter() const
+{
+    return mHeader && mHeader->closed.load(std::memory_order_acquire) != 0;
+}
+
+quint64 SharedFrameReader::published() const
+{
+    return mHeader ? mHeader->published.load(std::memory_order_acquire) : 0;
+}
+
+bool SharedFrameReader::readLatest(SharedFrameInfo *info, QByteArray *pixels, quint64 afterFrame) const
+{
+    if (!mHeader)
+        return false;
+    const quint64 capacity = mHeader->slotSize - sizeof(SharedFrameSlot);
+    // 写端正好在写这个槽时重试几次（写端领先整整一圈才会发生，一般是读端处理太慢）
+    for (int attempt = 0; attempt < 4; attempt++) {
+        quint64 number = mHeader->published.load(std::memory_order_acquire);
+        if (number == 0 || number <= afterFrame)
+            return false;
+        const SharedFrameSlot *slot = slotAt(mHeader, (number - 1) % mHeader->slotCount);
+        quint64 seq = slot->sequence.load(std::memory_order_acquire);
+        if (seq & 1)
+            continue;
+
+        info->frameNumber = slot->frameNumber;
+        info->ptsMs = slot->ptsMs;
+        info->wallTimeUs = slot->wallTimeUs;
+        info->format = SharedFrameFormat(slot->format);
+        info->width = int(slot->width);
+        info->height = int(slot->height);
+        info->planeCount = int(qMin<quint32>(slot->planeCount, 3));
+        for (int i = 0; i < 3; i++) {
+            info->stride[i] = int(slot->stride[i]);
+            info->offset[i] = int(slot->offset[i]);
+        }
+        quint64 size = qMin<quint64>(slot->dataSize, capacity);
+        pixels->resize(int(size));
+        memcpy(pixels->data(), reinterpret_cast<const char *>(slot) + sizeof(SharedFrameSlot), size_t(size));
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot->sequence.load(std::memory_order_relaxed) == seq && info->frameNumber > afterFrame)
+            return true;
+    }
+    return false;
+}
@@ -0,0 +1,143 @@
+#ifndef SHAREDFRAME_H
+#define SHAREDFRAME_H
+
+#include <QMutex>
+#include <QString>
+#include <QByteArray>
+
+#include <atomic>
+
+#include "frameconverter.h"
+
+extern "C" {
+    #include <libavutil/frame.h>
+    #include <libswscale/swscale.h>
+}
+
+// 解码后的帧导出到共享内存环形缓冲，本机的分析进程直接映射读取，不用再拉一遍流。
+//
+// 布局（小端，所有结构 64 字节对齐）：
+//   SharedFrameHeader | 槽 0 | 槽 1 | ... ，槽 i 在 headerSize + i * slotSize
+//   每个槽 = SharedFrameSlot 槽头 + 像素数据（各平面按 offset/stride 排列）
+// 单写多读，槽头用 seqlock：写前 sequence 变奇数，写完变偶数；读端读前后 sequence 相同且为偶数才算读到完整的一帧。
+// 写端退出或换了分辨率/格式时把 closed 置 1 并重建，读端看到后应重新打开。
+//
+// 共享内存名：Linux/macOS 为 shm_open("/vp_<name>")，Windows 为 "Local\vp_<name>" 的文件映射。
+
+enum SharedFrameFormat {
+    SharedFrameYuv420p = 0,   // 三个平面 Y/U/V
+    SharedFrameRgb32 = 1      // 一个平面，每像素 4 字节，内存顺序 B,G,R,0xff（同 QImage::Format_RGB32）
+};
+
+static const quint32 kSharedFrameMagic = 0x31465056;   // "VPF1"
+static const quint32 kSharedFrameVersion = 1;
+
+struct alignas(64) SharedFrameHeader {
+    quint32 magic;
+    quint32 version;
+    quint32 headerSize;                 // sizeof(SharedFrameHeader)
+    quint32 slotCount;
+    quint64 slotSize;                   // 每个槽的字节数（槽头 + 像素）
+    std::atomic<quint64> published;     // 已发布的帧数，最新一帧在槽 (published - 1) % slotCount
+    std::atomic<quint32> closed;        // 1 表示这块共享内存已作废
+    quint32 writerPid;
+};
+
+struct alignas(64) SharedFrameSlot {
+    std::atomic<quint64> sequence;      // seqlock 计数，奇数表示正在写
+    quint64 frameNumber;                // 从 1 开始，与 published 对应
+    qint64 ptsMs;                       // 流时间（毫秒），未知时为 INT64_MIN
+    qint64 wallTimeUs;                  // 写入时刻（Unix 时间，微秒）
+    quint32 format;                     // SharedFrameFormat
+    quint32 width;
+    quint32 height;
+    quint32 planeCount;
+    quint32 stride[3];
+    quint32 offset[3];                  // 相对槽头结尾
+    quint32 dataSize;
+};
+
+// 读端拷贝出来的一帧信息（与槽头相同，但可以拷贝）
+struct SharedFrameInfo {
+    quint64 frameNumber = 0;
+    qint64 ptsMs = 0;
+    qint64 wallTimeUs = 0;
+    SharedFrameFormat format = SharedFrameYuv420p;
+    int width = 0;
+    int height = 0;
+    int planeCount = 0;
+    int stride[3] = { 0, 0, 0 };
+    int offset[3] = { 0, 0, 0 };     // 相对拷贝出来的像素数据开头
+};
+
+// 写端：只在解码线程调用 publish/close；设置可在任意线程调用，下一帧生效
+class SharedFrameWriter
+{
+public:
+    SharedFrameWriter();
+    ~SharedFrameWriter();
+
+    void setName(const QString &name);       // 为空（默认）时不导出
+    QString name() const;
+    void setFormat(SharedFrameFormat format);   // 默认 YUV420P
+    void setMaxFps(double fps);              // 0（默认）表示每帧都导出
+    void setSlotCount(int count);            // 默认 4，读端处理慢时可加大
+
+    // 按需创建/重建共享内存并写入一帧，没到导出时刻时立即返回 false
+    bool publish(const AVFrame *frame, qint64 ptsMs);
+    void close();
+
+    static QString systemName(const QString &name);
+
+private:
+    Q_DISABLE_COPY(SharedFrameWriter)
+
+    struct Config {
+        QString name;
+        SharedFrameFormat format;
+        qint64 intervalNs;
+        int slotCount;
+    };
+    bool open(const Config &cfg, quint64 slotSize);
+    bool fillSlot(SharedFrameSlot *slot, uint8_t *data, const AVFrame *frame, SharedFrameFormat format);
+
+    mutable QMutex mMutex;
+    Config mConfig;
+
+    // 解码线程
+    Config mOpened;                  // 当前共享内存对应的设置
+    quint64 mSlotSize;
+    qint64 mLastPublishNs;
+    qint64 mRetryNs;                 // 创建失败后隔一段时间再试
+    SharedFrameHeader *mHeader;
+    quint64 mMapSize;
+    void *mHandle;                   // Windows 文件映射句柄
+    FrameConverter mRgb;
+    SwsContext *mSws;
+};
+
+// 读端：给分析进程用（也可以用任何语言按上面的布局自己读）
+class SharedFrameReader
+{
+public:
+    SharedFrameReader();
+    ~SharedFrameReader();
+
+    bool open(const QString &name, QString *error);
+    void close();
+    bool isOpen() const;
+    bool isClosedByWriter() const;           // 写端已作废这块内存，需要重新 open
+
+    quint64 published() const;
+    // 拷贝最新一帧的槽头和像素；没有比 afterFrame 更新的帧或多次重试都撞上写入时返回 false
+    bool readLatest(SharedFrameInfo *info, QByteArray *pixels, quint64 afterFrame = 0) const;
+
+private:
+    Q_DISABLE_COPY(SharedFrameReader)
+
+    const SharedFrameHeader *mHeader;
+    quint64 mMapSize;
+    void *mHandle;
+};
+
+#endif // SHAREDFRAME_H
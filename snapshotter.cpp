@@ -0,0 +1,295 @@
+#include "snapshotter.h"
+#include "perfstats.h"
+
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QThread>
+#include <QtConcurrent/QtConcurrentRun>
+#include <QDebug>
+
+extern "C" {
+    #include <libavcodec/avcodec.h>
+    #include <libswscale/swscale.h>
+}
+
+// 转成编码器要的像素格式并按需缩小；失败返回空
+static AVFrame *scaleFrame(const AVFrame *frame, AVPixelFormat format, int width, int height)
+{
+    // 缩略图用 AREA 抗锯齿，原尺寸只做格式转换
+    int flags = (width < frame->width) ? SWS_AREA : SWS_BILINEAR;
+    SwsContext *sws = sws_getContext(frame->width, frame->height, AVPixelFormat(frame->format),
+                                     width, height, format, flags, nullptr, nullptr, nullptr);
+    if (!sws)
+        return nullptr;
+    AVFrame *out = av_frame_alloc();
+    if (out) {
+        out->format = format;
+        out->width = width;
+        out->height = height;
+        if (av_frame_get_buffer(out, 32) < 0
+                || sws_scale(sws, frame->data, frame->linesize, 0, frame->height, out->data, out->linesize) <= 0)
+            av_frame_free(&out);
+    }
+    sws_freeContext(sws);
+    return out;
+}
+
+static bool encodeFrame(AVCodecID codecId, AVFrame *frame, int qscale, QByteArray *out, QString *error)
+{
+    AVCodec *codec = avcodec_find_encoder(codecId);
+    if (!codec) {
+        *error = QString("Encoder %1 not available").arg(avcodec_get_name(codecId));
+        return false;
+    }
+    AVCodecContext *ctx = avcodec_alloc_context3(codec);
+    if (!ctx) {
+        *error = "Out of memory";
+        return false;
+    }
+    ctx->width = frame->width;
+    ctx->height = frame->height;
+    ctx->pix_fmt = AVPixelFormat(frame->format);
+    ctx->time_base = av_make_q(1, 25);
+    ctx->thread_count = 1;   // 并行靠线程池里同时编多张，单张不再开线程
+    if (qscale > 0) {
+        ctx->flags |= AV_CODEC_FLAG_QSCALE;
+        ctx->global_quality = FF_QP2LAMBDA * qscale;
+        frame->quality = ctx->global_quality;
+    }
+    frame->pts = 0;
+
+    bool ok = false;
+    AVPacket *packet = av_packet_alloc();
+    int ret = avcodec_open2(ctx, codec, nullptr);
+    if (ret >= 0 && packet) {
+        ret = avcodec_send_frame(ctx, frame);
+        if (ret >= 0)
+            ret = avcodec_receive_packet(ctx, packet);
+        if (ret >= 0) {
+            *out = QByteArray(reinterpret_cast<const char *>(packet->data), packet->size);
+            ok = true;
+        }
+    }
+    if (!ok) {
+        char msg[AV_ERROR_MAX_STRING_SIZE] = { 0 };
+        av_strerror(ret, msg, sizeof(msg));
+        *error = QString("Snapshot encode failed: %1").arg(msg);
+    }
+    av_packet_free(&packet);
+    avcodec_free_context(&ctx);
+    return ok;
+}
+
+Snapshotter::Snapshotter(QObject *parent)
+    : QObject(parent), mFormat("jpg"), mQuality(80), mMaxWidth(0), mIntervalNs(0), mPeriodicToFile(false),
+      mNextId(1), mLatestMs(0), mLastPeriodicNs(0), mBusy(false)
+{
+    mOutputDir = QStandardPaths::writableLocation(QStandardPaths::PicturesLocation) + "/snapshots";
+}
+
+Snapshotter::~Snapshotter()
+{
+    mJob.waitForFinished();
+}
+
+QThreadPool *Snapshotter::encodePool()
+{
+    // 所有摄像头共用；截图不急，最多占四分之一的核
+    static QThreadPool *pool = []() {
+        QThreadPool *p = new QThreadPool;
+        p->setMaxThreadCount(qMax(1, QThread::idealThreadCount() / 4));
+        return p;
+    }();
+    return pool;
+}
+
+void Snapshotter::setOutputDir(const QString &dir)
+{
+    QMutexLocker locker(&mMutex);
+    mOutputDir = dir;
+}
+
+void Snapshotter::setStreamName(const QString &name)
+{
+    // 只保留文件名里安全的字符
+    QString safe;
+    for (QChar c : name)
+        safe += (c.isLetterOrNumber() || c == '-' || c == '_') ? c : QChar('_');
+    QMutexLocker locker(&mMutex);
+    mStreamName = safe;
+}
+
+void Snapshotter::setFormat(const QString &ext)
+{
+    QMutexLocker locker(&mMutex);
+    mFormat = (ext.toLower() == "png") ? QString("png") : QString("jpg");
+}
+
+void Snapshotter::setQuality(int quality)
+{
+    QMutexLocker locker(&mMutex);
+    mQuality = qBound(1, quality, 100);
+}
+
+void Snapshotter::setMaxWidth(int width)
+{
+    QMutexLocker locker(&mMutex);
+    mMaxWidth = qMax(0, width);
+}
+
+void Snapshotter::setPeriodic(int intervalMs, bool toFile)
+{
+    QMutexLocker locker(&mMutex);
+    mIntervalNs = qint64(qMax(0, intervalMs)) * 1000000;
+    mPeriodicToFile = toFile;
+}
+
+int Snapshotter::request(const QString &path)
+{
+    QMutexLocker locker(&mMutex);
+    Request request;
+    request.id = mNextId++;
+    request.path = path;
+    mPending.append(request);
+    return request.id;
+}
+
+QString Snapshotter::pathLocked(bool timestamped) const
+{
+    QString name = mStreamName.isEmpty() ? QString("stream") : mStreamName;
+    if (timestamped)
+        name += "_" + QDateTime::currentDateTime().toString("yyyyMMdd-HHmmss-zzz");
+    return QString("%1/%2.%3").arg(mOutputDir, name, mFormat);
+}
+
+QString Snapshotter::nextPath() const
+{
+    QMutexLocker locker(&mMutex);
+    return pathLocked(true);
+}
+
+QString Snapshotter::thumbnailPath() const
+{
+    QMutexLocker locker(&mMutex);
+    return pathLocked(false);
+}
+
+QByteArray Snapshotter::latest(qint64 *timeMs) const
+{
+    QMutexLocker locker(&mMutex);
+    if (timeMs)
+        *timeMs = mLatestMs;
+    return mLatest;
+}
+
+void Snapshotter::offer(const AVFrame *frame)
+{
+    qint64 now = perfNowNs();
+    QList<Request> requests;
+    QString format;
+    int quality, maxWidth;
+    {
+        QMutexLocker locker(&mMutex);
+        bool periodic = mIntervalNs > 0 && (!mLastPeriodicNs || now - mLastPeriodicNs >= mIntervalNs);
+        if (!periodic && mPending.isEmpty())
+            return;
+        // 上一张还没编完：按需请求留到下一帧，定时截图顺延
+        if (mBusy.exchange(true))
+            return;
+        requests.swap(mPending);
+        if (periodic) {
+            Request request;
+            request.id = 0;
+            request.path = mPeriodicToFile ? pathLocked(false) : QString();
+            requests.append(request);
+            mLastPeriodicNs = now;
+        }
+        format = mFormat;
+        quality = mQuality;
+        maxWidth = mMaxWidth;
+    }
+
+    AVFrame *ref = av_frame_clone(frame);
+    if (!ref) {
+        mBusy = false;
+        for (const Request &request : requests) {
+            if (request.id)
+                emit sig_SnapshotFailed(request.id, "Out of memory");
+        }
+        return;
+    }
+    mJob = QtConcurrent::run(encodePool(), [this, ref, requests, format, quality, maxWidth]() {
+        run(ref, requests, format, quality, maxWidth);
+    });
+}
+
+bool Snapshotter::encode(const AVFrame *frame, const QString &format, int quality, int maxWidth,
+                         QByteArray *out, QString *error)
+{
+    const bool png = format == "png";
+    int width = frame->width;
+    int height = frame->height;
+    if (maxWidth > 0 && width > maxWidth) {
+        height = int(qint64(height) * maxWidth / width);
+        width = maxWidth;
+    }
+    // JPEG 用 4:2:0 采样，宽高取偶数
+    if (!png) {
+        width = qMax(2, width & ~1);
+        height = qMax(2, height & ~1);
+    }
+
+    // mjpeg 编码器要求全范围 YUV（yuvj420p），sws 会顺带做范围转换
+    AVFrame *scaled = scaleFrame(frame, png ? AV_PIX_FMT_RGB24 : AV_PIX_FMT_YUVJ420P, width, height);
+    if (!scaled) {
+        *error = "Snapshot scaling failed";
+        return false;
+    }
+    // 质量 1..100 映射到 qscale 31..2
+    int qscale = png ? 0 : 31 - (qBound(1, quality, 100) - 1) * 29 / 99;
+    bool ok = encodeFrame(png ? AV_CODEC_ID_PNG : AV_CODEC_ID_MJPEG, scaled, qscale, out, error);
+    av_frame_free(&scaled);
+    return ok;
+}
+
+void Snapshotter::run(AVFrame *frame, const QList<Request> &requests, const QString &format,
+                      int quality, int maxWidth)
+{
+    QByteArray image;
+    QString error;
+    bool ok = encode(frame, format, quality, maxWidth, &image, &error);
+    av_frame_free(&frame);
+
+    // mBusy 最后才清：清掉后解码线程会换上新任务，析构只等得到 mJob 里最新的那个
+    if (!ok) {
+        qWarning() << error;
+        for (const Request &request : requests)
+            emit sig_SnapshotFailed(request.id, error);
+        mBusy = false;
+        return;
+    }
+    {
+        QMutexLocker locker(&mMutex);
+        mLatest = image;
+        mLatestMs = QDateTime::currentMSecsSinceEpoch();
+    }
+
+    for (const Request &request : requests) {
+        if (!request.path.isEmpty()) {
+            // 先写临时文件再替换，看缩略图的程序不会读到半张图
+            QDir().mkpath(QFileInfo(request.path).absolutePath());
+            QSaveFile file(request.path);
+            if (!file.open(QIODevice::WriteOnly) || file.write(image) != image.size() || !file.commit()) {
+                QString message = QString("Cannot write snapshot %1: %2").arg(request.path, file.errorString());
+                qWarning() << message;
+                emit sig_SnapshotFailed(request.id, message);
+                continue;
+            }
+        }
+        emit sig_SnapshotReady(request.id, image, request.path);
+    }
+    mBusy = false;
+}
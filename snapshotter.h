@@ -0,0 +1,88 @@
+#ifndef SNAPSHOTTER_H
+#define SNAPSHOTTER_H
+
+#include <QObject>
+#include <QMutex>
+#include <QList>
+#include <QFuture>
+#include <QThreadPool>
+
+#include <atomic>
+
+extern "C" {
+    #include <libavutil/frame.h>
+}
+
+// 截图：按需或定时从解码线程取当前帧（只增加帧的引用，不拷贝像素），
+// 在线程池里用 libavcodec 的 mjpeg/png 编码器压缩，写文件或只留在内存里。
+// 所有摄像头共用一个编码线程池，每隔几秒给每路出一张缩略图的开销很小。
+//
+// 线程：设置、request()、latest() 可在任意线程调用；offer() 只在解码线程调用；
+// 结果信号在编码线程里发出。
+class Snapshotter : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit Snapshotter(QObject *parent = nullptr);
+    ~Snapshotter();
+
+    void setOutputDir(const QString &dir);    // 默认 <图片目录>/snapshots
+    void setStreamName(const QString &name);  // 文件名前缀
+    void setFormat(const QString &ext);       // jpg（默认）或 png
+    void setQuality(int quality);             // JPEG 质量 1..100，默认 80
+    void setMaxWidth(int width);              // 超过该宽度时等比缩小，0（默认）表示原尺寸
+    // 定时截图：intervalMs 为 0（默认）时关闭；toFile 时每次覆盖写 thumbnailPath()，否则只更新 latest()
+    void setPeriodic(int intervalMs, bool toFile = false);
+
+    // 按需截图：用下一帧，path 为空时只通过信号返回数据。返回请求序号
+    int request(const QString &path = QString());
+    QString nextPath() const;                 // <目录>/<流名>_<时间>.<扩展名>
+    QString thumbnailPath() const;            // <目录>/<流名>.<扩展名>
+
+    // 最近一次成功编码的图片（按需或定时），没有时为空
+    QByteArray latest(qint64 *timeMs = nullptr) const;
+
+    // 解码线程：每个要显示的帧都交给它，没有到期的截图时立即返回
+    void offer(const AVFrame *frame);
+
+    // 编码一帧，线程安全
+    static bool encode(const AVFrame *frame, const QString &format, int quality, int maxWidth,
+                       QByteArray *out, QString *error);
+
+signals:
+    void sig_SnapshotReady(int id, const QByteArray &image, const QString &path);   // 定时截图的 id 为 0
+    void sig_SnapshotFailed(int id, const QString &message);
+
+private:
+    Q_DISABLE_COPY(Snapshotter)
+
+    struct Request {
+        int id;
+        QString path;
+    };
+    static QThreadPool *encodePool();
+    QString pathLocked(bool timestamped) const;
+    void run(AVFrame *frame, const QList<Request> &requests, const QString &format,
+             int quality, int maxWidth);
+
+    mutable QMutex mMutex;
+    QString mOutputDir;
+    QString mStreamName;
+    QString mFormat;
+    int mQuality;
+    int mMaxWidth;
+    qint64 mIntervalNs;
+    bool mPeriodicToFile;
+    QList<Request> mPending;
+    int mNextId;
+    QByteArray mLatest;
+    qint64 mLatestMs;
+
+    // 解码线程
+    qint64 mLastPeriodicNs;
+    std::atomic<bool> mBusy;      // 上一次编码还没完成
+    QFuture<void> mJob;
+};
+
+#endif // SNAPSHOTTER_H
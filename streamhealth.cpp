@@ -0,0 +1,230 @@
+#include "streamhealth.h"
+#include "perfstats.h"
+
+#include <QStringList>
+#include <QDebug>
+
+#include <cmath>
+#include <cstdlib>
+
+extern "C" {
+    #include <libavutil/pixdesc.h>
+}
+
+static const int kGridWidth = 64;
+static const int kGridHeight = 36;
+
+// 各异常的单帧判定阈值（8 位亮度，有限范围黑电平为 16）
+static const double kBlackMean = 24.0;
+static const double kBlackStddev = 8.0;
+static const double kBrightRatio = 0.5;
+static const double kBrightMean = 235.0;
+static const double kBlankStddev = 2.0;
+
+const char *healthConditionName(HealthCondition condition)
+{
+    switch (condition) {
+    case HealthFrozen:      return "frozen";
+    case HealthBlack:       return "black";
+    case HealthOverexposed: return "overexposed";
+    case HealthBlank:       return "blank";
+    default:                return "unknown";
+    }
+}
+
+QString healthConditionsText(int conditions)
+{
+    QStringList names;
+    for (int i = 0; i < HealthConditionCount; i++) {
+        if (conditions & (1 << i))
+            names.append(healthConditionName(HealthCondition(1 << i)));
+    }
+    return names.isEmpty() ? QString("ok") : names.join(",");
+}
+
+StreamHealth::StreamHealth(QObject *parent)
+    : QObject(parent), mLastSampleNs(0), mPrevHash(0), mConditions(0)
+{
+    mConfig.enabled = true;
+    mConfig.intervalNs = 500000000;
+    mConfig.freezeNs = qint64(10000) * 1000000;
+    mConfig.blackNs = qint64(5000) * 1000000;
+    mConfig.exposureNs = qint64(5000) * 1000000;
+    mConfig.freezeTolerance = 0;
+    for (int i = 0; i < HealthConditionCount; i++)
+        mSinceNs[i] = 0;
+}
+
+void StreamHealth::setEnabled(bool enabled)
+{
+    QMutexLocker locker(&mMutex);
+    mConfig.enabled = enabled;
+}
+
+void StreamHealth::setSampleFps(double fps)
+{
+    QMutexLocker locker(&mMutex);
+    mConfig.intervalNs = fps > 0 ? qint64(1e9 / fps) : 0;
+}
+
+void StreamHealth::setFreezeWindowMs(int ms)
+{
+    QMutexLocker locker(&mMutex);
+    mConfig.freezeNs = qint64(qMax(0, ms)) * 1000000;
+}
+
+void StreamHealth::setBlackWindowMs(int ms)
+{
+    QMutexLocker locker(&mMutex);
+    mConfig.blackNs = qint64(qMax(0, ms)) * 1000000;
+}
+
+void StreamHealth::setExposureWindowMs(int ms)
+{
+    QMutexLocker locker(&mMutex);
+    mConfig.exposureNs = qint64(qMax(0, ms)) * 1000000;
+}
+
+void StreamHealth::setFreezeTolerance(double mad)
+{
+    QMutexLocker locker(&mMutex);
+    mConfig.freezeTolerance = qMax(0.0, mad);
+}
+
+StreamHealth::Config StreamHealth::config() const
+{
+    QMutexLocker locker(&mMutex);
+    return mConfig;
+}
+
+int StreamHealth::conditions() const
+{
+    return mConditions.load();
+}
+
+HealthSignature StreamHealth::lastSignature() const
+{
+    QMutexLocker locker(&mMutex);
+    return mLast;
+}
+
+void StreamHealth::reset()
+{
+    int previous = mConditions.exchange(0);
+    for (int i = 0; i < HealthConditionCount; i++) {
+        mSinceNs[i] = 0;
+        if (previous & (1 << i))
+            emit sig_ConditionCleared(healthConditionName(HealthCondition(1 << i)));
+    }
+    if (previous)
+        emit sig_HealthChanged(0);
+    mLastSampleNs = 0;
+    mGrid.clear();
+    mPrevGrid.clear();
+    mPrevHash = 0;
+}
+
+HealthSignature StreamHealth::signature(const AVFrame *frame, QVector<quint8> *grid,
+                                        const QVector<quint8> *prev)
+{
+    HealthSignature sig;
+    grid->resize(kGridWidth * kGridHeight);
+    quint8 *out = grid->data();
+    quint64 hash = 14695981039346656037ULL;
+    qint64 sum = 0, sumSq = 0;
+    int bright = 0;
+    // 取每个网格单元中心的像素，避开边缘的黑边/时间水印
+    for (int gy = 0; gy < kGridHeight; gy++) {
+        int y = int((2 * gy + 1) * qint64(frame->height) / (2 * kGridHeight));
+        const quint8 *row = frame->data[0] + qint64(y) * frame->linesize[0];
+        for (int gx = 0; gx < kGridWidth; gx++) {
+            quint8 v = row[(2 * gx + 1) * frame->width / (2 * kGridWidth)];
+            *out++ = v;
+            hash = (hash ^ v) * 1099511628211ULL;
+            sum += v;
+            sumSq += v * v;
+            bright += v >= 250;
+        }
+    }
+    const int n = kGridWidth * kGridHeight;
+    sig.hash = hash;
+    sig.mean = double(sum) / n;
+    sig.stddev = std::sqrt(qMax(0.0, double(sumSq) / n - sig.mean * sig.mean));
+    sig.brightRatio = double(bright) / n;
+    if (prev && prev->size() == n) {
+        int diff = 0;
+        for (int i = 0; i < n; i++)
+            diff += std::abs(int(grid->at(i)) - int(prev->at(i)));
+        sig.change = double(diff) / n;
+    }
+    return sig;
+}
+
+bool StreamHealth::analyze(const AVFrame *frame)
+{
+    const Config cfg = config();
+    if (!cfg.enabled)
+        return false;
+    qint64 now = perfNowNs();
+    if (mLastSampleNs && now - mLastSampleNs < cfg.intervalNs)
+        return false;
+
+    // 第一个平面是 8 位亮度的格式才处理
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(AVPixelFormat(frame->format));
+    if (!desc || (desc->flags & (AV_PIX_FMT_FLAG_RGB | AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_HWACCEL))
+            || desc->comp[0].depth != 8 || desc->comp[0].step != 1
+            || frame->width < kGridWidth || frame->height < kGridHeight)
+        return false;
+    mLastSampleNs = now;
+
+    mPrevGrid.swap(mGrid);
+    HealthSignature sig = signature(frame, &mGrid, &mPrevGrid);
+    bool hasPrev = mPrevGrid.size() == mGrid.size();
+    bool still = hasPrev && (cfg.freezeTolerance > 0 ? sig.change <= cfg.freezeTolerance
+                                                     : sig.hash == mPrevHash && sig.change == 0);
+    mPrevHash = sig.hash;
+    {
+        QMutexLocker locker(&mMutex);
+        mLast = sig;
+    }
+
+    // 单帧判定
+    bool black = sig.mean < kBlackMean && sig.stddev < kBlackStddev;
+    bool bright = sig.brightRatio > kBrightRatio || sig.mean > kBrightMean;
+    bool blank = !black && !bright && sig.stddev < kBlankStddev;
+    const bool now_[HealthConditionCount] = { still, black, bright, blank };
+    const qint64 windows[HealthConditionCount] = { cfg.freezeNs, cfg.blackNs, cfg.exposureNs, cfg.blackNs };
+
+    int previous = mConditions.load();
+    int current = 0;
+    for (int i = 0; i < HealthConditionCount; i++) {
+        if (!now_[i]) {
+            mSinceNs[i] = 0;
+            continue;
+        }
+        if (mSinceNs[i] == 0)
+            mSinceNs[i] = now;
+        if (now - mSinceNs[i] >= windows[i])
+            current |= 1 << i;
+    }
+    // 纯色画面同时也是静止的，只报更具体的 blank/black
+    if (current & (HealthBlank | HealthBlack))
+        current &= ~HealthFrozen;
+
+    if (current != previous) {
+        mConditions.store(current);
+        for (int i = 0; i < HealthConditionCount; i++) {
+            const int bit = 1 << i;
+            QString name = healthConditionName(HealthCondition(bit));
+            if ((current & bit) && !(previous & bit)) {
+                qWarning() << "Stream health:" << name << "mean" << sig.mean << "stddev" << sig.stddev;
+                emit sig_ConditionRaised(name);
+            } else if (!(current & bit) && (previous & bit)) {
+                qDebug() << "Stream health:" << name << "cleared";
+                emit sig_ConditionCleared(name);
+            }
+        }
+        emit sig_HealthChanged(current);
+    }
+    return true;
+}
@@ -0,0 +1,94 @@
+#ifndef STREAMHEALTH_H
+#define STREAMHEALTH_H
+
+#include <QObject>
+#include <QMutex>
+#include <QVector>
+
+#include <atomic>
+
+extern "C" {
+    #include <libavutil/frame.h>
+}
+
+// 画面异常类型，可同时存在多个
+enum HealthCondition {
+    HealthFrozen = 0x1,        // 画面长时间完全不变（摄像头卡死、编码器重复发同一帧）
+    HealthBlack = 0x2,         // 黑屏
+    HealthOverexposed = 0x4,   // 大面积过曝
+    HealthBlank = 0x8          // 纯色画面（无信号蓝屏/灰屏）
+};
+enum { HealthConditionCount = 4 };
+
+const char *healthConditionName(HealthCondition condition);
+QString healthConditionsText(int conditions);   // "frozen,black"，没有异常时为 "ok"
+
+// 一帧的廉价特征：在 Y 平面上按 64x36 网格取样
+struct HealthSignature {
+    quint64 hash = 0;          // 取样点的 FNV-1a 哈希
+    double mean = 0;           // 亮度均值
+    double stddev = 0;         // 亮度标准差
+    double brightRatio = 0;    // 接近饱和（>= 250）的取样点比例
+    double change = 0;         // 与上一次取样的平均绝对差
+};
+
+// 流健康检查：解码线程按采样帧率计算特征（每次几微秒，64 路同时开也可以忽略），
+// 某种异常在各自的时间窗口内持续成立才报出，恢复后立即清除。
+// 状态变化通过信号通知，条件位可在任意线程读取。
+class StreamHealth : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit StreamHealth(QObject *parent = nullptr);
+
+    // 以下设置可在任意线程调用
+    void setEnabled(bool enabled);             // 默认开启
+    void setSampleFps(double fps);             // 默认 2
+    void setFreezeWindowMs(int ms);            // 默认 10000
+    void setBlackWindowMs(int ms);             // 黑屏、纯色，默认 5000
+    void setExposureWindowMs(int ms);          // 默认 5000
+    // 判为静止的帧间平均绝对差（亮度级），默认 0 表示取样点完全相同
+    void setFreezeTolerance(double mad);
+
+    // 解码线程：到了采样时刻才计算，返回是否取样了
+    bool analyze(const AVFrame *frame);
+    void reset();
+
+    int conditions() const;
+    HealthSignature lastSignature() const;
+
+    // 计算特征；grid 保存本次的取样点，prev 为上一次的（可为空，此时 change 为 0）
+    static HealthSignature signature(const AVFrame *frame, QVector<quint8> *grid,
+                                     const QVector<quint8> *prev = nullptr);
+
+signals:
+    void sig_HealthChanged(int conditions);
+    void sig_ConditionRaised(const QString &name);
+    void sig_ConditionCleared(const QString &name);
+
+private:
+    Q_DISABLE_COPY(StreamHealth)
+
+    struct Config {
+        bool enabled;
+        qint64 intervalNs;
+        qint64 freezeNs, blackNs, exposureNs;
+        double freezeTolerance;
+    };
+    Config config() const;
+
+    mutable QMutex mMutex;
+    Config mConfig;
+    HealthSignature mLast;
+
+    // 解码线程
+    qint64 mLastSampleNs;
+    QVector<quint8> mGrid, mPrevGrid;
+    quint64 mPrevHash;
+    qint64 mSinceNs[HealthConditionCount];   // 各异常条件开始连续成立的时刻，0 表示不成立
+
+    std::atomic<int> mConditions;
+};
+
+#endif // STREAMHEALTH_H
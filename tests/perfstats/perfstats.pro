@@ -0,0 +1,22 @@
+#-------------------------------------------------
+#
+# LatencyHistogram 单元测试：make check 运行
+#
+#-------------------------------------------------
+
+QT       += core testlib
+QT       -= gui
+
+CONFIG   += console testcase c++11
+CONFIG   -= app_bundle
+
+TARGET = tst_perfstats
+TEMPLATE = app
+
+INCLUDEPATH += ../..
+
+SOURCES += tst_perfstats.cpp \
+    ../../perfstats.cpp
+
+HEADERS += \
+    ../../perfstats.h
@@ -0,0 +1,74 @@
+#include <QtTest>
+
+#include "perfstats.h"
+
+// 直方图的相对误差约 6%，分位数按 7% 检查
+static bool near(qint64 value, qint64 expected)
+{
+    return qAbs(double(value - expected)) <= expected * 0.07;
+}
+
+class TestPerfStats : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void emptyHistogram();
+    void singleValue();
+    void uniformPercentiles();
+    void skewedPercentiles();
+};
+
+void TestPerfStats::emptyHistogram()
+{
+    LatencyHistogram h;
+    QCOMPARE(h.count(), quint64(0));
+    QCOMPARE(h.percentile(0.5), qint64(0));
+    QCOMPARE(h.percentile(0.99), qint64(0));
+}
+
+void TestPerfStats::singleValue()
+{
+    LatencyHistogram h;
+    h.record(12345);
+    QVERIFY(near(h.percentile(0.0), 12345));
+    QVERIFY(near(h.percentile(0.5), 12345));
+    QVERIFY(near(h.percentile(1.0), 12345));
+    QVERIFY(h.percentile(1.0) <= h.maxValue());
+}
+
+// 1..1000 ms 均匀分布：p50/p90/p99 分别约为 500/900/990 ms，都不能等于最大值
+void TestPerfStats::uniformPercentiles()
+{
+    LatencyHistogram h;
+    for (qint64 ms = 1; ms <= 1000; ms++)
+        h.record(ms * 1000);
+    QCOMPARE(h.count(), quint64(1000));
+    QCOMPARE(h.maxValue(), qint64(1000000));
+
+    const qint64 p50 = h.percentile(0.50);
+    const qint64 p90 = h.percentile(0.90);
+    const qint64 p99 = h.percentile(0.99);
+    QVERIFY2(near(p50, 500000), qPrintable(QString("p50 = %1").arg(p50)));
+    QVERIFY2(near(p90, 900000), qPrintable(QString("p90 = %1").arg(p90)));
+    QVERIFY2(near(p99, 990000), qPrintable(QString("p99 = %1").arg(p99)));
+    QVERIFY(p50 < p90 && p90 <= p99 && p99 <= h.maxValue());
+    QVERIFY(p50 < h.maxValue() / 2 + h.maxValue() / 10);
+}
+
+// 99 个 10 ms 加 1 个 1 s 的尖峰：p50 和 p99 落在 10 ms，只有最大值是尖峰
+void TestPerfStats::skewedPercentiles()
+{
+    LatencyHistogram h;
+    for (int i = 0; i < 99; i++)
+        h.record(10000);
+    h.record(1000000);
+    QVERIFY(near(h.percentile(0.50), 10000));
+    QVERIFY(near(h.percentile(0.99), 10000));
+    QVERIFY(near(h.percentile(1.0), 1000000));
+    QCOMPARE(h.maxValue(), qint64(1000000));
+}
+
+QTEST_APPLESS_MAIN(TestPerfStats)
+
+#include "tst_perfstats.moc"
@@ -0,0 +1,15 @@
+# 测试/基准工具共用的代码
+
+INCLUDEPATH += $$PWD
+
+SOURCES += \
+    $$PWD/syntheticsource.cpp \
+    $$PWD/procstats.cpp \
+    $$PWD/timestampcode.cpp
+
+HEADERS += \
+    $$PWD/syntheticsource.h \
+    $$PWD/procstats.h \
+    $$PWD/timestampcode.h
+
+win32: LIBS += -lpsapi
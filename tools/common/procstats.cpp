@@ -0,0 +1,47 @@
+#include "procstats.h"
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#include <psapi.h>
+
+static double fileTimeToSec(const FILETIME &ft)
+{
+    ULARGE_INTEGER v;
+    v.LowPart = ft.dwLowDateTime;
+    v.HighPart = ft.dwHighDateTime;
+    return v.QuadPart / 1e7;   // 100ns 为单位
+}
+
+ProcessStats currentProcessStats()
+{
+    ProcessStats stats;
+    FILETIME creation, exitTime, kernel, user;
+    if (GetProcessTimes(GetCurrentProcess(), &creation, &exitTime, &kernel, &user)) {
+        stats.userSec = fileTimeToSec(user);
+        stats.systemSec = fileTimeToSec(kernel);
+    }
+    PROCESS_MEMORY_COUNTERS pmc;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+        stats.peakRssKb = qint64(pmc.PeakWorkingSetSize / 1024);
+    return stats;
+}
+
+#else
+#include <sys/resource.h>
+
+ProcessStats currentProcessStats()
+{
+    ProcessStats stats;
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        stats.userSec = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6;
+        stats.systemSec = usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+#ifdef Q_OS_MACOS
+        stats.peakRssKb = usage.ru_maxrss / 1024;   // macOS 单位是字节
+#else
+        stats.peakRssKb = usage.ru_maxrss;
+#endif
+    }
+    return stats;
+}
+#endif
@@ -0,0 +1,17 @@
+#ifndef PROCSTATS_H
+#define PROCSTATS_H
+
+#include <QtGlobal>
+
+// 当前进程累计 CPU 时间与内存峰值
+struct ProcessStats {
+    double userSec = 0.0;
+    double systemSec = 0.0;
+    qint64 peakRssKb = 0;
+
+    double cpuSec() const { return userSec + systemSec; }
+};
+
+ProcessStats currentProcessStats();
+
+#endif // PROCSTATS_H
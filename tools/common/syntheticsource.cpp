@@ -0,0 +1,207 @@
+#include "syntheticsource.h"
+#include "timestampcode.h"
+
+#include <QRegularExpression>
+#include <QDebug>
+
+#include <cstring>
+
+extern "C" {
+    #include <libavformat/avformat.h>
+    #include <libavutil/opt.h>
+}
+
+bool SyntheticSpec::parse(const QString &text)
+{
+    QRegularExpression re("^(\\d+)x(\\d+)(?:@(\\d+))?$");
+    QRegularExpressionMatch m = re.match(text.trimmed());
+    if (!m.hasMatch())
+        return false;
+
+    width = m.captured(1).toInt() & ~1;   // YUV420 需要偶数宽高
+    height = m.captured(2).toInt() & ~1;
+    if (!m.captured(3).isEmpty())
+        fps = m.captured(3).toInt();
+    return width > 0 && height > 0 && fps > 0;
+}
+
+QString SyntheticSpec::toString() const
+{
+    return QString("%1x%2@%3").arg(width).arg(height).arg(fps);
+}
+
+SyntheticSource::SyntheticSource(const SyntheticSpec &spec)
+    : mSpec(spec), mEncCtx(nullptr), mFrame(nullptr), mPacket(nullptr)
+{
+}
+
+SyntheticSource::~SyntheticSource()
+{
+    if (mEncCtx) avcodec_free_context(&mEncCtx);
+    if (mFrame) av_frame_free(&mFrame);
+    if (mPacket) av_packet_free(&mPacket);
+}
+
+bool SyntheticSource::open(bool globalHeader, QString *error)
+{
+    AVCodec *codec = avcodec_find_encoder_by_name("libx264");
+    if (!codec)
+        codec = avcodec_find_encoder(AV_CODEC_ID_H264);
+    if (!codec) {
+        qWarning() << "SyntheticSource: no H.264 encoder, falling back to MPEG-4";
+        codec = avcodec_find_encoder(AV_CODEC_ID_MPEG4);
+    }
+    if (!codec) {
+        if (error) *error = "No usable video encoder";
+        return false;
+    }
+
+    mEncCtx = avcodec_alloc_context3(codec);
+    mEncCtx->width = mSpec.width;
+    mEncCtx->height = mSpec.height;
+    mEncCtx->time_base = av_make_q(1, mSpec.fps);
+    mEncCtx->framerate = av_make_q(mSpec.fps, 1);
+    mEncCtx->pix_fmt = AV_PIX_FMT_YUV420P;
+    mEncCtx->gop_size = mSpec.gop > 0 ? mSpec.gop : mSpec.fps * 2;
+    mEncCtx->max_b_frames = 0;
+    mEncCtx->bit_rate = mSpec.bitrate;
+    if (globalHeader)
+        mEncCtx->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+    if (codec->id == AV_CODEC_ID_H264) {
+        av_opt_set(mEncCtx->priv_data, "preset", "veryfast", 0);
+        av_opt_set(mEncCtx->priv_data, "tune", "zerolatency", 0);
+    }
+
+    if (avcodec_open2(mEncCtx, codec, nullptr) < 0) {
+        if (error) *error = QString("Cannot open encoder %1").arg(codec->name);
+        return false;
+    }
+
+    mFrame = av_frame_alloc();
+    mFrame->format = mEncCtx->pix_fmt;
+    mFrame->width = mEncCtx->width;
+    mFrame->height = mEncCtx->height;
+    if (av_frame_get_buffer(mFrame, 32) < 0) {
+        if (error) *error = "Cannot allocate frame";
+        return false;
+    }
+    mPacket = av_packet_alloc();
+    return true;
+}
+
+// 斜向渐变 + 移动方块 + 少量噪声，避免编码器把画面压成几乎为零
+void SyntheticSource::fillFrame(AVFrame *frame, qint64 index)
+{
+    const int w = frame->width, h = frame->height;
+    quint32 noise = quint32(index) * 2654435761u;
+
+    for (int y = 0; y < h; y++) {
+        uint8_t *row = frame->data[0] + y * frame->linesize[0];
+        for (int x = 0; x < w; x++) {
+            noise = noise * 1664525u + 1013904223u;
+            row[x] = uint8_t(((x + y + index * 3) & 0xff) ^ ((noise >> 28) & 0x7));
+        }
+    }
+    for (int y = 0; y < h / 2; y++) {
+        uint8_t *u = frame->data[1] + y * frame->linesize[1];
+        uint8_t *v = frame->data[2] + y * frame->linesize[2];
+        for (int x = 0; x < w / 2; x++) {
+            u[x] = uint8_t(128 + ((x + index) & 0x3f) - 32);
+            v[x] = uint8_t(128 + ((y + index * 2) & 0x3f) - 32);
+        }
+    }
+
+    // 每帧移动的白色方块
+    int box = qMax(16, h / 8);
+    int bx = int((index * 7) % qMax(1, w - box));
+    int by = int((index * 3) % qMax(1, h - box));
+    for (int y = by; y < by + box; y++)
+        memset(frame->data[0] + y * frame->linesize[0] + bx, 235, box);
+}
+
+bool SyntheticSource::drain(const std::function<void(AVPacket *)> &sink)
+{
+    for (;;) {
+        int ret = avcodec_receive_packet(mEncCtx, mPacket);
+        if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF)
+            return true;
+        if (ret < 0)
+            return false;
+        sink(mPacket);
+        av_packet_unref(mPacket);
+    }
+}
+
+bool SyntheticSource::encodeFrame(qint64 index, const std::function<void(AVPacket *)> &sink)
+{
+    if (av_frame_make_writable(mFrame) < 0)
+        return false;
+    fillFrame(mFrame, index);
+    if (mSpec.timestamp)
+        TimestampCode::stamp(mFrame, TimestampCode::nowMs());
+    mFrame->pts = index;
+    if (avcodec_send_frame(mEncCtx, mFrame) < 0)
+        return false;
+    return drain(sink);
+}
+
+bool SyntheticSource::flush(const std::function<void(AVPacket *)> &sink)
+{
+    avcodec_send_frame(mEncCtx, nullptr);
+    return drain(sink);
+}
+
+bool SyntheticSource::writeFile(const SyntheticSpec &spec, const QString &path, QString *error)
+{
+    AVFormatContext *oc = nullptr;
+    QByteArray file = path.toUtf8();
+    if (avformat_alloc_output_context2(&oc, nullptr, nullptr, file.constData()) < 0 || !oc) {
+        if (error) *error = QString("Unknown output format: %1").arg(path);
+        return false;
+    }
+
+    SyntheticSource source(spec);
+    if (!source.open(oc->oformat->flags & AVFMT_GLOBALHEADER, error)) {
+        avformat_free_context(oc);
+        return false;
+    }
+
+    AVStream *st = avformat_new_stream(oc, nullptr);
+    avcodec_parameters_from_context(st->codecpar, source.codecContext());
+    st->time_base = source.codecContext()->time_base;
+
+    if (avio_open(&oc->pb, file.constData(), AVIO_FLAG_WRITE) < 0) {
+        if (error) *error = QString("Cannot create %1").arg(path);
+        avformat_free_context(oc);
+        return false;
+    }
+    if (avformat_write_header(oc, nullptr) < 0) {
+        if (error) *error = "Cannot write header";
+        avio_closep(&oc->pb);
+        avformat_free_context(oc);
+        return false;
+    }
+
+    AVRational encTb = source.codecContext()->time_base;
+    bool ok = true;
+    auto sink = [&](AVPacket *pkt) {
+        av_packet_rescale_ts(pkt, encTb, st->time_base);
+        pkt->stream_index = st->index;
+        if (av_interleaved_write_frame(oc, pkt) < 0)
+            ok = false;
+    };
+
+    qint64 total = qint64(spec.fps) * spec.seconds;
+    for (qint64 i = 0; i < total && ok; i++) {
+        ok = source.encodeFrame(i, sink);
+    }
+    ok = source.flush(sink) && ok;
+
+    av_write_trailer(oc);
+    avio_closep(&oc->pb);
+    avformat_free_context(oc);
+
+    if (!ok && error)
+        *error = "Encoding synthetic stream failed";
+    return ok;
+}
@@ -0,0 +1,54 @@
+#ifndef SYNTHETICSOURCE_H
+#define SYNTHETICSOURCE_H
+
+#include <QString>
+
+#include <functional>
+
+extern "C" {
+    #include <libavcodec/avcodec.h>
+}
+
+// 合成测试视频参数，例如 1920x1080@30
+struct SyntheticSpec {
+    int width = 1920;
+    int height = 1080;
+    int fps = 30;
+    int seconds = 10;
+    int bitrate = 4000000;
+    int gop = 0;                 // 0 表示 2 秒一个关键帧
+    bool timestamp = false;      // 画面顶部写入生成时刻，用于测量端到端延迟
+
+    bool parse(const QString &text);   // 解析 "WxH@FPS"
+    QString toString() const;
+};
+
+// 生成带运动画面的合成 YUV 帧并编码为 H.264（无 libx264 时退回 MPEG-4）
+class SyntheticSource
+{
+public:
+    explicit SyntheticSource(const SyntheticSpec &spec);
+    ~SyntheticSource();
+
+    bool open(bool globalHeader, QString *error);   // 封装格式需要全局头时 globalHeader=true
+    AVCodecContext *codecContext() const { return mEncCtx; }
+
+    // 生成第 index 帧并送入编码器，得到的包交给 sink（包的所有权不转移）
+    bool encodeFrame(qint64 index, const std::function<void(AVPacket *)> &sink);
+    bool flush(const std::function<void(AVPacket *)> &sink);
+
+    static void fillFrame(AVFrame *frame, qint64 index);
+
+    // 生成一个完整的测试文件（按扩展名选择封装格式）
+    static bool writeFile(const SyntheticSpec &spec, const QString &path, QString *error);
+
+private:
+    bool drain(const std::function<void(AVPacket *)> &sink);
+
+    SyntheticSpec mSpec;
+    AVCodecContext *mEncCtx;
+    AVFrame *mFrame;
+    AVPacket *mPacket;
+};
+
+#endif // SYNTHETICSOURCE_H
@@ -0,0 +1,70 @@
+#include "timestampcode.h"
+
+#include <QDateTime>
+
+#include <cstring>
+
+// 条带高度占画面的 1/24，读取时按比例取中线，和显示缩放无关
+static int bandHeight(int frameHeight)
+{
+    return qMax(16, (frameHeight / 24) & ~1);
+}
+
+static quint8 checksum(quint32 value)
+{
+    quint8 sum = quint8(value) + quint8(value >> 8) + quint8(value >> 16) + quint8(value >> 24);
+    return sum ^ 0xA5;
+}
+
+quint32 TimestampCode::nowMs()
+{
+    return quint32(QDateTime::currentMSecsSinceEpoch());
+}
+
+qint32 TimestampCode::elapsedMs(quint32 stampMs)
+{
+    return qint32(nowMs() - stampMs);
+}
+
+void TimestampCode::stamp(AVFrame *frame, quint32 value)
+{
+    const int w = frame->width;
+    const int band = qMin(bandHeight(frame->height), frame->height);
+    const int cellWidth = w / Cells;
+    quint64 bits = (quint64(checksum(value)) << DataBits) | value;
+
+    for (int y = 0; y < band; y++) {
+        uint8_t *row = frame->data[0] + y * frame->linesize[0];
+        for (int i = 0; i < Cells; i++) {
+            uint8_t level = (bits >> i) & 1 ? 235 : 16;
+            memset(row + i * cellWidth, level, cellWidth);
+        }
+        memset(row + Cells * cellWidth, 16, w - Cells * cellWidth);
+    }
+    // 色度置中性，转换成 RGB 后仍是纯黑白
+    for (int y = 0; y < band / 2; y++) {
+        memset(frame->data[1] + y * frame->linesize[1], 128, w / 2);
+        memset(frame->data[2] + y * frame->linesize[2], 128, w / 2);
+    }
+}
+
+bool TimestampCode::read(const QImage &image, quint32 *value)
+{
+    if (image.isNull() || image.width() < Cells)
+        return false;
+
+    const int y = qMin(image.height() - 1, image.height() / 48);
+    const double cellWidth = double(image.width()) / Cells;
+    quint64 bits = 0;
+    for (int i = 0; i < Cells; i++) {
+        QRgb px = image.pixel(int((i + 0.5) * cellWidth), y);
+        if (qGray(px) > 128)
+            bits |= quint64(1) << i;
+    }
+
+    quint32 data = quint32(bits);
+    if (quint8(bits >> DataBits) != checksum(data))
+        return false;
+    *value = data;
+    return true;
+}
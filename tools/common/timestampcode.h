@@ -0,0 +1,23 @@
+#ifndef TIMESTAMPCODE_H
+#define TIMESTAMPCODE_H
+
+#include <QImage>
+
+extern "C" {
+    #include <libavutil/frame.h>
+}
+
+// 把生成时刻编码成画面顶部的一排黑白方格，播放端从显示图像中读回，
+// 用于测量“镜头到屏幕”（glass-to-glass）延迟。同一台机器上收发，时钟一致。
+namespace TimestampCode
+{
+    enum { DataBits = 32, CheckBits = 8, Cells = DataBits + CheckBits };
+
+    quint32 nowMs();                           // 毫秒时间戳的低 32 位
+    qint32 elapsedMs(quint32 stampMs);         // 距 stampMs 已过去的毫秒数（处理回绕）
+
+    void stamp(AVFrame *frame, quint32 value); // 写入 YUV420P 帧
+    bool read(const QImage &image, quint32 *value);
+}
+
+#endif // TIMESTAMPCODE_H
@@ -0,0 +1,27 @@
+#-------------------------------------------------
+#
+# 颜色转换基准：专用 SIMD 转换（YuvConverter）与 sws_scale 对比
+#
+#-------------------------------------------------
+
+QT       += core gui concurrent
+QT       -= widgets
+
+CONFIG   += console c++11
+CONFIG   -= app_bundle
+
+TARGET = convbench
+TEMPLATE = app
+
+INCLUDEPATH += ../..
+
+include(../../ffmpeg.pri)
+include(../common/common.pri)
+
+SOURCES += main.cpp \
+    ../../frameconverter.cpp \
+    ../../yuvconverter.cpp
+
+HEADERS += \
+    ../../frameconverter.h \
+    ../../yuvconverter.h
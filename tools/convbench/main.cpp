@@ -0,0 +1,176 @@
+/**
+ * convbench：YUV -> RGB32 颜色转换基准
+ *
+ * 用法：
+ *   convbench
+ *   convbench --size 3840x2160 --display 1280x720 --threads 0
+ *   convbench --simd sse4.1 --format nv12
+ *
+ * 对每种源格式/尺寸，分别用 sws_scale 和专用转换（YuvConverter）转换同一帧，
+ * 输出每帧耗时、加速比，以及专用转换相对 sws_scale 的 PSNR。
+ */
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QImage>
+#include <QStringList>
+#include <QTextStream>
+
+#include <cmath>
+#include <cstring>
+
+#include "frameconverter.h"
+#include "syntheticsource.h"
+
+extern "C" {
+    #include <libavutil/pixdesc.h>
+}
+
+static bool parseSize(const QString &text, QSize *size)
+{
+    QStringList parts = text.split('x');
+    if (parts.size() != 2)
+        return false;
+    *size = QSize(parts[0].toInt(), parts[1].toInt());
+    return !size->isEmpty();
+}
+
+// 合成画面，NV12 由 YUV420P 交织色度得到
+static AVFrame *makeFrame(AVPixelFormat format, const QSize &size)
+{
+    AVFrame *yuv = av_frame_alloc();
+    yuv->format = AV_PIX_FMT_YUV420P;
+    yuv->width = size.width();
+    yuv->height = size.height();
+    av_frame_get_buffer(yuv, 32);
+    SyntheticSource::fillFrame(yuv, 42);
+    if (format == AV_PIX_FMT_YUV420P)
+        return yuv;
+
+    AVFrame *nv12 = av_frame_alloc();
+    nv12->format = AV_PIX_FMT_NV12;
+    nv12->width = size.width();
+    nv12->height = size.height();
+    av_frame_get_buffer(nv12, 32);
+    for (int y = 0; y < size.height(); y++)
+        memcpy(nv12->data[0] + y * nv12->linesize[0], yuv->data[0] + y * yuv->linesize[0], size.width());
+    for (int y = 0; y < (size.height() + 1) / 2; y++) {
+        uint8_t *uv = nv12->data[1] + y * nv12->linesize[1];
+        const uint8_t *u = yuv->data[1] + y * yuv->linesize[1];
+        const uint8_t *v = yuv->data[2] + y * yuv->linesize[2];
+        for (int x = 0; x < (size.width() + 1) / 2; x++) {
+            uv[2 * x] = u[x];
+            uv[2 * x + 1] = v[x];
+        }
+    }
+    av_frame_free(&yuv);
+    return nv12;
+}
+
+static double psnr(const QImage &a, const QImage &b)
+{
+    double sum = 0;
+    for (int y = 0; y < a.height(); y++) {
+        const QRgb *pa = reinterpret_cast<const QRgb *>(a.constScanLine(y));
+        const QRgb *pb = reinterpret_cast<const QRgb *>(b.constScanLine(y));
+        for (int x = 0; x < a.width(); x++) {
+            int dr = qRed(pa[x]) - qRed(pb[x]);
+            int dg = qGreen(pa[x]) - qGreen(pb[x]);
+            int db = qBlue(pa[x]) - qBlue(pb[x]);
+            sum += dr * dr + dg * dg + db * db;
+        }
+    }
+    double mse = sum / (3.0 * a.width() * a.height());
+    return mse > 0 ? 10.0 * std::log10(255.0 * 255.0 / mse) : 99.0;
+}
+
+// 返回每帧平均毫秒数，第一帧（建表/建上下文）不计入
+static double timeConvert(FrameConverter *converter, const AVFrame *frame, QImage *image, int frames)
+{
+    converter->convert(frame, image);
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < frames; i++)
+        converter->convert(frame, image);
+    return timer.nsecsElapsed() / 1e6 / frames;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("convbench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Compare the SIMD YUV->RGB32 converter with sws_scale");
+    parser.addHelpOption();
+    QCommandLineOption sizeOpt("size", "Source sizes, comma separated", "WxH[,WxH...]", "1920x1080,3840x2160");
+    QCommandLineOption displayOpt("display", "Also convert to this display size", "WxH", "1280x720");
+    QCommandLineOption formatOpt("format", "yuv420p, nv12 or all", "fmt", "all");
+    QCommandLineOption framesOpt("frames", "Frames per measurement", "n", "50");
+    QCommandLineOption threadsOpt("threads", "Conversion slices (0 = auto by resolution)", "n", "1");
+    QCommandLineOption simdOpt("simd", "Force avx2, sse4.1, neon or c", "name", "auto");
+    parser.addOptions({ sizeOpt, displayOpt, formatOpt, framesOpt, threadsOpt, simdOpt });
+    parser.process(app);
+
+    QTextStream out(stdout);
+    QList<QSize> sizes;
+    for (const QString &text : parser.value(sizeOpt).split(',')) {
+        QSize size;
+        if (!parseSize(text, &size)) {
+            out << "Invalid --size value: " << text << "\n";
+            return 2;
+        }
+        sizes.append(size);
+    }
+    QSize display;
+    if (!parseSize(parser.value(displayOpt), &display)) {
+        out << "Invalid --display value\n";
+        return 2;
+    }
+    QList<AVPixelFormat> formats;
+    QString format = parser.value(formatOpt);
+    if (format == "yuv420p" || format == "all")
+        formats.append(AV_PIX_FMT_YUV420P);
+    if (format == "nv12" || format == "all")
+        formats.append(AV_PIX_FMT_NV12);
+    const int frames = qMax(1, parser.value(framesOpt).toInt());
+    const int threads = parser.value(threadsOpt).toInt();
+
+    FrameConverter sws, fast;
+    sws.setFastPathEnabled(false);
+    sws.setThreadCount(threads);
+    fast.setThreadCount(threads);
+    if (!fast.setSimd(parser.value(simdOpt))) {
+        out << "SIMD variant not available on this CPU: " << parser.value(simdOpt) << "\n";
+        return 2;
+    }
+
+    out << QString("%1 %2 %3 %4 %5 %6\n")
+           .arg("format", -8).arg("source -> output", -24).arg("sws ms", 9)
+           .arg("fast ms", 9).arg("speedup", 8).arg("PSNR dB", 8);
+    for (AVPixelFormat pixelFormat : formats) {
+        for (const QSize &size : sizes) {
+            AVFrame *frame = makeFrame(pixelFormat, size);
+            QList<QSize> targets = { size };
+            if (size.scaled(display, Qt::KeepAspectRatio) != size)
+                targets.append(size.scaled(display, Qt::KeepAspectRatio));
+            for (const QSize &target : targets) {
+                QImage reference(target, QImage::Format_RGB32);
+                QImage result(target, QImage::Format_RGB32);
+                double swsMs = timeConvert(&sws, frame, &reference, frames);
+                double fastMs = timeConvert(&fast, frame, &result, frames);
+                QString route = QString("%1x%2 -> %3x%4").arg(size.width()).arg(size.height())
+                        .arg(target.width()).arg(target.height());
+                out << QString("%1 %2 %3 %4 %5 %6  [%7]\n")
+                       .arg(av_get_pix_fmt_name(pixelFormat), -8).arg(route, -24)
+                       .arg(swsMs, 9, 'f', 2).arg(fastMs, 9, 'f', 2)
+                       .arg(QString::number(swsMs / fastMs, 'f', 2) + "x", 8)
+                       .arg(psnr(result, reference), 8, 'f', 1).arg(fast.backendName());
+                out.flush();
+            }
+            av_frame_free(&frame);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,393 @@
+/**
+ * rtspe2e：端到端测试
+ *
+ * 在进程内启动本地回环 RTSP 服务器（合成画面，顶部带时间戳条码），
+ * 用 VideoPlayer 拉流，逐帧读回条码得到“镜头到屏幕”延迟。
+ *
+ * 场景：
+ *   pull-tcp         TCP 交织拉流
+ *   pull-udp         UDP 拉流，注入丢包和抖动
+ *   reconnect        拉流中服务器断开所有连接并离线一段时间，测量恢复出画时间
+ *   push             startPushing 把 /test 转推到 /push，再从 /push 拉流（需要 ffmpeg 可执行文件）
+ *   push-reconnect   推流路径上的断线重连
+ *   push-encode      /test 解码后用 libx264 重新编码推到 /push（默认参数，两秒一个关键帧）
+ *   push-lowlatency  同上，低延迟参数（帧内刷新、切片多线程、单帧 VBV、无 B 帧），与 push-encode 对比
+ *
+ * 用法：
+ *   rtspe2e --json e2e.json
+ *   rtspe2e --scenarios pull-tcp,reconnect --max-latency 300
+ *   rtspe2e --scenarios push-encode,push-lowlatency
+ *
+ * 任一场景超过阈值时退出码为 1。
+ */
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QEventLoop>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QStandardPaths>
+#include <QTextStream>
+#include <QTimer>
+
+#include <atomic>
+#include <functional>
+
+#include "videoplayer.h"
+#include "pushmanager.h"
+#include "perfstats.h"
+#include "timestampcode.h"
+#include "rtspserver.h"
+#include "rtpsource.h"
+
+struct Scenario {
+    QString name;
+    QString transport = "tcp";
+    double loss = 0.0;
+    int jitterMs = 0;
+    bool push = false;
+    bool reconnect = false;
+    bool encode = false;        // 推流时重新编码（PushJobManager 单路同播），而不是转推
+    bool lowLatency = false;
+    int encodeFps = 30;
+    qint64 encodeBitrateBps = 2000000;
+};
+
+struct Thresholds {
+    double maxStartupMs;
+    double maxLatencyMs;     // p99
+    double maxReconnectMs;
+};
+
+struct ScenarioResult {
+    QString name;
+    QString error;
+    bool skipped = false;
+    bool passed = false;
+    quint64 frames = 0;
+    quint64 stamped = 0;     // 成功读出条码的帧数
+    double startupMs = -1;
+    double reconnectMs = -1;
+    double p50Ms = 0, p90Ms = 0, p99Ms = 0, maxMs = 0;
+};
+
+// 在事件循环里等待条件成立，超时返回 false
+static bool waitFor(const std::function<bool()> &condition, int timeoutMs)
+{
+    QEventLoop loop;
+    QTimer poll;
+    QObject::connect(&poll, &QTimer::timeout, &loop, [&]() {
+        if (condition())
+            loop.quit();
+    });
+    QTimer::singleShot(timeoutMs, &loop, &QEventLoop::quit);
+    poll.start(20);
+    if (!condition())
+        loop.exec();
+    return condition();
+}
+
+static ScenarioResult runScenario(RtspTestServer &server, const Scenario &sc, int seconds,
+                                  int offlineMs, const Thresholds &limits)
+{
+    ScenarioResult result;
+    result.name = sc.name;
+
+    server.setPacketLoss(sc.loss);
+    server.setJitter(sc.jitterMs);
+
+    qint64 startNs = perfNowNs();
+    VideoPlayer pusher;
+    if (sc.push) {
+        if (QStandardPaths::findExecutable("ffmpeg").isEmpty()) {
+            result.skipped = true;
+            result.error = "ffmpeg not found in PATH";
+            return result;
+        }
+        if (sc.encode) {
+            // 原始分辨率、与源相同的帧率和码率编码一路，只比较编码参数带来的延迟差别
+            PushRendition rendition;
+            rendition.output = server.url("/push");
+            rendition.fps = sc.encodeFps;
+            rendition.bitrateBps = sc.encodeBitrateBps;
+            PushJobSpec spec;
+            spec.id = "rtspe2e";
+            spec.input = server.url("/test");
+            spec.renditions.append(rendition);
+            spec.lowLatency = sc.lowLatency;
+            spec.retry.maxRetries = 0;
+            PushJobManager::instance()->submit(spec);
+        } else {
+            pusher.startPushing(server.url("/test"), server.url("/push"));
+        }
+        if (!waitFor([&]() { return server.hasPublisher("/push"); }, 10000)) {
+            pusher.stopPushing();
+            PushJobManager::instance()->remove("rtspe2e");
+            result.error = "publisher did not connect";
+            return result;
+        }
+    }
+
+    VideoPlayer player;
+    player.setAudioEnabled(false);
+    player.setTransportProtocol(sc.transport);
+    player.setStreamUrl(server.url(sc.push ? "/push" : "/test"));
+
+    QEventLoop loop;
+    LatencyHistogram latency;   // 只在播放线程写
+    std::atomic<quint64> frames(0), stamped(0);
+    std::atomic<qint64> firstFrameNs(0), disconnectNs(0), recoveredNs(0);
+    std::atomic<bool> reconnecting(false);
+
+    // 与帧信号同一线程直连，重连信号和之后的第一帧严格有序
+    QObject::connect(&player, &VideoPlayer::sig_Reconnecting, &player, [&](int) {
+        if (disconnectNs.load())
+            reconnecting = true;
+    }, Qt::DirectConnection);
+    QObject::connect(&player, &VideoPlayer::sig_GetOneFrame, &player, [&](QImage image) {
+        qint64 now = perfNowNs();
+        qint64 expected = 0;
+        firstFrameNs.compare_exchange_strong(expected, now);
+        frames++;
+
+        quint32 stamp;
+        if (TimestampCode::read(image, &stamp)) {
+            qint32 ms = TimestampCode::elapsedMs(stamp);
+            if (ms >= 0) {
+                latency.record(qint64(ms) * 1000);
+                stamped++;
+            }
+        }
+
+        if (reconnecting && recoveredNs.load() == 0) {
+            recoveredNs = now;
+            // 恢复后再采集一会儿延迟
+            QMetaObject::invokeMethod(&loop, [&loop]() {
+                QTimer::singleShot(2000, &loop, &QEventLoop::quit);
+            }, Qt::QueuedConnection);
+        }
+    }, Qt::DirectConnection);
+    QObject::connect(&player, &VideoPlayer::sig_StreamError, &loop, [&](const QString &msg) {
+        result.error = msg;
+        loop.quit();
+    });
+
+    if (sc.reconnect) {
+        QTimer::singleShot(seconds * 1000 / 2, &loop, [&]() {
+            disconnectNs = perfNowNs();
+            server.disconnectAll(offlineMs);
+        });
+        QTimer::singleShot(seconds * 1000 / 2 + int(limits.maxReconnectMs) + 2000, &loop, &QEventLoop::quit);
+    } else {
+        QTimer::singleShot(seconds * 1000, &loop, &QEventLoop::quit);
+    }
+
+    player.startPlay();
+    loop.exec();
+    player.stopPlay();
+    if (sc.push) {
+        pusher.stopPushing();
+        PushJobManager::instance()->remove("rtspe2e");
+    }
+
+    result.frames = frames.load();
+    result.stamped = stamped.load();
+    if (firstFrameNs.load())
+        result.startupMs = (firstFrameNs.load() - startNs) / 1e6;
+    if (recoveredNs.load())
+        result.reconnectMs = (recoveredNs.load() - disconnectNs.load()) / 1e6;
+    result.p50Ms = latency.percentile(0.50) / 1000.0;
+    result.p90Ms = latency.percentile(0.90) / 1000.0;
+    result.p99Ms = latency.percentile(0.99) / 1000.0;
+    result.maxMs = latency.maxValue() / 1000.0;
+
+    result.passed = result.error.isEmpty() && result.frames > 0 && result.stamped > 0
+            && result.startupMs <= limits.maxStartupMs
+            && result.p99Ms <= limits.maxLatencyMs;
+    if (sc.reconnect)
+        result.passed = result.passed && result.reconnectMs >= 0 && result.reconnectMs <= limits.maxReconnectMs;
+    return result;
+}
+
+static QJsonObject resultJson(const ScenarioResult &r)
+{
+    QJsonObject o;
+    o["scenario"] = r.name;
+    o["status"] = r.skipped ? "skipped" : (r.passed ? "pass" : "fail");
+    if (!r.error.isEmpty())
+        o["error"] = r.error;
+    o["frames"] = double(r.frames);
+    o["stamped_frames"] = double(r.stamped);
+    o["startup_ms"] = r.startupMs;
+    if (r.reconnectMs >= 0)
+        o["reconnect_ms"] = r.reconnectMs;
+
+    QJsonObject lat;
+    lat["p50"] = r.p50Ms;
+    lat["p90"] = r.p90Ms;
+    lat["p99"] = r.p99Ms;
+    lat["max"] = r.maxMs;
+    o["glass_to_glass_ms"] = lat;
+    return o;
+}
+
+static void printResult(QTextStream &out, const ScenarioResult &r)
+{
+    out << QString("%1 %2\n").arg(r.name, -15).arg(r.skipped ? "SKIP" : (r.passed ? "PASS" : "FAIL"));
+    if (!r.error.isEmpty())
+        out << "  error:     " << r.error << "\n";
+    if (!r.skipped) {
+        out << QString("  frames:    %1 (%2 stamped)  startup %3 ms\n")
+               .arg(r.frames).arg(r.stamped).arg(r.startupMs, 0, 'f', 0);
+        out << QString("  latency:   p50 %1  p90 %2  p99 %3  max %4 ms\n")
+               .arg(r.p50Ms, 0, 'f', 0).arg(r.p90Ms, 0, 'f', 0)
+               .arg(r.p99Ms, 0, 'f', 0).arg(r.maxMs, 0, 'f', 0);
+        if (r.reconnectMs >= 0)
+            out << QString("  reconnect: %1 ms\n").arg(r.reconnectMs, 0, 'f', 0);
+    }
+    out.flush();
+}
+
+// push-encode 与 push-lowlatency 都跑了时并排输出两者的延迟分位数，差值为低延迟减默认
+static QJsonObject printComparison(QTextStream &out, const QList<ScenarioResult> &all)
+{
+    const ScenarioResult *base = nullptr;
+    const ScenarioResult *low = nullptr;
+    for (const ScenarioResult &r : all) {
+        if (r.skipped || r.stamped == 0)
+            continue;
+        if (r.name == "push-encode")
+            base = &r;
+        else if (r.name == "push-lowlatency")
+            low = &r;
+    }
+    if (!base || !low)
+        return QJsonObject();
+
+    out << "push-encode vs push-lowlatency (ms)\n";
+    out << QString("  %1 %2 %3 %4\n").arg("", -5).arg("default", 9).arg("lowlat", 9).arg("delta", 9);
+    const double b[] = { base->p50Ms, base->p90Ms, base->p99Ms, base->maxMs };
+    const double l[] = { low->p50Ms, low->p90Ms, low->p99Ms, low->maxMs };
+    const char *names[] = { "p50", "p90", "p99", "max" };
+    QJsonObject o;
+    for (int i = 0; i < 4; i++) {
+        out << QString("  %1 %2 %3 %4\n").arg(names[i], -5)
+               .arg(b[i], 9, 'f', 0).arg(l[i], 9, 'f', 0).arg(l[i] - b[i], 9, 'f', 0);
+        o[QString(names[i]) + "_delta"] = l[i] - b[i];
+    }
+    out.flush();
+    return o;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("rtspe2e");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("End-to-end RTSP pull/push test against a loopback server");
+    parser.addHelpOption();
+    QCommandLineOption scenariosOpt("scenarios", "Comma separated scenario list", "list",
+                                    "pull-tcp,pull-udp,reconnect,push,push-reconnect");
+    QCommandLineOption sourceOpt("source", "Synthetic source WxH@FPS", "WxH@FPS", "1280x720@30");
+    QCommandLineOption bitrateOpt("bitrate", "Synthetic encoder bitrate (bps)", "bps", "2000000");
+    QCommandLineOption secondsOpt("seconds", "Duration of each scenario", "s", "10");
+    QCommandLineOption lossOpt("loss", "Packet loss ratio for pull-udp", "ratio", "0.01");
+    QCommandLineOption jitterOpt("jitter", "Jitter for pull-udp", "ms", "20");
+    QCommandLineOption offlineOpt("offline-ms", "Server downtime in reconnect scenarios", "ms", "1000");
+    QCommandLineOption maxStartupOpt("max-startup", "Startup threshold", "ms", "3000");
+    QCommandLineOption maxLatencyOpt("max-latency", "p99 glass-to-glass threshold", "ms", "500");
+    QCommandLineOption maxReconnectOpt("max-reconnect", "Reconnect threshold", "ms", "10000");
+    QCommandLineOption jsonOpt("json", "Write results as JSON", "file");
+    parser.addOptions({ scenariosOpt, sourceOpt, bitrateOpt, secondsOpt, lossOpt, jitterOpt, offlineOpt,
+                        maxStartupOpt, maxLatencyOpt, maxReconnectOpt, jsonOpt });
+    parser.process(app);
+
+    QTextStream out(stdout);
+
+    RtpSource::Options options;
+    if (!options.synthetic.parse(parser.value(sourceOpt))) {
+        out << "Invalid --source value\n";
+        return 2;
+    }
+    options.synthetic.bitrate = parser.value(bitrateOpt).toInt();
+    options.synthetic.gop = options.synthetic.fps;   // 1 秒一个关键帧，缩短起播和恢复时间
+    options.synthetic.timestamp = true;
+
+    RtpSource source;
+    RtspTestServer server;
+    QString error;
+    if (!source.prepare(options, &error) || !server.listen(0, &error)) {
+        out << error << "\n";
+        return 2;
+    }
+    server.addGeneratedStream("/test", &source);
+    source.start();
+
+    Thresholds limits;
+    limits.maxStartupMs = parser.value(maxStartupOpt).toDouble();
+    limits.maxLatencyMs = parser.value(maxLatencyOpt).toDouble();
+    limits.maxReconnectMs = parser.value(maxReconnectOpt).toDouble();
+
+    QList<Scenario> scenarios;
+    for (const QString &name : parser.value(scenariosOpt).split(',', QString::SkipEmptyParts)) {
+        Scenario sc;
+        sc.name = name.trimmed();
+        if (sc.name == "pull-udp") {
+            sc.transport = "udp";
+            sc.loss = parser.value(lossOpt).toDouble();
+            sc.jitterMs = parser.value(jitterOpt).toInt();
+        } else if (sc.name == "reconnect") {
+            sc.reconnect = true;
+        } else if (sc.name == "push") {
+            sc.push = true;
+        } else if (sc.name == "push-reconnect") {
+            sc.push = true;
+            sc.reconnect = true;
+        } else if (sc.name == "push-encode" || sc.name == "push-lowlatency") {
+            sc.push = true;
+            sc.encode = true;
+            sc.lowLatency = sc.name == "push-lowlatency";
+            sc.encodeFps = options.synthetic.fps;
+            sc.encodeBitrateBps = options.synthetic.bitrate;
+        } else if (sc.name != "pull-tcp") {
+            out << "Unknown scenario " << sc.name << "\n";
+            return 2;
+        }
+        scenarios.append(sc);
+    }
+
+    out << "Serving " << server.url("/test") << " (" << options.synthetic.toString() << ")\n";
+    out.flush();
+
+    QJsonArray results;
+    QList<ScenarioResult> all;
+    bool allPassed = true;
+    for (const Scenario &sc : scenarios) {
+        ScenarioResult r = runScenario(server, sc, parser.value(secondsOpt).toInt(),
+                                       parser.value(offlineOpt).toInt(), limits);
+        printResult(out, r);
+        results.append(resultJson(r));
+        all.append(r);
+        if (!r.skipped && !r.passed)
+            allPassed = false;
+    }
+    QJsonObject comparison = printComparison(out, all);
+
+    source.stop();
+
+    if (parser.isSet(jsonOpt)) {
+        QJsonObject root;
+        root["source"] = options.synthetic.toString();
+        root["passed"] = allPassed;
+        root["scenarios"] = results;
+        if (!comparison.isEmpty())
+            root["push_lowlatency_vs_encode_ms"] = comparison;
+        QFile file(parser.value(jsonOpt));
+        if (file.open(QIODevice::WriteOnly))
+            file.write(QJsonDocument(root).toJson());
+    }
+    return allPassed ? 0 : 1;
+}
@@ -0,0 +1,21 @@
+#-------------------------------------------------
+#
+# 端到端测试：本地回环 RTSP 服务器 + VideoPlayer，
+# 测量起播时间、镜头到屏幕延迟和断线重连时间（拉流与推流两条路径）
+#
+#-------------------------------------------------
+
+QT       += core gui multimedia concurrent network
+QT       -= widgets
+
+CONFIG   += console c++11
+CONFIG   -= app_bundle
+
+TARGET = rtspe2e
+TEMPLATE = app
+
+include(../../videoplayer_core.pri)
+include(../common/common.pri)
+include(../rtsptestserver/rtspserver.pri)
+
+SOURCES += main.cpp
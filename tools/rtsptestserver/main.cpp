@@ -0,0 +1,128 @@
+/**
+ * rtsptestserver：本地回环 RTSP 测试服务器
+ *
+ * 用法：
+ *   rtsptestserver --source synthetic:1280x720@30 --bitrate 2000000
+ *   rtsptestserver --source sample.mp4 --loss 0.02 --jitter 40
+ *   rtsptestserver --disconnect-every 30 --offline-ms 3000
+ *
+ * 播放：rtsp://127.0.0.1:8554/test
+ * 推流：任意其他路径（ANNOUNCE/RECORD），同一路径上的播放端收到转发的包
+ *
+ * 运行中可在标准输入输入命令：
+ *   loss 0.05 | jitter 30 | drop [离线毫秒] | quit
+ */
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDebug>
+#include <QTextStream>
+
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "rtspserver.h"
+#include "rtpsource.h"
+
+static void handleCommand(RtspTestServer *server, const QString &line)
+{
+    QStringList args = line.split(' ', QString::SkipEmptyParts);
+    if (args.isEmpty())
+        return;
+    QTextStream out(stdout);
+    const QString cmd = args.first();
+    if (cmd == "loss" && args.size() > 1) {
+        server->setPacketLoss(args.at(1).toDouble());
+        out << "loss " << args.at(1) << "\n";
+    } else if (cmd == "jitter" && args.size() > 1) {
+        server->setJitter(args.at(1).toInt());
+        out << "jitter " << args.at(1) << " ms\n";
+    } else if (cmd == "drop") {
+        server->disconnectAll(args.size() > 1 ? args.at(1).toInt() : 0);
+    } else if (cmd == "quit") {
+        QCoreApplication::quit();
+    } else {
+        out << "commands: loss <ratio> | jitter <ms> | drop [offline ms] | quit\n";
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("rtsptestserver");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Loopback RTSP server with impairment injection");
+    parser.addHelpOption();
+    QCommandLineOption portOpt("port", "TCP port", "port", "8554");
+    QCommandLineOption pathOpt("path", "Path of the generated stream", "path", "/test");
+    QCommandLineOption sourceOpt("source", "synthetic:WxH@FPS or a media file", "source", "synthetic:1280x720@30");
+    QCommandLineOption bitrateOpt("bitrate", "Synthetic encoder bitrate (bps)", "bps", "2000000");
+    QCommandLineOption gopOpt("gop", "Synthetic keyframe interval in frames (0 = 2 s)", "frames", "0");
+    QCommandLineOption lossOpt("loss", "RTP packet loss ratio 0..1", "ratio", "0");
+    QCommandLineOption jitterOpt("jitter", "Random per-packet delay 0..ms", "ms", "0");
+    QCommandLineOption disconnectOpt("disconnect-every", "Drop all sessions every N seconds", "s", "0");
+    QCommandLineOption offlineOpt("offline-ms", "Refuse connections for ms after a drop", "ms", "0");
+    QCommandLineOption noStampOpt("no-timestamp", "Do not burn the latency barcode into synthetic frames");
+    parser.addOptions({ portOpt, pathOpt, sourceOpt, bitrateOpt, gopOpt, lossOpt, jitterOpt,
+                        disconnectOpt, offlineOpt, noStampOpt });
+    parser.process(app);
+
+    QTextStream out(stdout);
+
+    RtpSource::Options options;
+    QString source = parser.value(sourceOpt);
+    if (source.startsWith("synthetic:")) {
+        if (!options.synthetic.parse(source.mid(10))) {
+            out << "Invalid --source value\n";
+            return 2;
+        }
+        options.synthetic.bitrate = parser.value(bitrateOpt).toInt();
+        options.synthetic.gop = parser.value(gopOpt).toInt();
+        options.synthetic.timestamp = !parser.isSet(noStampOpt);
+    } else {
+        options.file = source;
+    }
+
+    RtpSource rtpSource;
+    QString error;
+    if (!rtpSource.prepare(options, &error)) {
+        out << error << "\n";
+        return 2;
+    }
+
+    RtspTestServer server;
+    if (!server.listen(quint16(parser.value(portOpt).toUInt()), &error)) {
+        out << "Cannot listen: " << error << "\n";
+        return 2;
+    }
+    server.addGeneratedStream(parser.value(pathOpt), &rtpSource);
+    server.setPacketLoss(parser.value(lossOpt).toDouble());
+    server.setJitter(parser.value(jitterOpt).toInt());
+    server.setAutoDisconnect(parser.value(disconnectOpt).toInt(), parser.value(offlineOpt).toInt());
+    QObject::connect(&server, &RtspTestServer::sig_Log, [](const QString &line) {
+        qDebug().noquote() << line;
+    });
+
+    rtpSource.start();
+    out << "Serving " << server.url(parser.value(pathOpt)) << "\n";
+    out.flush();
+
+    // 标准输入命令：读线程阻塞在 getline 上，命令排队到主线程执行
+    std::thread stdinThread([&server]() {
+        std::string line;
+        while (std::getline(std::cin, line)) {
+            QString cmd = QString::fromStdString(line).trimmed();
+            QMetaObject::invokeMethod(&server, [&server, cmd]() { handleCommand(&server, cmd); },
+                                      Qt::QueuedConnection);
+            if (cmd == "quit")
+                break;
+        }
+    });
+    stdinThread.detach();
+
+    int ret = app.exec();
+    rtpSource.stop();
+    return ret;
+}
@@ -0,0 +1,204 @@
+#include "rtpsource.h"
+
+#include <QElapsedTimer>
+#include <QDebug>
+
+static const int kRtpPacketSize = 1400;
+
+RtpSource::RtpSource(QObject *parent)
+    : QThread(parent), mSynthetic(nullptr), mInputCtx(nullptr), mInputStream(-1),
+      mRtpCtx(nullptr), mStopRequested(false)
+{
+}
+
+RtpSource::~RtpSource()
+{
+    stop();
+    delete mSynthetic;
+    if (mInputCtx)
+        avformat_close_input(&mInputCtx);
+    if (mRtpCtx) {
+        if (mRtpCtx->pb) {
+            av_freep(&mRtpCtx->pb->buffer);
+            avio_context_free(&mRtpCtx->pb);
+        }
+        avformat_free_context(mRtpCtx);
+    }
+}
+
+void RtpSource::stop()
+{
+    mStopRequested = true;
+    wait();
+}
+
+QByteArray RtpSource::sdp() const
+{
+    return mSdp;
+}
+
+bool RtpSource::prepare(const Options &options, QString *error)
+{
+    mOptions = options;
+
+    if (options.file.isEmpty()) {
+        mSynthetic = new SyntheticSource(options.synthetic);
+        if (!mSynthetic->open(true, error))   // SDP 需要 SPS/PPS，必须用全局头
+            return false;
+
+        AVCodecParameters *par = avcodec_parameters_alloc();
+        avcodec_parameters_from_context(par, mSynthetic->codecContext());
+        bool ok = openRtpMuxer(par, error);
+        avcodec_parameters_free(&par);
+        return ok;
+    }
+
+    QByteArray path = options.file.toUtf8();
+    if (avformat_open_input(&mInputCtx, path.constData(), nullptr, nullptr) < 0
+            || avformat_find_stream_info(mInputCtx, nullptr) < 0) {
+        if (error) *error = QString("Cannot open %1").arg(options.file);
+        return false;
+    }
+    mInputStream = av_find_best_stream(mInputCtx, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+    if (mInputStream < 0) {
+        if (error) *error = QString("No video stream in %1").arg(options.file);
+        return false;
+    }
+    return openRtpMuxer(mInputCtx->streams[mInputStream]->codecpar, error);
+}
+
+// RTP 封装写到自定义 AVIO，每次 flush 恰好是一个 RTP/RTCP 包
+bool RtpSource::openRtpMuxer(const AVCodecParameters *par, QString *error)
+{
+    AVOutputFormat *fmt = av_guess_format("rtp", nullptr, nullptr);
+    if (avformat_alloc_output_context2(&mRtpCtx, fmt, nullptr, "rtp://127.0.0.1") < 0 || !mRtpCtx) {
+        if (error) *error = "RTP muxer not available";
+        return false;
+    }
+
+    AVStream *st = avformat_new_stream(mRtpCtx, nullptr);
+    avcodec_parameters_copy(st->codecpar, par);
+    st->codecpar->codec_tag = 0;
+
+    const int bufSize = 4096;
+    uint8_t *buf = static_cast<uint8_t *>(av_malloc(bufSize));
+    mRtpCtx->pb = avio_alloc_context(buf, bufSize, 1, this, nullptr, &RtpSource::writePacket, nullptr);
+    mRtpCtx->pb->max_packet_size = kRtpPacketSize;
+    mRtpCtx->flags |= AVFMT_FLAG_CUSTOM_IO;
+
+    if (avformat_write_header(mRtpCtx, nullptr) < 0) {
+        if (error) *error = "Cannot start RTP muxer";
+        return false;
+    }
+
+    char sdp[8192];
+    if (av_sdp_create(&mRtpCtx, 1, sdp, sizeof(sdp)) < 0) {
+        if (error) *error = "Cannot create SDP";
+        return false;
+    }
+    mSdp = QByteArray(sdp);
+    return true;
+}
+
+int RtpSource::writePacket(void *opaque, uint8_t *buf, int size)
+{
+    RtpSource *self = static_cast<RtpSource *>(opaque);
+    // RTCP 包类型 200~204 落在第二个字节
+    bool rtcp = size >= 2 && buf[1] >= 200 && buf[1] <= 204;
+    emit self->sig_RtpPacket(0, rtcp, QByteArray(reinterpret_cast<const char *>(buf), size));
+    return size;
+}
+
+void RtpSource::sendPacket(AVPacket *pkt, AVRational srcTimeBase)
+{
+    av_packet_rescale_ts(pkt, srcTimeBase, mRtpCtx->streams[0]->time_base);
+    pkt->stream_index = 0;
+    if (av_write_frame(mRtpCtx, pkt) < 0)
+        qWarning() << "RtpSource: write failed";
+}
+
+void RtpSource::run()
+{
+    if (mSynthetic)
+        runSynthetic();
+    else if (mInputCtx)
+        runFile();
+}
+
+void RtpSource::runSynthetic()
+{
+    const int fps = mOptions.synthetic.fps;
+    AVRational encTb = mSynthetic->codecContext()->time_base;
+    auto sink = [this, encTb](AVPacket *pkt) { sendPacket(pkt, encTb); };
+
+    QElapsedTimer clock;
+    clock.start();
+    for (qint64 i = 0; !mStopRequested; i++) {
+        qint64 dueMs = i * 1000 / fps;
+        qint64 now;
+        while (!mStopRequested && (now = clock.elapsed()) < dueMs)
+            msleep(qMin<qint64>(dueMs - now, 5));
+        if (!mSynthetic->encodeFrame(i, sink)) {
+            qWarning() << "RtpSource: encoding failed";
+            break;
+        }
+    }
+}
+
+void RtpSource::runFile()
+{
+    AVStream *in = mInputCtx->streams[mInputStream];
+    qint64 firstTs = AV_NOPTS_VALUE;
+    qint64 offset = 0, lastEnd = 0;
+    bool readSinceSeek = false;   // 这一轮读到过包；回到开头后一个包都读不到说明文件不可循环
+    AVPacket pkt;
+    av_init_packet(&pkt);
+
+    QElapsedTimer clock;
+    clock.start();
+    while (!mStopRequested) {
+        if (av_read_frame(mInputCtx, &pkt) < 0) {
+            if (!mOptions.loop)
+                break;
+            // 循环播放：时间戳接在上一轮末尾，保证 RTP 时间戳单调。
+            // 回不到开头（不可定位的输入）或回去后读不到包时停止，不空转
+            if (!readSinceSeek) {
+                qWarning() << "RtpSource: input has no packets to loop, stopping";
+                break;
+            }
+            int ret = av_seek_frame(mInputCtx, mInputStream,
+                                    in->start_time != AV_NOPTS_VALUE ? in->start_time : 0, AVSEEK_FLAG_BACKWARD);
+            if (ret < 0) {
+                qWarning() << "RtpSource: cannot seek back to the start for looping, stopping";
+                break;
+            }
+            readSinceSeek = false;
+            offset = lastEnd;
+            continue;
+        }
+        readSinceSeek = true;
+        if (pkt.stream_index != mInputStream) {
+            av_packet_unref(&pkt);
+            continue;
+        }
+
+        qint64 ts = pkt.dts != AV_NOPTS_VALUE ? pkt.dts : pkt.pts;
+        if (ts == AV_NOPTS_VALUE)
+            ts = firstTs != AV_NOPTS_VALUE ? firstTs : 0;
+        if (firstTs == AV_NOPTS_VALUE)
+            firstTs = ts;
+
+        qint64 shift = offset - firstTs;
+        qint64 tsAdj = ts + shift;
+        qint64 dueMs = av_rescale_q(tsAdj, in->time_base, av_make_q(1, 1000));
+        qint64 now;
+        while (!mStopRequested && (now = clock.elapsed()) < dueMs)
+            msleep(qMin<qint64>(dueMs - now, 5));
+
+        lastEnd = qMax(lastEnd, tsAdj + qMax<qint64>(pkt.duration, 1));
+        if (pkt.pts != AV_NOPTS_VALUE) pkt.pts += shift;
+        if (pkt.dts != AV_NOPTS_VALUE) pkt.dts += shift;
+        sendPacket(&pkt, in->time_base);
+        av_packet_unref(&pkt);
+    }
+}
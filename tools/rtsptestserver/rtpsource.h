@@ -0,0 +1,54 @@
+#ifndef RTPSOURCE_H
+#define RTPSOURCE_H
+
+#include <QThread>
+#include <QByteArray>
+
+#include "syntheticsource.h"
+
+extern "C" {
+    #include <libavformat/avformat.h>
+}
+
+// 测试源：生成的合成画面或本地文件，按实时节奏打包成 RTP
+class RtpSource : public QThread
+{
+    Q_OBJECT
+
+public:
+    struct Options {
+        QString file;              // 为空时使用合成画面
+        SyntheticSpec synthetic;
+        bool loop = true;          // 文件播完后从头循环
+    };
+
+    explicit RtpSource(QObject *parent = nullptr);
+    ~RtpSource();
+
+    bool prepare(const Options &options, QString *error);
+    QByteArray sdp() const;
+    void stop();
+
+signals:
+    void sig_RtpPacket(int track, bool rtcp, const QByteArray &packet);
+
+protected:
+    void run() override;
+
+private:
+    static int writePacket(void *opaque, uint8_t *buf, int size);
+    bool openRtpMuxer(const AVCodecParameters *par, QString *error);
+    void sendPacket(AVPacket *pkt, AVRational srcTimeBase);
+    void runSynthetic();
+    void runFile();
+
+    Options mOptions;
+    SyntheticSource *mSynthetic;
+    AVFormatContext *mInputCtx;
+    int mInputStream;
+    AVFormatContext *mRtpCtx;
+    QByteArray mSdp;
+    volatile bool mStopRequested;
+};
+
+#endif // RTPSOURCE_H
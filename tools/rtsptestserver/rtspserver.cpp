@@ -0,0 +1,168 @@
+#include "rtspserver.h"
+#include "rtspsession.h"
+#include "rtpsource.h"
+
+#include <QRandomGenerator>
+#include <QTcpSocket>
+
+RtspTestServer::RtspTestServer(QObject *parent)
+    : QObject(parent), mLoss(0.0), mJitterMs(0), mOfflineUntilMs(0), mAutoOfflineMs(0)
+{
+    mClock.start();
+    connect(&mServer, &QTcpServer::newConnection, this, &RtspTestServer::onNewConnection);
+    connect(&mAutoDisconnectTimer, &QTimer::timeout, this, [this]() {
+        disconnectAll(mAutoOfflineMs);
+    });
+}
+
+RtspTestServer::~RtspTestServer()
+{
+    mServer.close();
+    const QList<RtspSession *> sessions = mSessions;
+    for (RtspSession *s : sessions)
+        s->close();
+}
+
+bool RtspTestServer::listen(quint16 port, QString *error)
+{
+    if (!mServer.listen(QHostAddress::LocalHost, port)) {
+        if (error) *error = mServer.errorString();
+        return false;
+    }
+    return true;
+}
+
+quint16 RtspTestServer::port() const
+{
+    return mServer.serverPort();
+}
+
+QString RtspTestServer::url(const QString &path) const
+{
+    return QString("rtsp://127.0.0.1:%1%2").arg(port()).arg(path);
+}
+
+void RtspTestServer::addGeneratedStream(const QString &path, RtpSource *source)
+{
+    StreamInfo info;
+    info.sdp = source->sdp();
+    info.tracks << "streamid=0";
+    info.generated = true;
+    mStreams[path] = info;
+
+    // 包在编码线程产生，排队到本线程再分发
+    connect(source, &RtpSource::sig_RtpPacket, this,
+            [this, path](int track, bool rtcp, const QByteArray &packet) {
+        deliver(path, track, rtcp, packet);
+    });
+}
+
+void RtspTestServer::setPacketLoss(double ratio)
+{
+    mLoss = qBound(0.0, ratio, 1.0);
+}
+
+void RtspTestServer::setJitter(int ms)
+{
+    mJitterMs = qMax(0, ms);
+}
+
+void RtspTestServer::disconnectAll(int offlineMs)
+{
+    emit sig_Log(QString("disconnect all sessions, offline %1 ms").arg(offlineMs));
+    mOfflineUntilMs = mClock.elapsed() + offlineMs;
+    const QList<RtspSession *> sessions = mSessions;
+    for (RtspSession *s : sessions)
+        s->close();
+}
+
+void RtspTestServer::setAutoDisconnect(int intervalSec, int offlineMs)
+{
+    mAutoOfflineMs = offlineMs;
+    if (intervalSec > 0)
+        mAutoDisconnectTimer.start(intervalSec * 1000);
+    else
+        mAutoDisconnectTimer.stop();
+}
+
+int RtspTestServer::sessionCount() const
+{
+    return mSessions.size();
+}
+
+bool RtspTestServer::hasPublisher(const QString &path) const
+{
+    return mStreams.contains(path) && mStreams.value(path).publisher;
+}
+
+void RtspTestServer::onNewConnection()
+{
+    while (mServer.hasPendingConnections()) {
+        QTcpSocket *socket = mServer.nextPendingConnection();
+        // 模拟服务器不可用
+        if (mClock.elapsed() < mOfflineUntilMs) {
+            socket->abort();
+            socket->deleteLater();
+            continue;
+        }
+        mSessions.append(new RtspSession(socket, this));
+    }
+}
+
+// 路径可以是流本身（/test），也可以是流下的轨道（/test/streamid=0）
+bool RtspTestServer::findStream(const QString &urlPath, QString *path, int *track) const
+{
+    QString p = urlPath;
+    while (p.endsWith('/'))
+        p.chop(1);
+
+    for (auto it = mStreams.constBegin(); it != mStreams.constEnd(); ++it) {
+        if (p == it.key()) {
+            *path = it.key();
+            *track = it.value().tracks.size() == 1 ? 0 : -1;
+            return true;
+        }
+        if (p.startsWith(it.key() + "/")) {
+            *path = it.key();
+            *track = it.value().tracks.indexOf(p.mid(it.key().size() + 1));
+            return true;
+        }
+    }
+    return false;
+}
+
+void RtspTestServer::deliver(const QString &path, int track, bool rtcp, const QByteArray &packet)
+{
+    if (!rtcp && mLoss > 0.0 && QRandomGenerator::global()->generateDouble() < mLoss)
+        return;
+
+    const QList<RtspSession *> sessions = mSessions;
+    for (RtspSession *s : sessions) {
+        if (!s->isPlaying(path))
+            continue;
+        int delay = mJitterMs > 0 ? int(QRandomGenerator::global()->bounded(mJitterMs + 1)) : 0;
+        s->sendPacket(track, rtcp, packet, delay);
+    }
+}
+
+void RtspTestServer::removeSession(RtspSession *session)
+{
+    mSessions.removeAll(session);
+
+    // 推流端离开：移除该路径，断开正在播放它的客户端，让它们重连
+    for (auto it = mStreams.begin(); it != mStreams.end(); ) {
+        if (it.value().publisher != session) {
+            ++it;
+            continue;
+        }
+        QString path = it.key();
+        it = mStreams.erase(it);
+        emit sig_Log(QString("publisher left %1").arg(path));
+
+        const QList<RtspSession *> sessions = mSessions;
+        for (RtspSession *s : sessions) {
+            if (s->path() == path)
+                s->close();
+        }
+    }
+}
@@ -0,0 +1,74 @@
+#ifndef RTSPSERVER_H
+#define RTSPSERVER_H
+
+#include <QObject>
+#include <QTcpServer>
+#include <QTimer>
+#include <QMap>
+#include <QList>
+#include <QStringList>
+#include <QElapsedTimer>
+
+class RtpSource;
+class RtspSession;
+
+// 只监听 127.0.0.1 的最小 RTSP 服务器，用于离线测试：
+//  - 播放端：DESCRIBE/SETUP/PLAY，支持 TCP 交织和 UDP 单播
+//  - 推流端：ANNOUNCE/SETUP/RECORD（TCP 交织），收到的包转发给同一路径的播放端
+//  - 可注入丢包、抖动和断线
+class RtspTestServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit RtspTestServer(QObject *parent = nullptr);
+    ~RtspTestServer();
+
+    bool listen(quint16 port, QString *error);
+    quint16 port() const;
+    QString url(const QString &path) const;
+
+    // 把测试源挂到某个路径上，例如 "/test"
+    void addGeneratedStream(const QString &path, RtpSource *source);
+
+    void setPacketLoss(double ratio);      // 0~1，只丢 RTP，不丢 RTCP
+    void setJitter(int ms);                // 每个包随机延迟 0~ms
+    void disconnectAll(int offlineMs = 0); // 断开所有连接，offlineMs 内拒绝新连接
+    void setAutoDisconnect(int intervalSec, int offlineMs);
+
+    int sessionCount() const;
+    bool hasPublisher(const QString &path) const;
+
+signals:
+    void sig_Log(const QString &line);
+
+private slots:
+    void onNewConnection();
+
+private:
+    friend class RtspSession;
+
+    struct StreamInfo {
+        QByteArray sdp;
+        QStringList tracks;                 // 各轨道的 a=control
+        RtspSession *publisher = nullptr;   // 为空且非生成源时，路径不可播放
+        bool generated = false;
+    };
+
+    bool findStream(const QString &urlPath, QString *path, int *track) const;
+    void deliver(const QString &path, int track, bool rtcp, const QByteArray &packet);
+    void removeSession(RtspSession *session);
+
+    QTcpServer mServer;
+    QMap<QString, StreamInfo> mStreams;
+    QList<RtspSession *> mSessions;
+
+    double mLoss;
+    int mJitterMs;
+    QElapsedTimer mClock;
+    qint64 mOfflineUntilMs;
+    QTimer mAutoDisconnectTimer;
+    int mAutoOfflineMs;
+};
+
+#endif // RTSPSERVER_H
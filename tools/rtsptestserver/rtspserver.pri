@@ -0,0 +1,15 @@
+# 本地回环 RTSP 测试服务器，rtsptestserver 与 rtspe2e 共用
+
+QT += network
+
+INCLUDEPATH += $$PWD
+
+SOURCES += \
+    $$PWD/rtpsource.cpp \
+    $$PWD/rtspserver.cpp \
+    $$PWD/rtspsession.cpp
+
+HEADERS += \
+    $$PWD/rtpsource.h \
+    $$PWD/rtspserver.h \
+    $$PWD/rtspsession.h
@@ -0,0 +1,306 @@
+#include "rtspsession.h"
+#include "rtspserver.h"
+
+#include <QRandomGenerator>
+#include <QRegularExpression>
+#include <QUrl>
+
+static const int kMaxHeaderSize = 64 * 1024;
+static const qint64 kMaxPendingBytes = 8 * 1024 * 1024;   // 慢客户端积压超过后丢包
+
+RtspSession::RtspSession(QTcpSocket *socket, RtspTestServer *server)
+    : QObject(server), mSocket(socket), mServer(server), mPlaying(false), mPublisher(false),
+      mClosed(false), mRtpSocket(nullptr), mRtcpSocket(nullptr), mLastDueMs(0)
+{
+    mSocket->setParent(this);
+    mSocket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+    mSessionId = QString::number(QRandomGenerator::global()->generate(), 16);
+    mClock.start();
+
+    mDelayTimer.setSingleShot(true);
+    connect(&mDelayTimer, &QTimer::timeout, this, &RtspSession::flushDelayed);
+    connect(mSocket, &QTcpSocket::readyRead, this, &RtspSession::onReadyRead);
+    connect(mSocket, &QTcpSocket::disconnected, this, &RtspSession::close);
+}
+
+RtspSession::~RtspSession()
+{
+}
+
+void RtspSession::close()
+{
+    if (mClosed)
+        return;
+    mClosed = true;
+    mPlaying = false;
+    mDelayTimer.stop();
+    mSocket->abort();
+    mServer->removeSession(this);
+    deleteLater();
+}
+
+void RtspSession::onReadyRead()
+{
+    mBuffer.append(mSocket->readAll());
+
+    while (!mBuffer.isEmpty() && !mClosed) {
+        // TCP 交织数据：'$' 通道 长度(2字节) 数据
+        if (mBuffer.at(0) == '$') {
+            if (mBuffer.size() < 4)
+                return;
+            int channel = quint8(mBuffer.at(1));
+            int length = (quint8(mBuffer.at(2)) << 8) | quint8(mBuffer.at(3));
+            if (mBuffer.size() < 4 + length)
+                return;
+            handleInterleaved(channel, mBuffer.mid(4, length));
+            mBuffer.remove(0, 4 + length);
+            continue;
+        }
+
+        int headerEnd = mBuffer.indexOf("\r\n\r\n");
+        if (headerEnd < 0) {
+            if (mBuffer.size() > kMaxHeaderSize)
+                close();
+            return;
+        }
+
+        Request req;
+        QList<QByteArray> lines = mBuffer.left(headerEnd).split('\n');
+        QList<QByteArray> requestLine = lines.first().trimmed().split(' ');
+        if (requestLine.size() < 2) {
+            close();
+            return;
+        }
+        req.method = QString::fromLatin1(requestLine.at(0)).toUpper();
+        req.url = QString::fromLatin1(requestLine.at(1));
+        for (int i = 1; i < lines.size(); i++) {
+            int colon = lines.at(i).indexOf(':');
+            if (colon <= 0)
+                continue;
+            QString key = QString::fromLatin1(lines.at(i).left(colon)).trimmed().toLower();
+            req.headers[key] = QString::fromLatin1(lines.at(i).mid(colon + 1)).trimmed();
+        }
+        req.cseq = req.headers.value("cseq").toInt();
+
+        int contentLength = req.headers.value("content-length").toInt();
+        if (mBuffer.size() < headerEnd + 4 + contentLength)
+            return;
+        req.body = mBuffer.mid(headerEnd + 4, contentLength);
+        mBuffer.remove(0, headerEnd + 4 + contentLength);
+
+        handleRequest(req);
+    }
+}
+
+void RtspSession::reply(const Request &req, int code, const QString &reason,
+                        const QStringList &headers, const QByteArray &body)
+{
+    QByteArray out = QString("RTSP/1.0 %1 %2\r\nCSeq: %3\r\nServer: rtsptestserver\r\n")
+            .arg(code).arg(reason).arg(req.cseq).toLatin1();
+    for (const QString &h : headers)
+        out += h.toLatin1() + "\r\n";
+    if (!body.isEmpty())
+        out += "Content-Length: " + QByteArray::number(body.size()) + "\r\n";
+    out += "\r\n";
+    out += body;
+    mSocket->write(out);
+}
+
+void RtspSession::handleRequest(const Request &req)
+{
+    emit mServer->sig_Log(QString("%1 %2").arg(req.method, req.url));
+    const QString sessionHeader = QString("Session: %1;timeout=60").arg(mSessionId);
+    const QString urlPath = QUrl(req.url).path();
+
+    if (req.method == "OPTIONS") {
+        reply(req, 200, "OK", QStringList()
+              << "Public: OPTIONS, DESCRIBE, SETUP, PLAY, PAUSE, TEARDOWN, ANNOUNCE, RECORD, GET_PARAMETER");
+    } else if (req.method == "DESCRIBE") {
+        QString path;
+        int track;
+        if (!mServer->findStream(urlPath, &path, &track)) {
+            reply(req, 404, "Not Found");
+            return;
+        }
+        const RtspTestServer::StreamInfo &info = mServer->mStreams[path];
+        QString base = req.url.endsWith('/') ? req.url : req.url + "/";
+        reply(req, 200, "OK", QStringList()
+              << "Content-Base: " + base
+              << "Content-Type: application/sdp", info.sdp);
+    } else if (req.method == "ANNOUNCE") {
+        QString path = urlPath;
+        while (path.endsWith('/'))
+            path.chop(1);
+        if (mServer->mStreams.contains(path)) {
+            reply(req, 403, "Forbidden");   // 已有生成源或其他推流端
+            return;
+        }
+
+        RtspTestServer::StreamInfo info;
+        info.sdp = req.body;
+        info.publisher = this;
+        // 每个 m= 段对应一个轨道，取其 a=control
+        QStringList sections = QString::fromLatin1(req.body).split(QRegularExpression("\r?\nm="));
+        for (int i = 1; i < sections.size(); i++) {
+            QRegularExpressionMatch m = QRegularExpression("a=control:(\\S+)").match(sections.at(i));
+            info.tracks << (m.hasMatch() ? m.captured(1) : QString("streamid=%1").arg(i - 1));
+        }
+        mServer->mStreams[path] = info;
+        mPath = path;
+        mPublisher = true;
+        reply(req, 200, "OK");
+    } else if (req.method == "SETUP") {
+        handleSetup(req);
+    } else if (req.method == "PLAY") {
+        if (mTransports.isEmpty()) {
+            reply(req, 455, "Method Not Valid in This State");
+            return;
+        }
+        mPlaying = true;
+        reply(req, 200, "OK", QStringList() << sessionHeader << "Range: npt=0.000-");
+    } else if (req.method == "RECORD") {
+        if (!mPublisher) {
+            reply(req, 455, "Method Not Valid in This State");
+            return;
+        }
+        reply(req, 200, "OK", QStringList() << sessionHeader);
+    } else if (req.method == "PAUSE") {
+        mPlaying = false;
+        reply(req, 200, "OK", QStringList() << sessionHeader);
+    } else if (req.method == "GET_PARAMETER" || req.method == "SET_PARAMETER") {
+        reply(req, 200, "OK", QStringList() << sessionHeader);
+    } else if (req.method == "TEARDOWN") {
+        reply(req, 200, "OK", QStringList() << sessionHeader);
+        mSocket->flush();
+        close();
+    } else {
+        reply(req, 501, "Not Implemented");
+    }
+}
+
+void RtspSession::handleSetup(const Request &req)
+{
+    const QString sessionHeader = QString("Session: %1;timeout=60").arg(mSessionId);
+    const QString transport = req.headers.value("transport");
+
+    QString path;
+    int track = -1;
+    if (!mServer->findStream(QUrl(req.url).path(), &path, &track) || track < 0) {
+        reply(req, 404, "Not Found");
+        return;
+    }
+
+    QRegularExpressionMatch interleaved =
+            QRegularExpression("interleaved=(\\d+)(?:-(\\d+))?").match(transport);
+
+    // 推流端：只支持 TCP 交织
+    if (mPublisher) {
+        if (path != mPath || !interleaved.hasMatch()) {
+            reply(req, 461, "Unsupported Transport");
+            return;
+        }
+        int channel = interleaved.captured(1).toInt();
+        mRecordChannels[channel] = track * 2;
+        mRecordChannels[channel + 1] = track * 2 + 1;
+        reply(req, 200, "OK", QStringList() << sessionHeader << "Transport: " + transport);
+        return;
+    }
+
+    if (!mPath.isEmpty() && mPath != path) {
+        reply(req, 459, "Aggregate Operation Not Allowed");
+        return;
+    }
+    mPath = path;
+
+    Transport t;
+    if (interleaved.hasMatch() || transport.contains("RTP/AVP/TCP")) {
+        t.tcp = true;
+        t.channel = interleaved.hasMatch() ? interleaved.captured(1).toInt() : track * 2;
+        mTransports[track] = t;
+        reply(req, 200, "OK", QStringList() << sessionHeader
+              << QString("Transport: RTP/AVP/TCP;unicast;interleaved=%1-%2").arg(t.channel).arg(t.channel + 1));
+        return;
+    }
+
+    QRegularExpressionMatch ports = QRegularExpression("client_port=(\\d+)(?:-(\\d+))?").match(transport);
+    if (!ports.hasMatch()) {
+        reply(req, 461, "Unsupported Transport");
+        return;
+    }
+    t.tcp = false;
+    t.clientRtpPort = quint16(ports.captured(1).toUInt());
+    t.clientRtcpPort = ports.captured(2).isEmpty() ? t.clientRtpPort + 1 : quint16(ports.captured(2).toUInt());
+
+    if (!mRtpSocket) {
+        mRtpSocket = new QUdpSocket(this);
+        mRtcpSocket = new QUdpSocket(this);
+        mRtpSocket->bind(QHostAddress::LocalHost, 0);
+        mRtcpSocket->bind(QHostAddress::LocalHost, 0);
+    }
+    mTransports[track] = t;
+    reply(req, 200, "OK", QStringList() << sessionHeader
+          << QString("Transport: RTP/AVP;unicast;client_port=%1-%2;server_port=%3-%4")
+             .arg(t.clientRtpPort).arg(t.clientRtcpPort)
+             .arg(mRtpSocket->localPort()).arg(mRtcpSocket->localPort()));
+}
+
+void RtspSession::handleInterleaved(int channel, const QByteArray &data)
+{
+    // 播放端回来的 RTCP 接收报告直接忽略
+    if (!mPublisher)
+        return;
+    int value = mRecordChannels.value(channel, -1);
+    if (value >= 0)
+        mServer->deliver(mPath, value / 2, value & 1, data);
+}
+
+void RtspSession::sendPacket(int track, bool rtcp, const QByteArray &packet, int delayMs)
+{
+    if (mClosed || !mTransports.contains(track))
+        return;
+    if (delayMs <= 0 && mDelayed.empty()) {
+        writeNow(track, rtcp, packet);
+        return;
+    }
+
+    qint64 due = mClock.elapsed() + qMax(0, delayMs);
+    // TCP 是有序的：抖动只能推迟，不能乱序；UDP 允许乱序
+    if (mTransports.value(track).tcp)
+        due = qMax(due, mLastDueMs);
+    mLastDueMs = due;
+
+    Delayed d;
+    d.track = track;
+    d.rtcp = rtcp;
+    d.packet = packet;
+    mDelayed.insert(std::make_pair(due, d));
+    mDelayTimer.start(int(qMax<qint64>(0, mDelayed.begin()->first - mClock.elapsed())));
+}
+
+void RtspSession::flushDelayed()
+{
+    qint64 now = mClock.elapsed();
+    while (!mDelayed.empty() && mDelayed.begin()->first <= now) {
+        Delayed d = mDelayed.begin()->second;
+        mDelayed.erase(mDelayed.begin());
+        writeNow(d.track, d.rtcp, d.packet);
+    }
+    if (!mDelayed.empty())
+        mDelayTimer.start(int(qMax<qint64>(0, mDelayed.begin()->first - now)));
+}
+
+void RtspSession::writeNow(int track, bool rtcp, const QByteArray &packet)
+{
+    const Transport t = mTransports.value(track);
+    if (t.tcp) {
+        if (mSocket->bytesToWrite() > kMaxPendingBytes)
+            return;
+        int channel = t.channel + (rtcp ? 1 : 0);
+        char header[4] = { '$', char(channel), char((packet.size() >> 8) & 0xff), char(packet.size() & 0xff) };
+        mSocket->write(header, 4);
+        mSocket->write(packet);
+    } else {
+        QUdpSocket *udp = rtcp ? mRtcpSocket : mRtpSocket;
+        udp->writeDatagram(packet, mSocket->peerAddress(), rtcp ? t.clientRtcpPort : t.clientRtpPort);
+    }
+}
@@ -0,0 +1,82 @@
+#ifndef RTSPSESSION_H
+#define RTSPSESSION_H
+
+#include <QObject>
+#include <QTcpSocket>
+#include <QUdpSocket>
+#include <QTimer>
+#include <QMap>
+#include <QElapsedTimer>
+
+#include <map>
+
+class RtspTestServer;
+
+// 一个 RTSP 控制连接：可能是播放端，也可能是推流端
+class RtspSession : public QObject
+{
+    Q_OBJECT
+
+public:
+    RtspSession(QTcpSocket *socket, RtspTestServer *server);
+    ~RtspSession();
+
+    QString path() const { return mPath; }
+    bool isPlaying(const QString &path) const { return mPlaying && mPath == path; }
+
+    // delayMs > 0 时进入抖动队列延后发送
+    void sendPacket(int track, bool rtcp, const QByteArray &packet, int delayMs);
+    void close();
+
+private slots:
+    void onReadyRead();
+    void flushDelayed();
+
+private:
+    struct Request {
+        QString method;
+        QString url;
+        int cseq = 0;
+        QMap<QString, QString> headers;   // 键为小写
+        QByteArray body;
+    };
+    struct Transport {
+        bool tcp = true;
+        int channel = 0;                  // TCP 交织：RTP 通道号，RTCP 为 +1
+        quint16 clientRtpPort = 0;        // UDP：客户端端口
+        quint16 clientRtcpPort = 0;
+    };
+    struct Delayed {
+        int track;
+        bool rtcp;
+        QByteArray packet;
+    };
+
+    void handleRequest(const Request &req);
+    void handleSetup(const Request &req);
+    void handleInterleaved(int channel, const QByteArray &data);
+    void reply(const Request &req, int code, const QString &reason,
+               const QStringList &headers = QStringList(), const QByteArray &body = QByteArray());
+    void writeNow(int track, bool rtcp, const QByteArray &packet);
+
+    QTcpSocket *mSocket;
+    RtspTestServer *mServer;
+    QByteArray mBuffer;
+    QString mSessionId;
+    QString mPath;
+    bool mPlaying;
+    bool mPublisher;
+    bool mClosed;
+
+    QMap<int, Transport> mTransports;     // 播放端：轨道 -> 传输方式
+    QMap<int, int> mRecordChannels;       // 推流端：交织通道 -> 轨道*2 (+1 为 RTCP)
+    QUdpSocket *mRtpSocket;
+    QUdpSocket *mRtcpSocket;
+
+    std::multimap<qint64, Delayed> mDelayed;   // 同一时刻的包保持插入顺序
+    QTimer mDelayTimer;
+    QElapsedTimer mClock;
+    qint64 mLastDueMs;
+};
+
+#endif // RTSPSESSION_H
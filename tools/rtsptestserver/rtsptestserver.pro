@@ -0,0 +1,20 @@
+#-------------------------------------------------
+#
+# 本地回环 RTSP 测试服务器：合成画面或文件源，可注入丢包/抖动/断线
+#
+#-------------------------------------------------
+
+QT       += core gui network
+QT       -= widgets
+
+CONFIG   += console c++11
+CONFIG   -= app_bundle
+
+TARGET = rtsptestserver
+TEMPLATE = app
+
+include(../../ffmpeg.pri)
+include(../common/common.pri)
+include(rtspserver.pri)
+
+SOURCES += main.cpp
@@ -0,0 +1,94 @@
+/**
+ * shmcat：读取 VideoPlayer 导出到共享内存的帧（VP_SHM_NAME）
+ *
+ * 用法：
+ *   shmcat cam1                          每秒打印帧率、分辨率和导出延迟
+ *   shmcat cam1 --raw | ffmpeg -f rawvideo -pix_fmt yuv420p -s 1920x1080 -i - ...
+ *   shmcat cam1 --frames 100
+ *
+ * 写端停止或重建共享内存后自动重新打开。
+ */
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QTextStream>
+#include <QThread>
+
+#include "sharedframe.h"
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("shmcat");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Read frames exported by VideoPlayer through shared memory");
+    parser.addHelpOption();
+    parser.addPositionalArgument("name", "Export name (VP_SHM_NAME of the player)");
+    QCommandLineOption rawOpt("raw", "Write raw frames to stdout instead of statistics");
+    QCommandLineOption framesOpt("frames", "Exit after this many frames (0 = run forever)", "n", "0");
+    parser.addOptions({ rawOpt, framesOpt });
+    parser.process(app);
+    if (parser.positionalArguments().size() != 1)
+        parser.showHelp(2);
+
+    const QString name = parser.positionalArguments().first();
+    const bool raw = parser.isSet(rawOpt);
+    const qint64 maxFrames = parser.value(framesOpt).toLongLong();
+    QTextStream err(stderr);
+    QFile out;
+    if (raw)
+        out.open(stdout, QIODevice::WriteOnly);
+
+    SharedFrameReader reader;
+    SharedFrameInfo info;
+    QByteArray pixels;
+    quint64 last = 0;
+    qint64 total = 0, frames = 0, missed = 0;
+    double latencyMs = 0;
+    QElapsedTimer interval;
+    interval.start();
+
+    while (maxFrames <= 0 || total < maxFrames) {
+        if (!reader.isOpen() || reader.isClosedByWriter()) {
+            QString error;
+            if (!reader.open(name, &error)) {
+                QThread::msleep(500);   // 写端还没开始导出
+                continue;
+            }
+            err << "Opened " << SharedFrameWriter::systemName(name) << "\n";
+            err.flush();
+            last = 0;
+        }
+        if (!reader.readLatest(&info, &pixels, last)) {
+            QThread::msleep(2);
+            continue;
+        }
+        if (last && info.frameNumber > last + 1)
+            missed += info.frameNumber - last - 1;   // 读得比写得慢，中间的帧被覆盖了
+        last = info.frameNumber;
+        total++;
+        frames++;
+        latencyMs += (QDateTime::currentMSecsSinceEpoch() * 1000 - info.wallTimeUs) / 1000.0;
+
+        if (raw)
+            out.write(pixels);
+
+        if (interval.elapsed() >= 1000) {
+            err << QString("%1x%2 %3  %4 fps  latency %5 ms  missed %6\n")
+                   .arg(info.width).arg(info.height)
+                   .arg(info.format == SharedFrameRgb32 ? "rgb32" : "yuv420p")
+                   .arg(frames * 1000.0 / interval.elapsed(), 0, 'f', 1)
+                   .arg(latencyMs / frames, 0, 'f', 2)
+                   .arg(missed);
+            err.flush();
+            frames = 0;
+            latencyMs = 0;
+            interval.restart();
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,29 @@
+#-------------------------------------------------
+#
+# 共享内存帧导出的读端示例：统计帧率/延迟，或把原始帧写到标准输出
+#
+#-------------------------------------------------
+
+QT       += core gui
+QT       -= widgets
+
+CONFIG   += console c++11
+CONFIG   -= app_bundle
+
+TARGET = shmcat
+TEMPLATE = app
+
+INCLUDEPATH += ../..
+
+include(../../ffmpeg.pri)
+unix:!macx: LIBS += -lrt
+
+SOURCES += main.cpp \
+    ../../sharedframe.cpp \
+    ../../frameconverter.cpp \
+    ../../yuvconverter.cpp
+
+HEADERS += \
+    ../../sharedframe.h \
+    ../../frameconverter.h \
+    ../../yuvconverter.h
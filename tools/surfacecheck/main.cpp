@@ -0,0 +1,136 @@
+/**
+ * surfacecheck：OpenGL 视频画面自检
+ *
+ * 用法（无显示器、无 GPU 的 Linux）：
+ *   QT_QPA_PLATFORM=offscreen surfacecheck --software
+ *   xvfb-run surfacecheck --software --require-software --size 1920x1080
+ *
+ * 把一帧合成 YUV420P 画面交给 VideoSurface 渲染，读回帧缓冲，
+ * 与 sws_scale 转出的 RGB 比较 PSNR；同时报告 GL 渲染器和每帧绘制耗时。
+ */
+
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QTextStream>
+
+#include <cmath>
+
+#include "videosurface.h"
+#include "syntheticsource.h"
+
+extern "C" {
+    #include <libswscale/swscale.h>
+}
+
+static double psnr(const QImage &a, const QImage &b)
+{
+    double sum = 0;
+    const int w = qMin(a.width(), b.width()), h = qMin(a.height(), b.height());
+    for (int y = 0; y < h; y++) {
+        const QRgb *pa = reinterpret_cast<const QRgb *>(a.constScanLine(y));
+        const QRgb *pb = reinterpret_cast<const QRgb *>(b.constScanLine(y));
+        for (int x = 0; x < w; x++) {
+            int dr = qRed(pa[x]) - qRed(pb[x]);
+            int dg = qGreen(pa[x]) - qGreen(pb[x]);
+            int db = qBlue(pa[x]) - qBlue(pb[x]);
+            sum += dr * dr + dg * dg + db * db;
+        }
+    }
+    double mse = sum / (3.0 * w * h);
+    return mse > 0 ? 10.0 * std::log10(255.0 * 255.0 / mse) : 99.0;
+}
+
+static QImage referenceImage(const AVFrame *frame)
+{
+    QImage image(frame->width, frame->height, QImage::Format_RGB32);
+    SwsContext *ctx = sws_getContext(frame->width, frame->height, AV_PIX_FMT_YUV420P,
+                                     frame->width, frame->height, AV_PIX_FMT_RGB32,
+                                     SWS_BICUBIC | SWS_ACCURATE_RND, nullptr, nullptr, nullptr);
+    uint8_t *dst[4] = { image.bits(), nullptr, nullptr, nullptr };
+    int dstStride[4] = { image.bytesPerLine(), 0, 0, 0 };
+    sws_scale(ctx, frame->data, frame->linesize, 0, frame->height, dst, dstStride);
+    sws_freeContext(ctx);
+    return image;
+}
+
+int main(int argc, char *argv[])
+{
+    // 软件 OpenGL 必须在创建 QApplication 之前选定
+    for (int i = 1; i < argc; i++) {
+        if (qstrcmp(argv[i], "--software") == 0) {
+            QCoreApplication::setAttribute(Qt::AA_UseSoftwareOpenGL);
+            qputenv("LIBGL_ALWAYS_SOFTWARE", "1");
+        }
+    }
+
+    QApplication app(argc, argv);
+    QCoreApplication::setApplicationName("surfacecheck");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Render a synthetic YUV frame with VideoSurface and compare it to sws_scale");
+    parser.addHelpOption();
+    QCommandLineOption softwareOpt("software", "Force a software OpenGL implementation");
+    QCommandLineOption requireSoftwareOpt("require-software", "Fail unless the renderer is llvmpipe/softpipe");
+    QCommandLineOption sizeOpt("size", "Frame size", "WxH", "1280x720");
+    QCommandLineOption framesOpt("frames", "Frames to render for timing", "n", "100");
+    QCommandLineOption minPsnrOpt("min-psnr", "Minimum PSNR against sws_scale", "dB", "30");
+    parser.addOptions({ softwareOpt, requireSoftwareOpt, sizeOpt, framesOpt, minPsnrOpt });
+    parser.process(app);
+
+    QTextStream out(stdout);
+    SyntheticSpec spec;
+    if (!spec.parse(parser.value(sizeOpt) + "@30")) {
+        out << "Invalid --size value\n";
+        return 2;
+    }
+
+    if (!VideoSurface::isAvailable()) {
+        out << "FAIL: no usable OpenGL context (the GUI would fall back to QLabel)\n";
+        return 1;
+    }
+
+    AVFrame *frame = av_frame_alloc();
+    frame->format = AV_PIX_FMT_YUV420P;
+    frame->width = spec.width;
+    frame->height = spec.height;
+    av_frame_get_buffer(frame, 32);
+    SyntheticSource::fillFrame(frame, 42);
+    QSharedPointer<AVFrame> shared(frame, [](AVFrame *f) { av_frame_free(&f); });
+
+    // 与帧同尺寸，不缩放，只比较颜色转换和色度上采样
+    PerfStats perf;
+    VideoSurface surface;
+    surface.setPerfStats(&perf);
+    surface.resize(spec.width, spec.height);
+    surface.show();
+    app.processEvents();
+
+    surface.setFrame(shared);
+    QImage rendered = surface.grabFramebuffer().convertToFormat(QImage::Format_RGB32);
+    QString renderer = surface.rendererInfo();
+    double quality = psnr(rendered, referenceImage(frame));
+
+    // 每次都重新上传纹理，测的是上传 + 绘制
+    int frames = parser.value(framesOpt).toInt();
+    for (int i = 0; i < frames; i++) {
+        surface.setFrame(shared);
+        surface.grabFramebuffer();
+    }
+    PerfStageSnapshot paint = perf.snapshot().stages[PerfPaint];
+
+    bool software = renderer.contains("llvmpipe", Qt::CaseInsensitive)
+            || renderer.contains("softpipe", Qt::CaseInsensitive)
+            || renderer.contains("Software", Qt::CaseInsensitive);
+    out << "renderer: " << renderer << (software ? "  (software)" : "") << "\n";
+    out << QString("frame:    %1  psnr %2 dB\n").arg(spec.toString()).arg(quality, 0, 'f', 1);
+    out << QString("paint:    p50 %1 ms  p99 %2 ms over %3 frames\n")
+           .arg(paint.p50Ms, 0, 'f', 2).arg(paint.p99Ms, 0, 'f', 2).arg(paint.count);
+
+    bool ok = quality >= parser.value(minPsnrOpt).toDouble();
+    if (parser.isSet(requireSoftwareOpt) && !software) {
+        out << "FAIL: renderer is not a software rasterizer\n";
+        ok = false;
+    }
+    out << (ok ? "PASS\n" : "FAIL\n");
+    return ok ? 0 : 1;
+}
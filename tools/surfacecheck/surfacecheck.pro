@@ -0,0 +1,27 @@
+#-------------------------------------------------
+#
+# OpenGL 视频画面自检：渲染一帧合成 YUV 画面，与 sws_scale 结果比较 PSNR，
+# 无 GPU 的 Linux 上配合 Mesa llvmpipe 使用
+#
+#-------------------------------------------------
+
+QT       += core gui widgets
+
+CONFIG   += console c++11
+CONFIG   -= app_bundle
+
+TARGET = surfacecheck
+TEMPLATE = app
+
+INCLUDEPATH += ../..
+
+include(../../ffmpeg.pri)
+include(../common/common.pri)
+
+SOURCES += main.cpp \
+    ../../videosurface.cpp \
+    ../../perfstats.cpp
+
+HEADERS += \
+    ../../videosurface.h \
+    ../../perfstats.h
@@ -0,0 +1,293 @@
+/**
+ * vpbench：无界面基准测试
+ *
+ * 用法：
+ *   vpbench [选项] [文件或URL...]
+ *   vpbench --synthetic 1920x1080@30 --seconds 20 --json result.json
+ *   vpbench sample.mp4 --baseline last.json --tolerance 0.1
+ *   vpbench --synthetic 1920x1080@30 --motion 0     # 每帧都做移动侦测，看 motion 阶段耗时
+ *
+ * 每个输入都交给一个 VideoPlayer 实例，走与界面程序完全相同的
+ * 解复用 -> 解码 -> sws_scale -> 红色通道 -> 信号投递 路径。
+ */
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTemporaryDir>
+#include <QTimer>
+#include <QTextStream>
+
+#include <atomic>
+
+#include "videoplayer.h"
+#include "syntheticsource.h"
+#include "procstats.h"
+
+struct BenchResult {
+    QString input;
+    QString error;
+    quint64 frames = 0;
+    double fps = 0.0;
+    double startupMs = 0.0;
+    double cpuPercent = 0.0;
+    double peakRssMb = 0.0;
+    PerfSnapshot perf;
+};
+
+static BenchResult runInput(const QString &name, const QString &url, int maxFrames,
+                            int liveSeconds, bool realtime, const QSize &displaySize,
+                            int convertThreads, double motionFps)
+{
+    BenchResult result;
+    result.input = name;
+
+    VideoPlayer player;
+    player.setAudioEnabled(false);
+    player.setRealtimePacing(realtime);
+    player.setTransportProtocol("tcp");
+    player.setStreamUrl(url);
+    player.setDisplaySize(displaySize);
+    player.setConvertThreads(convertThreads);
+    if (motionFps >= 0) {
+        player.motionDetector()->setAnalysisFps(motionFps);
+        player.motionDetector()->setEnabled(true);
+    }
+
+    QEventLoop loop;
+    std::atomic<quint64> frames(0);
+    std::atomic<qint64> firstFrameNs(0), lastFrameNs(0);
+
+    // 直连：在解码线程里计数，不经过事件队列
+    QObject::connect(&player, &VideoPlayer::sig_GetRFrame, &player, [&](QImage) {
+        qint64 now = perfNowNs();
+        qint64 expected = 0;
+        firstFrameNs.compare_exchange_strong(expected, now);
+        lastFrameNs.store(now);
+        if (++frames == quint64(maxFrames) && maxFrames > 0)
+            QMetaObject::invokeMethod(&loop, "quit", Qt::QueuedConnection);
+    }, Qt::DirectConnection);
+    QObject::connect(&player, &VideoPlayer::sig_PlaybackFinished, &loop, &QEventLoop::quit);
+    QObject::connect(&player, &QThread::finished, &loop, &QEventLoop::quit);
+    QObject::connect(&player, &VideoPlayer::sig_StreamError, &loop, [&](const QString &msg) {
+        result.error = msg;
+        loop.quit();
+    });
+    if (!player.isLocalFile())
+        QTimer::singleShot(liveSeconds * 1000, &loop, &QEventLoop::quit);
+
+    ProcessStats before = currentProcessStats();
+    QElapsedTimer wall;
+    wall.start();
+    qint64 startNs = perfNowNs();
+
+    player.startPlay();
+    loop.exec();
+    player.stopPlay();
+
+    double wallSec = wall.elapsed() / 1000.0;
+    ProcessStats after = currentProcessStats();
+
+    result.frames = frames.load();
+    result.perf = player.perfStats()->snapshot();
+    if (result.frames > 0) {
+        result.startupMs = (firstFrameNs.load() - startNs) / 1e6;
+        double activeSec = (lastFrameNs.load() - firstFrameNs.load()) / 1e9;
+        if (activeSec > 0 && result.frames > 1)
+            result.fps = (result.frames - 1) / activeSec;
+    }
+    if (wallSec > 0)
+        result.cpuPercent = (after.cpuSec() - before.cpuSec()) / wallSec * 100.0;
+    result.peakRssMb = after.peakRssKb / 1024.0;
+    return result;
+}
+
+static QJsonObject stageJson(const PerfStageSnapshot &s)
+{
+    QJsonObject o;
+    o["count"] = double(s.count);
+    o["mean"] = s.meanMs;
+    o["p50"] = s.p50Ms;
+    o["p90"] = s.p90Ms;
+    o["p99"] = s.p99Ms;
+    o["max"] = s.maxMs;
+    return o;
+}
+
+static QJsonObject resultJson(const BenchResult &r)
+{
+    QJsonObject o;
+    o["input"] = r.input;
+    if (!r.error.isEmpty())
+        o["error"] = r.error;
+    o["frames"] = double(r.frames);
+    o["fps"] = r.fps;
+    o["startup_ms"] = r.startupMs;
+    o["cpu_percent"] = r.cpuPercent;
+    o["peak_rss_mb"] = r.peakRssMb;
+    o["latency_ms"] = stageJson(r.perf.stages[PerfFrame]);
+
+    QJsonObject stages;
+    for (int i = 0; i < PerfStageCount; i++) {
+        if (i == PerfPaint || i == PerfFrame)
+            continue;   // 无界面，没有绘制阶段
+        if (i == PerfMotion && r.perf.stages[i].count == 0)
+            continue;   // 没有开启移动侦测
+        stages[perfStageName(PerfStage(i))] = stageJson(r.perf.stages[i]);
+    }
+    o["stages"] = stages;
+    return o;
+}
+
+static void printResult(QTextStream &out, const BenchResult &r)
+{
+    const PerfStageSnapshot &lat = r.perf.stages[PerfFrame];
+    out << r.input << "\n";
+    if (!r.error.isEmpty())
+        out << "  error:    " << r.error << "\n";
+    out << QString("  frames:   %1  fps %2  startup %3 ms\n")
+           .arg(r.frames).arg(r.fps, 0, 'f', 1).arg(r.startupMs, 0, 'f', 1);
+    out << QString("  latency:  p50 %1  p90 %2  p99 %3  max %4 ms\n")
+           .arg(lat.p50Ms, 0, 'f', 2).arg(lat.p90Ms, 0, 'f', 2)
+           .arg(lat.p99Ms, 0, 'f', 2).arg(lat.maxMs, 0, 'f', 2);
+    for (int i = 0; i < PerfStageCount; i++) {
+        const PerfStageSnapshot &s = r.perf.stages[i];
+        if (i == PerfPaint || i == PerfFrame || (i == PerfMotion && s.count == 0))
+            continue;
+        out << QString("  %1 p50 %2  p99 %3 ms\n")
+               .arg(perfStageName(PerfStage(i)), -9)
+               .arg(s.p50Ms, 0, 'f', 2).arg(s.p99Ms, 0, 'f', 2);
+    }
+    out << QString("  cpu:      %1 %  peak rss %2 MB\n")
+           .arg(r.cpuPercent, 0, 'f', 0).arg(r.peakRssMb, 0, 'f', 1);
+    out.flush();
+}
+
+// 与基准结果比较：帧率下降或 p99 延迟上升超过容差即视为回归
+static int compareBaseline(QTextStream &out, const QJsonArray &current,
+                           const QString &baselineFile, double tolerance)
+{
+    QFile file(baselineFile);
+    if (!file.open(QIODevice::ReadOnly)) {
+        out << "Cannot read baseline " << baselineFile << "\n";
+        return 2;
+    }
+    QJsonArray baseline = QJsonDocument::fromJson(file.readAll()).object()["results"].toArray();
+
+    int regressions = 0;
+    for (const QJsonValue &cv : current) {
+        QJsonObject c = cv.toObject();
+        for (const QJsonValue &bv : baseline) {
+            QJsonObject b = bv.toObject();
+            if (b["input"].toString() != c["input"].toString())
+                continue;
+
+            double fps = c["fps"].toDouble(), baseFps = b["fps"].toDouble();
+            double p99 = c["latency_ms"].toObject()["p99"].toDouble();
+            double baseP99 = b["latency_ms"].toObject()["p99"].toDouble();
+            if (baseFps > 0 && fps < baseFps * (1.0 - tolerance)) {
+                out << QString("REGRESSION %1: fps %2 -> %3\n")
+                       .arg(c["input"].toString()).arg(baseFps, 0, 'f', 1).arg(fps, 0, 'f', 1);
+                regressions++;
+            }
+            if (baseP99 > 0 && p99 > baseP99 * (1.0 + tolerance)) {
+                out << QString("REGRESSION %1: p99 latency %2 -> %3 ms\n")
+                       .arg(c["input"].toString()).arg(baseP99, 0, 'f', 2).arg(p99, 0, 'f', 2);
+                regressions++;
+            }
+        }
+    }
+    out.flush();
+    return regressions ? 1 : 0;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("vpbench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Headless decode/convert benchmark for VideoPlayer");
+    parser.addHelpOption();
+    parser.addPositionalArgument("inputs", "Local files or stream URLs", "[inputs...]");
+    QCommandLineOption syntheticOpt("synthetic", "Generate a synthetic H.264 stream, e.g. 1920x1080@30", "WxH@FPS");
+    QCommandLineOption secondsOpt("seconds", "Synthetic length / live capture time in seconds", "s", "10");
+    QCommandLineOption framesOpt("frames", "Stop each input after N frames (0 = all)", "n", "0");
+    QCommandLineOption realtimeOpt("realtime", "Keep real-time pacing for local files");
+    QCommandLineOption threadsOpt("convert-threads", "RGB conversion slices (0 = auto by resolution)", "n", "0");
+    QCommandLineOption displayOpt("display", "Scale RGB output to fit a display area, e.g. 520x381", "WxH");
+    QCommandLineOption motionOpt("motion", "Run motion detection at this analysis fps (0 = every frame)", "fps");
+    QCommandLineOption jsonOpt("json", "Write results as JSON", "file");
+    QCommandLineOption baselineOpt("baseline", "Compare against a previous JSON result", "file");
+    QCommandLineOption toleranceOpt("tolerance", "Allowed relative regression", "ratio", "0.1");
+    parser.addOptions({ syntheticOpt, secondsOpt, framesOpt, realtimeOpt, displayOpt, threadsOpt, motionOpt, jsonOpt, baselineOpt, toleranceOpt });
+    parser.process(app);
+
+    QTextStream out(stdout);
+    int seconds = parser.value(secondsOpt).toInt();
+    int maxFrames = parser.value(framesOpt).toInt();
+    bool realtime = parser.isSet(realtimeOpt);
+    int convertThreads = parser.value(threadsOpt).toInt();
+    double motionFps = parser.isSet(motionOpt) ? qMax(0.0, parser.value(motionOpt).toDouble()) : -1.0;
+    QSize displaySize;
+    if (parser.isSet(displayOpt)) {
+        QStringList parts = parser.value(displayOpt).split('x');
+        if (parts.size() == 2)
+            displaySize = QSize(parts[0].toInt(), parts[1].toInt());
+        if (displaySize.isEmpty()) {
+            out << "Invalid --display value\n";
+            return 2;
+        }
+    }
+
+    QList<QPair<QString, QString> > inputs;   // 名称, 地址
+    QTemporaryDir tempDir;
+    if (parser.isSet(syntheticOpt)) {
+        SyntheticSpec spec;
+        if (!spec.parse(parser.value(syntheticOpt))) {
+            out << "Invalid --synthetic value\n";
+            return 2;
+        }
+        spec.seconds = seconds;
+        QString path = tempDir.filePath("synthetic.mkv");
+        QString error;
+        out << "Generating synthetic stream " << spec.toString() << " ...\n";
+        out.flush();
+        if (!SyntheticSource::writeFile(spec, path, &error)) {
+            out << error << "\n";
+            return 2;
+        }
+        inputs.append(qMakePair("synthetic:" + spec.toString(), path));
+    }
+    for (const QString &arg : parser.positionalArguments())
+        inputs.append(qMakePair(arg, arg));
+
+    if (inputs.isEmpty()) {
+        parser.showHelp(2);
+    }
+
+    QJsonArray results;
+    for (const auto &input : inputs) {
+        BenchResult r = runInput(input.first, input.second, maxFrames, seconds, realtime, displaySize,
+                                 convertThreads, motionFps);
+        printResult(out, r);
+        results.append(resultJson(r));
+    }
+
+    if (parser.isSet(jsonOpt)) {
+        QJsonObject root;
+        root["results"] = results;
+        QFile file(parser.value(jsonOpt));
+        if (file.open(QIODevice::WriteOnly))
+            file.write(QJsonDocument(root).toJson());
+    }
+
+    if (parser.isSet(baselineOpt))
+        return compareBaseline(out, results, parser.value(baselineOpt), parser.value(toleranceOpt).toDouble());
+    return 0;
+}
@@ -0,0 +1,19 @@
+#-------------------------------------------------
+#
+# 无界面基准测试：解复用/解码/转换/红色通道，与 VideoPlayer 同一份代码
+#
+#-------------------------------------------------
+
+QT       += core gui multimedia concurrent
+QT       -= widgets
+
+CONFIG   += console c++11
+CONFIG   -= app_bundle
+
+TARGET = vpbench
+TEMPLATE = app
+
+include(../../videoplayer_core.pri)
+include(../common/common.pri)
+
+SOURCES += main.cpp
@@ -1,25 +1,162 @@
 #include "videoplayer.h"
+#include "frameconverter.h"
+#include "imagepool.h"
 #include <QAudioFormat>
 #include <QDebug>
 #include <QFileInfo>
 #include <QTimer>
 #include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QMetaMethod>
+#include <QtConcurrent/QtConcurrentRun>
+
+// 达到该倍速后只解码关键帧
+static const double kKeyframeOnlySpeed = 4.0;
+
+// 断线重连的退避时间
+static const int kReconnectBaseDelayMs = 500;
+static const int kReconnectMaxDelayMs = 5000;
 
 VideoPlayer::VideoPlayer(QObject *parent)
     : QThread(parent), mStopRequested(false),
       mAudioOutput(nullptr), mAudioIO(nullptr),
-      mSwrCtx(nullptr), mDstSampleFmt(AV_SAMPLE_FMT_S16),mIsPushing(false)
+      mSwrCtx(nullptr), mDstSampleFmt(AV_SAMPLE_FMT_S16), mFrameTaps(0)
 {
     avformat_network_init();
     av_register_all();
+    mMotion.setPerfStats(&mPerf);
+    mProcessedOutput.setMotionDetector(&mMotion);
+    // 移动侦测的事件在分析线程里发出，直接调用录像的触发接口（线程安全），不经过事件循环
+    connect(&mMotion, &MotionDetector::sig_MotionStarted, &mRecorder,
+            [this](const QString &zone) { mRecorder.onMotionStarted(zone); }, Qt::DirectConnection);
+    connect(&mMotion, &MotionDetector::sig_MotionStopped, &mRecorder,
+            [this](const QString &zone) { mRecorder.onMotionStopped(zone); }, Qt::DirectConnection);
 }
 
 VideoPlayer::~VideoPlayer()
 {
     stopPlay();
+    for (const QString &id : mPushJobs)
+        PushJobManager::instance()->remove(id);
     avformat_network_deinit();
 }
 
+PerfStats *VideoPlayer::perfStats()
+{
+    return &mPerf;
+}
+
+MotionDetector *VideoPlayer::motionDetector()
+{
+    return &mMotion;
+}
+
+EventRecorder *VideoPlayer::recorder()
+{
+    return &mRecorder;
+}
+
+StreamHealth *VideoPlayer::streamHealth()
+{
+    return &mHealth;
+}
+
+Snapshotter *VideoPlayer::snapshotter()
+{
+    return &mSnapshot;
+}
+
+SharedFrameWriter *VideoPlayer::frameExport()
+{
+    return &mFrameExport;
+}
+
+ProcessedOutput *VideoPlayer::processedOutput()
+{
+    return &mProcessedOutput;
+}
+
+bool VideoPlayer::takeFrame(QImage *image)
+{
+    if (!mFrameMailbox.take(image))
+        return false;
+    mPerf.frameConsumed();
+    return true;
+}
+
+bool VideoPlayer::takeRFrame(QImage *image)
+{
+    return mRFrameMailbox.take(image);
+}
+
+bool VideoPlayer::takeYuvFrame(QSharedPointer<AVFrame> *frame)
+{
+    if (!mYuvMailbox.take(frame))
+        return false;
+    mPerf.frameConsumed();
+    return true;
+}
+
+void VideoPlayer::addFrameTap()
+{
+    QMutexLocker locker(&mLatestMutex);
+    mFrameTaps++;
+}
+
+void VideoPlayer::removeFrameTap()
+{
+    QMutexLocker locker(&mLatestMutex);
+    mFrameTaps--;
+    Q_ASSERT(mFrameTaps >= 0);
+    if (mFrameTaps == 0)
+        mLatestFrame.clear();   // 没人取了，不再占着解码器的缓冲
+}
+
+QSharedPointer<AVFrame> VideoPlayer::latestFrame(qint64 *timeNs) const
+{
+    QMutexLocker locker(&mLatestMutex);
+    if (timeNs)
+        *timeNs = mLatestFrameNs;
+    return mLatestFrame;
+}
+
+void VideoPlayer::noteMailboxPost(bool replaced)
+{
+    if (replaced) {
+        // 界面还没取走上一帧，直接覆盖
+        mPerf.frameDropped();
+        mMetrics->onFrameDropped();
+    } else {
+        mPerf.frameQueued();
+    }
+}
+
+// 给 GL 画面的 YUV420P 帧：本来就是 420P 时只增加引用，否则转一次格式
+static QSharedPointer<AVFrame> makeYuvFrame(const AVFrame *src, SwsContext **convertCtx)
+{
+    AVFrame *frame = nullptr;
+    if (src->format == AV_PIX_FMT_YUV420P || src->format == AV_PIX_FMT_YUVJ420P) {
+        frame = av_frame_clone(src);
+    } else {
+        frame = av_frame_alloc();
+        frame->format = AV_PIX_FMT_YUV420P;
+        frame->width = src->width;
+        frame->height = src->height;
+        *convertCtx = sws_getCachedContext(*convertCtx, src->width, src->height, AVPixelFormat(src->format),
+                                           src->width, src->height, AV_PIX_FMT_YUV420P,
+                                           SWS_BILINEAR, nullptr, nullptr, nullptr);
+        if (!*convertCtx || av_frame_get_buffer(frame, 32) < 0) {
+            av_frame_free(&frame);
+            return QSharedPointer<AVFrame>();
+        }
+        sws_scale(*convertCtx, src->data, src->linesize, 0, src->height, frame->data, frame->linesize);
+        av_frame_copy_props(frame, src);
+    }
+    if (!frame)
+        return QSharedPointer<AVFrame>();
+    return QSharedPointer<AVFrame>(frame, [](AVFrame *f) { av_frame_free(&f); });
+}
+
 void VideoPlayer::startPlay()
 {
     mStopRequested = false;
@@ -111,42 +248,260 @@ void VideoPlayer::processAudioPacket(AVCodecContext *audioCodecCtx, AVPacket *pa
     av_frame_free(&frame);
 }
 
+void VideoPlayer::playAudioData(const QByteArray &audioData)
+{
+    if (mAudioIO) {
+        mAudioIO->write(audioData);
+    }
+}
+
+void VideoPlayer::setAudioEnabled(bool enabled)
+{
+    mAudioEnabled = enabled;
+}
+
+void VideoPlayer::setRealtimePacing(bool enabled)
+{
+    mRealtimePacing = enabled;
+}
+
+void VideoPlayer::setVideoOutputEnabled(bool enabled)
+{
+    mVideoOutput = enabled;
+}
+
 // videoplayer.cpp
 void VideoPlayer::setStreamUrl(const QString &url) {
     QMutexLocker locker(&mStopMutex);
     mStreamUrl = url;
+    mIsLocalFile = QFileInfo::exists(url);
+}
+
+bool VideoPlayer::isLocalFile() const
+{
+    return mIsLocalFile;
+}
+
+void VideoPlayer::seekTo(qint64 ms)
+{
+    QMutexLocker locker(&mPlaybackMutex);
+    mSeekTargetMs = qMax<qint64>(0, ms);
+}
+
+void VideoPlayer::stepFrame(bool backward)
+{
+    QMutexLocker locker(&mPlaybackMutex);
+    mPaused = true;
+    if (backward) {
+        // 定位到上一帧：目标取在上一帧与再上一帧之间，避免毫秒取整误差
+        mSeekTargetMs = qMax<qint64>(0, mPositionMs - mFrameDurationMs - mFrameDurationMs / 2);
+    } else {
+        mStepPending++;
+    }
+}
+
+void VideoPlayer::setPaused(bool paused)
+{
+    QMutexLocker locker(&mPlaybackMutex);
+    mPaused = paused;
+    if (!paused)
+        mStepPending = 0;
+}
+
+bool VideoPlayer::isPaused() const
+{
+    QMutexLocker locker(&mPlaybackMutex);
+    return mPaused;
+}
+
+void VideoPlayer::setPlaybackSpeed(double speed)
+{
+    QMutexLocker locker(&mPlaybackMutex);
+    mPlaybackSpeed = qBound(0.1, speed, 32.0);
+}
+
+double VideoPlayer::playbackSpeed() const
+{
+    QMutexLocker locker(&mPlaybackMutex);
+    return mPlaybackSpeed;
+}
+
+VideoPlayer::PlaybackState VideoPlayer::takePlaybackState()
+{
+    QMutexLocker locker(&mPlaybackMutex);
+    PlaybackState state;
+    state.seekMs = mSeekTargetMs;
+    state.stepPending = mStepPending;
+    state.paused = mPaused;
+    state.speed = mPlaybackSpeed;
+    mSeekTargetMs = -1;
+    return state;
+}
+
+bool VideoPlayer::hasPendingSeek() const
+{
+    QMutexLocker locker(&mPlaybackMutex);
+    return mSeekTargetMs >= 0;
+}
+
+void VideoPlayer::consumeStep()
+{
+    QMutexLocker locker(&mPlaybackMutex);
+    if (mStepPending > 0)
+        mStepPending--;
+}
+
+// 借助关键帧索引跳到目标之前最近的关键帧，之后解码丢弃直到目标帧
+void VideoPlayer::seekFile(AVFormatContext *fmtCtx, int videoStream, AVCodecContext *videoCtx,
+                           AVCodecContext *audioCtx, qint64 targetMs, qint64 *dropUntilPts)
+{
+    AVStream *stream = fmtCtx->streams[videoStream];
+    qint64 startPts = stream->start_time != AV_NOPTS_VALUE ? stream->start_time : 0;
+    qint64 targetPts = startPts + av_rescale_q(targetMs, av_make_q(1, 1000), stream->time_base);
+
+    int ret = -1;
+    KeyframeIndex::Entry keyframe;
+    if (mKeyframeIndex && mKeyframeIndex->streamIndex() == videoStream
+            && mKeyframeIndex->findKeyframe(targetPts, &keyframe)) {
+        if (keyframe.pos >= 0 && stream->nb_index_entries == 0
+                && !(fmtCtx->iformat->flags & AVFMT_NO_BYTE_SEEK)) {
+            // 没有自带索引的格式（TS/PS 等）按时间定位要在文件里反复读包二分查找，直接跳到关键帧的字节偏移
+            ret = av_seek_frame(fmtCtx, -1, keyframe.pos, AVSEEK_FLAG_BYTE);
+        } else {
+            // 有索引的格式把范围限定在这个关键帧上，不让解复用器再按自己的索引挑别的位置
+            ret = avformat_seek_file(fmtCtx, videoStream, keyframe.pts, keyframe.pts, keyframe.pts, 0);
+        }
+    }
+    if (ret < 0)
+        ret = av_seek_frame(fmtCtx, videoStream, targetPts, AVSEEK_FLAG_BACKWARD);
+    if (ret < 0)
+        qDebug() << "Seek failed:" << targetMs << "ms";
+    avcodec_flush_buffers(videoCtx);
+    if (audioCtx)
+        avcodec_flush_buffers(audioCtx);
+
+    *dropUntilPts = targetPts;
+}
+
+// 阻塞的网络读取在 stopPlay 时立即返回
+int VideoPlayer::interruptCallback(void *opaque)
+{
+    VideoPlayer *player = static_cast<VideoPlayer *>(opaque);
+    return player->mStopRequested ? 1 : 0;
+}
+
+void VideoPlayer::setAutoReconnect(bool enabled)
+{
+    mAutoReconnect = enabled;
+}
+
+void VideoPlayer::setConvertThreads(int count)
+{
+    mConvertThreads = count;
+}
+
+void VideoPlayer::setDisplaySize(const QSize &size)
+{
+    QMutexLocker locker(&mDisplayMutex);
+    mDisplaySize = size;
+}
+
+// RGB 输出尺寸：等比放进显示区域，未设置显示区域时为原始尺寸
+QSize VideoPlayer::outputSize(int srcWidth, int srcHeight) const
+{
+    QSize src(srcWidth, srcHeight);
+    QMutexLocker locker(&mDisplayMutex);
+    if (mDisplaySize.isEmpty())
+        return src;
+    return src.scaled(mDisplaySize, Qt::KeepAspectRatio).expandedTo(QSize(2, 2));
 }
 
 void VideoPlayer::run()
+{
+    mPerf.reset();
+    if (mFrameMailbox.clear())
+        mPerf.frameConsumed();   // 上次停止时界面没取走的帧
+    if (mYuvMailbox.clear())
+        mPerf.frameConsumed();
+    mRFrameMailbox.clear();
+    mMetrics = MetricsRegistry::instance()->registerStream("pull", mStreamUrl, &mPerf);
+
+    int attempt = 0;
+    bool reconnecting = false;
+    while (!mStopRequested) {
+        StreamResult result = playStream(reconnecting);
+        if (mStopRequested || mIsLocalFile || !mAutoReconnect)
+            break;
+        // 首次打开就失败说明地址有误，交给界面提示，不再重试
+        if (result == StreamOpenFailed && !reconnecting)
+            break;
+        if (result == StreamEnded)
+            attempt = 0;
+
+        attempt++;
+        reconnecting = true;
+        int delayMs = qMin(kReconnectMaxDelayMs, kReconnectBaseDelayMs << qMin(attempt - 1, 4));
+        qDebug() << "Stream lost, reconnect attempt" << attempt << "in" << delayMs << "ms";
+        mMetrics->onReconnect();
+        emit sig_Reconnecting(attempt);
+        for (int waited = 0; waited < delayMs && !mStopRequested; waited += 50)
+            msleep(50);
+    }
+
+    mFrameExport.close();   // 重连期间保留，停止播放后读端才看到 closed
+    mProcessedOutput.close();
+    {
+        QMutexLocker locker(&mLatestMutex);
+        mLatestFrame.clear();   // 使用方手里的最后一帧照常可用，按收到时刻判断已过时
+    }
+    MetricsRegistry::instance()->unregisterStream(mMetrics);
+    mMetrics.clear();
+}
+
+VideoPlayer::StreamResult VideoPlayer::playStream(bool reconnecting)
 {
     AVFormatContext *pFormatCtx = nullptr;
     AVCodecContext *pVideoCodecCtx = nullptr, *pAudioCodecCtx = nullptr;
     AVCodec *pVideoCodec = nullptr, *pAudioCodec = nullptr;
-    AVFrame *pFrame = nullptr, *pFrameRGB = nullptr;
+    AVFrame *pFrame = nullptr;
     AVPacket packet;
-    uint8_t *out_buffer = nullptr;
-    SwsContext *img_convert_ctx = nullptr;
+    FrameConverter rgbConverter;           // 4K 等高分辨率时多线程分条带转换
+    ImagePool imagePool(6);                // RGB 帧和红色通道帧各有邮箱、界面、正在写的三份
+    SwsContext *yuvConvertCtx = nullptr;   // 解码输出不是 YUV420P 时给 GL 画面转格式
 
     int videoStream = -1, audioStream = -1;
     QByteArray urlData1 = m_transport.toUtf8();
     // 打开RTSP流
     AVDictionary *options = nullptr;
-    av_dict_set(&options, "rtsp_transport", urlData1, 0);
-    av_dict_set(&options, "max_delay", "100", 0);
+    if (!mIsLocalFile) {
+        av_dict_set(&options, "rtsp_transport", urlData1, 0);
+        av_dict_set(&options, "max_delay", "100", 0);
+        av_dict_set(&options, "stimeout", "5000000", 0);   // 5 秒收不到数据视为断线
+    }
 
     //const char *url = mStreamUrl.toUtf8().constData();
     QByteArray urlData = mStreamUrl.toUtf8();
     char *url = strdup(urlData.constData()); // 动态分配内存
-    if (avformat_open_input(&pFormatCtx, url, nullptr, &options) < 0) {
-        emit sig_StreamError(QString("Failed to open stream: %1").arg(mStreamUrl));
-        return;
+    pFormatCtx = avformat_alloc_context();
+    pFormatCtx->interrupt_callback.callback = &VideoPlayer::interruptCallback;
+    pFormatCtx->interrupt_callback.opaque = this;
+    int openRet = avformat_open_input(&pFormatCtx, url, nullptr, &options);
+    av_dict_free(&options);
+    free(url);
+    if (openRet < 0) {
+        // 重连过程中不弹错误框，由 run() 继续重试
+        if (!reconnecting)
+            emit sig_StreamError(QString("Failed to open stream: %1").arg(mStreamUrl));
+        return StreamOpenFailed;
     }
 
     if (avformat_find_stream_info(pFormatCtx, nullptr) < 0) {
-        emit sig_StreamError("No valid video or audio stream found");
+        if (!reconnecting)
+            emit sig_StreamError("No valid video or audio stream found");
         avformat_close_input(&pFormatCtx);
-        return;
+        return StreamOpenFailed;
     }
+    mMetrics->onOpened();
 
     // 查找视频和音频流
     for (unsigned int i = 0; i < pFormatCtx->nb_streams; i++) {
@@ -162,6 +517,7 @@ void VideoPlayer::run()
     if (videoStream >= 0) {
         pVideoCodecCtx = pFormatCtx->streams[videoStream]->codec;
         pVideoCodec = avcodec_find_decoder(pVideoCodecCtx->codec_id);
+        pVideoCodecCtx->refcounted_frames = 1;   // 解码帧可以零拷贝交给 GL 画面
         if (!pVideoCodec || avcodec_open2(pVideoCodecCtx, pVideoCodec, nullptr) < 0) {
             qDebug() << "Could not open video codec";
             videoStream = -1;
@@ -169,6 +525,9 @@ void VideoPlayer::run()
     }
 
     // 初始化音频解码器
+    const int sourceAudioStream = audioStream;   // 不播放声音时录像里仍保留音频
+    if (!mAudioEnabled)
+        audioStream = -1;
     if (audioStream >= 0) {
         pAudioCodecCtx = pFormatCtx->streams[audioStream]->codec;
         pAudioCodec = avcodec_find_decoder(pAudioCodecCtx->codec_id);
@@ -180,223 +539,358 @@ void VideoPlayer::run()
         }
     }
 
-    // 准备视频转换上下文
-    if (videoStream >= 0) {
+    // RGB 转换上下文在出帧时按显示尺寸创建/更新；VP_CONVERT=sws 时不用专用 SIMD 转换（对比排查用）
+    if (videoStream >= 0)
         pFrame = av_frame_alloc();
-        pFrameRGB = av_frame_alloc();
-        img_convert_ctx = sws_getContext(pVideoCodecCtx->width, pVideoCodecCtx->height,
-                                        pVideoCodecCtx->pix_fmt, pVideoCodecCtx->width,
-                                        pVideoCodecCtx->height, AV_PIX_FMT_RGB32,
-                                        SWS_BICUBIC, nullptr, nullptr, nullptr);
-
-        int numBytes = avpicture_get_size(AV_PIX_FMT_RGB32, pVideoCodecCtx->width, pVideoCodecCtx->height);
-        out_buffer = (uint8_t *)av_malloc(numBytes * sizeof(uint8_t));
-        avpicture_fill((AVPicture *)pFrameRGB, out_buffer, AV_PIX_FMT_RGB32,
-                      pVideoCodecCtx->width, pVideoCodecCtx->height);
+    rgbConverter.setFastPathEnabled(qgetenv("VP_CONVERT") != "sws");
+    mMotion.reset();   // 重连后画面可能已经变了，背景重新建立
+    mHealth.reset();
+    mSnapshot.setStreamName(MetricsRegistry::displayName(mStreamUrl));
+
+    // 事件录像只对网络流有意义（本地文件本身就是录像）；预录缓冲在开启录像后才开始积累
+    const bool recordStreams = !mIsLocalFile && videoStream >= 0;
+    if (recordStreams) {
+        mRecorder.setStreamName(MetricsRegistry::displayName(mStreamUrl));
+        mRecorder.openStreams(pFormatCtx, videoStream, sourceAudioStream);
+        mPacketRing.setVideoStream(videoStream);
+        mPacketRing.clear();
+    }
+
+    // 本地文件：按时间戳节奏播放，后台加载/建立关键帧索引
+    bool fileMode = mIsLocalFile && videoStream >= 0;
+    AVRational videoTimeBase = av_make_q(1, AV_TIME_BASE);
+    qint64 startPts = 0;
+    if (fileMode) {
+        AVStream *stream = pFormatCtx->streams[videoStream];
+        videoTimeBase = stream->time_base;
+        startPts = stream->start_time != AV_NOPTS_VALUE ? stream->start_time : 0;
+
+        AVRational frameRate = av_guess_frame_rate(pFormatCtx, stream, nullptr);
+        {
+            QMutexLocker locker(&mPlaybackMutex);
+            mSeekTargetMs = -1;
+            mStepPending = 0;
+            mPaused = false;
+            mPositionMs = 0;
+            mFrameDurationMs = frameRate.num > 0 ? qMax<qint64>(1, 1000 * frameRate.den / frameRate.num) : 40;
+        }
+
+        if (pFormatCtx->duration != AV_NOPTS_VALUE)
+            emit sig_DurationChanged(pFormatCtx->duration / 1000);
+
+        QSharedPointer<KeyframeIndex> index(new KeyframeIndex);
+        mKeyframeIndex = index;
+        QString mediaFile = mStreamUrl;
+        QtConcurrent::run([index, mediaFile]() { index->loadOrBuild(mediaFile); });
     }
 
+    QElapsedTimer wallClock;
+    wallClock.start();
+    qint64 anchorPtsMs = AV_NOPTS_VALUE, anchorWallMs = 0;
+    qint64 dropUntilPts = AV_NOPTS_VALUE;  // 精确定位时，丢弃目标之前的帧
+    double lastSpeed = 1.0;
+    bool endOfFile = false;
+    bool draining = false;   // 读到结尾后送空包，取出解码器里还没输出的帧
+    PlaybackState state = { -1, 0, false, 1.0 };
+
     // 主播放循环
     while (!mStopRequested) {
-        if (av_read_frame(pFormatCtx, &packet) < 0) {
+        bool keyframesOnly = false;
+        if (fileMode) {
+            state = takePlaybackState();
+            if (state.seekMs >= 0) {
+                seekFile(pFormatCtx, videoStream, pVideoCodecCtx, pAudioCodecCtx, state.seekMs, &dropUntilPts);
+                anchorPtsMs = AV_NOPTS_VALUE;
+                endOfFile = false;   // 定位和后退单步都经过这里
+                draining = false;
+            } else if (endOfFile && !state.paused) {
+                // 播完后再按播放：从头开始
+                seekFile(pFormatCtx, videoStream, pVideoCodecCtx, pAudioCodecCtx, 0, &dropUntilPts);
+                anchorPtsMs = AV_NOPTS_VALUE;
+                endOfFile = false;
+            }
+            if (state.speed != lastSpeed) {
+                anchorPtsMs = AV_NOPTS_VALUE;
+                lastSpeed = state.speed;
+            }
+
+            keyframesOnly = state.speed >= kKeyframeOnlySpeed;
+            pVideoCodecCtx->skip_frame = keyframesOnly ? AVDISCARD_NONKEY : AVDISCARD_DEFAULT;
+            if (keyframesOnly)
+                dropUntilPts = AV_NOPTS_VALUE;  // 只解关键帧时无法精确到帧
+
+            // 暂停（且没有单步/未完成的定位）或已到结尾时等待
+            bool idle = state.paused && state.stepPending == 0 && dropUntilPts == AV_NOPTS_VALUE;
+            if (idle || endOfFile) {
+                if (endOfFile && state.stepPending > 0)
+                    consumeStep();   // 已经是最后一帧，没有可前进的
+                anchorPtsMs = AV_NOPTS_VALUE;
+                msleep(10);
+                continue;
+            }
+        }
+
+        int readRet = 0;
+        if (draining) {
+            av_init_packet(&packet);
+            packet.data = nullptr;
+            packet.size = 0;
+            packet.stream_index = videoStream;
+        } else {
+            qint64 readStartNs = perfNowNs();
+            readRet = av_read_frame(pFormatCtx, &packet);
+            mPerf.record(PerfNetwork, readStartNs);
+        }
+        if (readRet < 0) {
+            if (fileMode) {
+                // B 帧重排和帧级多线程会让最后几帧留在解码器里，送空包全部取出后才算播完
+                draining = true;
+                continue;
+            }
             break;
         }
+        if (!draining)
+            mMetrics->onPacket(packet.size);
+
+        if (recordStreams && (packet.stream_index == videoStream || packet.stream_index == sourceAudioStream)) {
+            if (mRecorder.isEnabled()) {
+                mPacketRing.setDurationMs(mRecorder.preRollMs());
+                mPacketRing.push(&packet, perfNowNs());
+            } else if (mPacketRing.count() > 0) {
+                mPacketRing.clear();
+            }
+            mRecorder.process(&packet, &mPacketRing);
+        }
 
         if (packet.stream_index == videoStream && videoStream >= 0) {
+            // 高倍速时跳过非关键帧，不送解码器
+            bool skipPacket = keyframesOnly && !draining && !(packet.flags & AV_PKT_FLAG_KEY);
+
             // 视频帧处理
+            qint64 frameStartNs = perfNowNs();
             int got_picture = 0;
-            avcodec_decode_video2(pVideoCodecCtx, pFrame, &got_picture, &packet);
-
+            if (!skipPacket) {
+                PerfScope scope(&mPerf, PerfDecode);
+                if (avcodec_decode_video2(pVideoCodecCtx, pFrame, &got_picture, &packet) < 0)
+                    mMetrics->onError();
+            }
             if (got_picture) {
-                sws_scale(img_convert_ctx,
-                         (uint8_t const * const *)pFrame->data,
-                         pFrame->linesize, 0, pVideoCodecCtx->height,
-                         pFrameRGB->data, pFrameRGB->linesize);
-
-                QImage tmpImg((uchar *)out_buffer, pVideoCodecCtx->width,
-                            pVideoCodecCtx->height, QImage::Format_RGB32);
-                QImage image = tmpImg.copy();
-                emit sig_GetOneFrame(image);
-
-                // 提取红色通道
-                for(int i = 0; i < pVideoCodecCtx->width; i++) {
-                    for(int j = 0; j < pVideoCodecCtx->height; j++) {
-                        QRgb rgb = image.pixel(i,j);
-                        int r = qRed(rgb);
-                        image.setPixel(i,j,qRgb(r,0,0));
+                mPerf.frameDecoded();
+                mMetrics->onFrameDecoded();
+            } else if (draining) {
+                // 解码器已经取空，最后一帧已显示
+                draining = false;
+                endOfFile = true;
+                setPaused(true);
+                emit sig_PlaybackFinished();
+            }
+
+            bool present = got_picture != 0;
+            if (present && fileMode) {
+                qint64 pts = pFrame->best_effort_timestamp;
+                if (dropUntilPts != AV_NOPTS_VALUE) {
+                    if (pts != AV_NOPTS_VALUE && pts < dropUntilPts) {
+                        present = false;   // 还没到定位目标
+                        mPerf.frameDropped();
+                        mMetrics->onFrameDropped();
+                    } else {
+                        dropUntilPts = AV_NOPTS_VALUE;
                     }
+                } else if (state.paused) {
+                    consumeStep();
+                }
+
+                if (present && pts != AV_NOPTS_VALUE) {
+                    qint64 ptsMs = av_rescale_q(pts - startPts, videoTimeBase, av_make_q(1, 1000));
+
+                    // 按 pts/倍速 等待显示时刻，暂停单步时不等待
+                    if (!state.paused && mRealtimePacing) {
+                        qint64 nowMs = wallClock.elapsed();
+                        if (anchorPtsMs == AV_NOPTS_VALUE) {
+                            anchorPtsMs = ptsMs;
+                            anchorWallMs = nowMs;
+                        }
+                        qint64 waitStartNs = perfNowNs();
+                        qint64 dueMs = anchorWallMs + qint64((ptsMs - anchorPtsMs) / state.speed);
+                        if (dueMs - nowMs > 2000 || nowMs - dueMs > 500) {
+                            // 时间戳跳变或严重落后，重新对齐时钟
+                            anchorPtsMs = ptsMs;
+                            anchorWallMs = nowMs;
+                            dueMs = nowMs;
+                        }
+                        while (!mStopRequested && !hasPendingSeek() && (nowMs = wallClock.elapsed()) < dueMs) {
+                            msleep(qMin<qint64>(dueMs - nowMs, 10));
+                        }
+                        frameStartNs += perfNowNs() - waitStartNs;  // 单帧耗时不含节奏等待
+                    }
+
+                    {
+                        QMutexLocker locker(&mPlaybackMutex);
+                        mPositionMs = ptsMs;
+                    }
+                    emit sig_PositionChanged(ptsMs);
                 }
-                emit sig_GetRFrame(image);
+            }
+
+            if (present) {
+                // 移动侦测按自己的分析帧率抽帧，只增加帧的引用，分析在线程池里做
+                mMotion.submit(pFrame);
+                // 健康检查按自己的采样帧率在解码线程里直接算（只取几千个点）；本地文件可能本来就是静止画面，不检查
+                if (!fileMode && mHealth.analyze(pFrame))
+                    mMetrics->setHealth(mHealth.conditions(), mHealth.lastSignature().mean);
+                mSnapshot.offer(pFrame);
+                {
+                    qint64 pts = pFrame->best_effort_timestamp;
+                    mFrameExport.publish(pFrame, pts == AV_NOPTS_VALUE ? AV_NOPTS_VALUE
+                            : av_rescale_q(pts, pFormatCtx->streams[videoStream]->time_base, av_make_q(1, 1000)));
+                }
+                // 分析画面编码输出：按自己的帧率抽帧，在帧池里直接生成 YUV 画面，编码在单独的线程里做
+                mProcessedOutput.offer(pFrame);
+                // 拼接输出等按自己的节奏取最新一帧：只增加引用，格式转换和缩放由使用方做
+                {
+                    // 判断和保存都在锁里：最后一个使用方注销后不会再存进一帧占着缓冲
+                    QMutexLocker locker(&mLatestMutex);
+                    AVFrame *ref = mFrameTaps > 0 ? av_frame_clone(pFrame) : nullptr;
+                    if (ref) {
+                        mLatestFrame = QSharedPointer<AVFrame>(ref, [](AVFrame *f) { av_frame_free(&f); });
+                        mLatestFrameNs = perfNowNs();
+                    }
+                }
+
+                // GL 画面只要 YUV 帧；RGB 转换和红色通道只在有人接收时才做
+                bool wantYuv = mVideoOutput
+                        && isSignalConnected(QMetaMethod::fromSignal(&VideoPlayer::sig_YuvFrameReady));
+                bool wantRgb = mVideoOutput
+                        && (!wantYuv
+                            || isSignalConnected(QMetaMethod::fromSignal(&VideoPlayer::sig_GetOneFrame))
+                            || isSignalConnected(QMetaMethod::fromSignal(&VideoPlayer::sig_FrameReady))
+                            || isSignalConnected(QMetaMethod::fromSignal(&VideoPlayer::sig_GetRFrame))
+                            || isSignalConnected(QMetaMethod::fromSignal(&VideoPlayer::sig_RFrameReady)));
+
+                if (wantYuv) {
+                    qint64 stageStartNs = perfNowNs();
+                    QSharedPointer<AVFrame> yuv = makeYuvFrame(pFrame, &yuvConvertCtx);
+                    if (yuv) {
+                        bool replaced = false;
+                        if (mYuvMailbox.post(yuv, &replaced))
+                            emit sig_YuvFrameReady();
+                        noteMailboxPost(replaced);
+                    }
+                    mPerf.record(PerfDeliver, stageStartNs);
+                }
+
+                if (wantRgb) {
+                    qint64 stageStartNs = perfNowNs();
+                    // 转 RGB 的同时缩放到界面显示尺寸，直接写进新的 QImage，界面线程不再缩放
+                    QSize outSize = outputSize(pFrame->width, pFrame->height);
+                    // 缓冲从池里取，界面用完的上一帧直接复用；每帧的宽高/格式变化由 rgbConverter 处理
+                    QImage image = imagePool.acquire(outSize, QImage::Format_RGB32);
+                    rgbConverter.setThreadCount(mConvertThreads);
+                    if (!rgbConverter.convert(pFrame, &image))
+                        image.fill(Qt::black);
+                    imagePool.recycle(image);
+                    mPerf.record(PerfConvert, stageStartNs);
+
+                    stageStartNs = perfNowNs();
+                    // 没有界面取帧（基准/测试工具）时不经过邮箱，免得每帧都算作丢弃
+                    if (isSignalConnected(QMetaMethod::fromSignal(&VideoPlayer::sig_FrameReady))) {
+                        bool replaced = false;
+                        if (mFrameMailbox.post(image, &replaced))
+                            emit sig_FrameReady();
+                        noteMailboxPost(replaced);
+                    }
+                    emit sig_GetOneFrame(image);
+                    mPerf.record(PerfDeliver, stageStartNs);
+
+                    // 提取红色通道，写进另一块池缓冲（image 已经共享给界面，原地修改会整帧复制）
+                    stageStartNs = perfNowNs();
+                    QImage red = imagePool.acquire(image.size(), QImage::Format_RGB32);
+                    for (int j = 0; j < image.height(); j++) {
+                        const QRgb *in = reinterpret_cast<const QRgb *>(image.constScanLine(j));
+                        QRgb *out = reinterpret_cast<QRgb *>(red.scanLine(j));
+                        for (int i = 0; i < image.width(); i++)
+                            out[i] = 0xff000000 | (in[i] & 0x00ff0000);   // qRgb(qRed(px), 0, 0)
+                    }
+                    imagePool.recycle(red);
+                    mPerf.record(PerfRedChannel, stageStartNs);
+                    if (isSignalConnected(QMetaMethod::fromSignal(&VideoPlayer::sig_RFrameReady))
+                            && mRFrameMailbox.post(red))
+                        emit sig_RFrameReady();
+                    emit sig_GetRFrame(red);
+                }
+                mPerf.record(PerfFrame, frameStartNs);
             }
         }
         else if (packet.stream_index == audioStream && audioStream >= 0) {
-            // 音频帧处理
-            processAudioPacket(pAudioCodecCtx, &packet);
+            // 音频帧处理，本地文件倍速/暂停/定位时不输出声音
+            if (!fileMode || (state.speed == 1.0 && !state.paused && dropUntilPts == AV_NOPTS_VALUE))
+                processAudioPacket(pAudioCodecCtx, &packet);
         }
 
         av_packet_unref(&packet);
     }
 
     // 清理资源
-    if (out_buffer) av_free(out_buffer);
-    if (pFrameRGB) av_frame_free(&pFrameRGB);
+    if (recordStreams) {
+        mRecorder.closeStreams();   // 录像进行中则在这里收尾，重连后由新的触发重新开始
+        mPacketRing.clear();
+    }
     if (pFrame) av_frame_free(&pFrame);
-    if (img_convert_ctx) sws_freeContext(img_convert_ctx);
+    if (yuvConvertCtx) sws_freeContext(yuvConvertCtx);
     if (pVideoCodecCtx) avcodec_close(pVideoCodecCtx);
     if (pAudioCodecCtx) avcodec_close(pAudioCodecCtx);
     cleanupAudio();
     if (pFormatCtx) avformat_close_input(&pFormatCtx);
+    mMetrics->setConnected(false);
+
+    return mStopRequested ? StreamStopped : StreamEnded;
 }
 
-// videoplayer.cpp
+// 推流交给 PushJobManager，每个输出地址一路，可同时推多路
 void VideoPlayer::startPushing(const QString &inputUrl, const QString &outputUrl) {
     // 确保在主线程执行
     Q_ASSERT(QThread::currentThread() == QCoreApplication::instance()->thread());
 
-    // 安全终止现有进程
-    if (mFFmpegProcess) {
-        disconnect(mFFmpegProcess, nullptr, this, nullptr); // 断开所有信号连接
-        if (mFFmpegProcess->state() == QProcess::Running) {
-            mFFmpegProcess->terminate();
-            if (!mFFmpegProcess->waitForFinished(1000)) {
-                mFFmpegProcess->kill();
-                mFFmpegProcess->waitForFinished();
-            }
-        }
-        mFFmpegProcess->deleteLater(); // 安全删除
-        mFFmpegProcess = nullptr;
-    }
-
-    try {
-        mFFmpegProcess = new QProcess(this);
-        mIsPushing = true;
-
-        // 设置进程环境（可选）
-        QProcessEnvironment env = QProcessEnvironment::systemEnvironment();
-        env.insert("FFREPORT", "file=ffmpeg_log.txt:level=32"); // 生成详细日志
-        mFFmpegProcess->setProcessEnvironment(env);
-
-        // 合并标准输出和错误输出
-        mFFmpegProcess->setProcessChannelMode(QProcess::MergedChannels);
-
-        // 实时输出日志
-        connect(mFFmpegProcess, &QProcess::readyReadStandardOutput, this, [this]() {
-            QString output = QString::fromLocal8Bit(mFFmpegProcess->readAllStandardOutput());
-            emit sig_PushStatus(output.trimmed());
-        });
-
-        // 修改 finished 回调
-        connect(mFFmpegProcess, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
-            this, [this, inputUrl, outputUrl](int code, QProcess::ExitStatus status) {
-                mIsPushing = false;
-                if (code == 0) {
-                    mRetryCount = 0; // 重置计数器
-                    return;
-                }
-
-                if (mRetryCount < 3) {
-                    mRetryCount++;
-                    emit sig_PushStatus(QString("第 %1 次重试...").arg(mRetryCount));
-                    QTimer::singleShot(3000, this, [this, inputUrl, outputUrl]() {
-                        if (!mIsPushing) {
-                            startPushing(inputUrl, outputUrl);
-                        }
-                    });
-                } else {
-                    emit sig_PushStatus("超过最大重试次数，停止推流");
-                    emit sig_RequireButtonReset(); // 通知UI重置按钮状态
-                }
-            });
-
-        // 构建FFmpeg参数
-        QStringList args;
-        bool isCameraInput = inputUrl.contains("Camera", Qt::CaseInsensitive) ||
-                            inputUrl.contains("CAM", Qt::CaseInsensitive) ||
-                            inputUrl.contains("USB", Qt::CaseInsensitive) ||
-                            !QFileInfo(inputUrl).exists();
-
-        if (isCameraInput) {
-            // 摄像头设备参数
-            args << "-f" << "dshow"
-                 << "-thread_queue_size" << "512"  // 增加线程队列大小
-                 << "-i" << "video=" + inputUrl
-                 << "-vcodec" << "libx264"
-                 << "-preset:v" << "medium"
-                 << "-tune:v" << "zerolatency"
-                 << "-g" << "60"
-                 << "-r" << "30"
-                 << "-b:v" << "2M"
-                 << "-bufsize" << "4M"  // 增加缓冲区
-                 << "-maxrate" << "2M"
-                 << "-rtsp_transport" << "tcp"
-                 << "-reconnect" << "1"
-                 << "-reconnect_at_eof" << "1"
-                 << "-reconnect_streamed" << "1"
-                 << "-reconnect_delay_max" << "5"
-                 << "-timeout" << "5000000"
-                 << "-muxdelay" << "0.5"
-                 << "-loglevel" << "warning";  // 减少不必要的日志
-        } else {
-            // 文件输入参数
-            args << "-re"
-                 << "-stream_loop" << "-1"
-                 << "-i" << inputUrl
-                 << "-c" << "copy"
-                 << "-rtsp_transport" << "tcp"
-                 << "-fflags" << "+genpts"
-                 << "-loglevel" << "warning";
-        }
-        args << "-f" << "rtsp" << outputUrl;
-
-        emit sig_PushStatus(QString("启动推流命令: ffmpeg %1").arg(args.join(" ")));
-
-        // 启动进程
-        mFFmpegProcess->start("ffmpeg", args);
-
-        // 检查是否成功启动
-        if (!mFFmpegProcess->waitForStarted(3000)) {
-            emit sig_PushStatus("启动FFmpeg失败");
-            mFFmpegProcess->deleteLater();
-            mFFmpegProcess = nullptr;
-            mIsPushing = false;
-        }
-
-    } catch (const std::exception& e) {
-        qCritical() << "Exception in startPushing:" << e.what();
-        if (mFFmpegProcess) {
-            mFFmpegProcess->deleteLater();
-            mFFmpegProcess = nullptr;
-        }
-        mIsPushing = false;
-        emit sig_PushStatus(QString("发生异常: %1").arg(e.what()));
-    } catch (...) {
-        qCritical() << "Unknown exception in startPushing";
-        if (mFFmpegProcess) {
-            mFFmpegProcess->deleteLater();
-            mFFmpegProcess = nullptr;
-        }
-        mIsPushing = false;
-        emit sig_PushStatus("发生未知异常");
-    }
+    PushJobSpec spec;
+    spec.id = outputUrl;
+    spec.input = inputUrl;
+    spec.output = outputUrl;
+    spec.ffreport = QString::fromLocal8Bit(qgetenv("VP_PUSH_FFREPORT"));   // 默认不写 ffmpeg 日志文件
+    spec.adaptive = qgetenv("VP_PUSH_ADAPTIVE") != "0";   // 摄像头编码默认按负载调整档位
+    spec.lowLatency = qgetenv("VP_PUSH_LOWLATENCY") == "1";   // 帧内刷新代替关键帧，见 PushJobSpec::lowLatency
+    // 同播：VP_PUSH_SIMULCAST="0:30:2000,360:15:500"，第一路推到 outputUrl，其余推到 outputUrl_<高度>p
+    spec.renditions = parseRenditions(QString::fromLocal8Bit(qgetenv("VP_PUSH_SIMULCAST")), outputUrl);
+    PushJob *job = PushJobManager::instance()->submit(spec);   // 同一输出地址的旧任务被替换
+    if (!mPushJobs.contains(job->id()))
+        mPushJobs.append(job->id());
+
+    connect(job, &PushJob::sig_Output, this, &VideoPlayer::sig_PushStatus);
+    connect(job, &PushJob::sig_Progress, this, [this, outputUrl](const PushProgress &progress) {
+        emit sig_PushProgress(outputUrl, progress);
+    });
+    connect(job, &PushJob::sig_Failed, this, [this](const QString &reason) {
+        emit sig_PushStatus(reason);
+        emit sig_RequireButtonReset(); // 通知UI重置按钮状态
+    });
 }
 
-// 停止推流的函数
+// 停止本播放器发起的所有推流
 void VideoPlayer::stopPushing() {
-    if (mFFmpegProcess) {
-        disconnect(mFFmpegProcess, nullptr, this, nullptr); // 断开所有信号
-
-        // 优雅终止
-        mFFmpegProcess->terminate();
-        if (!mFFmpegProcess->waitForFinished(3000)) {
-            mFFmpegProcess->kill();
-            mFFmpegProcess->waitForFinished();
-            qWarning() << "FFmpeg 被强制终止";
-        }
+    for (const QString &id : mPushJobs)
+        PushJobManager::instance()->remove(id);
+    mPushJobs.clear();
+    emit sig_PushStatus("推流已停止");
+}
 
-        mFFmpegProcess->deleteLater();
-        mFFmpegProcess = nullptr;
+// 本播放器发起的推流中有还在运行（或排队、等待重试）的（只在界面线程调用）
+bool VideoPlayer::isPushing() const
+{
+    for (const QString &id : mPushJobs) {
+        PushJob *job = PushJobManager::instance()->job(id);
+        if (job && job->isActive())
+            return true;
     }
-    mIsPushing = false;
-    emit sig_PushStatus("推流已停止");
+    return false;
 }
 
 // videoplayer.cpp
@@ -5,7 +5,20 @@
 #include <QImage>
 #include <QAudioOutput>
 #include <QMutex>
-#include <QProcess>
+#include <QSharedPointer>
+
+#include "keyframeindex.h"
+#include "perfstats.h"
+#include "metrics.h"
+#include "framemailbox.h"
+#include "motiondetector.h"
+#include "packetring.h"
+#include "eventrecorder.h"
+#include "streamhealth.h"
+#include "snapshotter.h"
+#include "sharedframe.h"
+#include "processedoutput.h"
+#include "pushmanager.h"
 
 extern "C" {
     #include <libavcodec/avcodec.h>
@@ -27,21 +40,87 @@ public:
     void startPlay();
     void stopPlay();
     void setStreamUrl(const QString &url);  // 新增方法
-    void startPushing(const QString &inputUrl, const QString &outputUrl); // 新增推流方法
-    void stopPushing(); // 停止推流
+    void startPushing(const QString &inputUrl, const QString &outputUrl); // 新增推流方法，可同时推多路
+    void stopPushing(); // 停止本播放器发起的所有推流
+    bool isPushing() const;
     void setTransportProtocol(const QString &protocol); // 新增方法
 
+    // 本地文件回放控制（线程安全，可在界面线程调用）
+    bool isLocalFile() const;
+    void seekTo(qint64 ms);                   // 精确定位到指定时间
+    void stepFrame(bool backward = false);    // 暂停并前进/后退一帧
+    void setPaused(bool paused);
+    bool isPaused() const;
+    void setPlaybackSpeed(double speed);      // 倍速播放，高倍速时只解码关键帧
+    double playbackSpeed() const;
+
+    void setAudioEnabled(bool enabled);       // 无声卡的服务器/基准测试时关闭音频
+    void setRealtimePacing(bool enabled);     // 关闭后本地文件以最快速度解码
+    void setAutoReconnect(bool enabled);      // 网络流断开后自动重连（默认开启）
+    // 关闭后不再生成显示用的 RGB/YUV 帧（无界面的守护进程），移动侦测、录像、截图等照常
+    void setVideoOutputEnabled(bool enabled);
+    // 界面显示区域（物理像素）。RGB 帧在解码线程里直接等比缩放到该尺寸，界面只需贴图；
+    // 空尺寸（默认）表示输出原始分辨率
+    void setDisplaySize(const QSize &size);
+    void setConvertThreads(int count);        // RGB 转换的并行条带数，0（默认）按分辨率自动选择
+
+    // 热路径各阶段耗时统计，可在任意线程读取快照
+    PerfStats *perfStats();
+    // 移动侦测（默认关闭），事件和叠加层从这个对象的信号取得
+    MotionDetector *motionDetector();
+    // 事件录像（默认关闭）：开启后解码线程保留预录缓冲，移动侦测或外部触发时原样写文件，只用于网络流
+    EventRecorder *recorder();
+    // 画面健康检查（冻结/黑屏/过曝/纯色，默认开启，只用于网络流），结果同时写入流指标
+    StreamHealth *streamHealth();
+    // 截图（按需/定时），编码在线程池里做，不阻塞解码
+    Snapshotter *snapshotter();
+    // 解码帧导出到共享内存给本机其他进程（默认关闭，设置名称后开启），设置可在任意线程调用
+    SharedFrameWriter *frameExport();
+    // 分析画面（原画/红色通道/二值图/移动叠加）重新编码推流或写文件（默认关闭，设置输出地址后开启）
+    ProcessedOutput *processedOutput();
+
+    // 界面线程取最新一帧：收到 sig_FrameReady/sig_RFrameReady 后调用，没有新帧时返回 false
+    bool takeFrame(QImage *image);
+    bool takeRFrame(QImage *image);
+    // GL 画面用的 YUV420P 帧（引用计数，不拷贝像素），收到 sig_YuvFrameReady 后调用。
+    // 连接了 sig_YuvFrameReady 而没有任何 RGB 帧的接收方时，解码线程不再做 RGB 转换
+    bool takeYuvFrame(QSharedPointer<AVFrame> *frame);
+
+    // 最新解码帧的引用，给拼接输出等按自己节奏取帧的使用方（任意线程）。
+    // 有使用方登记时解码线程才保留最新一帧；timeNs 为收到该帧的 perfNowNs()，没有帧时返回空
+    void addFrameTap();
+    void removeFrameTap();
+    QSharedPointer<AVFrame> latestFrame(qint64 *timeNs = nullptr) const;
+
 signals:
+    // 每帧都会发出，只适合 DirectConnection（基准/测试工具在解码线程里直接处理）；
+    // 跨线程显示请用 sig_FrameReady + takeFrame，排队连接会在界面忙时堆积整帧
     void sig_GetOneFrame(QImage);
     void sig_GetRFrame(QImage);
+    void sig_FrameReady();                 // 邮箱里有新帧，取走前不会重复发出
+    void sig_RFrameReady();
+    void sig_YuvFrameReady();
     void sig_StreamError(const QString &errorMsg); // 新增错误信号
     void sig_PushStatus(const QString &message); // 推流状态信号
     void sig_RequireButtonReset();  // 需要复位按钮时触发
+    void sig_PushProgress(const QString &outputUrl, const PushProgress &progress);   // 推流进度，每路约每秒一次
+    void sig_DurationChanged(qint64 ms);   // 本地文件总时长
+    void sig_PositionChanged(qint64 ms);   // 当前显示帧的时间
+    void sig_PlaybackFinished();           // 本地文件播放到结尾
+    void sig_Reconnecting(int attempt);    // 网络流断开，正在第 attempt 次重连
 
 protected:
     void run() override;
 
 private:
+    enum StreamResult {
+        StreamOpenFailed,   // 打不开或没有可用的流
+        StreamEnded,        // 播放过程中断开/结束
+        StreamStopped       // stopPlay 请求退出
+    };
+    StreamResult playStream(bool reconnecting);
+    static int interruptCallback(void *opaque);
+
     QString mFileName;
     bool mStopRequested;
     QMutex mStopMutex;
@@ -57,10 +136,58 @@ private:
     void processAudioPacket(AVCodecContext *audioCodecCtx, AVPacket *packet);
     //2025.6.19
     QString mStreamUrl;  // 存储流地址
-    bool mIsPushing;
-    QProcess *mFFmpegProcess = nullptr; // 用于调用FFmpeg命令行推流
+    QStringList mPushJobs;   // 本播放器提交给 PushJobManager 的推流任务 id
     QString m_transport; // 存储传输协议 ("tcp" 或 "udp")
-    int mRetryCount = 0;
+
+    // 本地文件回放
+    struct PlaybackState {
+        qint64 seekMs;
+        int stepPending;
+        bool paused;
+        double speed;
+    };
+    PlaybackState takePlaybackState();
+    bool hasPendingSeek() const;
+    void consumeStep();
+    void seekFile(AVFormatContext *fmtCtx, int videoStream, AVCodecContext *videoCtx,
+                  AVCodecContext *audioCtx, qint64 targetMs, qint64 *dropUntilPts);
+
+    bool mIsLocalFile = false;
+    bool mAudioEnabled = true;
+    bool mRealtimePacing = true;
+    bool mAutoReconnect = true;
+    bool mVideoOutput = true;
+    int mConvertThreads = 0;
+    mutable QMutex mPlaybackMutex;            // 不能复用 mStopMutex，stopPlay 持有它等待线程退出
+    qint64 mSeekTargetMs = -1;
+    int mStepPending = 0;
+    bool mPaused = false;
+    double mPlaybackSpeed = 1.0;
+    qint64 mPositionMs = 0;
+    qint64 mFrameDurationMs = 40;
+    QSharedPointer<KeyframeIndex> mKeyframeIndex;
+
+    QSize outputSize(int srcWidth, int srcHeight) const;
+    mutable QMutex mDisplayMutex;
+    QSize mDisplaySize;
+
+    PerfStats mPerf;
+    EventRecorder mRecorder;
+    MotionDetector mMotion;                   // 在 mRecorder 之后声明：先析构，等完分析任务（会直接调用 mRecorder）
+    PacketRing mPacketRing;                   // 预录缓冲，只在解码线程访问
+    StreamHealth mHealth;
+    Snapshotter mSnapshot;
+    SharedFrameWriter mFrameExport;           // publish/close 只在解码线程调用
+    ProcessedOutput mProcessedOutput;         // offer/close 只在解码线程调用
+    FrameMailbox<QImage> mFrameMailbox;
+    FrameMailbox<QImage> mRFrameMailbox;
+    FrameMailbox<QSharedPointer<AVFrame> > mYuvMailbox;
+    mutable QMutex mLatestMutex;              // 保护以下三项
+    int mFrameTaps;
+    QSharedPointer<AVFrame> mLatestFrame;
+    qint64 mLatestFrameNs = 0;
+    void noteMailboxPost(bool replaced);
+    QSharedPointer<StreamMetrics> mMetrics;       // 拉流指标，run() 期间注册
 
 private slots:
     void playAudioData(const QByteArray &audioData);
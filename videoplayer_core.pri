@@ -0,0 +1,51 @@
+# 播放核心：界面程序、基准测试等目标共用同一份解复用/解码/转换代码
+
+QT += core gui multimedia concurrent network
+
+INCLUDEPATH += $$PWD \
+               $$PWD/src
+
+SOURCES += \
+    $$PWD/videoplayer.cpp \
+    $$PWD/frameconverter.cpp \
+    $$PWD/yuvconverter.cpp \
+    $$PWD/keyframeindex.cpp \
+    $$PWD/perfstats.cpp \
+    $$PWD/metrics.cpp \
+    $$PWD/motiondetector.cpp \
+    $$PWD/packetring.cpp \
+    $$PWD/eventrecorder.cpp \
+    $$PWD/streamhealth.cpp \
+    $$PWD/snapshotter.cpp \
+    $$PWD/sharedframe.cpp \
+    $$PWD/processedoutput.cpp \
+    $$PWD/mosaiccompositor.cpp \
+    $$PWD/pushmanager.cpp \
+    $$PWD/adaptiveencoder.cpp \
+    $$PWD/httpserver.cpp
+
+HEADERS += \
+    $$PWD/videoplayer.h \
+    $$PWD/frameconverter.h \
+    $$PWD/imagepool.h \
+    $$PWD/yuvconverter.h \
+    $$PWD/keyframeindex.h \
+    $$PWD/perfstats.h \
+    $$PWD/metrics.h \
+    $$PWD/motiondetector.h \
+    $$PWD/packetring.h \
+    $$PWD/eventrecorder.h \
+    $$PWD/streamhealth.h \
+    $$PWD/snapshotter.h \
+    $$PWD/sharedframe.h \
+    $$PWD/framepool.h \
+    $$PWD/processedoutput.h \
+    $$PWD/mosaiccompositor.h \
+    $$PWD/pushmanager.h \
+    $$PWD/adaptiveencoder.h \
+    $$PWD/httpserver.h
+
+# 共享内存帧导出用 shm_open
+unix:!macx: LIBS += -lrt
+
+include($$PWD/ffmpeg.pri)
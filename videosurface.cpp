@@ -0,0 +1,251 @@
+#include "videosurface.h"
+
+#include <QOpenGLContext>
+#include <QOffscreenSurface>
+#include <QOpenGLFramebufferObject>
+#include <QMatrix3x3>
+#include <QVector3D>
+#include <QDebug>
+
+#include <cstring>
+
+#ifndef GL_UNPACK_ROW_LENGTH
+#define GL_UNPACK_ROW_LENGTH 0x0CF2
+#endif
+
+static const char *kVertexShader =
+        "attribute vec2 position;\n"
+        "attribute vec2 texCoord;\n"
+        "varying vec2 vTexCoord;\n"
+        "void main() {\n"
+        "    gl_Position = vec4(position, 0.0, 1.0);\n"
+        "    vTexCoord = texCoord;\n"
+        "}\n";
+
+static const char *kFragmentShader =
+        "#ifdef GL_ES\n"
+        "precision mediump float;\n"
+        "#endif\n"
+        "varying vec2 vTexCoord;\n"
+        "uniform sampler2D texY;\n"
+        "uniform sampler2D texU;\n"
+        "uniform sampler2D texV;\n"
+        "uniform mat3 yuvToRgb;\n"
+        "uniform vec3 yuvOffset;\n"
+        "void main() {\n"
+        "    vec3 yuv = vec3(texture2D(texY, vTexCoord).r,\n"
+        "                    texture2D(texU, vTexCoord).r,\n"
+        "                    texture2D(texV, vTexCoord).r) + yuvOffset;\n"
+        "    gl_FragColor = vec4(clamp(yuvToRgb * yuv, 0.0, 1.0), 1.0);\n"
+        "}\n";
+
+// 行优先：R/G/B 各一行，列为 Y/U/V
+static const float kBt601Limited[9] = { 1.164384f,  0.0f,       1.596027f,
+                                        1.164384f, -0.391762f, -0.812968f,
+                                        1.164384f,  2.017232f,  0.0f };
+static const float kBt709Limited[9] = { 1.164384f,  0.0f,       1.792741f,
+                                        1.164384f, -0.213249f, -0.532909f,
+                                        1.164384f,  2.112402f,  0.0f };
+static const float kBt601Full[9]    = { 1.0f,  0.0f,       1.402f,
+                                        1.0f, -0.344136f, -0.714136f,
+                                        1.0f,  1.772f,     0.0f };
+static const float kBt709Full[9]    = { 1.0f,  0.0f,       1.5748f,
+                                        1.0f, -0.187324f, -0.468124f,
+                                        1.0f,  1.8556f,    0.0f };
+
+VideoSurface::VideoSurface(QWidget *parent)
+    : QOpenGLWidget(parent), mHasRowLength(false), mColorKey(-1), mFrameDirty(false), mPerf(nullptr)
+{
+    for (int i = 0; i < 3; i++) {
+        mTextures[i] = 0;
+        mTextureWidth[i] = mTextureHeight[i] = 0;
+    }
+}
+
+VideoSurface::~VideoSurface()
+{
+    if (mTextures[0] && context()) {
+        makeCurrent();
+        glDeleteTextures(3, mTextures);
+        doneCurrent();
+    }
+}
+
+bool VideoSurface::isAvailable()
+{
+    QOpenGLContext context;
+    if (!context.create())
+        return false;
+    QOffscreenSurface surface;
+    surface.setFormat(context.format());
+    surface.create();
+    if (!context.makeCurrent(&surface))
+        return false;
+    // QOpenGLWidget 渲染到 FBO
+    bool ok = QOpenGLFramebufferObject::hasOpenGLFramebufferObjects();
+    context.doneCurrent();
+    return ok;
+}
+
+void VideoSurface::setFrame(const QSharedPointer<AVFrame> &frame)
+{
+    mFrame = frame;
+    mFrameDirty = true;
+    update();
+}
+
+void VideoSurface::setPerfStats(PerfStats *stats)
+{
+    mPerf = stats;
+}
+
+QString VideoSurface::rendererInfo() const
+{
+    return mRendererInfo;
+}
+
+void VideoSurface::initializeGL()
+{
+    initializeOpenGLFunctions();
+
+    QOpenGLContext *ctx = context();
+    mHasRowLength = !ctx->isOpenGLES() || ctx->format().majorVersion() >= 3;
+    mRendererInfo = QString("%1 / %2 / %3")
+            .arg(reinterpret_cast<const char *>(glGetString(GL_VENDOR)))
+            .arg(reinterpret_cast<const char *>(glGetString(GL_RENDERER)))
+            .arg(reinterpret_cast<const char *>(glGetString(GL_VERSION)));
+    qDebug() << "VideoSurface:" << mRendererInfo;
+
+    mProgram.removeAllShaders();   // 换顶层窗口时会重新初始化
+    mProgram.addShaderFromSourceCode(QOpenGLShader::Vertex, kVertexShader);
+    mProgram.addShaderFromSourceCode(QOpenGLShader::Fragment, kFragmentShader);
+    mProgram.bindAttributeLocation("position", 0);
+    mProgram.bindAttributeLocation("texCoord", 1);
+    if (!mProgram.link())
+        qWarning() << "VideoSurface: shader link failed" << mProgram.log();
+
+    mProgram.bind();
+    mProgram.setUniformValue("texY", 0);
+    mProgram.setUniformValue("texU", 1);
+    mProgram.setUniformValue("texV", 2);
+    mProgram.release();
+
+    glGenTextures(3, mTextures);
+    for (int i = 0; i < 3; i++) {
+        glBindTexture(GL_TEXTURE_2D, mTextures[i]);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        mTextureWidth[i] = mTextureHeight[i] = 0;
+    }
+    mColorKey = -1;
+    mFrameDirty = true;
+}
+
+void VideoSurface::resizeGL(int, int)
+{
+    // 视口在 paintGL 里按画面比例重新计算
+}
+
+void VideoSurface::uploadPlane(int index, const uint8_t *data, int linesize, int width, int height)
+{
+    glActiveTexture(GL_TEXTURE0 + index);
+    glBindTexture(GL_TEXTURE_2D, mTextures[index]);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    if (mTextureWidth[index] != width || mTextureHeight[index] != height) {
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE, width, height, 0, GL_LUMINANCE, GL_UNSIGNED_BYTE, nullptr);
+        mTextureWidth[index] = width;
+        mTextureHeight[index] = height;
+    }
+
+    if (linesize == width) {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_LUMINANCE, GL_UNSIGNED_BYTE, data);
+    } else if (mHasRowLength) {
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, linesize);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_LUMINANCE, GL_UNSIGNED_BYTE, data);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    } else {
+        // GLES2 没有 UNPACK_ROW_LENGTH，去掉行尾填充后再上传
+        mRepack.resize(width * height);
+        for (int y = 0; y < height; y++)
+            memcpy(mRepack.data() + y * width, data + y * linesize, width);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_LUMINANCE, GL_UNSIGNED_BYTE, mRepack.constData());
+    }
+}
+
+// 未标明色彩空间时按 BT.601 处理，与 sws_scale 的默认值（QLabel 路径）一致
+void VideoSurface::updateColorMatrix(const AVFrame *frame)
+{
+    bool full = frame->color_range == AVCOL_RANGE_JPEG || frame->format == AV_PIX_FMT_YUVJ420P;
+    bool bt709 = frame->colorspace == AVCOL_SPC_BT709;
+    int key = (bt709 ? 2 : 0) + (full ? 1 : 0);
+    if (key == mColorKey)
+        return;
+    mColorKey = key;
+
+    const float *m = bt709 ? (full ? kBt709Full : kBt709Limited) : (full ? kBt601Full : kBt601Limited);
+    mProgram.setUniformValue("yuvToRgb", QMatrix3x3(m));
+    mProgram.setUniformValue("yuvOffset", QVector3D(full ? 0.0f : -16.0f / 255.0f, -128.0f / 255.0f, -128.0f / 255.0f));
+}
+
+QRect VideoSurface::displayRect(const AVFrame *frame) const
+{
+    const qreal dpr = devicePixelRatioF();
+    const int w = int(width() * dpr), h = int(height() * dpr);
+
+    double aspect = double(frame->width) / frame->height;
+    if (frame->sample_aspect_ratio.num > 0 && frame->sample_aspect_ratio.den > 0)
+        aspect *= av_q2d(frame->sample_aspect_ratio);
+
+    int dw = w, dh = int(w / aspect);
+    if (dh > h) {
+        dh = h;
+        dw = int(h * aspect);
+    }
+    return QRect((w - dw) / 2, (h - dh) / 2, dw, dh);
+}
+
+void VideoSurface::paintGL()
+{
+    qint64 startNs = perfNowNs();
+
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+    if (!mFrame || !mProgram.isLinked())
+        return;
+
+    const AVFrame *frame = mFrame.data();
+    mProgram.bind();
+    if (mFrameDirty) {
+        const int cw = (frame->width + 1) / 2, ch = (frame->height + 1) / 2;
+        uploadPlane(0, frame->data[0], frame->linesize[0], frame->width, frame->height);
+        uploadPlane(1, frame->data[1], frame->linesize[1], cw, ch);
+        uploadPlane(2, frame->data[2], frame->linesize[2], cw, ch);
+        mFrameDirty = false;
+    } else {
+        for (int i = 0; i < 3; i++) {
+            glActiveTexture(GL_TEXTURE0 + i);
+            glBindTexture(GL_TEXTURE_2D, mTextures[i]);
+        }
+    }
+    updateColorMatrix(frame);
+
+    QRect rect = displayRect(frame);
+    glViewport(rect.x(), rect.y(), rect.width(), rect.height());
+
+    static const GLfloat positions[] = { -1.0f, -1.0f,  1.0f, -1.0f,  -1.0f, 1.0f,  1.0f, 1.0f };
+    static const GLfloat texCoords[] = {  0.0f,  1.0f,  1.0f,  1.0f,   0.0f, 0.0f,  1.0f, 0.0f };
+    mProgram.enableAttributeArray(0);
+    mProgram.enableAttributeArray(1);
+    mProgram.setAttributeArray(0, GL_FLOAT, positions, 2);
+    mProgram.setAttributeArray(1, GL_FLOAT, texCoords, 2);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    mProgram.disableAttributeArray(0);
+    mProgram.disableAttributeArray(1);
+    mProgram.release();
+
+    if (mPerf)
+        mPerf->record(PerfPaint, startNs);
+}
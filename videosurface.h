@@ -0,0 +1,58 @@
+#ifndef VIDEOSURFACE_H
+#define VIDEOSURFACE_H
+
+#include <QOpenGLWidget>
+#include <QOpenGLFunctions>
+#include <QOpenGLShaderProgram>
+#include <QSharedPointer>
+#include <QByteArray>
+
+#include "perfstats.h"
+
+extern "C" {
+    #include <libavutil/frame.h>
+}
+
+// OpenGL 视频画面：直接上传解码出的 Y/U/V 三个平面，在着色器里转 RGB 并缩放，
+// CPU 上不做 sws_scale 和 QPixmap 缩放。只接受 YUV420P/YUVJ420P 帧。
+// 没有可用 OpenGL 时（isAvailable() 为 false）由界面退回 QLabel 显示。
+class VideoSurface : public QOpenGLWidget, protected QOpenGLFunctions
+{
+    Q_OBJECT
+
+public:
+    explicit VideoSurface(QWidget *parent = nullptr);
+    ~VideoSurface();
+
+    void setFrame(const QSharedPointer<AVFrame> &frame);
+    void setPerfStats(PerfStats *stats);   // 记录 PerfPaint 阶段
+    QString rendererInfo() const;          // GL_VENDOR / GL_RENDERER / GL_VERSION，初始化后有效
+
+    // 能否创建 OpenGL 上下文，需在 QApplication 创建之后调用
+    static bool isAvailable();
+
+protected:
+    void initializeGL() override;
+    void resizeGL(int w, int h) override;
+    void paintGL() override;
+
+private:
+    void uploadPlane(int index, const uint8_t *data, int linesize, int width, int height);
+    void updateColorMatrix(const AVFrame *frame);
+    QRect displayRect(const AVFrame *frame) const;
+
+    QOpenGLShaderProgram mProgram;
+    GLuint mTextures[3];
+    int mTextureWidth[3];
+    int mTextureHeight[3];
+    bool mHasRowLength;          // 桌面 GL 或 GLES3 才能按行跨度直接上传
+    QByteArray mRepack;          // 不支持行跨度时的紧凑拷贝
+    int mColorKey;               // 当前矩阵对应的 色彩空间*2+范围
+
+    QSharedPointer<AVFrame> mFrame;
+    bool mFrameDirty;
+    PerfStats *mPerf;
+    QString mRendererInfo;
+};
+
+#endif // VIDEOSURFACE_H
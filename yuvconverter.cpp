@@ -0,0 +1,529 @@
+#include "yuvconverter.h"
+
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+extern "C" {
+    #include <libavutil/cpu.h>
+    #include <libavutil/pixfmt.h>
+}
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define VP_YUV_X86
+#include <immintrin.h>
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define VP_YUV_NEON
+#include <arm_neon.h>
+#endif
+
+// GCC/Clang 需要按函数打开指令集，MSVC 不需要
+#if defined(__GNUC__) || defined(__clang__)
+#define VP_TARGET(isa) __attribute__((target(isa)))
+#else
+#define VP_TARGET(isa)
+#endif
+
+// BT.601 定点系数（Q6）。有限范围的 Y 系数 1.164 用 74.5 表示（74 倍再加半倍），
+// 中间结果都在 int16 以内，最后一步相加用饱和加法
+static const YuvConverter::Coefficients kLimitedRange = { 16, 74, -1, 102, -25, -52, 129 };
+static const YuvConverter::Coefficients kFullRange    = {  0, 64,  0,  90, -22, -46, 113 };
+
+static inline uint8_t clampPixel(int value)
+{
+    value >>= 6;
+    return uint8_t(value < 0 ? 0 : (value > 255 ? 255 : value));
+}
+
+// 从第 x 个像素开始按 C 实现转换，SIMD 实现用它处理行尾
+static void rowTail(const uint8_t *y, const uint8_t *u, const uint8_t *v,
+                    uint8_t *dst, int x, int width, const YuvConverter::Coefficients &c)
+{
+    quint32 *out = reinterpret_cast<quint32 *>(dst);
+    for (; x < width; x++) {
+        int d = y[x] - c.yOffset;
+        int yy = d * c.yMul + ((d >> 1) & c.yHalf) + 32;
+        int uu = u[x >> 1] - 128;
+        int vv = v[x >> 1] - 128;
+        out[x] = 0xff000000u | (quint32(clampPixel(yy + c.vr * vv)) << 16)
+                | (quint32(clampPixel(yy + c.ug * uu + c.vg * vv)) << 8)
+                | quint32(clampPixel(yy + c.ub * uu));
+    }
+}
+
+static void rowC(const uint8_t *y, const uint8_t *u, const uint8_t *v,
+                 uint8_t *dst, int width, const YuvConverter::Coefficients &c)
+{
+    rowTail(y, u, v, dst, 0, width, c);
+}
+
+static void columnTail(const uint8_t *const *rows, const qint16 *weights, int taps,
+                       int x, int width, uint8_t *out)
+{
+    for (; x < width; x++) {
+        int sum = 8192;
+        for (int j = 0; j < taps; j++)
+            sum += weights[j] * rows[j][x];
+        out[x] = uint8_t(sum >> 14);
+    }
+}
+
+static void columnC(const uint8_t *const *rows, const qint16 *weights, int taps, int width, uint8_t *out)
+{
+    columnTail(rows, weights, taps, 0, width, out);
+}
+
+#ifdef VP_YUV_X86
+// 每次 16 个像素：8 组色度各算一次，再复制给相邻两个像素
+VP_TARGET("sse4.1")
+static void rowSse41(const uint8_t *y, const uint8_t *u, const uint8_t *v,
+                     uint8_t *dst, int width, const YuvConverter::Coefficients &c)
+{
+    const __m128i yOffset = _mm_set1_epi16(c.yOffset);
+    const __m128i yMul = _mm_set1_epi16(c.yMul);
+    const __m128i yHalf = _mm_set1_epi16(c.yHalf);
+    const __m128i round = _mm_set1_epi16(32);
+    const __m128i bias = _mm_set1_epi16(128);
+    const __m128i vr = _mm_set1_epi16(c.vr), ug = _mm_set1_epi16(c.ug);
+    const __m128i vg = _mm_set1_epi16(c.vg), ub = _mm_set1_epi16(c.ub);
+    const __m128i alpha = _mm_set1_epi8(-1);
+
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m128i y8 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(y + x));
+        __m128i u16 = _mm_sub_epi16(_mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(u + x / 2))), bias);
+        __m128i v16 = _mm_sub_epi16(_mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(v + x / 2))), bias);
+
+        __m128i rc = _mm_mullo_epi16(v16, vr);
+        __m128i gc = _mm_add_epi16(_mm_mullo_epi16(u16, ug), _mm_mullo_epi16(v16, vg));
+        __m128i bc = _mm_mullo_epi16(u16, ub);
+
+        __m128i yLo = _mm_cvtepu8_epi16(y8);
+        __m128i yHi = _mm_cvtepu8_epi16(_mm_srli_si128(y8, 8));
+        yLo = _mm_sub_epi16(yLo, yOffset);
+        yHi = _mm_sub_epi16(yHi, yOffset);
+        yLo = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(yLo, yMul), _mm_and_si128(_mm_srai_epi16(yLo, 1), yHalf)), round);
+        yHi = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(yHi, yMul), _mm_and_si128(_mm_srai_epi16(yHi, 1), yHalf)), round);
+
+        __m128i r8 = _mm_packus_epi16(_mm_srai_epi16(_mm_adds_epi16(yLo, _mm_unpacklo_epi16(rc, rc)), 6),
+                                      _mm_srai_epi16(_mm_adds_epi16(yHi, _mm_unpackhi_epi16(rc, rc)), 6));
+        __m128i g8 = _mm_packus_epi16(_mm_srai_epi16(_mm_adds_epi16(yLo, _mm_unpacklo_epi16(gc, gc)), 6),
+                                      _mm_srai_epi16(_mm_adds_epi16(yHi, _mm_unpackhi_epi16(gc, gc)), 6));
+        __m128i b8 = _mm_packus_epi16(_mm_srai_epi16(_mm_adds_epi16(yLo, _mm_unpacklo_epi16(bc, bc)), 6),
+                                      _mm_srai_epi16(_mm_adds_epi16(yHi, _mm_unpackhi_epi16(bc, bc)), 6));
+
+        // 内存中 RGB32 为 B G R A
+        __m128i bg0 = _mm_unpacklo_epi8(b8, g8), bg1 = _mm_unpackhi_epi8(b8, g8);
+        __m128i ra0 = _mm_unpacklo_epi8(r8, alpha), ra1 = _mm_unpackhi_epi8(r8, alpha);
+        __m128i *out = reinterpret_cast<__m128i *>(dst + x * 4);
+        _mm_storeu_si128(out + 0, _mm_unpacklo_epi16(bg0, ra0));
+        _mm_storeu_si128(out + 1, _mm_unpackhi_epi16(bg0, ra0));
+        _mm_storeu_si128(out + 2, _mm_unpacklo_epi16(bg1, ra1));
+        _mm_storeu_si128(out + 3, _mm_unpackhi_epi16(bg1, ra1));
+    }
+    rowTail(y, u, v, dst, x, width, c);
+}
+
+// 垂直滤波每次 8 个像素，相邻两行交织后用 madd 一次乘加两个抽头
+VP_TARGET("sse4.1")
+static void columnSse41(const uint8_t *const *rows, const qint16 *weights, int taps, int width, uint8_t *out)
+{
+    const __m128i round = _mm_set1_epi32(8192);
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        __m128i accLo = round, accHi = round;
+        for (int j = 0; j < taps; j += 2) {
+            __m128i a = _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(rows[j] + x)));
+            __m128i b = _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(rows[j + 1] + x)));
+            __m128i w = _mm_set1_epi32(int(quint16(weights[j]) | (quint32(quint16(weights[j + 1])) << 16)));
+            accLo = _mm_add_epi32(accLo, _mm_madd_epi16(_mm_unpacklo_epi16(a, b), w));
+            accHi = _mm_add_epi32(accHi, _mm_madd_epi16(_mm_unpackhi_epi16(a, b), w));
+        }
+        __m128i sum = _mm_packs_epi32(_mm_srai_epi32(accLo, 14), _mm_srai_epi32(accHi, 14));
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(out + x), _mm_packus_epi16(sum, sum));
+    }
+    columnTail(rows, weights, taps, x, width, out);
+}
+
+// 每次 32 个像素。AVX2 的 unpack/pack 在两个 128 位通道内各自进行，
+// 用 permute4x64(0xD8) 把数据排成通道内连续的顺序
+VP_TARGET("avx2")
+static void rowAvx2(const uint8_t *y, const uint8_t *u, const uint8_t *v,
+                    uint8_t *dst, int width, const YuvConverter::Coefficients &c)
+{
+    const __m256i yOffset = _mm256_set1_epi16(c.yOffset);
+    const __m256i yMul = _mm256_set1_epi16(c.yMul);
+    const __m256i yHalf = _mm256_set1_epi16(c.yHalf);
+    const __m256i round = _mm256_set1_epi16(32);
+    const __m256i bias = _mm256_set1_epi16(128);
+    const __m256i vr = _mm256_set1_epi16(c.vr), ug = _mm256_set1_epi16(c.ug);
+    const __m256i vg = _mm256_set1_epi16(c.vg), ub = _mm256_set1_epi16(c.ub);
+    const __m256i alpha = _mm256_set1_epi8(-1);
+
+    int x = 0;
+    for (; x + 32 <= width; x += 32) {
+        __m256i u16 = _mm256_sub_epi16(_mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(u + x / 2))), bias);
+        __m256i v16 = _mm256_sub_epi16(_mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(v + x / 2))), bias);
+
+        __m256i rc = _mm256_permute4x64_epi64(_mm256_mullo_epi16(v16, vr), 0xD8);
+        __m256i gc = _mm256_permute4x64_epi64(_mm256_add_epi16(_mm256_mullo_epi16(u16, ug),
+                                                               _mm256_mullo_epi16(v16, vg)), 0xD8);
+        __m256i bc = _mm256_permute4x64_epi64(_mm256_mullo_epi16(u16, ub), 0xD8);
+
+        __m256i yLo = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(y + x)));
+        __m256i yHi = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(y + x + 16)));
+        yLo = _mm256_sub_epi16(yLo, yOffset);
+        yHi = _mm256_sub_epi16(yHi, yOffset);
+        yLo = _mm256_add_epi16(_mm256_add_epi16(_mm256_mullo_epi16(yLo, yMul),
+                                                _mm256_and_si256(_mm256_srai_epi16(yLo, 1), yHalf)), round);
+        yHi = _mm256_add_epi16(_mm256_add_epi16(_mm256_mullo_epi16(yHi, yMul),
+                                                _mm256_and_si256(_mm256_srai_epi16(yHi, 1), yHalf)), round);
+
+        __m256i r8 = _mm256_permute4x64_epi64(_mm256_packus_epi16(
+                _mm256_srai_epi16(_mm256_adds_epi16(yLo, _mm256_unpacklo_epi16(rc, rc)), 6),
+                _mm256_srai_epi16(_mm256_adds_epi16(yHi, _mm256_unpackhi_epi16(rc, rc)), 6)), 0xD8);
+        __m256i g8 = _mm256_permute4x64_epi64(_mm256_packus_epi16(
+                _mm256_srai_epi16(_mm256_adds_epi16(yLo, _mm256_unpacklo_epi16(gc, gc)), 6),
+                _mm256_srai_epi16(_mm256_adds_epi16(yHi, _mm256_unpackhi_epi16(gc, gc)), 6)), 0xD8);
+        __m256i b8 = _mm256_permute4x64_epi64(_mm256_packus_epi16(
+                _mm256_srai_epi16(_mm256_adds_epi16(yLo, _mm256_unpacklo_epi16(bc, bc)), 6),
+                _mm256_srai_epi16(_mm256_adds_epi16(yHi, _mm256_unpackhi_epi16(bc, bc)), 6)), 0xD8);
+
+        // 通道内交织后：p0 = 像素 0-3 | 16-19，p1 = 4-7 | 20-23，p2 = 8-11 | 24-27，p3 = 12-15 | 28-31
+        __m256i bg0 = _mm256_unpacklo_epi8(b8, g8), bg1 = _mm256_unpackhi_epi8(b8, g8);
+        __m256i ra0 = _mm256_unpacklo_epi8(r8, alpha), ra1 = _mm256_unpackhi_epi8(r8, alpha);
+        __m256i p0 = _mm256_unpacklo_epi16(bg0, ra0), p1 = _mm256_unpackhi_epi16(bg0, ra0);
+        __m256i p2 = _mm256_unpacklo_epi16(bg1, ra1), p3 = _mm256_unpackhi_epi16(bg1, ra1);
+        __m256i *out = reinterpret_cast<__m256i *>(dst + x * 4);
+        _mm256_storeu_si256(out + 0, _mm256_permute2x128_si256(p0, p1, 0x20));
+        _mm256_storeu_si256(out + 1, _mm256_permute2x128_si256(p2, p3, 0x20));
+        _mm256_storeu_si256(out + 2, _mm256_permute2x128_si256(p0, p1, 0x31));
+        _mm256_storeu_si256(out + 3, _mm256_permute2x128_si256(p2, p3, 0x31));
+    }
+    rowTail(y, u, v, dst, x, width, c);
+}
+
+// 每次 16 个像素；pack 之后每个通道的低 64 位是结果，permute 到一起再存
+VP_TARGET("avx2")
+static void columnAvx2(const uint8_t *const *rows, const qint16 *weights, int taps, int width, uint8_t *out)
+{
+    const __m256i round = _mm256_set1_epi32(8192);
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m256i accLo = round, accHi = round;
+        for (int j = 0; j < taps; j += 2) {
+            __m256i a = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(rows[j] + x)));
+            __m256i b = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(rows[j + 1] + x)));
+            __m256i w = _mm256_set1_epi32(int(quint16(weights[j]) | (quint32(quint16(weights[j + 1])) << 16)));
+            accLo = _mm256_add_epi32(accLo, _mm256_madd_epi16(_mm256_unpacklo_epi16(a, b), w));
+            accHi = _mm256_add_epi32(accHi, _mm256_madd_epi16(_mm256_unpackhi_epi16(a, b), w));
+        }
+        __m256i sum = _mm256_packs_epi32(_mm256_srai_epi32(accLo, 14), _mm256_srai_epi32(accHi, 14));
+        __m256i bytes = _mm256_permute4x64_epi64(_mm256_packus_epi16(sum, sum), 0x08);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + x), _mm256_castsi256_si128(bytes));
+    }
+    columnTail(rows, weights, taps, x, width, out);
+}
+#endif
+
+#ifdef VP_YUV_NEON
+static void rowNeon(const uint8_t *y, const uint8_t *u, const uint8_t *v,
+                    uint8_t *dst, int width, const YuvConverter::Coefficients &c)
+{
+    const int16x8_t yOffset = vdupq_n_s16(c.yOffset);
+    const int16x8_t yHalf = vdupq_n_s16(c.yHalf);
+    const int16x8_t round = vdupq_n_s16(32);
+    const int16x8_t bias = vdupq_n_s16(128);
+
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        uint8x16_t y8 = vld1q_u8(y + x);
+        int16x8_t u16 = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(vld1_u8(u + x / 2))), bias);
+        int16x8_t v16 = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(vld1_u8(v + x / 2))), bias);
+
+        int16x8x2_t rc = vzipq_s16(vmulq_n_s16(v16, c.vr), vmulq_n_s16(v16, c.vr));
+        int16x8_t g = vmlaq_n_s16(vmulq_n_s16(u16, c.ug), v16, c.vg);
+        int16x8x2_t gc = vzipq_s16(g, g);
+        int16x8x2_t bc = vzipq_s16(vmulq_n_s16(u16, c.ub), vmulq_n_s16(u16, c.ub));
+
+        int16x8_t yLo = vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(y8)));
+        int16x8_t yHi = vreinterpretq_s16_u16(vmovl_u8(vget_high_u8(y8)));
+        yLo = vsubq_s16(yLo, yOffset);
+        yHi = vsubq_s16(yHi, yOffset);
+        yLo = vaddq_s16(vaddq_s16(vmulq_n_s16(yLo, c.yMul), vandq_s16(vshrq_n_s16(yLo, 1), yHalf)), round);
+        yHi = vaddq_s16(vaddq_s16(vmulq_n_s16(yHi, c.yMul), vandq_s16(vshrq_n_s16(yHi, 1), yHalf)), round);
+
+        uint8x16x4_t px;
+        px.val[0] = vcombine_u8(vqshrun_n_s16(vqaddq_s16(yLo, bc.val[0]), 6), vqshrun_n_s16(vqaddq_s16(yHi, bc.val[1]), 6));
+        px.val[1] = vcombine_u8(vqshrun_n_s16(vqaddq_s16(yLo, gc.val[0]), 6), vqshrun_n_s16(vqaddq_s16(yHi, gc.val[1]), 6));
+        px.val[2] = vcombine_u8(vqshrun_n_s16(vqaddq_s16(yLo, rc.val[0]), 6), vqshrun_n_s16(vqaddq_s16(yHi, rc.val[1]), 6));
+        px.val[3] = vdupq_n_u8(255);
+        vst4q_u8(dst + x * 4, px);
+    }
+    rowTail(y, u, v, dst, x, width, c);
+}
+
+static void columnNeon(const uint8_t *const *rows, const qint16 *weights, int taps, int width, uint8_t *out)
+{
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        int32x4_t accLo = vdupq_n_s32(8192), accHi = vdupq_n_s32(8192);
+        for (int j = 0; j < taps; j++) {
+            int16x8_t a = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(rows[j] + x)));
+            accLo = vmlal_n_s16(accLo, vget_low_s16(a), weights[j]);
+            accHi = vmlal_n_s16(accHi, vget_high_s16(a), weights[j]);
+        }
+        int16x8_t sum = vcombine_s16(vshrn_n_s32(accLo, 14), vshrn_n_s32(accHi, 14));
+        vst1_u8(out + x, vqmovun_s16(sum));
+    }
+    columnTail(rows, weights, taps, x, width, out);
+}
+#endif
+
+// 按名字取一组转换实现，CPU 不支持或未编译时返回 false
+static bool kernelsByName(const QString &name, YuvConverter::RowKernel *row, YuvConverter::ColumnKernel *column)
+{
+    const int flags = av_get_cpu_flags();
+    if (name == "c") {
+        *row = rowC;
+        *column = columnC;
+        return true;
+    }
+#ifdef VP_YUV_X86
+    if (name == "avx2" && (flags & AV_CPU_FLAG_AVX2)) {
+        *row = rowAvx2;
+        *column = columnAvx2;
+        return true;
+    }
+    if (name == "sse4.1" && (flags & AV_CPU_FLAG_SSE4)) {
+        *row = rowSse41;
+        *column = columnSse41;
+        return true;
+    }
+#endif
+#ifdef VP_YUV_NEON
+    if (name == "neon" && (flags & AV_CPU_FLAG_NEON)) {
+        *row = rowNeon;
+        *column = columnNeon;
+        return true;
+    }
+#endif
+    Q_UNUSED(flags);
+    return false;
+}
+
+YuvConverter::YuvConverter()
+    : mKernel(nullptr), mColumnKernel(nullptr), mRows(nullptr), mCoeff(kLimitedRange),
+      mSrcWidth(0), mSrcHeight(0), mDstWidth(0), mDstHeight(0)
+{
+    setSimd("auto");
+}
+
+bool YuvConverter::setSimd(const QString &name)
+{
+    if (name == "auto") {
+        for (const char *candidate : { "avx2", "sse4.1", "neon", "c" }) {
+            if (setSimd(candidate))
+                return true;
+        }
+        return false;
+    }
+    if (!kernelsByName(name, &mKernel, &mColumnKernel))
+        return false;
+    mKernelName = name;
+    return true;
+}
+
+QString YuvConverter::simdName() const
+{
+    return mKernelName;
+}
+
+bool YuvConverter::supportsFormat(int format)
+{
+    return format == AV_PIX_FMT_YUV420P || format == AV_PIX_FMT_YUVJ420P || format == AV_PIX_FMT_NV12;
+}
+
+// 三角滤波：放大时是双线性，缩小时支撑范围按比例放宽，覆盖对应的整块源像素
+void YuvConverter::buildFilter(FilterTable *table, int srcSize, int dstSize)
+{
+    const double scale = double(srcSize) / dstSize;
+    const double support = qMax(1.0, scale);
+    const int taps = qMin(int(std::ceil(support * 2)) + 1, srcSize);
+
+    table->taps = taps;
+    table->start.resize(dstSize);
+    table->weights.resize(dstSize * taps);
+    std::vector<double> w(taps);
+    for (int i = 0; i < dstSize; i++) {
+        const double center = (i + 0.5) * scale - 0.5;
+        int first = int(std::floor(center - support)) + 1;
+        first = qBound(0, first, srcSize - taps);
+
+        double sum = 0;
+        for (int j = 0; j < taps; j++) {
+            double d = std::fabs(first + j - center) / support;
+            w[j] = d < 1.0 ? 1.0 - d : 0.0;
+            sum += w[j];
+        }
+        qint16 *weights = table->weights.data() + i * taps;
+        int total = 0, peak = 0;
+        for (int j = 0; j < taps; j++) {
+            weights[j] = qint16(qRound(w[j] / sum * 16384));
+            total += weights[j];
+            if (weights[j] > weights[peak])
+                peak = j;
+        }
+        weights[peak] += qint16(16384 - total);   // 舍入误差补到最大的权重上
+        table->start[i] = first;
+    }
+}
+
+bool YuvConverter::prepare(const AVFrame *src, int dstWidth, int dstHeight)
+{
+    mRows = nullptr;
+    if (!supportsFormat(src->format) || src->width < 2 || src->height < 2
+            || dstWidth < 1 || dstHeight < 1)
+        return false;
+
+    const bool full = src->format == AV_PIX_FMT_YUVJ420P || src->color_range == AVCOL_RANGE_JPEG;
+    mCoeff = full ? kFullRange : kLimitedRange;
+
+    const bool interleaved = src->format == AV_PIX_FMT_NV12;
+    const bool scaled = src->width != dstWidth || src->height != dstHeight;
+    if (scaled) {
+        const int chromaWidth = (src->width + 1) / 2, chromaHeight = (src->height + 1) / 2;
+        buildFilter(&mLumaX, src->width, dstWidth);
+        buildFilter(&mLumaY, src->height, dstHeight);
+        buildFilter(&mChromaX, chromaWidth, (dstWidth + 1) / 2);
+        buildFilter(&mChromaY, chromaHeight, dstHeight);
+    }
+    mSrcWidth = src->width;
+    mSrcHeight = src->height;
+    mDstWidth = dstWidth;
+    mDstHeight = dstHeight;
+
+    if (interleaved)
+        mRows = scaled ? &YuvConverter::convertRowsT<true, true> : &YuvConverter::convertRowsT<true, false>;
+    else
+        mRows = scaled ? &YuvConverter::convertRowsT<false, true> : &YuvConverter::convertRowsT<false, false>;
+    return true;
+}
+
+void YuvConverter::convertRows(const AVFrame *src, uint8_t *dst, int dstStride, int dstY0, int dstY1) const
+{
+    if (mRows)
+        (this->*mRows)(src, dst, dstStride, dstY0, dstY1);
+}
+
+// 垂直方向：对 taps 行源数据加权，得到一行（宽度 width）。抽头数补成偶数，补的一行权重为 0
+static void filterRows(YuvConverter::ColumnKernel kernel, const uint8_t *plane, int linesize, int width,
+                       int start, int taps, const qint16 *weights,
+                       std::vector<const uint8_t *> *rows, std::vector<qint16> *padded, uint8_t *out)
+{
+    const int even = (taps + 1) & ~1;
+    rows->resize(even);
+    padded->resize(even);
+    for (int j = 0; j < taps; j++) {
+        (*rows)[j] = plane + qint64(start + j) * linesize;
+        (*padded)[j] = weights[j];
+    }
+    if (even != taps) {
+        (*rows)[taps] = (*rows)[taps - 1];
+        (*padded)[taps] = 0;
+    }
+    kernel(rows->data(), padded->data(), even, width, out);
+}
+
+// 水平方向：每个输出样本对 taps 个相邻源样本加权
+static void filterColumns(const uint8_t *in, int taps, const int *starts, const qint16 *weights,
+                          int outWidth, uint8_t *out)
+{
+    for (int i = 0; i < outWidth; i++) {
+        const uint8_t *s = in + starts[i];
+        const qint16 *w = weights + i * taps;
+        int sum = 8192;
+        for (int j = 0; j < taps; j++)
+            sum += w[j] * s[j];
+        out[i] = uint8_t(sum >> 14);
+    }
+}
+
+static void deinterleave(const uint8_t *uv, uint8_t *u, uint8_t *v, int count)
+{
+    for (int i = 0; i < count; i++) {
+        u[i] = uv[2 * i];
+        v[i] = uv[2 * i + 1];
+    }
+}
+
+template <bool Interleaved, bool Scaled>
+void YuvConverter::convertRowsT(const AVFrame *src, uint8_t *dst, int dstStride, int dstY0, int dstY1) const
+{
+    const int srcChromaWidth = (mSrcWidth + 1) / 2;
+    const int dstChromaWidth = (mDstWidth + 1) / 2;
+
+    // 每次调用（每个条带）分配一次临时行，行与行之间复用
+    std::vector<uint8_t> uSrc, vSrc, column, yLine, uLine, vLine;
+    std::vector<const uint8_t *> rows;
+    std::vector<qint16> weights;
+    if (Interleaved) {
+        uSrc.resize(srcChromaWidth);
+        vSrc.resize(srcChromaWidth);
+    }
+    if (Scaled) {
+        const int columnWidth = qMax(mSrcWidth, srcChromaWidth * 2);
+        column.resize(columnWidth);
+        yLine.resize(mDstWidth);
+        uLine.resize(dstChromaWidth);
+        vLine.resize(dstChromaWidth);
+    }
+
+    for (int dy = dstY0; dy < dstY1; dy++) {
+        const uint8_t *yRow, *uRow, *vRow;
+        if (!Scaled) {
+            const int cy = dy >> 1;
+            yRow = src->data[0] + qint64(dy) * src->linesize[0];
+            if (Interleaved) {
+                deinterleave(src->data[1] + qint64(cy) * src->linesize[1], uSrc.data(), vSrc.data(), srcChromaWidth);
+                uRow = uSrc.data();
+                vRow = vSrc.data();
+            } else {
+                uRow = src->data[1] + qint64(cy) * src->linesize[1];
+                vRow = src->data[2] + qint64(cy) * src->linesize[2];
+            }
+        } else {
+            filterRows(mColumnKernel, src->data[0], src->linesize[0], mSrcWidth, mLumaY.start[dy], mLumaY.taps,
+                       mLumaY.weights.data() + dy * mLumaY.taps, &rows, &weights, column.data());
+            filterColumns(column.data(), mLumaX.taps, mLumaX.start.data(), mLumaX.weights.data(),
+                          mDstWidth, yLine.data());
+
+            const int cs = mChromaY.start[dy];
+            const qint16 *cw = mChromaY.weights.data() + dy * mChromaY.taps;
+            if (Interleaved) {
+                // 交错的 UV 行可以整行做垂直滤波，再拆成两个平面
+                filterRows(mColumnKernel, src->data[1], src->linesize[1], srcChromaWidth * 2, cs, mChromaY.taps,
+                           cw, &rows, &weights, column.data());
+                deinterleave(column.data(), uSrc.data(), vSrc.data(), srcChromaWidth);
+                filterColumns(uSrc.data(), mChromaX.taps, mChromaX.start.data(), mChromaX.weights.data(),
+                              dstChromaWidth, uLine.data());
+                filterColumns(vSrc.data(), mChromaX.taps, mChromaX.start.data(), mChromaX.weights.data(),
+                              dstChromaWidth, vLine.data());
+            } else {
+                filterRows(mColumnKernel, src->data[1], src->linesize[1], srcChromaWidth, cs, mChromaY.taps,
+                           cw, &rows, &weights, column.data());
+                filterColumns(column.data(), mChromaX.taps, mChromaX.start.data(), mChromaX.weights.data(),
+                              dstChromaWidth, uLine.data());
+                filterRows(mColumnKernel, src->data[2], src->linesize[2], srcChromaWidth, cs, mChromaY.taps,
+                           cw, &rows, &weights, column.data());
+                filterColumns(column.data(), mChromaX.taps, mChromaX.start.data(), mChromaX.weights.data(),
+                              dstChromaWidth, vLine.data());
+            }
+            yRow = yLine.data();
+            uRow = uLine.data();
+            vRow = vLine.data();
+        }
+        mKernel(yRow, uRow, vRow, dst + qint64(dy) * dstStride, mDstWidth, mCoeff);
+    }
+}
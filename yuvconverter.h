@@ -0,0 +1,72 @@
+#ifndef YUVCONVERTER_H
+#define YUVCONVERTER_H
+
+#include <QString>
+#include <QVector>
+
+extern "C" {
+    #include <libavutil/frame.h>
+}
+
+// 常见情况的专用转换：YUV420P/YUVJ420P/NV12 -> RGB32，可同时缩放到显示尺寸。
+// 像素格式（平面/交错色度）和缩放方式（原尺寸/缩放）在编译期展开成不同的模板实例，
+// 行内颜色转换按 CPU 在运行时选择 AVX2/SSE4.1/NEON/C 实现。
+// 不支持的格式由 prepare() 返回 false，调用方退回 sws_scale。
+//
+// 颜色：BT.601，按 color_range 区分有限/全范围（与 sws_scale 的默认行为和 GL 画面一致）。
+// 缩放：可分离的三角滤波，缩小时按比例放宽支撑范围，相当于双线性 + 面积平均。
+class YuvConverter
+{
+public:
+    YuvConverter();
+
+    // 为给定的源帧参数和目标尺寸准备转换表，不支持时返回 false
+    bool prepare(const AVFrame *src, int dstWidth, int dstHeight);
+    bool isPrepared() const { return mRows != nullptr; }
+
+    // 输出目标的 [dstY0, dstY1) 行；不相交的行区间可以在多个线程里并发转换
+    void convertRows(const AVFrame *src, uint8_t *dst, int dstStride, int dstY0, int dstY1) const;
+
+    // 当前使用的行内转换实现："avx2"、"sse4.1"、"neon" 或 "c"
+    QString simdName() const;
+    // 强制使用某个实现（基准测试对比用），"auto" 恢复自动选择；CPU 不支持时返回 false
+    bool setSimd(const QString &name);
+
+    static bool supportsFormat(int format);
+
+    // 三个分量的定点系数（Q6），由 color_range 决定
+    struct Coefficients {
+        qint16 yOffset, yMul;      // y' = (Y - yOffset) * yMul，yHalf 为 -1 时再加上 (Y - yOffset) >> 1
+        qint16 yHalf;
+        qint16 vr, ug, vg, ub;
+    };
+    typedef void (*RowKernel)(const uint8_t *y, const uint8_t *u, const uint8_t *v,
+                              uint8_t *dst, int width, const Coefficients &c);
+    // 缩放时的垂直滤波：rows/weights 各 taps 个（taps 为偶数，多出的一行权重为 0）
+    typedef void (*ColumnKernel)(const uint8_t *const *rows, const qint16 *weights, int taps,
+                                 int width, uint8_t *out);
+
+private:
+    struct FilterTable {
+        int taps = 0;
+        QVector<int> start;        // 每个输出样本的第一个源样本
+        QVector<qint16> weights;   // 每个输出样本 taps 个权重，Q14，和为 16384
+    };
+    static void buildFilter(FilterTable *table, int srcSize, int dstSize);
+
+    template <bool Interleaved, bool Scaled>
+    void convertRowsT(const AVFrame *src, uint8_t *dst, int dstStride, int dstY0, int dstY1) const;
+    typedef void (YuvConverter::*RowsFunc)(const AVFrame *, uint8_t *, int, int, int) const;
+
+    RowKernel mKernel;
+    ColumnKernel mColumnKernel;
+    QString mKernelName;
+    RowsFunc mRows;
+    Coefficients mCoeff;
+
+    int mSrcWidth, mSrcHeight;
+    int mDstWidth, mDstHeight;
+    FilterTable mLumaX, mLumaY, mChromaX, mChromaY;
+};
+
+#endif // YUVCONVERTER_H